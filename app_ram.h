@@ -0,0 +1,115 @@
+#ifndef __APP_RAM_H_
+#define __APP_RAM_H_
+
+/**@file
+ *
+ * @brief SoftDevice configuration that sets the RAM of the application: link counts, vendor
+ *        specific UUIDs and the attribute table computed from the services of main.c.
+ *
+ * @details The armgcc Makefile runs this file through the preprocessor to place the RAM region
+ *          of the linker script at APP_RAM_START, so it holds macros only, with plain integer
+ *          expressions that the linker can evaluate. main.c checks the constants restated here
+ *          against the SDK headers and gives the same configuration to the SoftDevice.
+ *
+ *          APP_ATTR_SIZE is an estimate, so the computed table and RAM start are only used once
+ *          checked on a board, see APP_RAM_CHECK. Until then the three projects link at the RAM
+ *          start of app_ram_base.h, which holds any table up to the default size.
+ */
+
+#include "app_ram_base.h"
+
+#define CENTRAL_LINK_COUNT              0                         /**< Number of central links used by the application. */
+#define PERIPHERAL_LINK_COUNT           1                         /**< Number of peripheral links used by the application. */
+#define APP_VS_UUID_COUNT               1                         /**< Vendor specific UUID bases: the one of cus_service, shared by its instances. */
+
+#define APP_RAM_END                     0x20008000                /**< End of the RAM of the nRF51422 xxAC (32 KB). */
+
+/**@brief State of the check of APP_ATTR_TAB_SIZE and APP_RAM_BASE on a board.
+ *
+ * @details 0: not checked. The SoftDevice gets its default attribute table and the application
+ *             RAM starts where app_ram_base.h puts it for that table.
+ *          1: check run. The RAM start is the same, with room for any table up to the default,
+ *             but the SoftDevice gets APP_ATTR_TAB_SIZE. The services must fit in it, and
+ *             ble_stack_init prints the RAM start that sd_ble_enable asks for next to
+ *             APP_RAM_BASE.
+ *          2: checked, both matched. The SoftDevice gets APP_ATTR_TAB_SIZE and the armgcc link
+ *             starts at APP_RAM_BASE. The Keil and IAR projects are edited to the same start.
+ */
+#define APP_RAM_CHECK                   0
+
+/**@brief Attribute table of the SoftDevice defaults, which the RAM bases of app_ram_base.h are
+ *        given for, and the smallest table, which holds the GAP and GATT services of the
+ *        SoftDevice (BLE_GATTS_ATTR_TAB_SIZE_DEFAULT and BLE_GATTS_ATTR_TAB_SIZE_MIN). */
+#define APP_ATTR_TAB_SIZE_SD_DEFAULT    0x580
+#define APP_ATTR_TAB_SIZE_SD_MIN        216
+#define APP_VS_UUID_COUNT_SD_DEFAULT    1
+#define APP_VS_UUID_SIZE                16                        /**< RAM of the SoftDevice for each vendor specific UUID base. */
+
+/**@brief Bytes of an attribute in the table before its value. An estimate, the same as the host
+ *        emulator (tools/host): the layout of the SoftDevice is not public. */
+#define APP_ATTR_SIZE                   12
+#define APP_ATTR_TAB_MARGIN             64                        /**< Room for the estimate to be short. */
+
+/**@brief Attribute whose value of len bytes is kept by the SoftDevice, rounded to words. */
+#define APP_ATTR_STACK(len)             (APP_ATTR_SIZE + ((len) + 3) / 4 * 4)
+
+#define APP_CHAR_LEN                    20                        /**< BLE_CUSTOM_MAX_DATA_LEN. */
+#define APP_SERVICE_DECL                APP_ATTR_STACK(16)        /**< Primary service, 128-bit UUID. */
+#define APP_CHAR_DECL                   APP_ATTR_STACK(1 + 2 + 16)  /**< Properties, value handle and 128-bit UUID. */
+#define APP_CCCD                        APP_ATTR_STACK(2)
+
+/**@brief Instances of cus_service, as X(instance, settings, write_in_stack, read_in_stack, diag):
+ *        the ble_cus_t of main.c, the function of main.c that fills the rest of its
+ *        ble_cus_init_t, whether the WRITE and READ values are kept by the SoftDevice (otherwise
+ *        in the buffers <instance>_write_value and <instance>_read_value of main.c) and whether
+ *        the diagnostics characteristic is added. services_init adds the instances from this
+ *        list, so it is what the attribute table is sized for. The flags are written 0 or 1:
+ *        main.c pastes them into macro names.
+ */
+#define APP_CUS_SERVICES(X)                                                                     \
+    X(m_cus,  service1_settings, 1, 0, 0)                         /* UART stream. */            \
+    X(m_cus2, service2_settings, 0, 0, 1)                         /* Channels and diagnostics. */
+
+/**@brief Attributes added by ble_cus_init: the service, the WRITE and READ characteristics,
+ *        the NOTIFY characteristic and its CCCD, then the diagnostics characteristic. */
+#define APP_CUS_ATTR_COUNT(write_in_stack, read_in_stack, diag)                                  \
+    (1 + 2 + 2 + 3 + 2 * (diag))
+
+#define APP_CUS_ATTR_TAB_SIZE(write_in_stack, read_in_stack, diag)                               \
+    (APP_SERVICE_DECL                                                                           \
+     + APP_CHAR_DECL + APP_ATTR_SIZE + (write_in_stack) * (APP_ATTR_STACK(APP_CHAR_LEN) - APP_ATTR_SIZE) \
+     + APP_CHAR_DECL + APP_ATTR_SIZE + (read_in_stack) * (APP_ATTR_STACK(APP_CHAR_LEN) - APP_ATTR_SIZE)  \
+     + APP_CHAR_DECL + APP_ATTR_STACK(APP_CHAR_LEN) + APP_CCCD                                  \
+     + (diag) * (APP_CHAR_DECL + APP_ATTR_SIZE))
+
+#define APP_CUS_ATTR_COUNT_ADD(i, s, w, r, d)     + APP_CUS_ATTR_COUNT(w, r, d)
+#define APP_CUS_ATTR_TAB_SIZE_ADD(i, s, w, r, d)  + APP_CUS_ATTR_TAB_SIZE(w, r, d)
+
+/**@brief Attributes of the application, and the attribute table, rounded to words. */
+#define APP_ATTR_COUNT                  (0 APP_CUS_SERVICES(APP_CUS_ATTR_COUNT_ADD))
+#define APP_ATTR_TAB_SIZE               ((APP_ATTR_TAB_SIZE_SD_MIN APP_CUS_SERVICES(APP_CUS_ATTR_TAB_SIZE_ADD) \
+                                          + APP_ATTR_TAB_MARGIN + 3) / 4 * 4)
+
+/**@brief Start of the RAM of the application. The SoftDevice RAM grows byte for byte with the
+ *        attribute table and by APP_VS_UUID_SIZE for each vendor specific UUID base. */
+#define APP_RAM_BASE_SD_DEFAULT_(c, p)  APP_RAM_BASE_CENTRAL_LINKS_##c##_PERIPH_LINKS_##p##_SEC_COUNT_0_MID_BW
+#define APP_RAM_BASE_SD_DEFAULT(c, p)   APP_RAM_BASE_SD_DEFAULT_(c, p)
+
+#define APP_RAM_BASE                    (APP_RAM_BASE_SD_DEFAULT(CENTRAL_LINK_COUNT, PERIPHERAL_LINK_COUNT) \
+                                         + APP_ATTR_TAB_SIZE - APP_ATTR_TAB_SIZE_SD_DEFAULT                 \
+                                         + (APP_VS_UUID_COUNT - APP_VS_UUID_COUNT_SD_DEFAULT) * APP_VS_UUID_SIZE)
+
+/**@brief Attribute table given to the SoftDevice, and start of the RAM of the application in the
+ *        link, as far as APP_RAM_CHECK allows. */
+#if APP_RAM_CHECK == 2
+#define APP_ATTR_TAB_SIZE_ENABLE        APP_ATTR_TAB_SIZE
+#define APP_RAM_START                   APP_RAM_BASE
+#elif APP_RAM_CHECK == 1
+#define APP_ATTR_TAB_SIZE_ENABLE        APP_ATTR_TAB_SIZE
+#define APP_RAM_START                   APP_RAM_BASE_SD_DEFAULT(CENTRAL_LINK_COUNT, PERIPHERAL_LINK_COUNT)
+#else
+#define APP_ATTR_TAB_SIZE_ENABLE        APP_ATTR_TAB_SIZE_SD_DEFAULT
+#define APP_RAM_START                   APP_RAM_BASE_SD_DEFAULT(CENTRAL_LINK_COUNT, PERIPHERAL_LINK_COUNT)
+#endif
+
+#endif
@@ -0,0 +1,341 @@
+#include "cus_arq.h"
+
+#include "sdk_common.h"
+#include "app_util_platform.h"
+
+
+#define ARQ_SACK_BITS                   8                         /**< Frames covered by the SACK bitmap. */
+
+
+// Slots are indexed by sequence number, which wraps at 256.
+STATIC_ASSERT((CUS_ARQ_WINDOW_MAX > 0) && (CUS_ARQ_WINDOW_MAX <= 128) &&
+              ((CUS_ARQ_WINDOW_MAX & (CUS_ARQ_WINDOW_MAX - 1)) == 0));
+
+
+static cus_arq_slot_t * slot_get(cus_arq_t * p_arq, uint8_t seq)
+{
+    return &p_arq->slots[seq & (CUS_ARQ_WINDOW_MAX - 1)];
+}
+
+
+static void timer_stop(cus_arq_t * p_arq)
+{
+    if (p_arq->timer_running)
+    {
+        UNUSED_RETURN_VALUE(app_timer_stop(p_arq->timer_id));
+        p_arq->timer_running = false;
+    }
+}
+
+
+/**@brief Function for sending the pending frames, oldest first, while the TX scheduler accepts them. */
+static void arq_pump(cus_arq_t * p_arq)
+{
+    ble_cus_t * p_cus = p_arq->p_cus;
+
+    if ((p_cus->conn_handle == BLE_CONN_HANDLE_INVALID) || !p_cus->is_notification_enabled)
+    {
+        return;
+    }
+
+    for (uint8_t i = 0; i < p_arq->count; i++)
+    {
+        cus_arq_slot_t * p_slot = slot_get(p_arq, p_arq->base_seq + i);
+
+        if (!p_slot->pending)
+        {
+            continue;
+        }
+        cus_tx_stamp_next(p_cus->tx_id, p_slot->stamp);
+        if (ble_cus_string_send(p_cus, p_slot->frame, p_slot->len) != NRF_SUCCESS)
+        {
+            // Scheduler full, continue on the next TX complete.
+            break;
+        }
+        p_slot->pending = false;
+        p_slot->stamp   = CUS_TX_STAMP_NONE;
+        p_slot->tx_mark = cus_tx_queue_mark(p_cus->tx_id);
+        UNUSED_RETURN_VALUE(app_timer_cnt_get(&p_slot->sent_ticks));
+    }
+
+    if ((p_arq->count > 0) && !p_arq->timer_running)
+    {
+        p_arq->acked_at_tick = p_arq->stats.acked;
+        if (app_timer_start(p_arq->timer_id, p_arq->timeout_ticks, p_arq) == NRF_SUCCESS)
+        {
+            p_arq->timer_running = true;
+        }
+    }
+}
+
+
+static void frame_retransmit(cus_arq_t * p_arq, cus_arq_slot_t * p_slot)
+{
+    if (!p_slot->pending)
+    {
+        p_slot->pending = true;
+        p_arq->stats.retransmitted++;
+    }
+}
+
+
+/**@brief Function for checking that a frame had a whole period to be acknowledged.
+ *
+ * @details The period starts once the last copy of the frame has left the TX scheduler: a copy
+ *          still queued has not reached the peer, and sending the frame again would only queue a
+ *          duplicate.
+ */
+static bool frame_timed_out(cus_arq_t * p_arq, cus_arq_slot_t * p_slot)
+{
+    uint32_t now;
+    uint32_t ticks;
+
+    if (p_slot->pending)
+    {
+        return false;
+    }
+
+    UNUSED_RETURN_VALUE(app_timer_cnt_get(&now));
+
+    if (!cus_tx_queue_passed(p_arq->p_cus->tx_id, p_slot->tx_mark))
+    {
+        p_slot->sent_ticks = now;
+        return false;
+    }
+
+    UNUSED_RETURN_VALUE(app_timer_cnt_diff_compute(now, p_slot->sent_ticks, &ticks));
+
+    return ticks >= p_arq->timeout_ticks;
+}
+
+
+/**@brief Function for handling the stream timer, running as long as frames are not acknowledged.
+ *
+ * @details If nothing was acknowledged during a whole period, and the oldest frame had that long
+ *          since it left the TX scheduler, it is sent again; the SACK of the peer's answer then
+ *          tells which others are missing.
+ */
+static void arq_timeout_handler(void * p_context)
+{
+    cus_arq_t * p_arq = (cus_arq_t *)p_context;
+
+    if (p_arq->count == 0)
+    {
+        timer_stop(p_arq);
+        return;
+    }
+
+    if ((p_arq->stats.acked == p_arq->acked_at_tick) &&
+        frame_timed_out(p_arq, slot_get(p_arq, p_arq->base_seq)))
+    {
+        p_arq->stats.timeouts++;
+        frame_retransmit(p_arq, slot_get(p_arq, p_arq->base_seq));
+    }
+
+    // New period: a gap reported by a SACK may be filled again once.
+    for (uint8_t i = 0; i < p_arq->count; i++)
+    {
+        slot_get(p_arq, p_arq->base_seq + i)->fast_retx = false;
+    }
+
+    p_arq->acked_at_tick = p_arq->stats.acked;
+
+    arq_pump(p_arq);
+}
+
+
+uint32_t cus_arq_init(cus_arq_t * p_arq, cus_arq_init_t const * p_arq_init)
+{
+    VERIFY_PARAM_NOT_NULL(p_arq);
+    VERIFY_PARAM_NOT_NULL(p_arq_init);
+    VERIFY_PARAM_NOT_NULL(p_arq_init->p_cus);
+    VERIFY_TRUE((p_arq_init->window > 0) && (p_arq_init->window <= CUS_ARQ_WINDOW_MAX), NRF_ERROR_INVALID_PARAM);
+    VERIFY_TRUE(p_arq_init->timeout_ticks != 0, NRF_ERROR_INVALID_PARAM);
+
+    memset(p_arq, 0, sizeof(*p_arq));
+
+    p_arq->p_cus         = p_arq_init->p_cus;
+    p_arq->window        = p_arq_init->window;
+    p_arq->timeout_ticks = p_arq_init->timeout_ticks;
+    p_arq->timer_id      = &p_arq->timer_data;
+
+    return app_timer_create(&p_arq->timer_id, APP_TIMER_MODE_REPEATED, arq_timeout_handler);
+}
+
+
+void cus_arq_on_ble_evt(cus_arq_t * p_arq, ble_evt_t * p_ble_evt)
+{
+    switch (p_ble_evt->header.evt_id)
+    {
+        case BLE_GATTS_EVT_WRITE:
+            if (p_ble_evt->evt.gatts_evt.params.write.handle == p_arq->p_cus->notify_custom_value_handles.cccd_handle)
+            {
+                arq_pump(p_arq);
+            }
+            break;
+
+        case BLE_EVT_TX_COMPLETE:
+            arq_pump(p_arq);
+            break;
+
+        case BLE_GAP_EVT_DISCONNECTED:
+            // The frames the peer did not acknowledge are exactly those still retained: send them
+            // all again once a peer enables notifications.
+            timer_stop(p_arq);
+            for (uint8_t i = 0; i < p_arq->count; i++)
+            {
+                cus_arq_slot_t * p_slot = slot_get(p_arq, p_arq->base_seq + i);
+
+                p_slot->sacked = false;
+                frame_retransmit(p_arq, p_slot);
+            }
+            break;
+
+        default:
+            // No implementation needed.
+            break;
+    }
+}
+
+
+uint32_t cus_arq_on_write(cus_arq_t * p_arq, uint8_t ** pp_data, uint16_t * p_length)
+{
+    VERIFY_PARAM_NOT_NULL(p_arq);
+    VERIFY_PARAM_NOT_NULL(pp_data);
+    VERIFY_PARAM_NOT_NULL(p_length);
+
+    if (*p_length < CUS_ARQ_ACK_LEN)
+    {
+        return NRF_ERROR_INVALID_LENGTH;
+    }
+
+    uint8_t next_seq = (*pp_data)[0];
+    uint8_t sack     = (*pp_data)[1];
+    uint8_t acked    = (uint8_t)(next_seq - p_arq->base_seq);
+
+    *pp_data  += CUS_ARQ_ACK_LEN;
+    *p_length -= CUS_ARQ_ACK_LEN;
+
+    CRITICAL_REGION_ENTER();
+
+    // Cumulative part. An older acknowledgement than the last one is ignored.
+    if ((acked > 0) && (acked <= p_arq->count))
+    {
+        for (uint8_t i = 0; i < acked; i++)
+        {
+            cus_arq_slot_t * p_slot = slot_get(p_arq, p_arq->base_seq + i);
+
+            p_slot->pending = false;
+            p_slot->sacked  = false;
+        }
+        p_arq->base_seq     += acked;
+        p_arq->count        -= acked;
+        p_arq->stats.acked  += acked;
+
+        if (p_arq->count == 0)
+        {
+            timer_stop(p_arq);
+        }
+    }
+
+    // Selective part: the frames before the last one received out of order are missing.
+    if ((sack != 0) && (next_seq == p_arq->base_seq))
+    {
+        uint8_t last = 0;
+
+        for (uint8_t i = 0; (i < ARQ_SACK_BITS) && ((i + 1) < p_arq->count); i++)
+        {
+            if (sack & (1 << i))
+            {
+                slot_get(p_arq, p_arq->base_seq + 1 + i)->sacked = true;
+                last = i + 1;
+            }
+        }
+
+        for (uint8_t i = 0; i < last; i++)
+        {
+            cus_arq_slot_t * p_slot = slot_get(p_arq, p_arq->base_seq + i);
+
+            if (!p_slot->sacked && !p_slot->fast_retx)
+            {
+                p_slot->fast_retx = true;
+                frame_retransmit(p_arq, p_slot);
+            }
+        }
+    }
+
+    arq_pump(p_arq);
+
+    CRITICAL_REGION_EXIT();
+
+    return NRF_SUCCESS;
+}
+
+
+uint8_t * cus_arq_buf_get(cus_arq_t * p_arq)
+{
+    uint8_t * p_buf = NULL;
+
+    CRITICAL_REGION_ENTER();
+
+    if (p_arq->open || (p_arq->count < p_arq->window))
+    {
+        p_arq->open = true;
+        p_buf       = &slot_get(p_arq, p_arq->base_seq + p_arq->count)->frame[1];
+    }
+    else
+    {
+        p_arq->stats.window_full++;
+    }
+
+    CRITICAL_REGION_EXIT();
+
+    return p_buf;
+}
+
+
+uint32_t cus_arq_buf_commit(cus_arq_t * p_arq, uint16_t length, uint32_t stamp)
+{
+    VERIFY_PARAM_NOT_NULL(p_arq);
+    VERIFY_TRUE(p_arq->open, NRF_ERROR_INVALID_STATE);
+    VERIFY_TRUE((length > 0) && (length <= CUS_ARQ_MAX_DATA_LEN), NRF_ERROR_INVALID_PARAM);
+
+    CRITICAL_REGION_ENTER();
+
+    uint8_t          seq    = p_arq->base_seq + p_arq->count;
+    cus_arq_slot_t * p_slot = slot_get(p_arq, seq);
+
+    p_slot->frame[0]  = seq;
+    p_slot->len       = length + 1;
+    p_slot->pending   = true;
+    p_slot->sacked    = false;
+    p_slot->fast_retx = false;
+    p_slot->stamp     = stamp;
+
+    p_arq->count++;
+    p_arq->open = false;
+    p_arq->stats.sent++;
+
+    arq_pump(p_arq);
+
+    CRITICAL_REGION_EXIT();
+
+    return NRF_SUCCESS;
+}
+
+
+uint32_t cus_arq_window_set(cus_arq_t * p_arq, uint8_t window)
+{
+    VERIFY_PARAM_NOT_NULL(p_arq);
+    VERIFY_TRUE((window > 0) && (window <= CUS_ARQ_WINDOW_MAX), NRF_ERROR_INVALID_PARAM);
+
+    p_arq->window = window;
+
+    return NRF_SUCCESS;
+}
+
+
+void cus_arq_stats_get(cus_arq_t const * p_arq, cus_arq_stats_t * p_stats)
+{
+    *p_stats = p_arq->stats;
+}
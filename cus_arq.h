@@ -0,0 +1,160 @@
+#ifndef __CUS_ARQ_H_
+#define __CUS_ARQ_H_
+
+#include "ble.h"
+#include "app_timer.h"
+#include "sdk_config.h"
+#include "cus_service.h"
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#ifdef __cplusplus
+	extern "C" {
+#endif
+
+/**@brief Maximum payload of a frame, after its 1-byte sequence number. */
+#define CUS_ARQ_MAX_DATA_LEN            (BLE_CUSTOM_MAX_DATA_LEN - 1)
+
+/**@brief Length of the header of every write from the peer: {next expected seq, SACK bitmap}. */
+#define CUS_ARQ_ACK_LEN                 2
+
+/**@brief Reliable stream counters. */
+typedef struct
+{
+    uint32_t sent;                                                /**< Frames sent for the first time. */
+    uint32_t retransmitted;                                       /**< Frames sent again, after a SACK gap or a timeout. */
+    uint32_t acked;                                               /**< Frames acknowledged by the peer. */
+    uint32_t timeouts;                                            /**< Timer periods without any acknowledgement, the oldest frame being out of the scheduler for as long. */
+    uint32_t window_full;                                         /**< Times no frame could be taken because the window was full. */
+} cus_arq_stats_t;
+
+/**@brief Frame retained until the peer acknowledges it. */
+typedef struct
+{
+    uint8_t                  len;                                 /**< Length of the frame, sequence number included. */
+    bool                     pending;                             /**< To be sent (again) at the next opportunity. */
+    bool                     sacked;                              /**< Received out of order by the peer, never sent again. */
+    bool                     fast_retx;                           /**< Already sent again for a SACK gap in this timer period. */
+    uint32_t                 stamp;                               /**< Stamp of the first transmission in the TX scheduler, then CUS_TX_STAMP_NONE. */
+    uint32_t                 tx_mark;                             /**< End of the scheduler queue after the last transmission, see cus_tx_queue_mark. */
+    uint32_t                 sent_ticks;                          /**< app_timer tick of the last transmission, or at which it was last seen queued. */
+    uint8_t                  frame[BLE_CUSTOM_MAX_DATA_LEN];      /**< Sequence number followed by the payload. */
+} cus_arq_slot_t;
+
+/**@brief Sliding-window reliable stream over the WRITE/NOTIFY characteristic pair of a Custom Service.
+ *
+ * @details Notifications carry {seq, payload}. Every write from the peer starts with
+ *          {next expected seq, SACK bitmap}, bit i of the bitmap meaning that frame
+ *          next + 1 + i was received out of order; the rest of the write is application data.
+ *          The peer discards frames it has already received.
+ */
+typedef struct
+{
+    ble_cus_t              * p_cus;                               /**< Service carrying the stream. */
+    cus_arq_slot_t           slots[CUS_ARQ_WINDOW_MAX];           /**< Retained frames, indexed by sequence number. */
+    uint8_t                  base_seq;                            /**< Sequence number of the oldest frame not acknowledged. */
+    uint8_t                  count;                               /**< Frames not acknowledged, from base_seq. */
+    uint8_t                  window;                              /**< Frames allowed in flight, at most CUS_ARQ_WINDOW_MAX. */
+    bool                     open;                                /**< The slot after the last frame is being filled. */
+    bool                     timer_running;
+    uint32_t                 acked_at_tick;                       /**< Acknowledgement count at the previous timer expiry. */
+    uint32_t                 timeout_ticks;
+    app_timer_t              timer_data;
+    app_timer_id_t           timer_id;
+    cus_arq_stats_t          stats;
+} cus_arq_t;
+
+/**@brief Reliable stream initialization structure. */
+typedef struct
+{
+    ble_cus_t              * p_cus;                               /**< Initialized Custom Service carrying the stream. */
+    uint8_t                  window;                              /**< Initial window, 1 to CUS_ARQ_WINDOW_MAX. */
+    uint32_t                 timeout_ticks;                       /**< app_timer ticks without acknowledgement after which the oldest frame is sent again. */
+} cus_arq_init_t;
+
+/**@brief Function for initializing a reliable stream.
+ *
+ * @param[out] p_arq       Stream structure, supplied by the application.
+ * @param[in]  p_arq_init  Initialization parameters.
+ *
+ * @retval NRF_SUCCESS             If the stream was initialized.
+ * @retval NRF_ERROR_INVALID_PARAM If the window or the timeout is invalid.
+ */
+uint32_t cus_arq_init(cus_arq_t * p_arq, cus_arq_init_t const * p_arq_init);
+
+/**@brief Function for handling the BLE events relevant to the stream.
+ *
+ * @details Must be called after @ref ble_cus_on_ble_evt for the service carrying the stream.
+ *
+ * @param[in] p_arq      Stream structure.
+ * @param[in] p_ble_evt  Event received from the SoftDevice.
+ */
+void cus_arq_on_ble_evt(cus_arq_t * p_arq, ble_evt_t * p_ble_evt);
+
+/**@brief Function for handling a write from the peer.
+ *
+ * @details To be called from the data handler of the service. Processes the acknowledgement
+ *          header and moves p_data and length past it, to the application data.
+ *
+ * @param[in]     p_arq     Stream structure.
+ * @param[in,out] pp_data   Written data; on return, the application data.
+ * @param[in,out] p_length  Length of the written data; on return, of the application data.
+ *
+ * @retval NRF_SUCCESS              If the acknowledgement was processed.
+ * @retval NRF_ERROR_INVALID_LENGTH If the write is shorter than @ref CUS_ARQ_ACK_LEN.
+ */
+uint32_t cus_arq_on_write(cus_arq_t * p_arq, uint8_t ** pp_data, uint16_t * p_length);
+
+/**@brief Function for taking the payload buffer of the next frame.
+ *
+ * @details The buffer is @ref CUS_ARQ_MAX_DATA_LEN bytes long and lives in the retransmit
+ *          buffer, so it is filled once and never copied by the stream. Calling it again before
+ *          @ref cus_arq_buf_commit returns the same buffer.
+ *
+ * @param[in] p_arq  Stream structure.
+ *
+ * @return Payload buffer, or NULL if the window is full.
+ */
+uint8_t * cus_arq_buf_get(cus_arq_t * p_arq);
+
+/**@brief Function for sending the frame filled through @ref cus_arq_buf_get.
+ *
+ * @details The frame is retained and sent again until acknowledged, across disconnections.
+ *          Its first transmission carries the stamp (see @ref cus_tx_stamp_next), retransmissions
+ *          are not measured.
+ *
+ * @param[in] p_arq   Stream structure.
+ * @param[in] length  Payload length, 1 to @ref CUS_ARQ_MAX_DATA_LEN.
+ * @param[in] stamp   Stamp of the frame, or CUS_TX_STAMP_NONE.
+ *
+ * @retval NRF_SUCCESS             If the frame was queued for sending.
+ * @retval NRF_ERROR_INVALID_STATE If no buffer was taken.
+ * @retval NRF_ERROR_INVALID_PARAM If the length is invalid.
+ */
+uint32_t cus_arq_buf_commit(cus_arq_t * p_arq, uint16_t length, uint32_t stamp);
+
+/**@brief Function for changing the window at runtime.
+ *
+ * @details Frames already in flight beyond a smaller window are kept until acknowledged.
+ *
+ * @param[in] p_arq   Stream structure.
+ * @param[in] window  Frames allowed in flight, 1 to CUS_ARQ_WINDOW_MAX.
+ *
+ * @retval NRF_SUCCESS             If the window was changed.
+ * @retval NRF_ERROR_INVALID_PARAM If the window is out of range.
+ */
+uint32_t cus_arq_window_set(cus_arq_t * p_arq, uint8_t window);
+
+/**@brief Function for reading the stream counters.
+ *
+ * @param[in]  p_arq    Stream structure.
+ * @param[out] p_stats  Counters.
+ */
+void cus_arq_stats_get(cus_arq_t const * p_arq, cus_arq_stats_t * p_stats);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
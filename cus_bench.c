@@ -0,0 +1,335 @@
+#include "cus_bench.h"
+
+#include "sdk_common.h"
+#include "app_timer.h"
+#include "cus_tx.h"
+
+
+#define BENCH_DATA_HEADER_LEN           3                         /**< {op, offset (uint16)} in front of the data of DATA. */
+#define BENCH_CHUNK_LEN                 (CUS_MUX_MAX_DATA_LEN - BENCH_DATA_HEADER_LEN)
+#define BENCH_REC_CHUNK_LEN             (CUS_MUX_MAX_RELIABLE_DATA_LEN - BENCH_DATA_HEADER_LEN)
+#define BENCH_REPORT_LEN                (1 + 1 + 3 * sizeof(uint32_t) + 2 * sizeof(uint16_t))
+
+STATIC_ASSERT(BENCH_REPORT_LEN <= CUS_MUX_MAX_DATA_LEN);
+
+
+static cus_mux_t          * m_p_mux;
+static uint8_t              m_channel;
+static uint32_t             m_prescaler;
+static uint8_t              m_mode;                               /**< Run in progress, CUS_BENCH_MODE_IDLE if none. */
+static uint32_t             m_count;                              /**< Stream bytes of the run. */
+static uint32_t             m_offset;                             /**< Stream bytes sent, or expected next. */
+static uint32_t             m_frames;                             /**< DATA frames sent or received. */
+static uint32_t             m_lost;
+static uint8_t              m_depth;                              /**< Records of a record run not confirmed yet, at most. */
+static uint32_t             m_retransmitted;                      /**< Record counter at the start of a record run. */
+static uint32_t             m_start_ticks;
+static uint32_t             m_last_ticks;                         /**< Time of the last byte. */
+static uint32_t             m_start_events;
+static uint32_t             m_last_events;
+static cus_bench_report_t   m_report;
+
+
+static void report_send(void)
+{
+    uint8_t  frame[BENCH_REPORT_LEN];
+    uint8_t  len = 0;
+
+    frame[len++] = CUS_BENCH_OP_REPORT;
+    frame[len++] = m_report.mode;
+    len += uint32_encode(m_report.bytes,     &frame[len]);
+    len += uint32_encode(m_report.ticks,     &frame[len]);
+    len += uint16_encode(m_report.kbps,      &frame[len]);
+    len += uint16_encode(m_report.per_event, &frame[len]);
+    len += uint32_encode(m_report.lost,      &frame[len]);
+
+    UNUSED_RETURN_VALUE(cus_mux_send(m_p_mux, m_channel, frame, len));
+}
+
+
+/**@brief Function for ending the run in progress and reporting it. */
+static void run_end(void)
+{
+    uint32_t ticks  = 0;
+    uint32_t events = m_last_events - m_start_events;
+    uint32_t bytes  = (m_mode == CUS_BENCH_MODE_RX) ? (m_offset - m_lost) : m_offset;
+    uint64_t kbps   = 0;
+
+    if (m_mode == CUS_BENCH_MODE_REC)
+    {
+        ble_cus_rec_stats_t stats;
+
+        UNUSED_RETURN_VALUE(ble_cus_rec_stats_get(m_p_mux->p_cus, &stats));
+        m_lost = stats.retransmitted - m_retransmitted;
+    }
+
+    if (m_frames > 0)
+    {
+        UNUSED_RETURN_VALUE(app_timer_cnt_diff_compute(m_last_ticks, m_start_ticks, &ticks));
+    }
+    if (ticks > 0)
+    {
+        kbps = ((uint64_t)bytes * 8 * APP_TIMER_CLOCK_FREQ) / ((uint64_t)(m_prescaler + 1) * ticks * 1000);
+    }
+
+    m_report.mode      = m_mode;
+    m_report.bytes     = bytes;
+    m_report.ticks     = ticks;
+    m_report.kbps      = (uint16_t)MIN(kbps, UINT16_MAX);
+    m_report.per_event = (events > 0) ? (uint16_t)MIN((uint64_t)m_frames * 100 / events, UINT16_MAX) : 0;
+    m_report.lost      = m_lost;
+
+    m_mode = CUS_BENCH_MODE_IDLE;
+    report_send();
+}
+
+
+/**@brief Function for marking the time of the last byte of the run. */
+static void run_mark(void)
+{
+    UNUSED_RETURN_VALUE(app_timer_cnt_get(&m_last_ticks));
+    m_last_events = cus_tx_radio_event_count();
+}
+
+
+/**@brief Function for filling the TX buffers with stream data. */
+static void tx_pump(void)
+{
+    uint8_t  frame[BENCH_DATA_HEADER_LEN + BENCH_CHUNK_LEN];
+    uint32_t err_code;
+
+    while ((m_mode == CUS_BENCH_MODE_TX) && (m_offset < m_count))
+    {
+        uint16_t len = MIN(BENCH_CHUNK_LEN, m_count - m_offset);
+
+        frame[0] = CUS_BENCH_OP_DATA;
+        UNUSED_RETURN_VALUE(uint16_encode((uint16_t)m_offset, &frame[1]));
+        for (uint16_t i = 0; i < len; i++)
+        {
+            frame[BENCH_DATA_HEADER_LEN + i] = (uint8_t)(m_offset + i);
+        }
+
+        err_code = cus_mux_send(m_p_mux, m_channel, frame, BENCH_DATA_HEADER_LEN + len);
+        if (err_code == NRF_ERROR_NO_MEM)
+        {
+            // Every buffer is in use, the next TX_COMPLETE frees some.
+            m_lost++;
+            return;
+        }
+        if (err_code != NRF_SUCCESS)
+        {
+            // Notification disabled: report what was sent so far.
+            run_mark();
+            run_end();
+            return;
+        }
+
+        m_offset += len;
+        m_frames++;
+    }
+}
+
+
+/**@brief Function for sending stream data as records, as far as the depth of the run allows. */
+static void rec_pump(void)
+{
+    uint8_t  frame[BENCH_DATA_HEADER_LEN + BENCH_REC_CHUNK_LEN];
+    uint32_t err_code;
+
+    while ((m_mode == CUS_BENCH_MODE_REC) && (m_offset < m_count) && (m_p_mux->p_cus->rec.count < m_depth))
+    {
+        uint16_t len = MIN(BENCH_REC_CHUNK_LEN, m_count - m_offset);
+
+        frame[0] = CUS_BENCH_OP_DATA;
+        UNUSED_RETURN_VALUE(uint16_encode((uint16_t)m_offset, &frame[1]));
+        for (uint16_t i = 0; i < len; i++)
+        {
+            frame[BENCH_DATA_HEADER_LEN + i] = (uint8_t)(m_offset + i);
+        }
+
+        err_code = cus_mux_record_send(m_p_mux, m_channel, frame, BENCH_DATA_HEADER_LEN + len);
+        if (err_code != NRF_SUCCESS)
+        {
+            // Records disabled, or the peer enabled neither notifications nor indications.
+            run_mark();
+            run_end();
+            return;
+        }
+
+        m_offset += len;
+        m_frames++;
+    }
+
+    if ((m_mode == CUS_BENCH_MODE_REC) && (m_offset >= m_count) && (m_p_mux->p_cus->rec.count == 0))
+    {
+        // The last record is confirmed: the run is timed up to here.
+        run_mark();
+        run_end();
+    }
+}
+
+
+static void on_start(uint8_t mode, uint8_t const * p_data, uint16_t length)
+{
+    if ((length < sizeof(uint32_t)) || (uint32_decode(p_data) == 0))
+    {
+        return;
+    }
+    if ((mode == CUS_BENCH_MODE_REC) &&
+        ((length < sizeof(uint32_t) + 1) || (p_data[4] == 0) || (p_data[4] > CUS_REC_QUEUE_SIZE)))
+    {
+        return;
+    }
+
+    m_mode   = mode;
+    m_count  = uint32_decode(p_data);
+    m_offset = 0;
+    m_frames = 0;
+    m_lost   = 0;
+
+    UNUSED_RETURN_VALUE(app_timer_cnt_get(&m_start_ticks));
+    m_start_events = cus_tx_radio_event_count();
+    m_last_ticks   = m_start_ticks;
+    m_last_events  = m_start_events;
+
+    if (mode == CUS_BENCH_MODE_TX)
+    {
+        tx_pump();
+    }
+    else if (mode == CUS_BENCH_MODE_REC)
+    {
+        ble_cus_rec_stats_t stats;
+
+        UNUSED_RETURN_VALUE(ble_cus_rec_stats_get(m_p_mux->p_cus, &stats));
+        m_depth         = p_data[4];
+        m_retransmitted = stats.retransmitted;
+        rec_pump();
+    }
+}
+
+
+static void on_data(uint8_t const * p_data, uint16_t length)
+{
+    uint16_t gap;
+
+    if ((m_mode != CUS_BENCH_MODE_RX) || (length < sizeof(uint16_t)))
+    {
+        return;
+    }
+
+    if (m_frames == 0)
+    {
+        // The sink is timed from the first frame, not from START_RX.
+        UNUSED_RETURN_VALUE(app_timer_cnt_get(&m_start_ticks));
+        m_start_events = cus_tx_radio_event_count();
+    }
+
+    // Frames are never reordered, so a jump forward of the offset is the data missing.
+    gap       = uint16_decode(p_data) - (uint16_t)m_offset;
+    m_lost   += gap;
+    m_offset += gap + (length - sizeof(uint16_t));
+    m_frames++;
+    run_mark();
+
+    if (m_offset >= m_count)
+    {
+        run_end();
+    }
+}
+
+
+static void on_frame(cus_mux_t * p_mux, uint8_t channel, void * p_context, uint8_t * p_data, uint16_t length)
+{
+    UNUSED_PARAMETER(p_mux);
+    UNUSED_PARAMETER(channel);
+    UNUSED_PARAMETER(p_context);
+
+    if (length == 0)
+    {
+        return;
+    }
+
+    switch (p_data[0])
+    {
+        case CUS_BENCH_OP_START_TX:
+            on_start(CUS_BENCH_MODE_TX, &p_data[1], length - 1);
+            break;
+
+        case CUS_BENCH_OP_START_RX:
+            on_start(CUS_BENCH_MODE_RX, &p_data[1], length - 1);
+            break;
+
+        case CUS_BENCH_OP_START_REC:
+            on_start(CUS_BENCH_MODE_REC, &p_data[1], length - 1);
+            break;
+
+        case CUS_BENCH_OP_STOP:
+            if (m_mode != CUS_BENCH_MODE_IDLE)
+            {
+                run_end();
+            }
+            break;
+
+        case CUS_BENCH_OP_DATA:
+            on_data(&p_data[1], length - 1);
+            break;
+
+        default:
+            // Unknown opcode, ignored.
+            break;
+    }
+}
+
+
+uint32_t cus_bench_init(cus_mux_t * p_mux, uint8_t channel, uint32_t timer_prescaler)
+{
+    VERIFY_PARAM_NOT_NULL(p_mux);
+
+    m_p_mux     = p_mux;
+    m_channel   = channel;
+    m_prescaler = timer_prescaler;
+    m_mode      = CUS_BENCH_MODE_IDLE;
+
+    return cus_mux_channel_register(p_mux, channel, on_frame, NULL, CUS_TX_PRIO_BULK, false);
+}
+
+
+void cus_bench_on_ble_evt(ble_evt_t * p_ble_evt)
+{
+    switch (p_ble_evt->header.evt_id)
+    {
+        case BLE_EVT_TX_COMPLETE:
+            if (m_mode != CUS_BENCH_MODE_TX)
+            {
+                break;
+            }
+            tx_pump();
+            if ((m_mode == CUS_BENCH_MODE_TX) && (m_offset >= m_count) && cus_tx_idle())
+            {
+                // The last frame is on air: the run is timed up to here.
+                run_mark();
+                run_end();
+            }
+            break;
+
+        case BLE_GATTS_EVT_HVC:
+        case BLE_GATTS_EVT_WRITE:
+            // Indication confirmed, or record acknowledgement written.
+            rec_pump();
+            break;
+
+        case BLE_GAP_EVT_DISCONNECTED:
+            m_mode = CUS_BENCH_MODE_IDLE;
+            break;
+
+        default:
+            // No implementation needed.
+            break;
+    }
+}
+
+
+void cus_bench_report_get(cus_bench_report_t * p_report)
+{
+    *p_report = m_report;
+}
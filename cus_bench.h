@@ -0,0 +1,107 @@
+#ifndef __CUS_BENCH_H_
+#define __CUS_BENCH_H_
+
+#include "ble.h"
+#include "cus_mux.h"
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#ifdef __cplusplus
+	extern "C" {
+#endif
+
+/**@brief Opcodes, first byte of every frame of the benchmark channel.
+ *
+ * @details Peer to device:
+ *          - START_TX {count (uint32)}: generator run, the device notifies count bytes as fast as
+ *            the TX buffers allow.
+ *          - START_RX {count (uint32)}: sink run, the device counts the next count bytes sent
+ *            with DATA.
+ *          - START_REC {count (uint32), depth}: record run, the device sends count bytes as
+ *            reliable records, with at most depth records not confirmed yet. The service
+ *            indicates them one at a time while depth is below CUS_REC_BULK_THRESHOLD and the peer
+ *            enabled indications, otherwise notifies them for the peer to acknowledge.
+ *          - STOP: ends the run in progress, and reports it.
+ *          - DATA {offset (uint16), data}: stream bytes, sent with Write Commands.
+ *
+ *          Device to peer:
+ *          - DATA {offset (uint16), data}: stream bytes of a generator or record run. In a record
+ *            run the record sequence number follows the data.
+ *          - REPORT {mode, bytes (uint32), ticks (uint32), kbps (uint16), per_event (uint16),
+ *            lost (uint32)}: end of a run. ticks is the RTC1 time of the run, per_event the DATA
+ *            frames per connection event times 100. In a sink run lost is the number of stream
+ *            bytes missing; in a generator run it is the number of frames refused for lack of
+ *            TX buffers and sent again later, the peer counts the missing bytes itself; in a
+ *            record run it is the number of records notified again after a timeout. A record run
+ *            ends when the last record is confirmed.
+ *
+ *          Byte n of the stream is (n & 0xFF), and the offset of a DATA frame is the position of
+ *          its first byte modulo 2^16, so either side can check the data and spot gaps. All
+ *          values are little endian.
+ */
+enum
+{
+    CUS_BENCH_OP_START_TX  = 0x01,
+    CUS_BENCH_OP_START_RX  = 0x02,
+    CUS_BENCH_OP_STOP      = 0x03,
+    CUS_BENCH_OP_DATA      = 0x04,
+    CUS_BENCH_OP_START_REC = 0x05,
+    CUS_BENCH_OP_REPORT    = 0x81
+};
+
+/**@brief Mode of a run, in REPORT. */
+enum
+{
+    CUS_BENCH_MODE_IDLE = 0x00,
+    CUS_BENCH_MODE_TX   = 0x01,                                   /**< Generator. */
+    CUS_BENCH_MODE_RX   = 0x02,                                   /**< Sink. */
+    CUS_BENCH_MODE_REC  = 0x03                                    /**< Reliable records. */
+};
+
+/**@brief Result of the last run. */
+typedef struct
+{
+    uint8_t  mode;
+    uint32_t bytes;                                               /**< Stream bytes sent or received. */
+    uint32_t ticks;                                               /**< RTC1 time from the start to the last byte. */
+    uint16_t kbps;
+    uint16_t per_event;                                           /**< DATA frames per connection event, times 100. */
+    uint32_t lost;                                                /**< See REPORT. */
+} cus_bench_report_t;
+
+/**@brief Function for initializing the benchmark and registering its channel.
+ *
+ * @details All the functions of the module must run in the SoftDevice event context. The other
+ *          channels of the service should be quiet during a run, as they share its TX buffers.
+ *
+ * @param[in] p_mux            Initialized multiplexer.
+ * @param[in] channel          Channel carrying the benchmark.
+ * @param[in] timer_prescaler  Prescaler of the app_timer, to convert the ticks to kbps.
+ *
+ * @return NRF_SUCCESS on success, otherwise the error code returned by @ref cus_mux_channel_register.
+ */
+uint32_t cus_bench_init(cus_mux_t * p_mux, uint8_t channel, uint32_t timer_prescaler);
+
+/**@brief Function for handling the BLE events relevant to the benchmark.
+ *
+ * @details Continues a generator run on @ref BLE_EVT_TX_COMPLETE, and a record run on the
+ *          confirmations of the peer, and drops the run in progress on disconnection. Must be
+ *          called once per event from the application's BLE event dispatcher, after
+ *          @ref cus_tx_on_ble_evt and @ref ble_cus_on_ble_evt.
+ *
+ * @param[in] p_ble_evt  Event received from the SoftDevice.
+ */
+void cus_bench_on_ble_evt(ble_evt_t * p_ble_evt);
+
+/**@brief Function for getting the result of the last run.
+ *
+ * @param[out] p_report  Result, with mode CUS_BENCH_MODE_IDLE if no run has ended yet.
+ */
+void cus_bench_report_get(cus_bench_report_t * p_report);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,315 @@
+#include "cus_cfg.h"
+
+#include "sdk_common.h"
+#include "nrf.h"
+#include "ble_gap.h"
+#include "fstorage.h"
+#include "crc32.h"
+
+#include <stddef.h>
+
+
+#define CFG_MAGIC                       (0x43464700UL | CUS_CFG_PARAM_COUNT)  /**< "CFG" and the number of parameters: a record of another layout is not loaded. */
+#define CFG_RECORD_WORDS                (sizeof(cfg_record_t) / sizeof(uint32_t))
+
+/**@brief Configuration as stored in flash. */
+typedef struct
+{
+    uint32_t magic;
+    int32_t  values[CUS_CFG_PARAM_COUNT];
+    uint32_t crc;                                                 /**< CRC32 of the fields above. */
+} cfg_record_t;
+
+/**@brief Range of a parameter. */
+typedef struct
+{
+    int32_t min;
+    int32_t max;
+} cfg_range_t;
+
+/**@brief BAUDRATE register value of a baud rate. */
+typedef struct
+{
+    int32_t  bps;
+    uint32_t reg;
+} cfg_baudrate_t;
+
+
+static void fs_evt_handler(fs_evt_t const * const p_evt, fs_ret_t result);
+
+FS_REGISTER_CFG(fs_config_t cus_cfg_fs_config) =
+{
+    .callback  = fs_evt_handler,
+    .num_pages = 1,
+    .priority  = CUS_CFG_FS_PRIORITY
+};
+
+static const cfg_range_t m_ranges[CUS_CFG_PARAM_COUNT] =
+{
+    [CUS_CFG_MIN_CONN_INTERVAL] = {BLE_GAP_CP_MIN_CONN_INTVL_MIN, BLE_GAP_CP_MIN_CONN_INTVL_MAX},
+    [CUS_CFG_MAX_CONN_INTERVAL] = {BLE_GAP_CP_MAX_CONN_INTVL_MIN, BLE_GAP_CP_MAX_CONN_INTVL_MAX},
+    [CUS_CFG_SLAVE_LATENCY]     = {0,                             BLE_GAP_CP_SLAVE_LATENCY_MAX},
+    [CUS_CFG_CONN_SUP_TIMEOUT]  = {BLE_GAP_CP_CONN_SUP_TIMEOUT_MIN, BLE_GAP_CP_CONN_SUP_TIMEOUT_MAX},
+    [CUS_CFG_ADV_INTERVAL]      = {BLE_GAP_ADV_INTERVAL_MIN,      BLE_GAP_ADV_INTERVAL_MAX},
+    [CUS_CFG_ADV_TIMEOUT]       = {1,                             BLE_GAP_ADV_TIMEOUT_LIMITED_MAX},
+    [CUS_CFG_UART_BAUDRATE]     = {9600,                          1000000},
+    [CUS_CFG_TX_POWER]          = {-40,                           4},
+    [CUS_CFG_ARQ_WINDOW]        = {1,                             CUS_ARQ_WINDOW_MAX},
+    [CUS_CFG_TX_QUEUE_LIMIT]    = {1,                             CUS_TX_QUEUE_SIZE},
+    [CUS_CFG_TX_SYNC]           = {0,                             1},
+};
+
+static const cfg_baudrate_t m_baudrates[] =
+{
+    {9600,    UART_BAUDRATE_BAUDRATE_Baud9600},
+    {19200,   UART_BAUDRATE_BAUDRATE_Baud19200},
+    {38400,   UART_BAUDRATE_BAUDRATE_Baud38400},
+    {57600,   UART_BAUDRATE_BAUDRATE_Baud57600},
+    {115200,  UART_BAUDRATE_BAUDRATE_Baud115200},
+    {230400,  UART_BAUDRATE_BAUDRATE_Baud230400},
+    {460800,  UART_BAUDRATE_BAUDRATE_Baud460800},
+    {921600,  UART_BAUDRATE_BAUDRATE_Baud921600},
+    {1000000, UART_BAUDRATE_BAUDRATE_Baud1M},
+};
+
+static const int8_t m_tx_powers[] = {-40, -30, -20, -16, -12, -8, -4, 0, 4};  /**< Levels accepted by sd_ble_gap_tx_power_set on nRF51. */
+
+static int32_t                  m_values[CUS_CFG_PARAM_COUNT];
+static int32_t const          * m_p_defaults;
+static cus_cfg_evt_handler_t    m_evt_handler;
+static cfg_record_t             m_record;                         /**< Source of the flash write, must stay valid until it completes. */
+static bool                     m_saving;
+
+
+static cfg_baudrate_t const * baudrate_find(int32_t bps)
+{
+    for (uint32_t i = 0; i < sizeof(m_baudrates) / sizeof(m_baudrates[0]); i++)
+    {
+        if (m_baudrates[i].bps == bps)
+        {
+            return &m_baudrates[i];
+        }
+    }
+    return NULL;
+}
+
+
+static bool tx_power_valid(int32_t dbm)
+{
+    for (uint32_t i = 0; i < sizeof(m_tx_powers); i++)
+    {
+        if (m_tx_powers[i] == dbm)
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+
+/**@brief Function for checking a whole configuration. */
+static bool values_valid(int32_t const * p_values)
+{
+    for (uint32_t i = 0; i < CUS_CFG_PARAM_COUNT; i++)
+    {
+        if ((p_values[i] < m_ranges[i].min) || (p_values[i] > m_ranges[i].max))
+        {
+            return false;
+        }
+    }
+
+    if ((baudrate_find(p_values[CUS_CFG_UART_BAUDRATE]) == NULL) ||
+        !tx_power_valid(p_values[CUS_CFG_TX_POWER]))
+    {
+        return false;
+    }
+
+    if (p_values[CUS_CFG_MIN_CONN_INTERVAL] > p_values[CUS_CFG_MAX_CONN_INTERVAL])
+    {
+        return false;
+    }
+
+    // Core spec: supervision timeout (ms) > (1 + latency) * max interval (ms) * 2,
+    // that is timeout * 10 > (1 + latency) * max * 1.25 * 2.
+    if ((p_values[CUS_CFG_CONN_SUP_TIMEOUT] * 4) <=
+        ((1 + p_values[CUS_CFG_SLAVE_LATENCY]) * p_values[CUS_CFG_MAX_CONN_INTERVAL]))
+    {
+        return false;
+    }
+
+    return true;
+}
+
+
+static uint32_t record_crc(cfg_record_t const * p_record)
+{
+    return crc32_compute((uint8_t const *)p_record, offsetof(cfg_record_t, crc), NULL);
+}
+
+
+/**@brief Function for replacing the configuration and raising the event for what changed. */
+static void values_commit(int32_t const * p_values)
+{
+    cus_cfg_evt_t evt;
+
+    memset(&evt, 0, sizeof(evt));
+    evt.evt_type = CUS_CFG_EVT_CHANGED;
+
+    for (uint32_t i = 0; i < CUS_CFG_PARAM_COUNT; i++)
+    {
+        if (m_values[i] != p_values[i])
+        {
+            m_values[i]         = p_values[i];
+            evt.params.changed |= CUS_CFG_BIT(i);
+        }
+    }
+
+    if ((evt.params.changed != 0) && (m_evt_handler != NULL))
+    {
+        m_evt_handler(&evt);
+    }
+}
+
+
+static void save_done(uint32_t result)
+{
+    cus_cfg_evt_t evt;
+
+    m_saving = false;
+
+    memset(&evt, 0, sizeof(evt));
+    evt.evt_type      = CUS_CFG_EVT_SAVED;
+    evt.params.result = result;
+
+    if (m_evt_handler != NULL)
+    {
+        m_evt_handler(&evt);
+    }
+}
+
+
+/**@brief Function for handling the end of a flash operation: the erase is followed by the write. */
+static void fs_evt_handler(fs_evt_t const * const p_evt, fs_ret_t result)
+{
+    if (result != FS_SUCCESS)
+    {
+        save_done(NRF_ERROR_INTERNAL);
+        return;
+    }
+
+    switch (p_evt->id)
+    {
+        case FS_EVT_ERASE:
+            if (fs_store(&cus_cfg_fs_config, cus_cfg_fs_config.p_start_addr,
+                         (uint32_t const *)&m_record, CFG_RECORD_WORDS, NULL) != FS_SUCCESS)
+            {
+                save_done(NRF_ERROR_INTERNAL);
+            }
+            break;
+
+        case FS_EVT_STORE:
+            save_done(NRF_SUCCESS);
+            break;
+
+        default:
+            // No implementation needed.
+            break;
+    }
+}
+
+
+uint32_t cus_cfg_init(cus_cfg_init_t const * p_cfg_init)
+{
+    VERIFY_PARAM_NOT_NULL(p_cfg_init);
+    VERIFY_PARAM_NOT_NULL(p_cfg_init->p_defaults);
+    VERIFY_TRUE(values_valid(p_cfg_init->p_defaults), NRF_ERROR_INVALID_PARAM);
+
+    m_p_defaults  = p_cfg_init->p_defaults;
+    m_evt_handler = p_cfg_init->evt_handler;
+    m_saving      = false;
+
+    if (fs_init() != FS_SUCCESS)
+    {
+        return NRF_ERROR_INTERNAL;
+    }
+
+    // An erased page, a record of another layout or a record that is no longer valid (the limits
+    // changed with the firmware) all fall back to the defaults.
+    cfg_record_t const * p_stored = (cfg_record_t const *)cus_cfg_fs_config.p_start_addr;
+
+    if ((p_stored->magic == CFG_MAGIC)           &&
+        (p_stored->crc   == record_crc(p_stored)) &&
+        values_valid(p_stored->values))
+    {
+        memcpy(m_values, p_stored->values, sizeof(m_values));
+    }
+    else
+    {
+        memcpy(m_values, m_p_defaults, sizeof(m_values));
+    }
+
+    return NRF_SUCCESS;
+}
+
+
+int32_t cus_cfg_get(cus_cfg_param_t param)
+{
+    return (param < CUS_CFG_PARAM_COUNT) ? m_values[param] : 0;
+}
+
+
+uint32_t cus_cfg_uart_baudrate_reg_get(void)
+{
+    cfg_baudrate_t const * p_baudrate = baudrate_find(m_values[CUS_CFG_UART_BAUDRATE]);
+
+    // Only valid values are ever committed.
+    return (p_baudrate != NULL) ? p_baudrate->reg : UART_BAUDRATE_BAUDRATE_Baud115200;
+}
+
+
+uint32_t cus_cfg_set(cus_cfg_entry_t const * p_entries, uint8_t count)
+{
+    int32_t values[CUS_CFG_PARAM_COUNT];
+
+    VERIFY_PARAM_NOT_NULL(p_entries);
+
+    memcpy(values, m_values, sizeof(values));
+
+    for (uint8_t i = 0; i < count; i++)
+    {
+        VERIFY_TRUE(p_entries[i].param < CUS_CFG_PARAM_COUNT, NRF_ERROR_INVALID_PARAM);
+        values[p_entries[i].param] = p_entries[i].value;
+    }
+
+    VERIFY_TRUE(values_valid(values), NRF_ERROR_INVALID_PARAM);
+
+    values_commit(values);
+
+    return NRF_SUCCESS;
+}
+
+
+void cus_cfg_defaults_restore(void)
+{
+    values_commit(m_p_defaults);
+}
+
+
+uint32_t cus_cfg_save(void)
+{
+    VERIFY_TRUE(!m_saving, NRF_ERROR_BUSY);
+
+    m_record.magic = CFG_MAGIC;
+    memcpy(m_record.values, m_values, sizeof(m_record.values));
+    m_record.crc   = record_crc(&m_record);
+
+    m_saving = true;
+
+    if (fs_erase(&cus_cfg_fs_config, cus_cfg_fs_config.p_start_addr, 1, NULL) != FS_SUCCESS)
+    {
+        m_saving = false;
+        return NRF_ERROR_INTERNAL;
+    }
+
+    return NRF_SUCCESS;
+}
@@ -0,0 +1,129 @@
+#ifndef __CUS_CFG_H_
+#define __CUS_CFG_H_
+
+#include "sdk_config.h"
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#ifdef __cplusplus
+	extern "C" {
+#endif
+
+/**@brief Parameters that can be changed at runtime. */
+typedef enum
+{
+    CUS_CFG_MIN_CONN_INTERVAL,                                    /**< Preferred minimum connection interval, in 1.25 ms units. */
+    CUS_CFG_MAX_CONN_INTERVAL,                                    /**< Preferred maximum connection interval, in 1.25 ms units. */
+    CUS_CFG_SLAVE_LATENCY,                                        /**< Slave latency, in connection events. */
+    CUS_CFG_CONN_SUP_TIMEOUT,                                     /**< Supervision timeout, in 10 ms units. */
+    CUS_CFG_ADV_INTERVAL,                                         /**< Advertising interval, in 0.625 ms units. */
+    CUS_CFG_ADV_TIMEOUT,                                          /**< Advertising timeout, in seconds. */
+    CUS_CFG_UART_BAUDRATE,                                        /**< UART baud rate, in bits per second. */
+    CUS_CFG_TX_POWER,                                             /**< Radio TX power, in dBm. */
+    CUS_CFG_ARQ_WINDOW,                                           /**< Window of the reliable UART stream, in frames. */
+    CUS_CFG_TX_QUEUE_LIMIT,                                       /**< Bulk packets each service can queue in the TX scheduler. */
+    CUS_CFG_TX_SYNC,                                              /**< 1 to send bulk data just before each connection event (see cus_tx_sync_set). */
+    CUS_CFG_PARAM_COUNT
+} cus_cfg_param_t;
+
+/**@brief Bit of a parameter in @ref cus_cfg_evt_t::params.changed. */
+#define CUS_CFG_BIT(param)              (1UL << (param))
+
+/**@brief Configuration event type. */
+typedef enum
+{
+    CUS_CFG_EVT_CHANGED,                                          /**< Parameters changed, they must be applied. */
+    CUS_CFG_EVT_SAVED                                             /**< Writing to flash completed. */
+} cus_cfg_evt_type_t;
+
+/**@brief Configuration event. */
+typedef struct
+{
+    cus_cfg_evt_type_t evt_type;
+    union
+    {
+        uint32_t changed;                                         /**< @ref CUS_CFG_EVT_CHANGED: CUS_CFG_BIT of each changed parameter. */
+        uint32_t result;                                          /**< @ref CUS_CFG_EVT_SAVED: NRF_SUCCESS or the fstorage error. */
+    } params;
+} cus_cfg_evt_t;
+
+/**@brief Configuration event handler type. */
+typedef void (*cus_cfg_evt_handler_t)(cus_cfg_evt_t const * p_evt);
+
+/**@brief A parameter and its new value. */
+typedef struct
+{
+    uint8_t                  param;                               /**< One of @ref cus_cfg_param_t. */
+    int32_t                  value;
+} cus_cfg_entry_t;
+
+/**@brief Configuration initialization structure. */
+typedef struct
+{
+    int32_t const          * p_defaults;                          /**< CUS_CFG_PARAM_COUNT values used when flash holds no valid configuration. Kept by reference. */
+    cus_cfg_evt_handler_t    evt_handler;                         /**< Applies the changed parameters, and gets the result of saving. */
+} cus_cfg_init_t;
+
+/**@brief Function for initializing the configuration.
+ *
+ * @details Loads the configuration saved in flash if there is a valid one, otherwise the defaults.
+ *          No event is raised: the application reads the values with @ref cus_cfg_get while it
+ *          initializes. Can be called before the SoftDevice is enabled; fstorage is initialized
+ *          here.
+ *
+ * @param[in] p_cfg_init  Initialization structure.
+ *
+ * @retval NRF_SUCCESS             If the configuration was loaded.
+ * @retval NRF_ERROR_INVALID_PARAM If the defaults are not a valid configuration.
+ * @retval NRF_ERROR_INTERNAL      If fstorage could not be initialized.
+ */
+uint32_t cus_cfg_init(cus_cfg_init_t const * p_cfg_init);
+
+/**@brief Function for getting the current value of a parameter.
+ *
+ * @param[in] param  Parameter.
+ *
+ * @return Value of the parameter, 0 if the parameter does not exist.
+ */
+int32_t cus_cfg_get(cus_cfg_param_t param);
+
+/**@brief Function for getting the UART baud rate as a value of the BAUDRATE register. */
+uint32_t cus_cfg_uart_baudrate_reg_get(void);
+
+/**@brief Function for changing parameters.
+ *
+ * @details The entries are checked together against the current values of the other parameters,
+ *          so that related parameters (such as the connection intervals) can be moved in one call.
+ *          Either all entries are taken or none. On success @ref CUS_CFG_EVT_CHANGED is raised
+ *          with the parameters whose value actually changed. The flash copy is not updated.
+ *
+ * @param[in] p_entries  Parameters and their new values.
+ * @param[in] count      Number of entries.
+ *
+ * @retval NRF_SUCCESS             If the parameters were changed.
+ * @retval NRF_ERROR_INVALID_PARAM If a parameter does not exist or the resulting configuration
+ *                                 is not valid.
+ */
+uint32_t cus_cfg_set(cus_cfg_entry_t const * p_entries, uint8_t count);
+
+/**@brief Function for going back to the default values. The flash copy is not updated. */
+void cus_cfg_defaults_restore(void);
+
+/**@brief Function for saving the current configuration to flash.
+ *
+ * @details The page is erased then written in the background; @ref CUS_CFG_EVT_SAVED is raised
+ *          when done. The SoftDevice must be enabled and its system events passed to
+ *          fs_sys_event_handler.
+ *
+ * @retval NRF_SUCCESS        If saving started.
+ * @retval NRF_ERROR_BUSY     If a save is already in progress.
+ * @retval NRF_ERROR_INTERNAL If the erase could not be queued.
+ */
+uint32_t cus_cfg_save(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,195 @@
+#include "sdk_common.h"
+#if CUS_EVTCAP_ENABLED
+#include "cus_evtcap.h"
+
+#include "app_timer.h"
+#include "app_util_platform.h"
+
+
+#define EVTCAP_RECORD_MAX_LEN           (2 + CUS_EVTCAP_ENTRY_HEADER_LEN + CUS_EVTCAP_MAX_BODY_LEN + 1)
+
+STATIC_ASSERT((CUS_EVTCAP_SIZE & (CUS_EVTCAP_SIZE - 1)) == 0);
+STATIC_ASSERT(CUS_EVTCAP_SIZE >= CUS_EVTCAP_ENTRY_HEADER_LEN + CUS_EVTCAP_MAX_BODY_LEN);
+STATIC_ASSERT(CUS_EVTCAP_SIZE <= UINT16_MAX);
+
+static uint8_t       m_ring[CUS_EVTCAP_SIZE];                     /**< Entries without their sync and check bytes. */
+static uint16_t      m_head;                                      /**< First byte of the oldest entry. */
+static uint16_t      m_count;                                     /**< Bytes used. */
+static uint16_t      m_records;
+static uint32_t      m_overwritten;
+static uint32_t      m_missed;
+static volatile bool m_dumping;
+static bool          m_start_pending;                             /**< The start entry of the dump is still to be sent. */
+static uint8_t       m_record[EVTCAP_RECORD_MAX_LEN];             /**< Record being sent. */
+static uint16_t      m_record_len;
+static uint16_t      m_record_pos;                                /**< Next byte of m_record to send. */
+
+
+static uint8_t ring_get(uint16_t pos)
+{
+    return m_ring[(m_head + pos) & (CUS_EVTCAP_SIZE - 1)];
+}
+
+
+/**@brief Function for dropping the oldest entry. */
+static void ring_drop(void)
+{
+    uint16_t len = CUS_EVTCAP_ENTRY_HEADER_LEN + ring_get(0);
+
+    m_head   = (m_head + len) & (CUS_EVTCAP_SIZE - 1);
+    m_count -= len;
+    m_records--;
+}
+
+
+static void ring_write(uint8_t const * p_data, uint16_t len)
+{
+    for (uint16_t i = 0; i < len; i++)
+    {
+        m_ring[(m_head + m_count++) & (CUS_EVTCAP_SIZE - 1)] = p_data[i];
+    }
+}
+
+
+void cus_evtcap_add(ble_evt_t const * p_ble_evt)
+{
+    uint8_t  header[CUS_EVTCAP_ENTRY_HEADER_LEN];
+    uint16_t body_len;
+    uint32_t stamp;
+
+    if (m_dumping)
+    {
+        m_missed++;
+        return;
+    }
+
+    body_len = (p_ble_evt->header.evt_len > sizeof(ble_evt_hdr_t))
+             ? (p_ble_evt->header.evt_len - sizeof(ble_evt_hdr_t)) : 0;
+    body_len = MIN(body_len, CUS_EVTCAP_MAX_BODY_LEN);
+
+    UNUSED_RETURN_VALUE(app_timer_cnt_get(&stamp));
+    header[0] = (uint8_t)body_len;
+    header[1] = (uint8_t)p_ble_evt->header.evt_id;
+    header[2] = (uint8_t)(stamp);
+    header[3] = (uint8_t)(stamp >> 8);
+    header[4] = (uint8_t)(stamp >> 16);
+
+    while (CUS_EVTCAP_SIZE - m_count < CUS_EVTCAP_ENTRY_HEADER_LEN + body_len)
+    {
+        ring_drop();
+        m_overwritten++;
+    }
+
+    ring_write(header, sizeof(header));
+    ring_write((uint8_t const *)&p_ble_evt->evt, body_len);
+    m_records++;
+}
+
+
+uint32_t cus_evtcap_dump_start(cus_evtcap_stats_t * p_stats)
+{
+    uint8_t * p_body = &m_record[2 + CUS_EVTCAP_ENTRY_HEADER_LEN];
+
+    VERIFY_FALSE(m_dumping, NRF_ERROR_INVALID_STATE);
+
+    if (p_stats != NULL)
+    {
+        p_stats->records     = m_records;
+        p_stats->bytes       = m_count;
+        p_stats->overwritten = m_overwritten;
+        p_stats->missed      = m_missed;
+    }
+
+    // The start entry is built now, with the counters of this dump, and sent first.
+    m_record[2] = CUS_EVTCAP_START_BODY_LEN;
+    m_record[3] = CUS_EVTCAP_ID_START;
+    m_record[4] = 0;
+    m_record[5] = 0;
+    m_record[6] = 0;
+    UNUSED_RETURN_VALUE(uint16_encode(m_records,     &p_body[0]));
+    UNUSED_RETURN_VALUE(uint32_encode(m_overwritten, &p_body[2]));
+    UNUSED_RETURN_VALUE(uint32_encode(m_missed,      &p_body[6]));
+
+    m_overwritten   = 0;
+    m_missed        = 0;
+    m_start_pending = true;
+    m_record_pos    = m_record_len = 0;
+    m_dumping       = true;
+
+    return NRF_SUCCESS;
+}
+
+
+/**@brief Function for taking the next entry of the dump into the record buffer.
+ *
+ * @details The ring is frozen during the dump, the entries are read without a critical region.
+ *
+ * @return false at the end of the dump.
+ */
+static bool record_load(void)
+{
+    uint16_t entry_len;
+    uint8_t  check = 0;
+
+    if (m_start_pending)
+    {
+        m_start_pending = false;
+    }
+    else if (m_count > 0)
+    {
+        entry_len = CUS_EVTCAP_ENTRY_HEADER_LEN + ring_get(0);
+        for (uint16_t i = 0; i < entry_len; i++)
+        {
+            m_record[2 + i] = ring_get(i);
+        }
+        ring_drop();
+    }
+    else
+    {
+        return false;
+    }
+
+    entry_len   = CUS_EVTCAP_ENTRY_HEADER_LEN + m_record[2];
+    m_record[0] = CUS_EVTCAP_SYNC_0;
+    m_record[1] = CUS_EVTCAP_SYNC_1;
+    for (uint16_t i = 2; i < 2 + entry_len; i++)
+    {
+        check ^= m_record[i];
+    }
+    m_record[2 + entry_len] = check;
+    m_record_len = 2 + entry_len + 1;
+    m_record_pos = 0;
+
+    return true;
+}
+
+
+bool cus_evtcap_flush(cus_evtcap_put_t put)
+{
+    if (!m_dumping)
+    {
+        return false;
+    }
+
+    for (;;)
+    {
+        if ((m_record_pos >= m_record_len) && !record_load())
+        {
+            // The ring is empty, capturing starts again.
+            m_head    = 0;
+            m_dumping = false;
+            return false;
+        }
+
+        while (m_record_pos < m_record_len)
+        {
+            if (!put(m_record[m_record_pos]))
+            {
+                return true;
+            }
+            m_record_pos++;
+        }
+    }
+}
+
+#endif // CUS_EVTCAP_ENABLED
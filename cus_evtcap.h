@@ -0,0 +1,88 @@
+#ifndef __CUS_EVTCAP_H_
+#define __CUS_EVTCAP_H_
+
+#include "ble.h"
+#include "sdk_config.h"
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#ifdef __cplusplus
+	extern "C" {
+#endif
+
+/**@brief Record format on the wire.
+ *
+ * @details CUS_EVTCAP_SYNC_0, CUS_EVTCAP_SYNC_1, then the entry: length of the body (8 bits),
+ *          event id (8 bits), RTC1 counter (24 bits, little endian), the body, then the XOR of
+ *          the entry bytes. The body is the event after its header, header.evt_len - 4 bytes.
+ *          A dump starts with a CUS_EVTCAP_ID_START entry, whose body is the number of records
+ *          that follow (uint16), then the events overwritten and the events missed during the
+ *          previous dump (uint32), little endian.
+ *          Records are mixed with the other output of the UART, as the records of cus_trace;
+ *          a decoder looks for the sync bytes and drops records with a wrong check byte.
+ */
+#define CUS_EVTCAP_SYNC_0               0xA5
+#define CUS_EVTCAP_SYNC_1               0xC3
+#define CUS_EVTCAP_ENTRY_HEADER_LEN     5
+#define CUS_EVTCAP_MAX_BODY_LEN         UINT8_MAX
+#define CUS_EVTCAP_ID_START             0x00                      /**< Never the id of a SoftDevice event. */
+#define CUS_EVTCAP_START_BODY_LEN       10
+
+/**@brief Capture counters. */
+typedef struct
+{
+    uint16_t records;                                             /**< Events in the ring. */
+    uint16_t bytes;                                               /**< Bytes of the ring used by them. */
+    uint32_t overwritten;                                         /**< Oldest events dropped to make room for new ones. */
+    uint32_t missed;                                              /**< Events not captured because a dump was running. */
+} cus_evtcap_stats_t;
+
+/**@brief Function for writing a byte to the dump output.
+ *
+ * @return false if the output is full, the byte is then offered again at the next flush.
+ */
+typedef bool (*cus_evtcap_put_t)(uint8_t byte);
+
+#if CUS_EVTCAP_ENABLED
+
+/**@brief Function for capturing a SoftDevice event.
+ *
+ * @details To be called first in the dispatch of the SoftDevice events. The ring keeps the most
+ *          recent events: the oldest are overwritten. Bodies longer than CUS_EVTCAP_MAX_BODY_LEN
+ *          are cut. Nothing is captured while a dump is running.
+ *
+ * @param[in] p_ble_evt  SoftDevice event.
+ */
+void cus_evtcap_add(ble_evt_t const * p_ble_evt);
+
+/**@brief Function for starting a dump of the ring.
+ *
+ * @details The ring is frozen until @ref cus_evtcap_flush has sent it, then emptied. To be called
+ *          from the context of the SoftDevice events, as @ref cus_evtcap_add.
+ *
+ * @param[out] p_stats  Counters at the start of the dump. Can be NULL.
+ *
+ * @retval NRF_SUCCESS             If the dump was started.
+ * @retval NRF_ERROR_INVALID_STATE If a dump is already running.
+ */
+uint32_t cus_evtcap_dump_start(cus_evtcap_stats_t * p_stats);
+
+/**@brief Function for sending the dump, as long as the output accepts it.
+ *
+ * @details Meant for the main loop, as @ref cus_trace_flush. Other output sent on the same line
+ *          while a dump runs cuts its records, so the caller holds it back.
+ *
+ * @param[in] put  Output function.
+ *
+ * @return true while a dump is running.
+ */
+bool cus_evtcap_flush(cus_evtcap_put_t put);
+
+#endif // CUS_EVTCAP_ENABLED
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
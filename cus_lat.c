@@ -0,0 +1,123 @@
+#include "cus_lat.h"
+
+#include <string.h>
+
+
+#define LAT_OVERFLOW_BUCKET             (CUS_LAT_BUCKETS - 1)
+
+
+static uint8_t bucket_get(uint32_t value)
+{
+    uint8_t msb = 0;
+
+    if (value < CUS_LAT_SUB_BUCKETS)
+    {
+        return (uint8_t)value;
+    }
+    if (value >= (1UL << CUS_LAT_RANGE_BITS))
+    {
+        return LAT_OVERFLOW_BUCKET;
+    }
+
+    while ((value >> (msb + 1)) != 0)
+    {
+        msb++;
+    }
+
+    // The 2 bits below the most significant one select the sub-bucket.
+    return (uint8_t)((msb - 1) * CUS_LAT_SUB_BUCKETS + ((value >> (msb - 2)) & (CUS_LAT_SUB_BUCKETS - 1)));
+}
+
+
+void cus_lat_bucket_range(uint8_t bucket, uint32_t * p_low, uint32_t * p_high)
+{
+    uint8_t shift;
+
+    if (bucket < CUS_LAT_SUB_BUCKETS)
+    {
+        *p_low  = bucket;
+        *p_high = bucket;
+        return;
+    }
+    if (bucket >= LAT_OVERFLOW_BUCKET)
+    {
+        *p_low  = 1UL << CUS_LAT_RANGE_BITS;
+        *p_high = UINT32_MAX;
+        return;
+    }
+
+    shift   = bucket / CUS_LAT_SUB_BUCKETS - 1;
+    *p_low  = (uint32_t)(CUS_LAT_SUB_BUCKETS + (bucket % CUS_LAT_SUB_BUCKETS)) << shift;
+    *p_high = *p_low + (1UL << shift) - 1;
+}
+
+
+void cus_lat_reset(cus_lat_t * p_lat)
+{
+    memset(p_lat, 0, sizeof(*p_lat));
+}
+
+
+void cus_lat_record(cus_lat_t * p_lat, uint32_t value)
+{
+    uint8_t bucket = bucket_get(value);
+
+    if (p_lat->buckets[bucket] == UINT16_MAX)
+    {
+        // Halving every bucket keeps the shape of the distribution, and so the percentiles.
+        for (uint8_t i = 0; i < CUS_LAT_BUCKETS; i++)
+        {
+            p_lat->buckets[i] >>= 1;
+        }
+    }
+
+    p_lat->buckets[bucket]++;
+    p_lat->count++;
+    if (value > p_lat->max)
+    {
+        p_lat->max = value;
+    }
+}
+
+
+/**@brief Function for finding the upper bound of the bucket holding the value of a given rank. */
+static uint32_t rank_value(cus_lat_t const * p_lat, uint32_t rank)
+{
+    uint32_t seen = 0;
+    uint32_t low;
+    uint32_t high = p_lat->max;
+
+    for (uint8_t i = 0; i < CUS_LAT_BUCKETS; i++)
+    {
+        seen += p_lat->buckets[i];
+        if (seen >= rank)
+        {
+            cus_lat_bucket_range(i, &low, &high);
+            break;
+        }
+    }
+
+    return (high < p_lat->max) ? high : p_lat->max;
+}
+
+
+void cus_lat_summary_get(cus_lat_t const * p_lat, cus_lat_summary_t * p_summary)
+{
+    uint32_t total = 0;
+
+    memset(p_summary, 0, sizeof(*p_summary));
+
+    for (uint8_t i = 0; i < CUS_LAT_BUCKETS; i++)
+    {
+        total += p_lat->buckets[i];
+    }
+    if (total == 0)
+    {
+        return;
+    }
+
+    p_summary->count = p_lat->count;
+    p_summary->p50   = rank_value(p_lat, (total * 50 + 99) / 100);
+    p_summary->p99   = rank_value(p_lat, (total * 99 + 99) / 100);
+    p_summary->max   = p_lat->max;
+}
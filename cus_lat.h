@@ -0,0 +1,70 @@
+#ifndef __CUS_LAT_H_
+#define __CUS_LAT_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#ifdef __cplusplus
+	extern "C" {
+#endif
+
+/**@brief Buckets of a latency histogram.
+ *
+ * @details Values 0 to 3 have a bucket each. Above, every power of two is split in 4 buckets of
+ *          equal width, so a percentile is known to within 25%, up to 2^16 - 1 ticks. The last
+ *          bucket holds all larger values.
+ */
+#define CUS_LAT_SUB_BUCKETS             4
+#define CUS_LAT_RANGE_BITS              16
+#define CUS_LAT_BUCKETS                 ((CUS_LAT_RANGE_BITS - 1) * CUS_LAT_SUB_BUCKETS + 1)
+
+/**@brief Summary of a latency histogram. Percentiles are the upper bound of their bucket. */
+typedef struct
+{
+    uint32_t count;                                               /**< Values recorded. */
+    uint32_t p50;                                                 /**< Median. */
+    uint32_t p99;                                                 /**< 99th percentile. */
+    uint32_t max;                                                 /**< Largest value, exact. */
+} cus_lat_summary_t;
+
+/**@brief Latency histogram, in the unit of the caller (app_timer ticks in this application). */
+typedef struct
+{
+    uint16_t                 buckets[CUS_LAT_BUCKETS];            /**< Values per bucket, all halved when one is full. */
+    uint32_t                 count;
+    uint32_t                 max;
+} cus_lat_t;
+
+/**@brief Function for clearing a histogram.
+ *
+ * @param[out] p_lat  Histogram.
+ */
+void cus_lat_reset(cus_lat_t * p_lat);
+
+/**@brief Function for adding a value to a histogram.
+ *
+ * @param[in] p_lat  Histogram.
+ * @param[in] value  Latency.
+ */
+void cus_lat_record(cus_lat_t * p_lat, uint32_t value);
+
+/**@brief Function for computing the percentiles of a histogram.
+ *
+ * @param[in]  p_lat      Histogram.
+ * @param[out] p_summary  Summary; all 0 if the histogram is empty.
+ */
+void cus_lat_summary_get(cus_lat_t const * p_lat, cus_lat_summary_t * p_summary);
+
+/**@brief Function for getting the range of values counted in a bucket.
+ *
+ * @param[in]  bucket  Bucket, below CUS_LAT_BUCKETS.
+ * @param[out] p_low   Smallest value of the bucket.
+ * @param[out] p_high  Largest value of the bucket, UINT32_MAX for the last one.
+ */
+void cus_lat_bucket_range(uint8_t bucket, uint32_t * p_low, uint32_t * p_high);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
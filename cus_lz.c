@@ -0,0 +1,193 @@
+#include "sdk_config.h"
+#if CUS_LZ_ENABLED
+#include "cus_lz.h"
+
+#include <string.h>
+
+
+/**@brief Bit writer over a frame. */
+typedef struct
+{
+    uint8_t  * p_buf;
+    uint16_t   bits;                                              /**< Bits written. */
+    uint16_t   max_bits;
+} bit_writer_t;
+
+
+static void bits_put(bit_writer_t * p_writer, uint16_t value, uint8_t count)
+{
+    while (count-- > 0)
+    {
+        uint8_t mask = 0x80 >> (p_writer->bits & 7);
+
+        if ((value >> count) & 1)
+        {
+            p_writer->p_buf[p_writer->bits >> 3] |= mask;
+        }
+        p_writer->bits++;
+    }
+}
+
+
+/**@brief Function for getting a byte of the history followed by the data.
+ *
+ * @details Index 0 is the oldest byte of the window, index p_lz->len the first byte of the data.
+ */
+static uint8_t byte_at(cus_lz_t const * p_lz, uint8_t const * p_data, uint16_t index)
+{
+    if (index >= p_lz->len)
+    {
+        return p_data[index - p_lz->len];
+    }
+    return p_lz->window[(p_lz->head - p_lz->len + index) & (CUS_LZ_WINDOW_SIZE - 1)];
+}
+
+
+/**@brief Function for finding the longest copy for the data at pos.
+ *
+ * @details Linear search of the window; only distances whose first byte matches are compared,
+ *          which keeps the cost of text close to one load per window byte. The nearest of equal
+ *          matches is kept, it is as cheap to code as any other.
+ *
+ * @return Length of the copy, 0 if there is none of at least CUS_LZ_MIN_MATCH bytes.
+ */
+static uint16_t match_find(cus_lz_t const * p_lz,
+                           uint8_t  const * p_data,
+                           uint16_t         pos,
+                           uint16_t         length,
+                           uint16_t       * p_dist)
+{
+    uint16_t cur      = p_lz->len + pos;
+    uint16_t max_dist = (cur < CUS_LZ_WINDOW_SIZE) ? cur : CUS_LZ_WINDOW_SIZE;
+    uint16_t max_len  = length - pos;
+    uint16_t best     = 0;
+    uint8_t  first    = p_data[pos];
+
+    if (max_len > CUS_LZ_MAX_MATCH)
+    {
+        max_len = CUS_LZ_MAX_MATCH;
+    }
+    if (max_len < CUS_LZ_MIN_MATCH)
+    {
+        return 0;
+    }
+
+    for (uint16_t dist = 1; dist <= max_dist; dist++)
+    {
+        uint16_t start = cur - dist;
+        uint16_t len;
+
+        if (byte_at(p_lz, p_data, start) != first)
+        {
+            continue;
+        }
+
+        // The copy may run into the bytes it produces; those are data bytes already known.
+        for (len = 1; len < max_len; len++)
+        {
+            if (byte_at(p_lz, p_data, start + len) != p_data[pos + len])
+            {
+                break;
+            }
+        }
+
+        if (len > best)
+        {
+            best    = len;
+            *p_dist = dist;
+            if (best == max_len)
+            {
+                break;
+            }
+        }
+    }
+
+    return (best >= CUS_LZ_MIN_MATCH) ? best : 0;
+}
+
+
+/**@brief Function for moving consumed data into the window. */
+static void window_append(cus_lz_t * p_lz, uint8_t const * p_data, uint16_t length)
+{
+    for (uint16_t i = 0; i < length; i++)
+    {
+        p_lz->window[p_lz->head] = p_data[i];
+        p_lz->head               = (p_lz->head + 1) & (CUS_LZ_WINDOW_SIZE - 1);
+    }
+
+    p_lz->len = ((p_lz->len + length) < CUS_LZ_WINDOW_SIZE) ? (p_lz->len + length)
+                                                             : CUS_LZ_WINDOW_SIZE;
+}
+
+
+void cus_lz_init(cus_lz_t * p_lz)
+{
+    p_lz->head          = 0;
+    p_lz->len           = 0;
+    p_lz->reset_pending = true;
+}
+
+
+void cus_lz_reset(cus_lz_t * p_lz)
+{
+    p_lz->reset_pending = true;
+}
+
+
+uint16_t cus_lz_frame_encode(cus_lz_t      * p_lz,
+                             uint8_t const * p_data,
+                             uint16_t        length,
+                             uint8_t       * p_frame,
+                             uint16_t        frame_max,
+                             uint16_t      * p_frame_len)
+{
+    bit_writer_t writer;
+    uint16_t     pos = 0;
+
+    memset(p_frame, 0, frame_max);
+
+    if (p_lz->reset_pending)
+    {
+        p_lz->reset_pending = false;
+        p_lz->head          = 0;
+        p_lz->len           = 0;
+        p_frame[0]         |= CUS_LZ_HEADER_RESET;
+    }
+
+    writer.p_buf    = &p_frame[CUS_LZ_HEADER_LEN];
+    writer.bits     = 0;
+    writer.max_bits = (frame_max - CUS_LZ_HEADER_LEN) * 8;
+
+    while (pos < length)
+    {
+        uint16_t dist = 0;
+        uint16_t len  = match_find(p_lz, p_data, pos, length, &dist);
+
+        // A copy that no longer fits can still leave room for a literal.
+        if ((len != 0) && ((writer.bits + CUS_LZ_MATCH_BITS) <= writer.max_bits))
+        {
+            bits_put(&writer, 0, 1);
+            bits_put(&writer, dist - 1, CUS_LZ_WINDOW_BITS);
+            bits_put(&writer, len - CUS_LZ_MIN_MATCH, CUS_LZ_LOOKAHEAD_BITS);
+            pos += len;
+        }
+        else if ((writer.bits + CUS_LZ_LITERAL_BITS) <= writer.max_bits)
+        {
+            bits_put(&writer, 1, 1);
+            bits_put(&writer, p_data[pos], 8);
+            pos++;
+        }
+        else
+        {
+            break;
+        }
+    }
+
+    window_append(p_lz, p_data, pos);
+
+    *p_frame_len = CUS_LZ_HEADER_LEN + ((writer.bits + 7) / 8);
+
+    return pos;
+}
+
+#endif //CUS_LZ_ENABLED
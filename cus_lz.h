@@ -0,0 +1,80 @@
+#ifndef __CUS_LZ_H_
+#define __CUS_LZ_H_
+
+#include "sdk_config.h"
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#ifdef __cplusplus
+	extern "C" {
+#endif
+
+/**@brief Frame format.
+ *
+ * @details A frame is a header byte followed by a bit stream, most significant bit first:
+ *          - 1, then 8 bits: a literal byte.
+ *          - 0, then CUS_LZ_WINDOW_BITS bits of distance - 1, then CUS_LZ_LOOKAHEAD_BITS bits of
+ *            length - CUS_LZ_MIN_MATCH: a copy of earlier output, which may overlap the copy.
+ *          Tokens never span two frames. The last byte is padded with 0 bits, fewer than a
+ *          literal needs, so a decoder stops when less than CUS_LZ_LITERAL_BITS bits are left.
+ *          The history is shared by consecutive frames, which must be decoded in order; a frame
+ *          with CUS_LZ_HEADER_RESET starts a new history, where a decoder can join the stream.
+ */
+#define CUS_LZ_HEADER_LEN               1
+#define CUS_LZ_HEADER_RESET             0x01                      /**< The history is empty before this frame. */
+#define CUS_LZ_WINDOW_SIZE              (1 << CUS_LZ_WINDOW_BITS)
+#define CUS_LZ_MIN_MATCH                2                         /**< Shortest copy; a 2-byte copy is shorter than 2 literals. */
+#define CUS_LZ_MAX_MATCH                (CUS_LZ_MIN_MATCH + (1 << CUS_LZ_LOOKAHEAD_BITS) - 1)
+#define CUS_LZ_LITERAL_BITS             9
+#define CUS_LZ_MATCH_BITS               (1 + CUS_LZ_WINDOW_BITS + CUS_LZ_LOOKAHEAD_BITS)
+
+/**@brief Compressor state. */
+typedef struct
+{
+    uint8_t           window[CUS_LZ_WINDOW_SIZE];                 /**< Last bytes compressed, circular. */
+    uint16_t          head;                                       /**< Where the next byte is stored in the window. */
+    uint16_t          len;                                        /**< Bytes in the window. */
+    volatile bool     reset_pending;                              /**< The next frame starts a new history. */
+} cus_lz_t;
+
+/**@brief Function for initializing a compressor. The first frame starts a new history.
+ *
+ * @param[out] p_lz  Compressor.
+ */
+void cus_lz_init(cus_lz_t * p_lz);
+
+/**@brief Function for starting a new history at the next frame.
+ *
+ * @details Can be called from any context; a decoder that lost the stream (a peer reconnecting
+ *          after a restart) gets back in sync at that frame.
+ *
+ * @param[in] p_lz  Compressor.
+ */
+void cus_lz_reset(cus_lz_t * p_lz);
+
+/**@brief Function for compressing data into one frame.
+ *
+ * @details Takes the longest prefix of the data whose tokens fit in the frame.
+ *
+ * @param[in]  p_lz         Compressor.
+ * @param[in]  p_data       Data.
+ * @param[in]  length       Length of the data.
+ * @param[out] p_frame      Frame.
+ * @param[in]  frame_max    Size of the frame, at least CUS_LZ_HEADER_LEN + 2.
+ * @param[out] p_frame_len  Length of the frame.
+ *
+ * @return Number of data bytes consumed. The rest goes into the next frame.
+ */
+uint16_t cus_lz_frame_encode(cus_lz_t      * p_lz,
+                             uint8_t const * p_data,
+                             uint16_t        length,
+                             uint8_t       * p_frame,
+                             uint16_t        frame_max,
+                             uint16_t      * p_frame_len);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
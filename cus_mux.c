@@ -0,0 +1,153 @@
+#include "cus_mux.h"
+
+#include "sdk_common.h"
+
+
+uint32_t cus_mux_init(cus_mux_t * p_mux, ble_cus_t * p_cus)
+{
+    VERIFY_PARAM_NOT_NULL(p_mux);
+    VERIFY_PARAM_NOT_NULL(p_cus);
+
+    memset(p_mux, 0, sizeof(*p_mux));
+    p_mux->p_cus = p_cus;
+
+    return NRF_SUCCESS;
+}
+
+
+uint32_t cus_mux_channel_register(cus_mux_t       * p_mux,
+                                  uint8_t           channel,
+                                  cus_mux_handler_t handler,
+                                  void            * p_context,
+                                  cus_tx_prio_t     prio,
+                                  bool              reliable)
+{
+    VERIFY_PARAM_NOT_NULL(p_mux);
+    VERIFY_TRUE((channel < CUS_MUX_CHANNEL_COUNT) && (handler != NULL), NRF_ERROR_INVALID_PARAM);
+    VERIFY_TRUE(p_mux->channels[channel].handler == NULL, NRF_ERROR_INVALID_STATE);
+
+    p_mux->channels[channel].handler   = handler;
+    p_mux->channels[channel].p_context = p_context;
+    p_mux->channels[channel].prio      = prio;
+    p_mux->channels[channel].reliable  = reliable;
+
+    return NRF_SUCCESS;
+}
+
+
+/**@brief Function for notifying a frame from a TX pool buffer, with the priority of its channel. */
+static uint32_t frame_notify(cus_mux_t * p_mux, cus_mux_channel_t const * p_channel, uint8_t channel,
+                             uint8_t const * p_data, uint16_t length)
+{
+    ble_cus_t * p_cus = p_mux->p_cus;
+    uint8_t   * p_buf;
+
+    if ((p_cus->conn_handle == BLE_CONN_HANDLE_INVALID) || !p_cus->is_notification_enabled)
+    {
+        return NRF_ERROR_INVALID_STATE;
+    }
+
+    p_buf = cus_tx_buf_alloc();
+    if (p_buf == NULL)
+    {
+        return NRF_ERROR_NO_MEM;
+    }
+
+    p_buf[0] = CUS_MUX_HEADER(channel);
+    memcpy(&p_buf[CUS_MUX_HEADER_LEN], p_data, length);
+
+    return cus_tx_buf_send(p_cus->tx_id,
+                           p_cus->conn_handle,
+                           p_cus->notify_custom_value_handles.value_handle,
+                           p_buf,
+                           length + CUS_MUX_HEADER_LEN,
+                           p_channel->prio);
+}
+
+
+static uint32_t frame_record_send(cus_mux_t * p_mux, uint8_t channel, uint8_t const * p_data, uint16_t length)
+{
+    uint8_t frame[BLE_CUS_REC_MAX_DATA_LEN];
+
+    frame[0] = CUS_MUX_HEADER(channel);
+    memcpy(&frame[CUS_MUX_HEADER_LEN], p_data, length);
+
+    return ble_cus_record_send(p_mux->p_cus, frame, length + CUS_MUX_HEADER_LEN);
+}
+
+
+/**@brief Function for sending a frame of a registered channel, and counting it. */
+static uint32_t frame_send(cus_mux_t * p_mux, uint8_t channel, uint8_t const * p_data, uint16_t length,
+                           bool reliable)
+{
+    cus_mux_channel_t * p_channel;
+    uint32_t            err_code;
+
+    VERIFY_PARAM_NOT_NULL(p_mux);
+    VERIFY_PARAM_NOT_NULL(p_data);
+    VERIFY_TRUE((channel < CUS_MUX_CHANNEL_COUNT) && (p_mux->channels[channel].handler != NULL),
+                NRF_ERROR_INVALID_PARAM);
+
+    p_channel = &p_mux->channels[channel];
+
+    if (reliable)
+    {
+        VERIFY_TRUE(length <= CUS_MUX_MAX_RELIABLE_DATA_LEN, NRF_ERROR_INVALID_PARAM);
+        err_code = frame_record_send(p_mux, channel, p_data, length);
+    }
+    else
+    {
+        VERIFY_TRUE(length <= CUS_MUX_MAX_DATA_LEN, NRF_ERROR_INVALID_PARAM);
+        err_code = frame_notify(p_mux, p_channel, channel, p_data, length);
+    }
+
+    if (err_code == NRF_SUCCESS)
+    {
+        p_channel->stats.tx++;
+    }
+    else
+    {
+        p_channel->stats.tx_failed++;
+    }
+
+    return err_code;
+}
+
+
+uint32_t cus_mux_send(cus_mux_t * p_mux, uint8_t channel, uint8_t const * p_data, uint16_t length)
+{
+    VERIFY_PARAM_NOT_NULL(p_mux);
+    VERIFY_TRUE(channel < CUS_MUX_CHANNEL_COUNT, NRF_ERROR_INVALID_PARAM);
+
+    return frame_send(p_mux, channel, p_data, length, p_mux->channels[channel].reliable);
+}
+
+
+uint32_t cus_mux_record_send(cus_mux_t * p_mux, uint8_t channel, uint8_t const * p_data, uint16_t length)
+{
+    return frame_send(p_mux, channel, p_data, length, true);
+}
+
+
+void cus_mux_on_write(cus_mux_t * p_mux, uint8_t * p_data, uint16_t length)
+{
+    cus_mux_channel_t * p_channel;
+
+    if ((length < CUS_MUX_HEADER_LEN) || ((p_data[0] & 0xF0) != 0))
+    {
+        p_mux->rx_unknown++;
+        return;
+    }
+
+    p_channel = &p_mux->channels[p_data[0]];
+
+    if (p_channel->handler == NULL)
+    {
+        p_mux->rx_unknown++;
+        return;
+    }
+
+    p_channel->stats.rx++;
+    p_channel->handler(p_mux, p_data[0], p_channel->p_context,
+                       &p_data[CUS_MUX_HEADER_LEN], length - CUS_MUX_HEADER_LEN);
+}
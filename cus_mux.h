@@ -0,0 +1,143 @@
+#ifndef __CUS_MUX_H_
+#define __CUS_MUX_H_
+
+#include "ble.h"
+#include "cus_service.h"
+#include "cus_tx.h"
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#ifdef __cplusplus
+	extern "C" {
+#endif
+
+#define CUS_MUX_CHANNEL_COUNT           16                        /**< Logical channels sharing one WRITE/NOTIFY pair. */
+#define CUS_MUX_HEADER_LEN              1                         /**< Channel header in front of every frame. */
+#define CUS_MUX_MAX_DATA_LEN            (BLE_CUSTOM_MAX_DATA_LEN - CUS_MUX_HEADER_LEN)  /**< Largest payload of a notified frame. */
+#define CUS_MUX_MAX_RELIABLE_DATA_LEN   (BLE_CUS_REC_MAX_DATA_LEN - CUS_MUX_HEADER_LEN) /**< Largest payload of a frame on a reliable channel. */
+
+/**@brief Header of a frame: the channel in the low nibble, the high nibble is reserved and 0. */
+#define CUS_MUX_HEADER(channel)         ((uint8_t)((channel) & 0x0F))
+
+/* Forward declaration of the cus_mux_t type. */
+typedef struct cus_mux_s cus_mux_t;
+
+/**@brief Handler of the frames received on a channel.
+ *
+ * @param[in] p_mux      Multiplexer the frame was received on.
+ * @param[in] channel    Channel of the frame.
+ * @param[in] p_context  Context given when the channel was registered.
+ * @param[in] p_data     Payload, without the channel header.
+ * @param[in] length     Length of the payload. Can be up to 511 bytes after a queued (long) write.
+ */
+typedef void (*cus_mux_handler_t)(cus_mux_t * p_mux, uint8_t channel, void * p_context, uint8_t * p_data, uint16_t length);
+
+/**@brief Per-channel counters. */
+typedef struct
+{
+    uint32_t rx;                                                  /**< Frames received. */
+    uint32_t tx;                                                  /**< Frames sent or queued. */
+    uint32_t tx_failed;                                           /**< Frames that could not be sent or queued. */
+} cus_mux_stats_t;
+
+/**@brief State of a channel. */
+typedef struct
+{
+    cus_mux_handler_t        handler;                             /**< NULL if the channel is not registered. */
+    void                   * p_context;                           /**< Passed to the handler. */
+    cus_tx_prio_t            prio;                                /**< TX priority of the notified frames. */
+    bool                     reliable;                            /**< Frames are sent as reliable records of the service. */
+    cus_mux_stats_t          stats;
+} cus_mux_channel_t;
+
+/**@brief Channel multiplexer over the WRITE/NOTIFY pair of a Custom Service.
+ *
+ * @details Each write and notification carries one frame {header, payload}. Frames of
+ *          a reliable channel are sent with @ref ble_cus_record_send, and so carry the record
+ *          sequence number after the payload.
+ */
+struct cus_mux_s
+{
+    ble_cus_t              * p_cus;                               /**< Service carrying the channels. */
+    cus_mux_channel_t        channels[CUS_MUX_CHANNEL_COUNT];
+    uint32_t                 rx_unknown;                          /**< Frames received on a channel with no handler, or malformed. */
+};
+
+/**@brief Function for initializing a multiplexer.
+ *
+ * @param[out] p_mux  Multiplexer structure, supplied by the application.
+ * @param[in]  p_cus  Initialized Custom Service carrying the channels.
+ *
+ * @return      NRF_SUCCESS on success, otherwise an error code.
+ */
+uint32_t cus_mux_init(cus_mux_t * p_mux, ble_cus_t * p_cus);
+
+/**@brief Function for registering a channel.
+ *
+ * @param[in] p_mux     Multiplexer structure.
+ * @param[in] channel   Channel, 0 to CUS_MUX_CHANNEL_COUNT - 1.
+ * @param[in] handler   Handler of the frames received on the channel.
+ * @param[in] p_context Context passed to the handler, typically the instance of the protocol
+ *                      carried by the channel.
+ * @param[in] prio      TX priority of the frames sent on the channel.
+ * @param[in] reliable  true to send the frames as reliable records. The service must then have been
+ *                      initialized with a record timeout, and prio is not used.
+ *
+ * @retval NRF_SUCCESS             If the channel was registered.
+ * @retval NRF_ERROR_INVALID_PARAM If the channel is out of range or the handler is NULL.
+ * @retval NRF_ERROR_INVALID_STATE If the channel is already registered.
+ */
+uint32_t cus_mux_channel_register(cus_mux_t       * p_mux,
+                                  uint8_t           channel,
+                                  cus_mux_handler_t handler,
+                                  void            * p_context,
+                                  cus_tx_prio_t     prio,
+                                  bool              reliable);
+
+/**@brief Function for sending a frame on a channel.
+ *
+ * @param[in] p_mux    Multiplexer structure.
+ * @param[in] channel  Registered channel.
+ * @param[in] p_data   Payload.
+ * @param[in] length   Length of the payload, at most @ref CUS_MUX_MAX_DATA_LEN, or
+ *                     @ref CUS_MUX_MAX_RELIABLE_DATA_LEN on a reliable channel.
+ *
+ * @retval NRF_SUCCESS             If the frame was sent or queued.
+ * @retval NRF_ERROR_INVALID_PARAM If the channel is not registered or the length is invalid.
+ * @retval NRF_ERROR_INVALID_STATE If the peer is not connected or did not enable notifications.
+ * @retval NRF_ERROR_NO_MEM        If the TX queue or the TX pool is full.
+ */
+uint32_t cus_mux_send(cus_mux_t * p_mux, uint8_t channel, uint8_t const * p_data, uint16_t length);
+
+/**@brief Function for sending a frame as a reliable record, whatever the channel.
+ *
+ * @details For a channel that sends most of its frames without confirmation, such as the
+ *          benchmark comparing both ways.
+ *
+ * @param[in] p_mux    Multiplexer structure.
+ * @param[in] channel  Registered channel.
+ * @param[in] p_data   Payload.
+ * @param[in] length   Length of the payload, at most @ref CUS_MUX_MAX_RELIABLE_DATA_LEN.
+ *
+ * @return NRF_ERROR_INVALID_PARAM if the channel is not registered or the length is invalid,
+ *         otherwise the error code returned by @ref ble_cus_record_send.
+ */
+uint32_t cus_mux_record_send(cus_mux_t * p_mux, uint8_t channel, uint8_t const * p_data, uint16_t length);
+
+/**@brief Function for handling a write from the peer.
+ *
+ * @details To be called from the data handler of the service. Dispatches the payload to the
+ *          handler of its channel.
+ *
+ * @param[in] p_mux   Multiplexer structure.
+ * @param[in] p_data  Written data.
+ * @param[in] length  Length of the written data.
+ */
+void cus_mux_on_write(cus_mux_t * p_mux, uint8_t * p_data, uint16_t length);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,559 @@
+#include "cus_obj.h"
+
+#include "sdk_common.h"
+#include "app_timer.h"
+#include "crc32.h"
+
+
+#define OBJ_MAGIC                       0x314A424FUL              /**< "OBJ1": the header page describes a complete, checked object. */
+#define OBJ_PAGE_SIZE                   (FS_PAGE_SIZE_WORDS * sizeof(uint32_t))
+#define OBJ_BUF_WORDS                   (CUS_OBJ_BUF_SIZE / sizeof(uint32_t))
+#define OBJ_BUF_COUNT                   2                         /**< One buffer is written to flash while the other is filled. */
+#define OBJ_WINDOW                      (OBJ_BUF_COUNT * CUS_OBJ_BUF_SIZE)
+#define OBJ_DATA_HEADER_LEN             3                         /**< {op, offset (uint16)} in front of the data of DATA and READ_DATA. */
+#define OBJ_READ_CHUNK_LEN              (CUS_MUX_MAX_DATA_LEN - OBJ_DATA_HEADER_LEN)
+
+/**@brief State of the transfer. */
+typedef enum
+{
+    OBJ_STATE_IDLE,                                               /**< No object. */
+    OBJ_STATE_ERASING,
+    OBJ_STATE_RECEIVING,
+    OBJ_STATE_FINISHING,                                          /**< Writing the header page. */
+    OBJ_STATE_COMPLETE,
+    OBJ_STATE_FAILED
+} obj_state_t;
+
+/**@brief First words of the header page. */
+typedef struct
+{
+    uint32_t magic;
+    uint32_t size;
+    uint32_t crc;
+} obj_header_t;
+
+/**@brief Staging buffer, written to flash when full or at the end of the object. */
+typedef struct
+{
+    uint32_t words[OBJ_BUF_WORDS];                                /**< Word aligned for fstorage. */
+    uint16_t offset;                                              /**< Offset of the first byte in the object. */
+    uint16_t len;
+} obj_buf_t;
+
+
+STATIC_ASSERT((CUS_OBJ_BUF_SIZE % sizeof(uint32_t)) == 0);
+STATIC_ASSERT(OBJ_BUF_WORDS <= FS_MAX_WRITE_SIZE_WORDS);
+STATIC_ASSERT(CUS_OBJ_MAX_SIZE <= 0x10000);
+
+
+static void fs_evt_handler(fs_evt_t const * const p_evt, fs_ret_t result);
+
+FS_REGISTER_CFG(fs_config_t cus_obj_fs_config) =
+{
+    .callback  = fs_evt_handler,
+    .num_pages = 1 + CUS_OBJ_MAX_PAGES,
+    .priority  = CUS_OBJ_FS_PRIORITY
+};
+
+static cus_mux_t      * m_p_mux;
+static uint8_t          m_channel;
+static obj_state_t      m_state;
+static uint32_t         m_size;
+static uint32_t         m_crc;                                    /**< CRC32 given by CREATE. */
+static uint32_t         m_crc_flash;                              /**< CRC32 of the data written so far, read back from flash. */
+static uint32_t         m_received;                               /**< Data accepted, in flash or in the staging buffers. */
+static uint32_t         m_committed;                              /**< Data written to flash. */
+static uint32_t         m_start_ticks;
+static bool             m_nack_sent;                              /**< Out-of-order frames are dropped silently until the peer goes back. */
+static obj_buf_t        m_bufs[OBJ_BUF_COUNT];
+static uint8_t          m_buf_head;                               /**< Oldest full buffer, being written to flash. */
+static uint8_t          m_buf_full;                               /**< Full buffers, being written or waiting to be. */
+static obj_header_t     m_header;                                 /**< Source of the header write. */
+static bool             m_reading;
+static uint32_t         m_read_offset;
+static uint32_t         m_read_end;
+static cus_obj_stats_t  m_stats;
+
+
+static uint32_t const * header_addr(void)
+{
+    return cus_obj_fs_config.p_start_addr;
+}
+
+
+static uint32_t const * data_addr(uint32_t offset)
+{
+    return cus_obj_fs_config.p_start_addr + FS_PAGE_SIZE_WORDS + (offset / sizeof(uint32_t));
+}
+
+
+static uint32_t frame_send(uint8_t const * p_frame, uint16_t length)
+{
+    return cus_mux_send(m_p_mux, m_channel, p_frame, length);
+}
+
+
+static void status_send(uint8_t op, uint8_t status, uint32_t offset)
+{
+    uint8_t frame[1 + 1 + sizeof(uint32_t)];
+
+    frame[0] = op;
+    frame[1] = status;
+    UNUSED_RETURN_VALUE(uint32_encode(offset, &frame[2]));
+
+    UNUSED_RETURN_VALUE(frame_send(frame, sizeof(frame)));
+}
+
+
+static void done_send(uint8_t status, uint32_t crc, uint32_t ticks)
+{
+    uint8_t frame[1 + 1 + 2 * sizeof(uint32_t)];
+
+    frame[0] = CUS_OBJ_OP_DONE;
+    frame[1] = status;
+    UNUSED_RETURN_VALUE(uint32_encode(crc,   &frame[2]));
+    UNUSED_RETURN_VALUE(uint32_encode(ticks, &frame[6]));
+
+    UNUSED_RETURN_VALUE(frame_send(frame, sizeof(frame)));
+}
+
+
+/**@brief Function for giving up the object. Called when no flash operation is in progress. */
+static void transfer_fail(uint8_t status)
+{
+    m_state    = OBJ_STATE_FAILED;
+    m_buf_full = 0;
+    m_stats.failed++;
+    done_send(status, m_crc_flash, 0);
+}
+
+
+/**@brief Function for writing the oldest full staging buffer to flash. */
+static void buf_write(void)
+{
+    obj_buf_t * p_buf = &m_bufs[m_buf_head];
+    uint16_t    words = (p_buf->len + sizeof(uint32_t) - 1) / sizeof(uint32_t);
+
+    // The tail of the last word of the object keeps the erased value.
+    memset((uint8_t *)p_buf->words + p_buf->len, 0xFF, words * sizeof(uint32_t) - p_buf->len);
+
+    if (fs_store(&cus_obj_fs_config, data_addr(p_buf->offset), p_buf->words, words, p_buf) != FS_SUCCESS)
+    {
+        transfer_fail(CUS_OBJ_STATUS_FAILED);
+    }
+}
+
+
+/**@brief Function for handing the buffer being filled over to the flash writes. */
+static void buf_close(void)
+{
+    m_buf_full++;
+    if (m_buf_full == 1)
+    {
+        buf_write();
+    }
+}
+
+
+static void on_buf_written(void)
+{
+    obj_buf_t * p_buf = &m_bufs[m_buf_head];
+
+    // Read back what was written, so the final check covers the flash and not the RAM copy.
+    m_crc_flash = crc32_compute((uint8_t const *)data_addr(p_buf->offset), p_buf->len,
+                                (m_committed == 0) ? NULL : &m_crc_flash);
+
+    m_committed += p_buf->len;
+    m_stats.flash_writes++;
+
+    p_buf->len = 0;
+    m_buf_head = (m_buf_head + 1) % OBJ_BUF_COUNT;
+    m_buf_full--;
+
+    status_send(CUS_OBJ_OP_ACK, CUS_OBJ_STATUS_OK, m_committed);
+
+    if (m_committed < m_size)
+    {
+        if (m_buf_full > 0)
+        {
+            buf_write();
+        }
+        return;
+    }
+
+    if (m_crc_flash != m_crc)
+    {
+        transfer_fail(CUS_OBJ_STATUS_CRC);
+        return;
+    }
+
+    // The header is written last: an object is only found again after a reset if it is complete.
+    m_header.magic = OBJ_MAGIC;
+    m_header.size  = m_size;
+    m_header.crc   = m_crc;
+    m_state        = OBJ_STATE_FINISHING;
+
+    if (fs_store(&cus_obj_fs_config, header_addr(), (uint32_t const *)&m_header,
+                 sizeof(m_header) / sizeof(uint32_t), &m_header) != FS_SUCCESS)
+    {
+        transfer_fail(CUS_OBJ_STATUS_FAILED);
+    }
+}
+
+
+static void on_header_written(void)
+{
+    uint32_t now;
+    uint32_t ticks;
+
+    UNUSED_RETURN_VALUE(app_timer_cnt_get(&now));
+    UNUSED_RETURN_VALUE(app_timer_cnt_diff_compute(now, m_start_ticks, &ticks));
+
+    m_state            = OBJ_STATE_COMPLETE;
+    m_stats.objects++;
+    m_stats.last_size  = m_size;
+    m_stats.last_ticks = ticks;
+
+    done_send(CUS_OBJ_STATUS_OK, m_crc, ticks);
+}
+
+
+static void fs_evt_handler(fs_evt_t const * const p_evt, fs_ret_t result)
+{
+    if (result != FS_SUCCESS)
+    {
+        if (m_state == OBJ_STATE_ERASING)
+        {
+            m_state = OBJ_STATE_FAILED;
+            m_stats.failed++;
+            status_send(CUS_OBJ_OP_CREATED, CUS_OBJ_STATUS_FAILED, 0);
+        }
+        else
+        {
+            transfer_fail(CUS_OBJ_STATUS_FAILED);
+        }
+        return;
+    }
+
+    switch (p_evt->id)
+    {
+        case FS_EVT_ERASE:
+        {
+            uint8_t frame[1 + 1 + sizeof(uint32_t) + sizeof(uint16_t)];
+
+            m_state = OBJ_STATE_RECEIVING;
+            UNUSED_RETURN_VALUE(app_timer_cnt_get(&m_start_ticks));
+
+            frame[0] = CUS_OBJ_OP_CREATED;
+            frame[1] = CUS_OBJ_STATUS_OK;
+            UNUSED_RETURN_VALUE(uint32_encode(0, &frame[2]));
+            UNUSED_RETURN_VALUE(uint16_encode(OBJ_WINDOW, &frame[6]));
+            UNUSED_RETURN_VALUE(frame_send(frame, sizeof(frame)));
+        } break;
+
+        case FS_EVT_STORE:
+            if (p_evt->p_context == &m_header)
+            {
+                on_header_written();
+            }
+            else
+            {
+                on_buf_written();
+            }
+            break;
+
+        default:
+            // No implementation needed.
+            break;
+    }
+}
+
+
+static bool flash_busy(void)
+{
+    return (m_state == OBJ_STATE_ERASING) || (m_state == OBJ_STATE_FINISHING) || (m_buf_full > 0);
+}
+
+
+static void on_create(uint8_t const * p_args, uint16_t length)
+{
+    uint8_t  frame[1 + 1 + sizeof(uint32_t) + sizeof(uint16_t)];
+    uint32_t size;
+    uint32_t crc;
+
+    if (length != 2 * sizeof(uint32_t))
+    {
+        status_send(CUS_OBJ_OP_CREATED, CUS_OBJ_STATUS_INVALID, 0);
+        return;
+    }
+
+    size = uint32_decode(&p_args[0]);
+    crc  = uint32_decode(&p_args[4]);
+
+    frame[0] = CUS_OBJ_OP_CREATED;
+    frame[1] = CUS_OBJ_STATUS_OK;
+    UNUSED_RETURN_VALUE(uint16_encode(OBJ_WINDOW, &frame[6]));
+
+    // Same object: resume after what was accepted. Data still in the staging buffers is kept, the
+    // link going down does not lose it.
+    if ((size == m_size) && (crc == m_crc) &&
+        ((m_state == OBJ_STATE_RECEIVING) || (m_state == OBJ_STATE_FINISHING) || (m_state == OBJ_STATE_COMPLETE)))
+    {
+        m_nack_sent = false;
+        UNUSED_RETURN_VALUE(uint32_encode(m_received, &frame[2]));
+        UNUSED_RETURN_VALUE(frame_send(frame, sizeof(frame)));
+        return;
+    }
+
+    if ((size == 0) || (size > CUS_OBJ_MAX_SIZE))
+    {
+        status_send(CUS_OBJ_OP_CREATED, CUS_OBJ_STATUS_INVALID, 0);
+        return;
+    }
+
+    if (flash_busy())
+    {
+        status_send(CUS_OBJ_OP_CREATED, CUS_OBJ_STATUS_BUSY, 0);
+        return;
+    }
+
+    m_size      = size;
+    m_crc       = crc;
+    m_crc_flash = 0;
+    m_received  = 0;
+    m_committed = 0;
+    m_nack_sent = false;
+    m_buf_head  = 0;
+    m_buf_full  = 0;
+    m_reading   = false;
+    memset(m_bufs, 0, sizeof(m_bufs));
+
+    // The header page goes first, so the previous object is forgotten before any of it is erased.
+    // CREATED is sent when the erase is done.
+    m_state = OBJ_STATE_ERASING;
+
+    if (fs_erase(&cus_obj_fs_config, header_addr(),
+                 1 + (size + OBJ_PAGE_SIZE - 1) / OBJ_PAGE_SIZE, NULL) != FS_SUCCESS)
+    {
+        m_state = OBJ_STATE_FAILED;
+        m_stats.failed++;
+        status_send(CUS_OBJ_OP_CREATED, CUS_OBJ_STATUS_FAILED, 0);
+    }
+}
+
+
+static void on_data(uint8_t const * p_args, uint16_t length)
+{
+    if ((m_state != OBJ_STATE_RECEIVING) || (length < sizeof(uint16_t)))
+    {
+        return;
+    }
+
+    uint32_t offset = uint16_decode(p_args);
+
+    p_args += sizeof(uint16_t);
+    length -= sizeof(uint16_t);
+
+    if ((offset != m_received) || ((offset + length) > m_size))
+    {
+        m_stats.out_of_order++;
+        if (!m_nack_sent)
+        {
+            status_send(CUS_OBJ_OP_ACK, CUS_OBJ_STATUS_OUT_OF_ORDER, m_received);
+            m_nack_sent = true;
+        }
+        return;
+    }
+
+    m_nack_sent = false;
+
+    while (length > 0)
+    {
+        if (m_buf_full == OBJ_BUF_COUNT)
+        {
+            // The peer went past the window: keep what fit, and have it send the rest again.
+            m_stats.out_of_order++;
+            status_send(CUS_OBJ_OP_ACK, CUS_OBJ_STATUS_OUT_OF_ORDER, m_received);
+            m_nack_sent = true;
+            return;
+        }
+
+        obj_buf_t * p_buf = &m_bufs[(m_buf_head + m_buf_full) % OBJ_BUF_COUNT];
+        uint16_t    len   = MIN(length, CUS_OBJ_BUF_SIZE - p_buf->len);
+
+        if (p_buf->len == 0)
+        {
+            p_buf->offset = (uint16_t)m_received;
+        }
+
+        memcpy((uint8_t *)p_buf->words + p_buf->len, p_args, len);
+        p_buf->len    += len;
+        m_received    += len;
+        m_stats.bytes += len;
+        p_args        += len;
+        length        -= len;
+
+        if ((p_buf->len == CUS_OBJ_BUF_SIZE) || (m_received == m_size))
+        {
+            buf_close();
+        }
+    }
+}
+
+
+/**@brief Function for sending the data being read back, while the TX pool has room. */
+static void read_pump(void)
+{
+    uint8_t frame[OBJ_DATA_HEADER_LEN + OBJ_READ_CHUNK_LEN];
+
+    while (m_reading && (m_read_offset < m_read_end))
+    {
+        uint16_t len = MIN(OBJ_READ_CHUNK_LEN, m_read_end - m_read_offset);
+
+        frame[0] = CUS_OBJ_OP_READ_DATA;
+        UNUSED_RETURN_VALUE(uint16_encode((uint16_t)m_read_offset, &frame[1]));
+        memcpy(&frame[OBJ_DATA_HEADER_LEN], (uint8_t const *)data_addr(0) + m_read_offset, len);
+
+        if (frame_send(frame, OBJ_DATA_HEADER_LEN + len) != NRF_SUCCESS)
+        {
+            return;
+        }
+        m_read_offset += len;
+    }
+
+    if (m_reading)
+    {
+        status_send(CUS_OBJ_OP_READ_END, CUS_OBJ_STATUS_OK, m_read_end);
+        m_reading = false;
+    }
+}
+
+
+static void on_read(uint8_t const * p_args, uint16_t length)
+{
+    uint32_t end = (m_state == OBJ_STATE_COMPLETE) ? m_size : m_committed;
+
+    if (length != sizeof(uint32_t))
+    {
+        status_send(CUS_OBJ_OP_READ_END, CUS_OBJ_STATUS_INVALID, 0);
+        return;
+    }
+    if ((m_state == OBJ_STATE_IDLE) || (m_state == OBJ_STATE_ERASING))
+    {
+        status_send(CUS_OBJ_OP_READ_END, CUS_OBJ_STATUS_NO_OBJECT, 0);
+        return;
+    }
+
+    uint32_t offset = uint32_decode(p_args);
+
+    if (offset > end)
+    {
+        status_send(CUS_OBJ_OP_READ_END, CUS_OBJ_STATUS_INVALID, end);
+        return;
+    }
+
+    m_reading     = true;
+    m_read_offset = offset;
+    m_read_end    = end;
+
+    read_pump();
+}
+
+
+static void on_frame(cus_mux_t * p_mux, uint8_t channel, void * p_context, uint8_t * p_data, uint16_t length)
+{
+    UNUSED_PARAMETER(p_mux);
+    UNUSED_PARAMETER(channel);
+    UNUSED_PARAMETER(p_context);
+
+    if (length == 0)
+    {
+        return;
+    }
+
+    switch (p_data[0])
+    {
+        case CUS_OBJ_OP_CREATE:
+            on_create(&p_data[1], length - 1);
+            break;
+
+        case CUS_OBJ_OP_DATA:
+            on_data(&p_data[1], length - 1);
+            break;
+
+        case CUS_OBJ_OP_READ:
+            on_read(&p_data[1], length - 1);
+            break;
+
+        default:
+            // Unknown opcode, ignored.
+            break;
+    }
+}
+
+
+uint32_t cus_obj_init(cus_mux_t * p_mux, uint8_t channel)
+{
+    VERIFY_PARAM_NOT_NULL(p_mux);
+
+    m_p_mux   = p_mux;
+    m_channel = channel;
+    m_state   = OBJ_STATE_IDLE;
+
+    if (fs_init() != FS_SUCCESS)
+    {
+        return NRF_ERROR_INTERNAL;
+    }
+
+    obj_header_t const * p_header = (obj_header_t const *)header_addr();
+
+    if ((p_header->magic == OBJ_MAGIC) && (p_header->size > 0) && (p_header->size <= CUS_OBJ_MAX_SIZE))
+    {
+        m_size      = p_header->size;
+        m_crc       = p_header->crc;
+        m_received  = m_size;
+        m_committed = m_size;
+        m_state     = OBJ_STATE_COMPLETE;
+    }
+
+    // Data and acknowledgements share the bulk share of the service with the other channels.
+    return cus_mux_channel_register(p_mux, channel, on_frame, NULL, CUS_TX_PRIO_BULK, false);
+}
+
+
+void cus_obj_on_ble_evt(ble_evt_t * p_ble_evt)
+{
+    switch (p_ble_evt->header.evt_id)
+    {
+        case BLE_EVT_TX_COMPLETE:
+            read_pump();
+            break;
+
+        case BLE_GAP_EVT_DISCONNECTED:
+            m_reading = false;
+            break;
+
+        default:
+            // No implementation needed.
+            break;
+    }
+}
+
+
+uint32_t cus_obj_get(uint8_t const ** pp_data, uint32_t * p_size)
+{
+    VERIFY_PARAM_NOT_NULL(pp_data);
+    VERIFY_PARAM_NOT_NULL(p_size);
+    VERIFY_TRUE(m_state == OBJ_STATE_COMPLETE, NRF_ERROR_NOT_FOUND);
+
+    *pp_data = (uint8_t const *)data_addr(0);
+    *p_size  = m_size;
+
+    return NRF_SUCCESS;
+}
+
+
+void cus_obj_stats_get(cus_obj_stats_t * p_stats)
+{
+    *p_stats = m_stats;
+}
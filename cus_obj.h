@@ -0,0 +1,118 @@
+#ifndef __CUS_OBJ_H_
+#define __CUS_OBJ_H_
+
+#include "ble.h"
+#include "sdk_config.h"
+#include "cus_mux.h"
+#include "fstorage.h"
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#ifdef __cplusplus
+	extern "C" {
+#endif
+
+/**@brief Opcodes, first byte of every frame of the object channel.
+ *
+ * @details Peer to device:
+ *          - CREATE {size (uint32), crc (uint32)}: starts an object, or resumes it if it has the
+ *            same size and CRC32 as the one in progress.
+ *          - DATA {offset (uint16), data}: data at offset, sent with Write Commands.
+ *          - READ {offset (uint32)}: reads the stored data back from offset.
+ *
+ *          Device to peer:
+ *          - CREATED {status, offset (uint32), window (uint16)}: the peer sends from offset, with
+ *            at most window bytes beyond the last acknowledged offset.
+ *          - ACK {status, offset (uint32)}: with CUS_OBJ_STATUS_OK, all data before offset is in
+ *            flash. With CUS_OBJ_STATUS_OUT_OF_ORDER, data was dropped and the peer goes back to
+ *            offset.
+ *          - DONE {status, crc (uint32), ticks (uint32)}: the object is complete and checked,
+ *            ticks is the RTC1 time from CREATED to the end of the last flash write.
+ *          - READ_DATA {offset (uint16), data}.
+ *          - READ_END {status, offset (uint32)}: end of the data, or error.
+ *
+ *          All values are little endian.
+ */
+enum
+{
+    CUS_OBJ_OP_CREATE    = 0x01,
+    CUS_OBJ_OP_DATA      = 0x02,
+    CUS_OBJ_OP_READ      = 0x03,
+    CUS_OBJ_OP_CREATED   = 0x81,
+    CUS_OBJ_OP_ACK       = 0x82,
+    CUS_OBJ_OP_DONE      = 0x83,
+    CUS_OBJ_OP_READ_DATA = 0x84,
+    CUS_OBJ_OP_READ_END  = 0x85
+};
+
+/**@brief Status of the answers. */
+enum
+{
+    CUS_OBJ_STATUS_OK           = 0x00,
+    CUS_OBJ_STATUS_INVALID      = 0x01,                           /**< Malformed frame, size too large, or offset out of range. */
+    CUS_OBJ_STATUS_BUSY         = 0x02,                           /**< Flash operations of the previous object are still running. */
+    CUS_OBJ_STATUS_OUT_OF_ORDER = 0x03,
+    CUS_OBJ_STATUS_CRC          = 0x04,                           /**< The data in flash does not match the CRC32 given by CREATE. */
+    CUS_OBJ_STATUS_FAILED       = 0x05,                           /**< A flash operation failed. */
+    CUS_OBJ_STATUS_NO_OBJECT    = 0x06
+};
+
+#define CUS_OBJ_MAX_SIZE                (CUS_OBJ_MAX_PAGES * FS_PAGE_SIZE_WORDS * sizeof(uint32_t))  /**< Largest object. */
+
+/**@brief Object transfer counters. */
+typedef struct
+{
+    uint32_t bytes;                                               /**< Data bytes accepted. */
+    uint32_t out_of_order;                                        /**< DATA frames dropped because of their offset or a full window. */
+    uint32_t flash_writes;                                        /**< Staging buffers written to flash. */
+    uint32_t objects;                                             /**< Objects completed and checked. */
+    uint32_t failed;                                              /**< Objects that failed their CRC or a flash operation. */
+    uint32_t last_size;                                           /**< Size of the last completed object. */
+    uint32_t last_ticks;                                          /**< RTC1 ticks it took, from CREATED to the last flash write. */
+} cus_obj_stats_t;
+
+/**@brief Function for initializing the object transfer and registering its channel.
+ *
+ * @details An object completed before a reset is found again in flash. All the functions of the
+ *          module, and the fstorage callbacks, must run in the SoftDevice event context.
+ *
+ * @param[in] p_mux    Initialized multiplexer.
+ * @param[in] channel  Channel carrying the transfer.
+ *
+ * @retval NRF_SUCCESS        If the channel was registered.
+ * @retval NRF_ERROR_INTERNAL If fstorage could not be initialized.
+ * @return Otherwise the error code returned by @ref cus_mux_channel_register.
+ */
+uint32_t cus_obj_init(cus_mux_t * p_mux, uint8_t channel);
+
+/**@brief Function for handling the BLE events relevant to the object transfer.
+ *
+ * @details Continues a read back on @ref BLE_EVT_TX_COMPLETE. Must be called once per event from
+ *          the application's BLE event dispatcher.
+ *
+ * @param[in] p_ble_evt  Event received from the SoftDevice.
+ */
+void cus_obj_on_ble_evt(ble_evt_t * p_ble_evt);
+
+/**@brief Function for getting the last completed object.
+ *
+ * @param[out] pp_data  Object in flash.
+ * @param[out] p_size   Size of the object.
+ *
+ * @retval NRF_SUCCESS         If there is a complete object.
+ * @retval NRF_ERROR_NOT_FOUND If there is none, or a new one is being transferred.
+ */
+uint32_t cus_obj_get(uint8_t const ** pp_data, uint32_t * p_size);
+
+/**@brief Function for reading the transfer counters.
+ *
+ * @param[out] p_stats  Counters.
+ */
+void cus_obj_stats_get(cus_obj_stats_t * p_stats);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
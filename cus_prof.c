@@ -0,0 +1,97 @@
+#include "sdk_common.h"
+#if CUS_PROF_ENABLED
+#include "cus_prof.h"
+
+#include "nrf.h"
+#include "app_util.h"
+
+
+#define PROF_TIMER                      CONCAT_2(NRF_TIMER, CUS_PROF_TIMER_INSTANCE)
+#define PROF_CC                         0                         /**< Capture register used to read the timer. */
+
+STATIC_ASSERT((CUS_PROF_TIMER_INSTANCE == 1) || (CUS_PROF_TIMER_INSTANCE == 2));  /**< TIMER0 belongs to the SoftDevice. */
+
+static cus_prof_hist_t m_hists[CUS_PROF_PROBE_COUNT];
+
+
+/**@brief Function for getting the bucket of a duration: the number of significant bits. */
+static uint8_t bucket_get(uint16_t ticks)
+{
+    uint8_t bucket = 0;
+
+    while (ticks != 0)
+    {
+        bucket++;
+        ticks >>= 1;
+    }
+    return bucket;
+}
+
+
+void cus_prof_init(void)
+{
+    PROF_TIMER->TASKS_STOP  = 1;
+    PROF_TIMER->MODE        = TIMER_MODE_MODE_Timer;
+    PROF_TIMER->BITMODE     = TIMER_BITMODE_BITMODE_16Bit;
+    PROF_TIMER->PRESCALER   = CUS_PROF_TIMER_PRESCALER;
+    PROF_TIMER->TASKS_CLEAR = 1;
+    PROF_TIMER->TASKS_START = 1;
+
+    cus_prof_reset();
+}
+
+
+uint16_t cus_prof_now(void)
+{
+    PROF_TIMER->TASKS_CAPTURE[PROF_CC] = 1;
+    return (uint16_t)PROF_TIMER->CC[PROF_CC];
+}
+
+
+void cus_prof_record(cus_prof_probe_t probe, uint16_t ticks)
+{
+    cus_prof_hist_t * p_hist = &m_hists[probe];
+    uint8_t           bucket = bucket_get(ticks);
+
+    p_hist->count++;
+    p_hist->total += ticks;
+    if (ticks > p_hist->max)
+    {
+        p_hist->max = ticks;
+    }
+    if (p_hist->buckets[bucket] != UINT16_MAX)
+    {
+        p_hist->buckets[bucket]++;
+    }
+}
+
+
+uint16_t cus_prof_encode(uint8_t * p_buf)
+{
+    uint16_t len = 0;
+
+    for (uint8_t i = 0; i < CUS_PROF_PROBE_COUNT; i++)
+    {
+        len += uint32_encode(m_hists[i].count, &p_buf[len]);
+        len += uint16_encode(m_hists[i].max,   &p_buf[len]);
+        for (uint8_t j = 0; j < CUS_PROF_BUCKETS; j++)
+        {
+            len += uint16_encode(m_hists[i].buckets[j], &p_buf[len]);
+        }
+    }
+    return len;
+}
+
+
+void cus_prof_hist_get(cus_prof_probe_t probe, cus_prof_hist_t * p_hist)
+{
+    *p_hist = m_hists[probe];
+}
+
+
+void cus_prof_reset(void)
+{
+    memset(m_hists, 0, sizeof(m_hists));
+}
+
+#endif // CUS_PROF_ENABLED
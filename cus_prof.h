@@ -0,0 +1,102 @@
+#ifndef __CUS_PROF_H_
+#define __CUS_PROF_H_
+
+#include "sdk_config.h"
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#ifdef __cplusplus
+	extern "C" {
+#endif
+
+/**@brief Instrumented hot paths. */
+typedef enum
+{
+    CUS_PROF_BLE_EVT,                                             /**< ble_evt_dispatch, whole. */
+    CUS_PROF_UART_EVT,                                            /**< uart_event_handle. */
+    CUS_PROF_DATA,                                                /**< Data handler of Service 1. */
+    CUS_PROF_DATA2,                                               /**< Data handler of Service 2. */
+    CUS_PROF_READ_AUTH,                                           /**< Read authorization of a READ characteristic. */
+    CUS_PROF_PROBE_COUNT
+} cus_prof_probe_t;
+
+/**@brief Buckets of a histogram: 0 ticks, then [2^(i-1), 2^i - 1] ticks in bucket i. */
+#define CUS_PROF_BUCKETS                17
+
+/**@brief Length of a histogram in @ref cus_prof_encode: count (uint32), max (uint16), buckets (uint16). */
+#define CUS_PROF_HIST_LEN               (4 + 2 + 2 * CUS_PROF_BUCKETS)
+
+#if CUS_PROF_ENABLED
+
+#define CUS_PROF_ENCODED_LEN            (CUS_PROF_PROBE_COUNT * CUS_PROF_HIST_LEN)
+
+/**@brief Macros for timing a section of code. Both must be in the same scope.
+ *
+ * @details Probes must only be used at the priority of the SoftDevice events
+ *          (APP_IRQ_PRIORITY_LOWEST here): a probe interrupting another between its capture and
+ *          the read of the result would corrupt it. They compile to nothing when CUS_PROF_ENABLED
+ *          is 0.
+ */
+#define CUS_PROF_BEGIN(probe)           uint16_t const cus_prof_begin_##probe = cus_prof_now()
+#define CUS_PROF_END(probe)             cus_prof_record((probe), (uint16_t)(cus_prof_now() - cus_prof_begin_##probe))
+
+/**@brief Histogram of the execution times of a probe, in timer ticks. */
+typedef struct
+{
+    uint32_t count;                                               /**< Sections timed. */
+    uint16_t max;                                                 /**< Longest section. */
+    uint16_t buckets[CUS_PROF_BUCKETS];                           /**< Sections per log2 bucket, saturating. */
+    uint32_t total;                                               /**< Sum of the sections, for the mean. Not encoded. */
+} cus_prof_hist_t;
+
+/**@brief Function for starting the free-running timer.
+ *
+ * @details The timer counts at 16 MHz / 2^CUS_PROF_TIMER_PRESCALER on 16 bits: with the default
+ *          prescaler 0 a tick is a CPU cycle and sections longer than 4.096 ms wrap around. The
+ *          timer keeps the high frequency clock running, profiling builds draw more current.
+ */
+void cus_prof_init(void);
+
+/**@brief Function for reading the timer. */
+uint16_t cus_prof_now(void);
+
+/**@brief Function for adding a section to the histogram of a probe.
+ *
+ * @param[in] probe  Probe.
+ * @param[in] ticks  Duration of the section.
+ */
+void cus_prof_record(cus_prof_probe_t probe, uint16_t ticks);
+
+/**@brief Function for writing all histograms, CUS_PROF_HIST_LEN bytes each in probe order,
+ *        little endian.
+ *
+ * @param[out] p_buf  Buffer of at least CUS_PROF_ENCODED_LEN bytes.
+ *
+ * @return Number of bytes written.
+ */
+uint16_t cus_prof_encode(uint8_t * p_buf);
+
+/**@brief Function for reading the histogram of a probe, total included.
+ *
+ * @param[in]  probe   Probe.
+ * @param[out] p_hist  Copy of the histogram.
+ */
+void cus_prof_hist_get(cus_prof_probe_t probe, cus_prof_hist_t * p_hist);
+
+/**@brief Function for clearing all histograms. */
+void cus_prof_reset(void);
+
+#else
+
+#define CUS_PROF_ENCODED_LEN            0
+#define CUS_PROF_BEGIN(probe)
+#define CUS_PROF_END(probe)
+
+#endif // CUS_PROF_ENABLED
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
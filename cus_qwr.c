@@ -0,0 +1,208 @@
+#include "cus_qwr.h"
+
+#include "sdk_common.h"
+#include "app_error.h"
+
+
+#define QWR_ENTRY_HEADER_LEN            6                         /**< Handle, offset and length of a queued write, little endian. */
+#define QWR_BLOCK_WORDS                 ((CUS_QWR_BLOCK_SIZE + 3) / 4)
+
+static uint32_t             m_blocks[CUS_QWR_BLOCK_COUNT][QWR_BLOCK_WORDS];  /**< Word aligned for the SoftDevice. */
+static ble_user_mem_block_t m_mem_blocks[CUS_QWR_BLOCK_COUNT];
+static uint16_t             m_block_conn[CUS_QWR_BLOCK_COUNT];    /**< Connection the block is lent to, BLE_CONN_HANDLE_INVALID if free. */
+static bool                 m_initialized;
+static uint16_t             m_blocks_used;
+static cus_qwr_stats_t      m_stats;
+
+
+STATIC_ASSERT(CUS_QWR_BLOCK_SIZE <= UINT16_MAX);
+
+
+static void pool_init(void)
+{
+    for (uint32_t i = 0; i < CUS_QWR_BLOCK_COUNT; i++)
+    {
+        m_mem_blocks[i].p_mem = (uint8_t *)m_blocks[i];
+        m_mem_blocks[i].len   = CUS_QWR_BLOCK_SIZE;
+        m_block_conn[i]       = BLE_CONN_HANDLE_INVALID;
+    }
+    m_initialized = true;
+}
+
+
+static ble_user_mem_block_t * block_find(uint16_t conn_handle)
+{
+    for (uint32_t i = 0; i < CUS_QWR_BLOCK_COUNT; i++)
+    {
+        if (m_block_conn[i] == conn_handle)
+        {
+            return &m_mem_blocks[i];
+        }
+    }
+    return NULL;
+}
+
+
+/**@brief Function for walking the queued writes of a block.
+ *
+ * @param[in]  p_block   Block filled by the SoftDevice.
+ * @param[in]  handle    Attribute handle to look for, or BLE_GATT_HANDLE_INVALID for none.
+ * @param[out] p_end     End of the furthest write to handle, 0 if there is none.
+ *
+ * @return Number of bytes used in the block, terminator included.
+ */
+static uint16_t block_parse(ble_user_mem_block_t const * p_block, uint16_t handle, uint16_t * p_end)
+{
+    uint8_t const * p_mem = p_block->p_mem;
+    uint32_t        pos   = 0;
+
+    *p_end = 0;
+
+    while ((pos + sizeof(uint16_t)) <= p_block->len)
+    {
+        uint16_t entry_handle = uint16_decode(&p_mem[pos]);
+
+        if (entry_handle == BLE_GATT_HANDLE_INVALID)
+        {
+            return (uint16_t)(pos + sizeof(uint16_t));
+        }
+        if ((pos + QWR_ENTRY_HEADER_LEN) > p_block->len)
+        {
+            break;
+        }
+
+        uint16_t offset = uint16_decode(&p_mem[pos + 2]);
+        uint16_t len    = uint16_decode(&p_mem[pos + 4]);
+
+        if ((entry_handle == handle) && ((offset + len) > *p_end))
+        {
+            *p_end = offset + len;
+        }
+        pos += QWR_ENTRY_HEADER_LEN + len;
+    }
+
+    // No terminator: the block was full.
+    return p_block->len;
+}
+
+
+static void on_user_mem_request(ble_evt_t * p_ble_evt)
+{
+    uint16_t               conn_handle = p_ble_evt->evt.common_evt.conn_handle;
+    ble_user_mem_block_t * p_block     = NULL;
+
+    if (p_ble_evt->evt.common_evt.params.user_mem_request.type == BLE_USER_MEM_TYPE_GATTS_QUEUED_WRITES)
+    {
+        m_stats.requests++;
+
+        p_block = block_find(BLE_CONN_HANDLE_INVALID);
+        if (p_block != NULL)
+        {
+            m_block_conn[p_block - m_mem_blocks] = conn_handle;
+            if (++m_blocks_used > m_stats.blocks_hwm)
+            {
+                m_stats.blocks_hwm = m_blocks_used;
+            }
+        }
+        else
+        {
+            m_stats.rejected++;
+        }
+    }
+
+    APP_ERROR_CHECK(sd_ble_user_mem_reply(conn_handle, p_block));
+}
+
+
+static void block_release(ble_user_mem_block_t * p_block)
+{
+    uint16_t end;
+    uint16_t used = block_parse(p_block, BLE_GATT_HANDLE_INVALID, &end);
+
+    if (used > m_stats.bytes_hwm)
+    {
+        m_stats.bytes_hwm = used;
+    }
+
+    m_block_conn[p_block - m_mem_blocks] = BLE_CONN_HANDLE_INVALID;
+    m_blocks_used--;
+}
+
+
+static void on_user_mem_release(ble_evt_t * p_ble_evt)
+{
+    ble_user_mem_block_t const * p_released = &p_ble_evt->evt.common_evt.params.user_mem_release.mem_block;
+    ble_user_mem_block_t       * p_block    = block_find(p_ble_evt->evt.common_evt.conn_handle);
+
+    if ((p_block != NULL) && (p_block->p_mem == p_released->p_mem))
+    {
+        block_release(p_block);
+    }
+}
+
+
+static void on_disconnect(ble_evt_t * p_ble_evt)
+{
+    // The block is normally released by the SoftDevice first; make sure it is not lost.
+    ble_user_mem_block_t * p_block = block_find(p_ble_evt->evt.gap_evt.conn_handle);
+
+    if (p_block != NULL)
+    {
+        block_release(p_block);
+    }
+}
+
+
+void cus_qwr_on_ble_evt(ble_evt_t * p_ble_evt)
+{
+    if (!m_initialized)
+    {
+        pool_init();
+    }
+
+    switch (p_ble_evt->header.evt_id)
+    {
+        case BLE_EVT_USER_MEM_REQUEST:
+            on_user_mem_request(p_ble_evt);
+            break;
+
+        case BLE_EVT_USER_MEM_RELEASE:
+            on_user_mem_release(p_ble_evt);
+            break;
+
+        case BLE_GAP_EVT_DISCONNECTED:
+            on_disconnect(p_ble_evt);
+            break;
+
+        default:
+            // No implementation needed.
+            break;
+    }
+}
+
+
+uint32_t cus_qwr_value_len_get(uint16_t conn_handle, uint16_t handle, uint16_t * p_len)
+{
+    ble_user_mem_block_t const * p_block;
+
+    if ((conn_handle == BLE_CONN_HANDLE_INVALID) || (handle == BLE_GATT_HANDLE_INVALID))
+    {
+        return NRF_ERROR_NOT_FOUND;
+    }
+
+    p_block = block_find(conn_handle);
+    if (p_block == NULL)
+    {
+        return NRF_ERROR_NOT_FOUND;
+    }
+
+    UNUSED_RETURN_VALUE(block_parse(p_block, handle, p_len));
+
+    return (*p_len != 0) ? NRF_SUCCESS : NRF_ERROR_NOT_FOUND;
+}
+
+
+void cus_qwr_stats_get(cus_qwr_stats_t * p_stats)
+{
+    *p_stats = m_stats;
+}
@@ -0,0 +1,58 @@
+#ifndef __CUS_QWR_H_
+#define __CUS_QWR_H_
+
+#include "ble.h"
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#ifdef __cplusplus
+	extern "C" {
+#endif
+
+/**@brief Usage counters of the user memory block pool. */
+typedef struct
+{
+    uint32_t requests;                                            /**< Blocks requested by the SoftDevice. */
+    uint32_t rejected;                                            /**< Requests answered without a block because the pool was empty. */
+    uint16_t blocks_hwm;                                          /**< Largest number of blocks lent at the same time. */
+    uint16_t bytes_hwm;                                           /**< Largest number of bytes used in a block, terminator included. */
+} cus_qwr_stats_t;
+
+/**@brief Function for handling the BLE events relevant to queued writes.
+ *
+ * @details Lends a block of the pool on @ref BLE_EVT_USER_MEM_REQUEST and takes it back on
+ *          @ref BLE_EVT_USER_MEM_RELEASE. When the pool is empty the request is answered with
+ *          NULL, and the SoftDevice falls back to authorizing each Prepare Write.
+ *          Must be called once per event from the application's BLE event dispatcher.
+ *
+ * @param[in] p_ble_evt  Event received from the SoftDevice.
+ */
+void cus_qwr_on_ble_evt(ble_evt_t * p_ble_evt);
+
+/**@brief Function for getting the length of an attribute value written by an Execute Write.
+ *
+ * @details To be called on @ref BLE_GATTS_EVT_WRITE with op @ref BLE_GATTS_OP_EXEC_WRITE_REQ_NOW.
+ *          The SoftDevice has already copied the queued data into the attribute; the length is
+ *          the end of the furthest Prepare Write to this handle.
+ *
+ * @param[in]  conn_handle  Connection handle.
+ * @param[in]  handle       Attribute handle.
+ * @param[out] p_len        Length of the value.
+ *
+ * @retval NRF_SUCCESS         If the Execute Write included data for this handle.
+ * @retval NRF_ERROR_NOT_FOUND If it did not, or no block is lent to this connection.
+ */
+uint32_t cus_qwr_value_len_get(uint16_t conn_handle, uint16_t handle, uint16_t * p_len);
+
+/**@brief Function for reading the usage counters of the pool.
+ *
+ * @param[out] p_stats  Counters.
+ */
+void cus_qwr_stats_get(cus_qwr_stats_t * p_stats);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
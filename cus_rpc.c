@@ -0,0 +1,185 @@
+#include "cus_rpc.h"
+
+#include "sdk_common.h"
+#include "app_util_platform.h"
+
+
+static uint32_t response_send(cus_rpc_t     * p_rpc,
+                              uint8_t         id,
+                              uint8_t         status,
+                              uint8_t const * p_result,
+                              uint16_t        result_len)
+{
+    uint8_t  rsp[CUS_MUX_MAX_DATA_LEN];
+    uint32_t err_code;
+
+    rsp[0] = id;
+    rsp[1] = status;
+    if (result_len > 0)
+    {
+        memcpy(&rsp[CUS_RPC_RSP_HEADER_LEN], p_result, result_len);
+    }
+
+    err_code = cus_mux_send(p_rpc->p_mux, p_rpc->channel, rsp, CUS_RPC_RSP_HEADER_LEN + result_len);
+
+    if (err_code == NRF_SUCCESS)
+    {
+        p_rpc->stats.responses++;
+    }
+    else
+    {
+        p_rpc->stats.lost++;
+    }
+    if (status != CUS_RPC_STATUS_OK)
+    {
+        p_rpc->stats.errors++;
+    }
+
+    return err_code;
+}
+
+
+static cus_rpc_handler_t method_find(cus_rpc_t const * p_rpc, uint8_t method)
+{
+    for (uint8_t i = 0; i < p_rpc->method_count; i++)
+    {
+        if (p_rpc->p_methods[i].method == method)
+        {
+            return p_rpc->p_methods[i].handler;
+        }
+    }
+    return NULL;
+}
+
+
+static bool pending_add(cus_rpc_t * p_rpc, uint8_t id)
+{
+    bool added = false;
+
+    CRITICAL_REGION_ENTER();
+    if (p_rpc->pending_count < CUS_RPC_MAX_PENDING)
+    {
+        p_rpc->pending_ids[p_rpc->pending_count++] = id;
+        added = true;
+    }
+    CRITICAL_REGION_EXIT();
+
+    return added;
+}
+
+
+static bool pending_remove(cus_rpc_t * p_rpc, uint8_t id)
+{
+    bool removed = false;
+
+    CRITICAL_REGION_ENTER();
+    for (uint8_t i = 0; i < p_rpc->pending_count; i++)
+    {
+        if (p_rpc->pending_ids[i] == id)
+        {
+            p_rpc->pending_ids[i] = p_rpc->pending_ids[--p_rpc->pending_count];
+            removed = true;
+            break;
+        }
+    }
+    CRITICAL_REGION_EXIT();
+
+    return removed;
+}
+
+
+/**@brief Function for handling a request received on the RPC channel. */
+static void on_request(cus_mux_t * p_mux, uint8_t channel, void * p_context, uint8_t * p_data, uint16_t length)
+{
+    cus_rpc_t       * p_rpc = (cus_rpc_t *)p_context;
+    cus_rpc_handler_t handler;
+    uint8_t           result[CUS_RPC_MAX_RESULT_LEN];
+    uint16_t          result_len = 0;
+    uint8_t           status;
+
+    UNUSED_PARAMETER(p_mux);
+    UNUSED_PARAMETER(channel);
+
+    if (length < CUS_RPC_REQ_HEADER_LEN)
+    {
+        // Without an id there is nobody to answer.
+        p_rpc->stats.errors++;
+        return;
+    }
+
+    uint8_t id = p_data[0];
+
+    p_rpc->stats.requests++;
+
+    handler = method_find(p_rpc, p_data[1]);
+    if (handler == NULL)
+    {
+        UNUSED_RETURN_VALUE(response_send(p_rpc, id, CUS_RPC_STATUS_UNKNOWN_METHOD, NULL, 0));
+        return;
+    }
+
+    // Reserve the pending slot first, so that an asynchronous answer can never find it missing.
+    if (!pending_add(p_rpc, id))
+    {
+        UNUSED_RETURN_VALUE(response_send(p_rpc, id, CUS_RPC_STATUS_BUSY, NULL, 0));
+        return;
+    }
+
+    status = handler(p_rpc,
+                     id,
+                     &p_data[CUS_RPC_REQ_HEADER_LEN],
+                     length - CUS_RPC_REQ_HEADER_LEN,
+                     result,
+                     &result_len);
+
+    if (status == CUS_RPC_STATUS_PENDING)
+    {
+        return;
+    }
+
+    if (pending_remove(p_rpc, id))
+    {
+        UNUSED_RETURN_VALUE(response_send(p_rpc, id, status, result, MIN(result_len, CUS_RPC_MAX_RESULT_LEN)));
+    }
+}
+
+
+uint32_t cus_rpc_init(cus_rpc_t              * p_rpc,
+                      cus_mux_t              * p_mux,
+                      uint8_t                  channel,
+                      cus_rpc_method_t const * p_methods,
+                      uint8_t                  method_count)
+{
+    VERIFY_PARAM_NOT_NULL(p_rpc);
+    VERIFY_PARAM_NOT_NULL(p_mux);
+    VERIFY_PARAM_NOT_NULL(p_methods);
+
+    memset(p_rpc, 0, sizeof(*p_rpc));
+
+    p_rpc->p_mux        = p_mux;
+    p_rpc->channel      = channel;
+    p_rpc->p_methods    = p_methods;
+    p_rpc->method_count = method_count;
+
+    // Responses are short and waited for: they go ahead of the bulk streams.
+    return cus_mux_channel_register(p_mux, channel, on_request, p_rpc, CUS_TX_PRIO_CONTROL, false);
+}
+
+
+uint32_t cus_rpc_respond(cus_rpc_t     * p_rpc,
+                         uint8_t         id,
+                         uint8_t         status,
+                         uint8_t const * p_result,
+                         uint16_t        result_len)
+{
+    VERIFY_PARAM_NOT_NULL(p_rpc);
+    VERIFY_TRUE(result_len <= CUS_RPC_MAX_RESULT_LEN, NRF_ERROR_INVALID_PARAM);
+    VERIFY_TRUE((result_len == 0) || (p_result != NULL), NRF_ERROR_INVALID_PARAM);
+
+    if (!pending_remove(p_rpc, id))
+    {
+        return NRF_ERROR_NOT_FOUND;
+    }
+
+    return response_send(p_rpc, id, status, p_result, result_len);
+}
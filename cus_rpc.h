@@ -0,0 +1,123 @@
+#ifndef __CUS_RPC_H_
+#define __CUS_RPC_H_
+
+#include "sdk_config.h"
+#include "cus_mux.h"
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#ifdef __cplusplus
+	extern "C" {
+#endif
+
+#define CUS_RPC_REQ_HEADER_LEN          2                         /**< {id, method} in front of the arguments. */
+#define CUS_RPC_RSP_HEADER_LEN          2                         /**< {id, status} in front of the result. */
+#define CUS_RPC_MAX_RESULT_LEN          (CUS_MUX_MAX_DATA_LEN - CUS_RPC_RSP_HEADER_LEN)  /**< Largest result of a call. */
+
+/**@brief Status of a call, returned in the response. */
+enum
+{
+    CUS_RPC_STATUS_OK             = 0x00,
+    CUS_RPC_STATUS_UNKNOWN_METHOD = 0x01,
+    CUS_RPC_STATUS_INVALID_ARGS   = 0x02,
+    CUS_RPC_STATUS_BUSY           = 0x03,                         /**< CUS_RPC_MAX_PENDING calls are already pending. */
+    CUS_RPC_STATUS_FAILED         = 0x04,
+    CUS_RPC_STATUS_PENDING        = 0xFF                          /**< Returned by a handler that answers later with @ref cus_rpc_respond. Never sent. */
+};
+
+/* Forward declaration of the cus_rpc_t type. */
+typedef struct cus_rpc_s cus_rpc_t;
+
+/**@brief Handler of a method.
+ *
+ * @param[in]    p_rpc         RPC instance.
+ * @param[in]    id            Identifier of the call, to be passed to @ref cus_rpc_respond if the
+ *                             handler returns CUS_RPC_STATUS_PENDING.
+ * @param[in]    p_args        Arguments.
+ * @param[in]    args_len      Length of the arguments.
+ * @param[out]   p_result      Result, at most @ref CUS_RPC_MAX_RESULT_LEN bytes.
+ * @param[inout] p_result_len  0 on entry; length of the result on return.
+ *
+ * @return Status of the call, or CUS_RPC_STATUS_PENDING.
+ */
+typedef uint8_t (*cus_rpc_handler_t)(cus_rpc_t     * p_rpc,
+                                     uint8_t         id,
+                                     uint8_t const * p_args,
+                                     uint16_t        args_len,
+                                     uint8_t       * p_result,
+                                     uint16_t      * p_result_len);
+
+/**@brief Entry of the method table. */
+typedef struct
+{
+    uint8_t                  method;
+    cus_rpc_handler_t        handler;
+} cus_rpc_method_t;
+
+/**@brief RPC counters. */
+typedef struct
+{
+    uint32_t requests;                                            /**< Requests received. */
+    uint32_t responses;                                           /**< Responses sent or queued. */
+    uint32_t errors;                                              /**< Calls answered with a status other than CUS_RPC_STATUS_OK. */
+    uint32_t lost;                                                /**< Responses that could not be sent; the peer calls again. */
+} cus_rpc_stats_t;
+
+/**@brief Request/response calls over a channel of a multiplexer.
+ *
+ * @details A request is {id, method, arguments} and its response {id, status, result}. The peer
+ *          chooses the ids and may have many calls outstanding; responses come back in the order
+ *          the calls complete, which is not the request order for pending calls.
+ */
+struct cus_rpc_s
+{
+    cus_mux_t              * p_mux;
+    uint8_t                  channel;
+    cus_rpc_method_t const * p_methods;                           /**< Method table, sorted or not. */
+    uint8_t                  method_count;
+    uint8_t                  pending_ids[CUS_RPC_MAX_PENDING];    /**< Calls waiting for @ref cus_rpc_respond. */
+    uint8_t                  pending_count;
+    cus_rpc_stats_t          stats;
+};
+
+/**@brief Function for initializing an RPC instance and registering its channel.
+ *
+ * @param[out] p_rpc         RPC structure, supplied by the application.
+ * @param[in]  p_mux         Initialized multiplexer.
+ * @param[in]  channel       Channel carrying the calls. Its frames are sent as control packets.
+ * @param[in]  p_methods     Method table, kept by reference.
+ * @param[in]  method_count  Number of entries in the table.
+ *
+ * @return      NRF_SUCCESS on success, otherwise an error code.
+ */
+uint32_t cus_rpc_init(cus_rpc_t              * p_rpc,
+                      cus_mux_t              * p_mux,
+                      uint8_t                  channel,
+                      cus_rpc_method_t const * p_methods,
+                      uint8_t                  method_count);
+
+/**@brief Function for answering a call for which the handler returned CUS_RPC_STATUS_PENDING.
+ *
+ * @param[in] p_rpc       RPC structure.
+ * @param[in] id          Identifier of the call.
+ * @param[in] status      Status of the call.
+ * @param[in] p_result    Result, may be NULL if result_len is 0.
+ * @param[in] result_len  Length of the result, at most @ref CUS_RPC_MAX_RESULT_LEN.
+ *
+ * @retval NRF_SUCCESS             If the response was sent or queued.
+ * @retval NRF_ERROR_NOT_FOUND     If no call with this id is pending.
+ * @retval NRF_ERROR_INVALID_PARAM If the result is too long.
+ * @return Otherwise the error code returned by @ref cus_mux_send.
+ */
+uint32_t cus_rpc_respond(cus_rpc_t     * p_rpc,
+                         uint8_t         id,
+                         uint8_t         status,
+                         uint8_t const * p_result,
+                         uint16_t        result_len);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -1,14 +1,259 @@
 #include "cus_service.h"
+#include "cus_qwr.h"
+#include "cus_prof.h"
 
 #include "sdk_common.h"
 #include "ble_srv_common.h"
+#include "app_util_platform.h"
 
 																									 
 #define BLE_CUSTOM_MAX_CHAR_LEN        (GATT_MTU_SIZE_DEFAULT - 3)        /**< Maximum length of the Custom Characteristic (in bytes). */
 
+static ble_cus_t * m_instances[CUS_TX_MAX_INSTANCES];                     /**< Initialized instances, reported by the diagnostics characteristic. */
+static uint8_t     m_instance_count;
+static uint8_t     m_diag_value[BLE_CUS_DIAG_MAX_LEN];                    /**< Value of the diagnostics characteristic, refreshed on each read. */
+static uint16_t    m_diag_len;
 
 
 
+
+/**@brief Function for sending the frame of a reliable record as a notification or an indication. */
+static uint32_t rec_hvx(ble_cus_t * p_cus, ble_cus_rec_slot_t * p_slot, uint8_t type)
+{
+    ble_gatts_hvx_params_t hvx_params;
+    uint16_t               len = p_slot->len;
+
+    if (type == BLE_GATT_HVX_NOTIFICATION)
+    {
+        // Notifications share the TX buffers with the other streams through the scheduler.
+        return cus_tx_send(p_cus->tx_id,
+                           p_cus->conn_handle,
+                           p_cus->notify_custom_value_handles.value_handle,
+                           p_slot->frame,
+                           p_slot->len,
+                           CUS_TX_PRIO_BULK);
+    }
+
+    memset(&hvx_params, 0, sizeof(hvx_params));
+
+    hvx_params.handle = p_cus->notify_custom_value_handles.value_handle;
+    hvx_params.type   = type;
+    hvx_params.p_len  = &len;
+    hvx_params.p_data = p_slot->frame;
+
+    return sd_ble_gatts_hvx(p_cus->conn_handle, &hvx_params);
+}
+
+
+static ble_cus_rec_mode_t rec_mode_select(ble_cus_t * p_cus)
+{
+    if (!p_cus->is_notification_enabled)
+    {
+        return BLE_CUS_REC_MODE_INDICATE;
+    }
+    if (!p_cus->is_indication_enabled)
+    {
+        return BLE_CUS_REC_MODE_NOTIFY_ACK;
+    }
+
+    // Both allowed: an indication costs a round trip per record, so it is only used for isolated
+    // records, and only while the peer keeps confirming them.
+    if (p_cus->rec.hvc_timed_out || (p_cus->rec.count >= CUS_REC_BULK_THRESHOLD))
+    {
+        return BLE_CUS_REC_MODE_NOTIFY_ACK;
+    }
+    return BLE_CUS_REC_MODE_INDICATE;
+}
+
+
+/**@brief Function for sending the records that are not in flight yet, as far as the mode allows. */
+static void rec_pump(ble_cus_t * p_cus)
+{
+    ble_cus_rec_t * p_rec = &p_cus->rec;
+
+    if ((p_rec->timeout_ticks == 0) || (p_cus->conn_handle == BLE_CONN_HANDLE_INVALID))
+    {
+        return;
+    }
+
+    // The mode only changes between two bursts, never with records in flight.
+    if (p_rec->in_flight == 0)
+    {
+        p_rec->mode = rec_mode_select(p_cus);
+    }
+
+    if (p_rec->mode == BLE_CUS_REC_MODE_INDICATE)
+    {
+        if ((p_rec->in_flight == 0) && (p_rec->count > 0) && p_cus->is_indication_enabled &&
+            (rec_hvx(p_cus, &p_rec->slots[p_rec->head], BLE_GATT_HVX_INDICATION) == NRF_SUCCESS))
+        {
+            p_rec->in_flight = 1;
+            p_rec->stats.indicated++;
+        }
+    }
+    else
+    {
+        while ((p_rec->in_flight < p_rec->count) && p_cus->is_notification_enabled)
+        {
+            ble_cus_rec_slot_t * p_slot = &p_rec->slots[(p_rec->head + p_rec->in_flight) % CUS_REC_QUEUE_SIZE];
+
+            if (rec_hvx(p_cus, p_slot, BLE_GATT_HVX_NOTIFICATION) != NRF_SUCCESS)
+            {
+                // Scheduler full, continue on the next TX complete.
+                break;
+            }
+            p_rec->in_flight++;
+            p_rec->stats.notified++;
+            p_rec->tx_mark = cus_tx_queue_mark(p_cus->tx_id);
+        }
+    }
+
+    if ((p_rec->in_flight > 0) && !p_rec->timer_running)
+    {
+        p_rec->confirmed_at_tick = p_rec->stats.confirmed;
+        if (app_timer_start(p_rec->timer_id, p_rec->timeout_ticks, p_cus) == NRF_SUCCESS)
+        {
+            p_rec->timer_running = true;
+        }
+    }
+}
+
+
+/**@brief Function for releasing the n oldest records once confirmed by the peer. */
+static void rec_release(ble_cus_t * p_cus, uint8_t n)
+{
+    ble_cus_rec_t * p_rec = &p_cus->rec;
+
+    p_rec->head             = (p_rec->head + n) % CUS_REC_QUEUE_SIZE;
+    p_rec->count           -= n;
+    p_rec->in_flight       -= MIN(n, p_rec->in_flight);
+    p_rec->stats.confirmed += n;
+
+    if ((p_rec->count == 0) && p_rec->timer_running)
+    {
+        UNUSED_RETURN_VALUE(app_timer_stop(p_rec->timer_id));
+        p_rec->timer_running = false;
+    }
+}
+
+
+static void rec_flush(ble_cus_t * p_cus)
+{
+    ble_cus_rec_t * p_rec = &p_cus->rec;
+
+    if (p_rec->timer_running)
+    {
+        UNUSED_RETURN_VALUE(app_timer_stop(p_rec->timer_id));
+        p_rec->timer_running = false;
+    }
+
+    p_rec->stats.dropped += p_rec->count;
+    p_rec->head           = 0;
+    p_rec->count          = 0;
+    p_rec->in_flight      = 0;
+    p_rec->next_seq       = 0;
+    p_rec->hvc_timed_out  = false;
+}
+
+
+/**@brief Function for handling the record timer, running as long as records are in flight.
+ *
+ * @details A timeout is declared only if nothing was confirmed during a whole period.
+ */
+static void rec_timeout_handler(void * p_context)
+{
+    ble_cus_t     * p_cus = (ble_cus_t *)p_context;
+    ble_cus_rec_t * p_rec = &p_cus->rec;
+
+    if (p_rec->count == 0)
+    {
+        UNUSED_RETURN_VALUE(app_timer_stop(p_rec->timer_id));
+        p_rec->timer_running = false;
+        return;
+    }
+
+    // Notified records still waiting in the scheduler have not reached the peer yet: sending them
+    // again would only queue duplicates, so the peer gets another period once they are out.
+    if ((p_rec->in_flight > 0) && (p_rec->stats.confirmed == p_rec->confirmed_at_tick) &&
+        ((p_rec->mode == BLE_CUS_REC_MODE_INDICATE) || cus_tx_queue_passed(p_cus->tx_id, p_rec->tx_mark)))
+    {
+        p_rec->stats.timeouts++;
+
+        if (p_rec->mode == BLE_CUS_REC_MODE_INDICATE)
+        {
+            // The indication stays pending in the SoftDevice, but notifications can still go out.
+            p_rec->hvc_timed_out = true;
+        }
+
+        // Go back to the oldest record that is not confirmed.
+        if (p_cus->is_notification_enabled)
+        {
+            if (p_rec->mode == BLE_CUS_REC_MODE_NOTIFY_ACK)
+            {
+                p_rec->stats.retransmitted += p_rec->in_flight;
+            }
+            p_rec->in_flight = 0;
+        }
+    }
+
+    p_rec->confirmed_at_tick = p_rec->stats.confirmed;
+
+    rec_pump(p_cus);
+}
+
+
+/**@brief Function for handling a {BLE_CUS_REC_ACK, seq} write from the peer.
+ *
+ * @return true if the write was a record acknowledgement.
+ */
+static bool rec_on_ack(ble_cus_t * p_cus, uint8_t const * p_data, uint16_t length)
+{
+    ble_cus_rec_t * p_rec = &p_cus->rec;
+
+    if ((p_rec->timeout_ticks == 0) || (length != 2) || (p_data[0] != BLE_CUS_REC_ACK))
+    {
+        return false;
+    }
+
+    // Cumulative: the peer received every record up to seq in order.
+    if ((p_rec->mode == BLE_CUS_REC_MODE_NOTIFY_ACK) && (p_rec->count > 0))
+    {
+        uint8_t oldest_seq = (uint8_t)(p_rec->next_seq - p_rec->count);
+        uint8_t n          = (uint8_t)(p_data[1] - oldest_seq) + 1;
+
+        if ((n != 0) && (n <= p_rec->in_flight))
+        {
+            rec_release(p_cus, n);
+            rec_pump(p_cus);
+        }
+    }
+
+    return true;
+}
+
+
+static void rec_on_hvc(ble_cus_t * p_cus, ble_evt_t * p_ble_evt)
+{
+    ble_cus_rec_t * p_rec = &p_cus->rec;
+
+    if (p_ble_evt->evt.gatts_evt.params.hvc.handle != p_cus->notify_custom_value_handles.value_handle)
+    {
+        return;
+    }
+
+    p_rec->hvc_timed_out = false;
+
+    // A late confirmation of an indication that was already sent again by notification is only
+    // taken as a sign that the link is back; the notified copy is acknowledged separately.
+    if ((p_rec->mode == BLE_CUS_REC_MODE_INDICATE) && (p_rec->in_flight > 0))
+    {
+        rec_release(p_cus, 1);
+    }
+
+    rec_pump(p_cus);
+}
+
+
 /**@brief Function for handling the @ref BLE_GAP_EVT_CONNECTED event from the S110 SoftDevice. */
 static void on_connect(ble_cus_t * p_cus, ble_evt_t * p_ble_evt)
 {
@@ -27,6 +272,9 @@ static void on_disconnect(ble_cus_t * p_cus, ble_evt_t * p_ble_evt)
 {
     UNUSED_PARAMETER(p_ble_evt);
     p_cus->conn_handle = BLE_CONN_HANDLE_INVALID;
+		p_cus->is_notification_enabled = false;
+		p_cus->is_indication_enabled   = false;
+		rec_flush(p_cus);
 	
 		ble_cus_evt_t evt;
 
@@ -41,12 +289,55 @@ static void on_write(ble_cus_t * p_cus, ble_evt_t * p_ble_evt)
 {
     ble_gatts_evt_write_t * p_evt_write = &p_ble_evt->evt.gatts_evt.params.write;
 
+		// Execute Write of queued (long) writes: the SoftDevice has already stored the whole value,
+		// deliver it in one callback if part of it was written to this service.
+		if (p_evt_write->op == BLE_GATTS_OP_EXEC_WRITE_REQ_NOW)
+		{
+				uint16_t  len;
+				uint8_t   value[BLE_CUSTOM_MAX_CHAR_LEN];
+				uint8_t * p_value = p_cus->p_write_value;
+				
+				if ((p_cus->data_handler == NULL) ||
+						(cus_qwr_value_len_get(p_cus->conn_handle,
+																	 p_cus->write_custom_value_handles.value_handle,
+																	 &len) != NRF_SUCCESS))
+				{
+						return;
+				}
+				len = MIN(len, p_cus->write_value_max_len);
+				
+				if (p_value == NULL)
+				{
+						// The value is kept by the SoftDevice, at most BLE_CUSTOM_MAX_CHAR_LEN bytes.
+						ble_gatts_value_t gatts_value;
+						
+						memset(&gatts_value, 0, sizeof(gatts_value));
+						gatts_value.len     = len;
+						gatts_value.p_value = value;
+						if (sd_ble_gatts_value_get(p_cus->conn_handle,
+																			 p_cus->write_custom_value_handles.value_handle,
+																			 &gatts_value) != NRF_SUCCESS)
+						{
+								return;
+						}
+						p_value = value;
+						len     = MIN(gatts_value.len, len);
+				}
+				
+				p_cus->counters.writes++;
+				p_cus->counters.bytes_in += len;
+				p_cus->data_handler(p_cus, p_value, len);
+				return;
+		}
+		
 		// Check if the Custom value CCCD is written to and that the value is the appropriate length, i.e 2 bytes.
     if ((p_evt_write->handle == p_cus->notify_custom_value_handles.cccd_handle)
 				&& (p_evt_write->len == 2))
 		
     {
 				ble_cus_evt_t evt;
+				
+				p_cus->counters.cccd_writes++;
 				// CCCD written, call application event handler
         if (ble_srv_is_notification_enabled(p_evt_write->data))
         {
@@ -58,14 +349,24 @@ static void on_write(ble_cus_t * p_cus, ble_evt_t * p_ble_evt)
             p_cus->is_notification_enabled = false;
 						evt.evt_type = BLE_CUS_EVT_NOTIFICATION_DISABLED;
         }
+				p_cus->is_indication_enabled = ble_srv_is_indication_enabled(p_evt_write->data);
 				// Call the application event handler.
 				p_cus->evt_handler(p_cus, &evt);
+				rec_pump(p_cus);
     }
-    else if ((p_evt_write->handle == p_cus->write_custom_value_handles.value_handle)
-             && (p_cus->data_handler != NULL))
-		
+    else if (p_evt_write->handle == p_cus->write_custom_value_handles.value_handle)
     {
-        p_cus->data_handler(p_cus, p_evt_write->data, p_evt_write->len);
+        p_cus->counters.writes++;
+        p_cus->counters.bytes_in += p_evt_write->len;
+
+        if (rec_on_ack(p_cus, p_evt_write->data, p_evt_write->len))
+        {
+            // Record acknowledgement, not application data.
+        }
+        else if (p_cus->data_handler != NULL)
+        {
+            p_cus->data_handler(p_cus, p_evt_write->data, p_evt_write->len);
+        }
     }
     else
     {
@@ -73,15 +374,126 @@ static void on_write(ble_cus_t * p_cus, ble_evt_t * p_ble_evt)
     }
 }
 
+/**@brief Function for answering a Read Blob request (offset > 0) from the stored value. */
+static void on_read_blob(ble_cus_t * p_cus, uint16_t offset, uint16_t value_len)
+{
+	ble_gatts_rw_authorize_reply_params_t auth_reply;
+
+	memset(&auth_reply, 0, sizeof(auth_reply));
+
+	// update = 0: the SoftDevice returns the stored value from the requested offset.
+	auth_reply.type                    = BLE_GATTS_AUTHORIZE_TYPE_READ;
+	auth_reply.params.read.gatt_status = (offset > value_len) ? BLE_GATT_STATUS_ATTERR_INVALID_OFFSET
+	                                                          : BLE_GATT_STATUS_SUCCESS;
+
+	UNUSED_RETURN_VALUE(sd_ble_gatts_rw_authorize_reply(p_cus->conn_handle, &auth_reply));
+}
+
+/**@brief Function for writing the counters of all instances into the diagnostics value. */
+static void diag_encode(void)
+{
+	ble_cus_counters_t counters;
+	uint16_t           len = 0;
+
+	m_diag_value[len++] = m_instance_count;
+	for (uint8_t i = 0; i < m_instance_count; i++)
+	{
+		if (ble_cus_counters_get(m_instances[i], &counters) != NRF_SUCCESS)
+		{
+			memset(&counters, 0, sizeof(counters));
+		}
+		len += uint32_encode(counters.bytes_in,      &m_diag_value[len]);
+		len += uint32_encode(counters.bytes_out,     &m_diag_value[len]);
+		len += uint32_encode(counters.writes,        &m_diag_value[len]);
+		len += uint32_encode(counters.notifications, &m_diag_value[len]);
+		len += uint32_encode(counters.no_tx_packets, &m_diag_value[len]);
+		len += uint32_encode(counters.reads,         &m_diag_value[len]);
+		len += uint32_encode(counters.cccd_writes,   &m_diag_value[len]);
+	}
+	m_diag_len = len;
+}
+
+/**@brief Function for answering a read of the diagnostics characteristic.
+ *
+ * @details Like the READ characteristic, the value is refreshed by the Read request only; the
+ *          Read Blob requests that follow get the rest of the same snapshot.
+ */
+static void on_diag_read(ble_cus_t * p_cus, uint16_t offset)
+{
+	ble_gatts_rw_authorize_reply_params_t auth_reply;
+
+	if (offset != 0)
+	{
+		on_read_blob(p_cus, offset, m_diag_len);
+		return;
+	}
+
+	diag_encode();
+
+	memset(&auth_reply, 0, sizeof(auth_reply));
+	auth_reply.type                    = BLE_GATTS_AUTHORIZE_TYPE_READ;
+	auth_reply.params.read.gatt_status = BLE_GATT_STATUS_SUCCESS;
+	auth_reply.params.read.update      = 1;
+	auth_reply.params.read.len         = m_diag_len;
+	auth_reply.params.read.p_data      = m_diag_value;
+
+	UNUSED_RETURN_VALUE(sd_ble_gatts_rw_authorize_reply(p_cus->conn_handle, &auth_reply));
+}
+
+/**@brief Function for handling a write to the diagnostics characteristic: the counters are cleared,
+ *        the value written is not stored.
+ */
+static void on_diag_write(ble_cus_t * p_cus, ble_evt_t const * p_ble_evt)
+{
+	ble_gatts_evt_write_t const         * p_evt_write = &p_ble_evt->evt.gatts_evt.params.authorize_request.request.write;
+	ble_gatts_rw_authorize_reply_params_t auth_reply;
+
+	// Queued writes to it are refused by the application's handler.
+	if ((p_cus->diag_handles.value_handle == 0) ||
+	    (p_evt_write->handle != p_cus->diag_handles.value_handle) ||
+	    (p_evt_write->op != BLE_GATTS_OP_WRITE_REQ))
+	{
+		return;
+	}
+
+	ble_cus_counters_reset();
+
+	memset(&auth_reply, 0, sizeof(auth_reply));
+	auth_reply.type                     = BLE_GATTS_AUTHORIZE_TYPE_WRITE;
+	auth_reply.params.write.gatt_status = BLE_GATT_STATUS_SUCCESS;
+	auth_reply.params.write.update      = 0;
+
+	UNUSED_RETURN_VALUE(sd_ble_gatts_rw_authorize_reply(p_cus->conn_handle, &auth_reply));
+}
+
 static void on_read(ble_cus_t * p_cus, ble_evt_t const * p_ble_evt)
 {
 	ble_cus_evt_t                 evt;
 	ble_gatts_evt_read_t const * p_evt_read = &p_ble_evt->evt.gatts_evt.params.authorize_request.request.read;
-	if ((p_evt_read->handle == p_cus->read_custom_value_handles.value_handle) &&
+	if ((p_cus->diag_handles.value_handle != 0) && (p_evt_read->handle == p_cus->diag_handles.value_handle))
+	{
+		on_diag_read(p_cus, p_evt_read->offset);
+	}
+	else if ((p_evt_read->handle == p_cus->read_custom_value_handles.value_handle) &&
 							 (p_cus->data_handler != NULL))	
 	{
-        evt.evt_type                  = BLE_CUS_EVT_READ;
-        p_cus->evt_handler(p_cus, &evt);	
+		// A value longer than the MTU is read as a Read request followed by Read Blob requests with
+		// increasing offsets. Only the first one goes to the application, which sets the whole value;
+		// the following ones are served from that value so the peer gets one consistent snapshot.
+		CUS_PROF_BEGIN(CUS_PROF_READ_AUTH);
+		
+		if (p_evt_read->offset != 0)
+		{
+				on_read_blob(p_cus, p_evt_read->offset, p_cus->read_value_len);
+		}
+		else
+		{
+				p_cus->counters.reads++;
+				evt.evt_type = BLE_CUS_EVT_READ;
+				p_cus->evt_handler(p_cus, &evt);
+		}
+		
+		CUS_PROF_END(CUS_PROF_READ_AUTH);
 	}
 }
 
@@ -100,6 +512,8 @@ static uint32_t custom_value_char_write_add(ble_cus_t * p_cus, const ble_cus_ini
 		
 		char_md.char_props.read   = 0;	// need for read with response
     char_md.char_props.write  = 1;
+		// Write commands: the peer can send several writes per connection event (pipelined calls).
+    char_md.char_props.write_wo_resp = 1;
 		// --- Configure Notify ----
     char_md.char_props.notify = 0; 
 		// -------------------------
@@ -115,10 +529,10 @@ static uint32_t custom_value_char_write_add(ble_cus_t * p_cus, const ble_cus_ini
 		// A other way to set up permissions
 //    attr_md.write_perm = p_cus_init->custom_value_char_attr_md.write_perm;
 		//  The .vloc option is set to BLE_GATTS_VLOC_STACK as we want the characteristic to be stored in the SoftDevice RAM section 
-		//  and not in the Application RAM section.
-    attr_md.vloc       = BLE_GATTS_VLOC_STACK;
+		//  and not in the Application RAM section, unless the application gave a buffer for long writes.
+    attr_md.vloc       = (p_cus->p_write_value != NULL) ? BLE_GATTS_VLOC_USER : BLE_GATTS_VLOC_STACK;
     attr_md.rd_auth    = 0;		// need for read with response
-    attr_md.wr_auth    = 0;
+    attr_md.wr_auth    = 0;		// no authorization, so queued writes are handled by the SoftDevice in the user memory block
     attr_md.vlen       = 1;		// 0: Get full size of attribute characteristic --> BLE_CUSTOM_MAX_CHAR_LEN
 															// 1: Get fit enough with data size 
 		
@@ -134,7 +548,8 @@ static uint32_t custom_value_char_write_add(ble_cus_t * p_cus, const ble_cus_ini
 		// Maximum lenth that can contain all characters from nRF Connect app send to the device 
 		// For example, attr_char_value.max_len   = sizeof(uint8_t); ==> only receive 1 byte.
 		// 							attr_char_value.max_len   = BLE_NUS_MAX_TX_CHAR_LEN; ==> receive > 1 byte
-    attr_char_value.max_len   = BLE_CUSTOM_MAX_CHAR_LEN;
+    attr_char_value.max_len   = p_cus->write_value_max_len;
+		attr_char_value.p_value   = p_cus->p_write_value;
 		
 		
 		err_code = sd_ble_gatts_characteristic_add(p_cus->service_handle, &char_md,
@@ -193,7 +608,9 @@ static uint32_t custom_value_char_read_add(ble_cus_t * p_cus, const ble_cus_init
 //    attr_md.write_perm = p_cus_init->custom_value_char_attr_md.write_perm;
 		//  The .vloc option is set to BLE_GATTS_VLOC_STACK as we want the characteristic to be stored in the SoftDevice RAM section 
 		//  and not in the Application RAM section.
-    attr_md.vloc       = BLE_GATTS_VLOC_STACK;
+		//  If the application supplies its own buffer, BLE_GATTS_VLOC_USER is used instead: the SoftDevice reads the value
+		//  straight from that buffer and the value takes no room in the attribute table.
+    attr_md.vloc       = (p_cus->p_read_value != NULL) ? BLE_GATTS_VLOC_USER : BLE_GATTS_VLOC_STACK;
     attr_md.rd_auth    = 1;		// need for read with response
     attr_md.wr_auth    = 0;
     attr_md.vlen       = 1;		// 0: Get full size of attribute characteristic --> BLE_CUSTOM_MAX_CHAR_LEN
@@ -206,12 +623,13 @@ static uint32_t custom_value_char_read_add(ble_cus_t * p_cus, const ble_cus_init
 		
 		attr_char_value.p_uuid    = &ble_uuid;
     attr_char_value.p_attr_md = &attr_md;
-    attr_char_value.init_len  = sizeof(uint8_t);
+    attr_char_value.init_len  = p_cus->read_value_len;
     attr_char_value.init_offs = 0;
 		// Maximum lenth that can contain all characters from nRF Connect app send to the device 
 		// For example, attr_char_value.max_len   = sizeof(uint8_t); ==> only receive 1 byte.
 		// 							attr_char_value.max_len   = BLE_NUS_MAX_TX_CHAR_LEN; ==> receive > 1 byte
-    attr_char_value.max_len   = BLE_CUSTOM_MAX_CHAR_LEN;
+    attr_char_value.max_len   = p_cus->read_value_max_len;
+		attr_char_value.p_value   = p_cus->p_read_value;
 		
 		
 		err_code = sd_ble_gatts_characteristic_add(p_cus->service_handle, &char_md,
@@ -252,6 +670,8 @@ static uint32_t custom_value_char_notify_add(ble_cus_t * p_cus, const ble_cus_in
     char_md.char_props.write  = 0;
 		// --- Configure Notify ----
     char_md.char_props.notify = 1; 
+		// The peer may enable indications too, for the reliable records.
+    char_md.char_props.indicate = (p_cus->rec.timeout_ticks != 0) ? 1 : 0;
 		// -------------------------
     char_md.p_char_user_desc  = NULL;
     char_md.p_char_pf         = NULL;
@@ -303,6 +723,50 @@ static uint32_t custom_value_char_notify_add(ble_cus_t * p_cus, const ble_cus_in
 }
 
 
+/**@brief Function for adding the diagnostics characteristic: read, and write to clear the counters.
+ *
+ * @details Both are authorized, so the value is computed at each read and never overwritten by a
+ *          write. It lives in a module buffer (BLE_GATTS_VLOC_USER), not in the attribute table.
+ */
+static uint32_t diag_char_add(ble_cus_t * p_cus, const ble_cus_init_t * p_cus_init)
+{
+		ble_gatts_char_md_t char_md;
+    ble_gatts_attr_t    attr_char_value;
+    ble_uuid_t          ble_uuid;
+    ble_gatts_attr_md_t attr_md;
+
+		memset(&char_md, 0, sizeof(char_md));
+
+		char_md.char_props.read  = 1;
+		char_md.char_props.write = 1;
+
+		memset(&attr_md, 0, sizeof(attr_md));
+
+		BLE_GAP_CONN_SEC_MODE_SET_OPEN(&attr_md.read_perm);
+		BLE_GAP_CONN_SEC_MODE_SET_OPEN(&attr_md.write_perm);
+    attr_md.vloc       = BLE_GATTS_VLOC_USER;
+    attr_md.rd_auth    = 1;
+    attr_md.wr_auth    = 1;
+    attr_md.vlen       = 1;
+
+		ble_uuid.type = p_cus->uuid_type;
+    ble_uuid.uuid = p_cus_init->char_diag_uuid;
+
+		memset(&attr_char_value, 0, sizeof(attr_char_value));
+
+		attr_char_value.p_uuid    = &ble_uuid;
+    attr_char_value.p_attr_md = &attr_md;
+    attr_char_value.init_len  = 1;
+    attr_char_value.init_offs = 0;
+    attr_char_value.max_len   = sizeof(m_diag_value);
+		attr_char_value.p_value   = m_diag_value;
+
+		return sd_ble_gatts_characteristic_add(p_cus->service_handle, &char_md,
+		                                       &attr_char_value,
+		                                       &p_cus->diag_handles);
+}
+
+
 void ble_cus_on_ble_evt(ble_cus_t * p_cus, ble_evt_t * p_ble_evt)
 {
     if ((p_cus == NULL) || (p_ble_evt == NULL))
@@ -325,7 +789,23 @@ void ble_cus_on_ble_evt(ble_cus_t * p_cus, ble_evt_t * p_ble_evt)
             break;
 
 				case BLE_GATTS_EVT_RW_AUTHORIZE_REQUEST:
-						on_read(p_cus, p_ble_evt);
+						if (p_ble_evt->evt.gatts_evt.params.authorize_request.type == BLE_GATTS_AUTHORIZE_TYPE_READ)
+						{
+								on_read(p_cus, p_ble_evt);
+						}
+						else if (p_ble_evt->evt.gatts_evt.params.authorize_request.type == BLE_GATTS_AUTHORIZE_TYPE_WRITE)
+						{
+								on_diag_write(p_cus, p_ble_evt);
+						}
+						break;
+
+				case BLE_GATTS_EVT_HVC:
+						rec_on_hvc(p_cus, p_ble_evt);
+						break;
+
+				case BLE_EVT_TX_COMPLETE:
+						rec_pump(p_cus);
+						break;
 				
         default:
             // No implementation needed.
@@ -350,6 +830,61 @@ uint32_t ble_cus_init(ble_cus_t * p_cus, const ble_cus_init_t * p_cus_init)
 		// Initialize function pointer to point to 'main.c' to get event of chacracteristic value attribute
 		p_cus->evt_handler               = p_cus_init->evt_handler;
 	
+		// Storage of the READ characteristic value: application buffer or SoftDevice attribute table.
+		// Values longer than BLE_CUSTOM_MAX_CHAR_LEN are read by the peer with Read Blob requests.
+		VERIFY_TRUE(p_cus_init->read_value_max_len <= BLE_GATTS_VAR_ATTR_LEN_MAX, NRF_ERROR_INVALID_PARAM);
+		
+		if (p_cus_init->p_read_value != NULL)
+		{
+				VERIFY_TRUE(p_cus_init->read_value_max_len > 0, NRF_ERROR_INVALID_PARAM);
+
+				p_cus->p_read_value       = p_cus_init->p_read_value;
+				p_cus->read_value_max_len = p_cus_init->read_value_max_len;
+				p_cus->read_value_len     = p_cus_init->read_value_max_len;
+		}
+		else
+		{
+				p_cus->p_read_value       = NULL;
+				p_cus->read_value_max_len = (p_cus_init->read_value_max_len != 0) ? p_cus_init->read_value_max_len
+				                                                                  : BLE_CUSTOM_MAX_CHAR_LEN;
+				p_cus->read_value_len     = sizeof(uint8_t);
+		}
+		
+		// Storage of the WRITE characteristic value. Values longer than BLE_CUSTOM_MAX_CHAR_LEN are
+		// written by the peer with queued writes, which need the value in an application buffer.
+		if (p_cus_init->p_write_value != NULL)
+		{
+				VERIFY_TRUE((p_cus_init->write_value_max_len > 0) &&
+										(p_cus_init->write_value_max_len <= BLE_GATTS_VAR_ATTR_LEN_MAX),
+										NRF_ERROR_INVALID_PARAM);
+				
+				p_cus->p_write_value       = p_cus_init->p_write_value;
+				p_cus->write_value_max_len = p_cus_init->write_value_max_len;
+		}
+		else
+		{
+				p_cus->p_write_value       = NULL;
+				p_cus->write_value_max_len = BLE_CUSTOM_MAX_CHAR_LEN;
+		}
+	
+		// Reliable records, timed out with an app_timer running while records are in flight.
+		memset(&p_cus->rec, 0, sizeof(p_cus->rec));
+		p_cus->rec.timeout_ticks = p_cus_init->rec_timeout_ticks;
+		if (p_cus->rec.timeout_ticks != 0)
+		{
+				p_cus->rec.timer_id = &p_cus->rec.timer_data;
+				err_code = app_timer_create(&p_cus->rec.timer_id, APP_TIMER_MODE_REPEATED, rec_timeout_handler);
+				VERIFY_SUCCESS(err_code);
+		}
+		
+		// All instances share the SoftDevice TX buffers through the TX scheduler, which also bounds
+		// the number of instances.
+		err_code = cus_tx_register(p_cus_init->tx_weight, &p_cus->tx_id);
+		VERIFY_SUCCESS(err_code);
+		
+		memset(&p_cus->counters, 0, sizeof(p_cus->counters));
+		memset(&p_cus->diag_handles, 0, sizeof(p_cus->diag_handles));
+		m_instances[m_instance_count++] = p_cus;
     
     // Add a custom base UUID.
 		ble_uuid128_t base_uuid = {CUSTOM_SERVICE_UUID_BASE};
@@ -394,6 +929,12 @@ uint32_t ble_cus_init(ble_cus_t * p_cus, const ble_cus_init_t * p_cus_init)
 				return err_code;
 		}
 		
+		// Add the diagnostics Characteristic, for all instances
+		if (p_cus_init->char_diag_uuid != 0)
+		{
+				err_code = diag_char_add(p_cus, p_cus_init);
+		}
+		
     return err_code;
 }
 
@@ -412,32 +953,14 @@ uint32_t ble_cus_string_send(ble_cus_t * p_cus, uint8_t * p_string, uint16_t len
         return NRF_ERROR_INVALID_PARAM;
     }
 	
-		ble_gatts_value_t gatts_value;
-		
-		// Initialize value struct.
-		memset(&gatts_value, 0, sizeof(gatts_value));
-
-		gatts_value.len     = length;
-		gatts_value.offset  = 0;
-		gatts_value.p_value = p_string;
-
-		// Update database.
-		sd_ble_gatts_value_set(p_cus->conn_handle,
-																				p_cus->read_custom_value_handles.value_handle,
-																				&gatts_value);
-	
-	
-		ble_gatts_hvx_params_t hvx_params;
-
-		memset(&hvx_params, 0, sizeof(hvx_params));
-
-		hvx_params.handle = p_cus->read_custom_value_handles.value_handle;
-		hvx_params.type   = BLE_GATT_HVX_NOTIFICATION;
-		hvx_params.offset = gatts_value.offset;
-		hvx_params.p_len  = &gatts_value.len;
-		hvx_params.p_data = gatts_value.p_value;
-
-		return sd_ble_gatts_hvx(p_cus->conn_handle, &hvx_params);
+		// The notification carries the value itself, there is no need to store it in the
+		// database with sd_ble_gatts_value_set first.
+		return cus_tx_send(p_cus->tx_id,
+											 p_cus->conn_handle,
+											 p_cus->notify_custom_value_handles.value_handle,
+											 p_string,
+											 length,
+											 CUS_TX_PRIO_BULK);
 	
 		// -----------------------------------
 	
@@ -467,6 +990,29 @@ uint32_t ble_cus_string_send(ble_cus_t * p_cus, uint8_t * p_string, uint16_t len
 //    return sd_ble_gatts_hvx(p_cus->conn_handle, &hvx_params);
 }
 
+// This function send a pool buffer to nRF Mobile App without copying it
+uint32_t ble_cus_notify(ble_cus_t * p_cus, uint8_t * p_buf, uint16_t length)
+{
+		if (p_cus == NULL)
+		{
+				cus_tx_buf_free(p_buf);
+				return NRF_ERROR_NULL;
+		}
+		
+		if ((p_cus->conn_handle == BLE_CONN_HANDLE_INVALID) || (!p_cus->is_notification_enabled))
+		{
+				cus_tx_buf_free(p_buf);
+				return NRF_ERROR_INVALID_STATE;
+		}
+		
+		return cus_tx_buf_send(p_cus->tx_id,
+													 p_cus->conn_handle,
+													 p_cus->notify_custom_value_handles.value_handle,
+													 p_buf,
+													 length,
+													 CUS_TX_PRIO_BULK);
+}
+
 // This function only send 1 byte data to nRF Mobile App
 uint32_t ble_cus_custom_value_update(ble_cus_t * p_cus, uint8_t custom_value)
 {
@@ -498,17 +1044,12 @@ uint32_t ble_cus_custom_value_update(ble_cus_t * p_cus, uint8_t custom_value)
 		// Send value if connected and notifying.
 		if ((p_cus->conn_handle != BLE_CONN_HANDLE_INVALID)) 
 		{
-				ble_gatts_hvx_params_t hvx_params;
-
-				memset(&hvx_params, 0, sizeof(hvx_params));
-
-				hvx_params.handle = p_cus->notify_custom_value_handles.value_handle;
-				hvx_params.type   = BLE_GATT_HVX_NOTIFICATION;
-				hvx_params.offset = gatts_value.offset;
-				hvx_params.p_len  = &gatts_value.len;
-				hvx_params.p_data = gatts_value.p_value;
-
-				err_code = sd_ble_gatts_hvx(p_cus->conn_handle, &hvx_params);
+				err_code = cus_tx_send(p_cus->tx_id,
+															 p_cus->conn_handle,
+															 p_cus->notify_custom_value_handles.value_handle,
+															 gatts_value.p_value,
+															 gatts_value.len,
+															 CUS_TX_PRIO_CONTROL);
 		}
 		else
 		{
@@ -518,6 +1059,189 @@ uint32_t ble_cus_custom_value_update(ble_cus_t * p_cus, uint8_t custom_value)
 		return err_code;
 }
 
+uint32_t ble_cus_tx_stats_get(ble_cus_t * p_cus, cus_tx_stats_t * p_stats)
+{
+    VERIFY_PARAM_NOT_NULL(p_cus);
 
+    return cus_tx_stats_get(p_cus->tx_id, p_stats);
+}
 
 
+uint32_t ble_cus_counters_get(ble_cus_t * p_cus, ble_cus_counters_t * p_counters)
+{
+    cus_tx_stats_t tx_stats;
+    uint32_t       err_code;
+
+    VERIFY_PARAM_NOT_NULL(p_cus);
+    VERIFY_PARAM_NOT_NULL(p_counters);
+
+    err_code = cus_tx_stats_get(p_cus->tx_id, &tx_stats);
+    VERIFY_SUCCESS(err_code);
+
+    *p_counters               = p_cus->counters;
+    p_counters->bytes_out     = tx_stats.bytes;
+    p_counters->notifications = tx_stats.sent;
+    p_counters->no_tx_packets = tx_stats.deferred;
+
+    return NRF_SUCCESS;
+}
+
+
+void ble_cus_counters_reset(void)
+{
+    for (uint8_t i = 0; i < m_instance_count; i++)
+    {
+        memset(&m_instances[i]->counters, 0, sizeof(m_instances[i]->counters));
+        UNUSED_RETURN_VALUE(cus_tx_stats_reset(m_instances[i]->tx_id));
+    }
+}
+
+
+/**@brief Function for finding the last handle of a characteristic, 0 if it was not added. */
+static uint16_t char_last_handle(ble_gatts_char_handles_t const * p_handles)
+{
+    return MAX(p_handles->value_handle, p_handles->cccd_handle);
+}
+
+
+uint16_t ble_cus_attr_count(void)
+{
+    ble_cus_t const * p_last;
+    uint16_t          last;
+
+    if (m_instance_count == 0)
+    {
+        return 0;
+    }
+
+    p_last = m_instances[m_instance_count - 1];
+    last   = MAX(MAX(char_last_handle(&p_last->write_custom_value_handles),
+                     char_last_handle(&p_last->read_custom_value_handles)),
+                 MAX(char_last_handle(&p_last->notify_custom_value_handles),
+                     char_last_handle(&p_last->diag_handles)));
+
+    return last - m_instances[0]->service_handle + 1;
+}
+
+
+uint32_t ble_cus_read_value_set(ble_cus_t * p_cus, uint8_t const * p_data, uint16_t length)
+{
+    ble_gatts_value_t gatts_value;
+
+    VERIFY_PARAM_NOT_NULL(p_cus);
+    VERIFY_PARAM_NOT_NULL(p_data);
+
+    if (length > p_cus->read_value_max_len)
+    {
+        return NRF_ERROR_INVALID_PARAM;
+    }
+
+    // Application-owned value of unchanged length: update in place, the SoftDevice reads it from there.
+    if ((p_cus->p_read_value != NULL) && (length == p_cus->read_value_len))
+    {
+        if (p_data != p_cus->p_read_value)
+        {
+            memmove(p_cus->p_read_value, p_data, length);
+        }
+        return NRF_SUCCESS;
+    }
+
+    memset(&gatts_value, 0, sizeof(gatts_value));
+
+    gatts_value.len     = length;
+    gatts_value.offset  = 0;
+    gatts_value.p_value = (uint8_t *)p_data;
+
+    VERIFY_SUCCESS(sd_ble_gatts_value_set(p_cus->conn_handle,
+                                          p_cus->read_custom_value_handles.value_handle,
+                                          &gatts_value));
+
+    p_cus->read_value_len = length;
+
+    return NRF_SUCCESS;
+}
+
+
+uint32_t ble_cus_read_reply(ble_cus_t * p_cus, uint8_t const * p_data, uint16_t length)
+{
+    ble_gatts_rw_authorize_reply_params_t auth_reply;
+
+    VERIFY_PARAM_NOT_NULL(p_cus);
+
+    memset(&auth_reply, 0, sizeof(auth_reply));
+
+    auth_reply.type                    = BLE_GATTS_AUTHORIZE_TYPE_READ;
+    auth_reply.params.read.gatt_status = BLE_GATT_STATUS_SUCCESS;
+
+    if (p_data != NULL)
+    {
+        if (length > p_cus->read_value_max_len)
+        {
+            return NRF_ERROR_INVALID_PARAM;
+        }
+
+        auth_reply.params.read.update = 1;
+        auth_reply.params.read.len    = length;
+        auth_reply.params.read.p_data = p_data;
+        p_cus->read_value_len         = length;
+    }
+
+    return sd_ble_gatts_rw_authorize_reply(p_cus->conn_handle, &auth_reply);
+}
+
+
+uint32_t ble_cus_record_send(ble_cus_t * p_cus, uint8_t const * p_data, uint16_t length)
+{
+    ble_cus_rec_t      * p_rec;
+    ble_cus_rec_slot_t * p_slot;
+    uint32_t             err_code = NRF_SUCCESS;
+
+    VERIFY_PARAM_NOT_NULL(p_cus);
+    VERIFY_PARAM_NOT_NULL(p_data);
+
+    p_rec = &p_cus->rec;
+
+    if (length > BLE_CUS_REC_MAX_DATA_LEN)
+    {
+        return NRF_ERROR_INVALID_PARAM;
+    }
+    if ((p_rec->timeout_ticks == 0) || (p_cus->conn_handle == BLE_CONN_HANDLE_INVALID) ||
+        (!p_cus->is_notification_enabled && !p_cus->is_indication_enabled))
+    {
+        return NRF_ERROR_INVALID_STATE;
+    }
+
+    CRITICAL_REGION_ENTER();
+
+    if (p_rec->count == CUS_REC_QUEUE_SIZE)
+    {
+        err_code = NRF_ERROR_NO_MEM;
+    }
+    else
+    {
+        p_slot = &p_rec->slots[(p_rec->head + p_rec->count) % CUS_REC_QUEUE_SIZE];
+
+        // The sequence number trails the record, so that a header of the record stays first.
+        memcpy(p_slot->frame, p_data, length);
+        p_slot->frame[length] = p_rec->next_seq++;
+        p_slot->len = length + 1;
+
+        p_rec->count++;
+        rec_pump(p_cus);
+    }
+
+    CRITICAL_REGION_EXIT();
+
+    return err_code;
+}
+
+
+uint32_t ble_cus_rec_stats_get(ble_cus_t * p_cus, ble_cus_rec_stats_t * p_stats)
+{
+    VERIFY_PARAM_NOT_NULL(p_cus);
+    VERIFY_PARAM_NOT_NULL(p_stats);
+
+    *p_stats = p_cus->rec.stats;
+
+    return NRF_SUCCESS;
+}
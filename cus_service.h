@@ -3,6 +3,9 @@
 
 #include "ble.h"
 #include "ble_srv_common.h"
+#include "app_timer.h"
+#include "sdk_config.h"
+#include "cus_tx.h"
 
 #include <stdint.h>
 #include <stdbool.h>
@@ -24,14 +27,30 @@
 #define BLE_UUID_CUSTOM_VAL_CHA_WRITE_2			0x1501
 #define BLE_UUID_CUSTOM_VAL_CHA_READ_2			0x1502
 #define BLE_UUID_CUSTOM_VAL_CHA_NOTIFY_2		0x1503
+#define BLE_UUID_CUSTOM_VAL_CHA_DIAG_2			0x1504
 
 
 #define BLE_CUSTOM_MAX_DATA_LEN (GATT_MTU_SIZE_DEFAULT - 3) /**< Maximum length of data (in bytes) that can be transmitted to the peer by the Nordic UART service module. */
 
+#define BLE_CUS_REC_MAX_DATA_LEN  (BLE_CUSTOM_MAX_DATA_LEN - 1) /**< Maximum length of a reliable record, before its 1-byte sequence number. */
+#define BLE_CUS_REC_ACK           0xAC                          /**< First byte of a record acknowledgement written by the peer: {BLE_CUS_REC_ACK, seq}. */
+
+/**@brief Value of the diagnostics characteristic: the number of instances (uint8), then the
+ *        counters of each instance in initialization order, as the uint32 fields of
+ *        @ref ble_cus_counters_t in order, little endian. Longer than one packet, read with Read Blob.
+ */
+#define BLE_CUS_DIAG_BLOCK_LEN    (7 * sizeof(uint32_t))
+#define BLE_CUS_DIAG_MAX_LEN      (1 + CUS_TX_MAX_INSTANCES * BLE_CUS_DIAG_BLOCK_LEN)
+
 /* Forward declaration of the ble_nus_t type. */
 typedef struct ble_cus_s ble_cus_t;
 
-/**@brief Nordic UART Service event handler type. */
+/**@brief Nordic UART Service event handler type.
+ *
+ * @details Called with the data of each Write, or once with the whole value after the Execute
+ *          Write of a queued (long) write, in which case p_data points to the p_write_value buffer,
+ *          or to a copy of the value read back from the SoftDevice if there is none.
+ */
 typedef void (*ble_cus_data_handler_t) (ble_cus_t * p_cus, uint8_t * p_data, uint16_t length);
 
 /**@brief Custom Service event type. */
@@ -41,7 +60,7 @@ typedef enum
     BLE_CUS_EVT_NOTIFICATION_DISABLED,                            /**< Custom value notification disabled event. */
     BLE_CUS_EVT_DISCONNECTED,
     BLE_CUS_EVT_CONNECTED,
-		BLE_CUS_EVT_READ
+		BLE_CUS_EVT_READ																							/**< The READ characteristic is being read, answer with @ref ble_cus_read_reply. Read Blob requests (offset > 0) are answered by the service. */
 } ble_cus_evt_type_t;
 
 
@@ -54,6 +73,62 @@ typedef struct
 /**@brief Custom Service event handler type. */
 typedef void (*ble_cus_evt_handler_t) (ble_cus_t * p_cus, ble_cus_evt_t * p_evt);
 
+/**@brief Traffic counters of a Custom Service instance. */
+typedef struct
+{
+    uint32_t bytes_in;                                            /**< Bytes written to the WRITE characteristic. */
+    uint32_t bytes_out;                                           /**< Bytes notified, from the TX scheduler. */
+    uint32_t writes;                                              /**< Writes to the WRITE characteristic, queued writes counted once. */
+    uint32_t notifications;                                       /**< Notifications accepted by the SoftDevice, from the TX scheduler. */
+    uint32_t no_tx_packets;                                       /**< Notifications refused with BLE_ERROR_NO_TX_PACKETS, from the TX scheduler. */
+    uint32_t reads;                                               /**< Reads of the READ characteristic answered by the application. */
+    uint32_t cccd_writes;                                         /**< Writes to the CCCD of the NOTIFY characteristic. */
+} ble_cus_counters_t;
+
+/**@brief Delivery mode of the reliable records, chosen by the service from the CCCD and the backlog. */
+typedef enum
+{
+    BLE_CUS_REC_MODE_INDICATE,                                    /**< One record in flight, confirmed by the ATT Handle Value Confirmation. */
+    BLE_CUS_REC_MODE_NOTIFY_ACK                                   /**< Records notified back to back, confirmed by cumulative BLE_CUS_REC_ACK writes. */
+} ble_cus_rec_mode_t;
+
+/**@brief Reliable record counters. */
+typedef struct
+{
+    uint32_t indicated;                                           /**< Records sent as indications. */
+    uint32_t notified;                                            /**< Records sent as notifications, retransmissions included. */
+    uint32_t confirmed;                                           /**< Records confirmed by the peer. */
+    uint32_t retransmitted;                                       /**< Records notified again after a timeout. */
+    uint32_t timeouts;                                            /**< Timeouts without any confirmation. */
+    uint32_t dropped;                                             /**< Records lost on disconnection. */
+} ble_cus_rec_stats_t;
+
+/**@brief Reliable record waiting for its confirmation. */
+typedef struct
+{
+    uint8_t                  len;                                 /**< Length of the frame, sequence number included. */
+    uint8_t                  frame[BLE_CUSTOM_MAX_DATA_LEN];      /**< Record followed by its sequence number. */
+} ble_cus_rec_slot_t;
+
+/**@brief Reliable record state of a Custom Service instance. */
+typedef struct
+{
+    ble_cus_rec_slot_t       slots[CUS_REC_QUEUE_SIZE];
+    uint8_t                  head;
+    uint8_t                  count;                               /**< Records not confirmed yet, sent or not. */
+    uint8_t                  in_flight;                           /**< Records from the head that have been sent. */
+    uint8_t                  next_seq;
+    ble_cus_rec_mode_t       mode;
+    bool                     hvc_timed_out;                       /**< An indication was not confirmed in time, use notifications until it is. */
+    bool                     timer_running;
+    uint32_t                 confirmed_at_tick;                   /**< Confirmation count at the previous timer expiry. */
+    uint32_t                 tx_mark;                             /**< End of the scheduler queue after the last record notified, see cus_tx_queue_mark. */
+    uint32_t                 timeout_ticks;                       /**< 0 if reliable records are disabled. */
+    app_timer_t              timer_data;
+    app_timer_id_t           timer_id;
+    ble_cus_rec_stats_t      stats;
+} ble_cus_rec_t;
+
 
 
 
@@ -70,9 +145,16 @@ typedef struct
 		uint16_t 											char_write_uuid;
 		uint16_t 											char_read_uuid;
 		uint16_t 											char_notify_uuid;
+		uint16_t                      char_diag_uuid;                 /**< UUID of the diagnostics characteristic, added to this instance only. 0 for none. */
 		uint8_t                       initial_custom_value;           /**< Initial custom value */
 		ble_srv_cccd_security_mode_t  custom_value_char_attr_md;     	/**< Initial security level for Custom characteristics attribute */
     ble_cus_data_handler_t 				data_handler; 									/**< Event handler to be called for handling received data. */
+		uint8_t												tx_weight;											/**< Share of the TX buffers given to this instance's bulk data, relative to the other instances. */
+		uint8_t                     * p_read_value;                   /**< Application buffer holding the READ characteristic value (BLE_GATTS_VLOC_USER), or NULL to keep it in the SoftDevice. */
+		uint16_t                      read_value_max_len;             /**< Maximum length of the READ characteristic value (size of p_read_value), at most BLE_GATTS_VAR_ATTR_LEN_MAX. 0 selects BLE_CUSTOM_MAX_DATA_LEN when p_read_value is NULL. */
+		uint8_t                     * p_write_value;                  /**< Application buffer receiving the WRITE characteristic value (BLE_GATTS_VLOC_USER), or NULL to keep it in the SoftDevice. Needed for queued (long) writes. */
+		uint16_t                      write_value_max_len;            /**< Size of p_write_value, at most BLE_GATTS_VAR_ATTR_LEN_MAX. Ignored if p_write_value is NULL. */
+		uint32_t                      rec_timeout_ticks;              /**< app_timer ticks without confirmation after which reliable records time out. 0 disables reliable records. */
 } ble_cus_init_t;
 
 /**@brief Nordic UART Service structure.
@@ -92,9 +174,19 @@ struct ble_cus_s
     ble_gatts_char_handles_t write_custom_value_handles;
 		ble_gatts_char_handles_t read_custom_value_handles;
 		ble_gatts_char_handles_t notify_custom_value_handles;
+		ble_gatts_char_handles_t diag_handles;                   /**< Diagnostics characteristic, zero if not added to this instance. */
     uint16_t                 conn_handle;            
     bool                     is_notification_enabled; 
+    bool                     is_indication_enabled;          /**< The peer enabled indications in the CCCD of the NOTIFY characteristic. */
     ble_cus_data_handler_t   data_handler; 									/**< Event handler to be called for handling received data. */
+    uint8_t                  tx_id;                          /**< Identifier of this instance in the TX scheduler. */
+    uint8_t                * p_read_value;                   /**< Application-owned READ characteristic value, NULL if stored in the SoftDevice. */
+    uint16_t                 read_value_max_len;             /**< Maximum length of the READ characteristic value. */
+    uint16_t                 read_value_len;                 /**< Current length of the READ characteristic value. */
+    uint8_t                * p_write_value;                  /**< Application-owned WRITE characteristic value, NULL if stored in the SoftDevice. */
+    uint16_t                 write_value_max_len;            /**< Maximum length of the WRITE characteristic value. */
+    ble_cus_rec_t            rec;                            /**< Reliable records. */
+    ble_cus_counters_t       counters;                       /**< Traffic counters; the TX scheduler keeps the notification ones. */
 };
 
 /**@brief Function for initializing the Nordic UART Service.
@@ -123,21 +215,38 @@ void ble_cus_on_ble_evt(ble_cus_t * p_cus, ble_evt_t * p_ble_evt);
 
 /**@brief Function for sending a string to the peer.
  *
- * @details This function sends the input string as an RX characteristic notification to the
- *          peer.
+ * @details This function sends the input string as a notification of the NOTIFY characteristic
+ *          to the peer. The notification goes through the TX scheduler as bulk data, so it may be
+ *          queued and sent at a later connection event; the string is copied only in that case.
  *
  * @param[in] p_nus       Pointer to the Nordic UART Service structure.
  * @param[in] p_string    String to be sent.
  * @param[in] length      Length of the string.
  *
- * @retval NRF_SUCCESS If the string was sent successfully. Otherwise, an error code is returned.
+ * @retval NRF_SUCCESS If the string was sent or queued successfully. Otherwise, an error code is returned.
+ * @retval NRF_ERROR_NO_MEM If the TX queue of this instance is full.
  */
 uint32_t ble_cus_string_send(ble_cus_t * p_cus, uint8_t * p_string, uint16_t length);
 
+/**@brief Function for sending a pool buffer to the peer without copying it.
+ *
+ * @details The buffer is filled in place by the application, then handed as is to the
+ *          SoftDevice, or queued by the TX scheduler until a TX buffer is free. It is given
+ *          back to the pool by the scheduler, whatever the result.
+ *
+ * @param[in] p_cus       Custom Service structure.
+ * @param[in] p_buf       Buffer obtained from @ref cus_tx_buf_alloc.
+ * @param[in] length      Number of bytes of the buffer to send.
+ *
+ * @retval NRF_SUCCESS If the buffer was sent or queued successfully. Otherwise, an error code is returned.
+ */
+uint32_t ble_cus_notify(ble_cus_t * p_cus, uint8_t * p_buf, uint16_t length);
+
 /**@brief Function for updating the custom value.
  *
  * @details The application calls this function when the cutom value should be updated. If
- *          notification has been enabled, the custom value characteristic is sent to the client.
+ *          notification has been enabled, the custom value characteristic is sent to the client
+ *          as a control message, ahead of the bulk data of all instances.
  *
  * @note 
  *       
@@ -148,6 +257,98 @@ uint32_t ble_cus_string_send(ble_cus_t * p_cus, uint8_t * p_string, uint16_t len
  */
 uint32_t ble_cus_custom_value_update(ble_cus_t * p_cus, uint8_t custom_value);
 
+/**@brief Function for setting the value of the READ characteristic.
+ *
+ * @details If the value is held in an application buffer (see @ref ble_cus_init_t::p_read_value)
+ *          and its length does not change, the buffer is updated in place and no SoftDevice call
+ *          is made. p_data may then point into the buffer itself. Otherwise the value is stored
+ *          with sd_ble_gatts_value_set.
+ *
+ * @param[in]   p_cus          Custom Service structure.
+ * @param[in]   p_data         New value.
+ * @param[in]   length         Length of the new value.
+ *
+ * @return      NRF_SUCCESS on success, otherwise an error code.
+ */
+uint32_t ble_cus_read_value_set(ble_cus_t * p_cus, uint8_t const * p_data, uint16_t length);
+
+/**@brief Function for answering a read of the READ characteristic (@ref BLE_CUS_EVT_READ).
+ *
+ * @param[in]   p_cus          Custom Service structure.
+ * @param[in]   p_data         Value to return, or NULL to return the stored value as is, which
+ *                             avoids any copy when the value lives in an application buffer.
+ * @param[in]   length         Length of p_data.
+ *
+ * @return      NRF_SUCCESS on success, otherwise an error code.
+ */
+uint32_t ble_cus_read_reply(ble_cus_t * p_cus, uint8_t const * p_data, uint16_t length);
+
+/**@brief Function for sending a reliable record to the peer.
+ *
+ * @details The record is kept until the peer confirms it. While the backlog is short and the peer
+ *          enabled indications, records are indicated one at a time and confirmed by the ATT layer.
+ *          When the backlog reaches CUS_REC_BULK_THRESHOLD, when an indication is not confirmed
+ *          within the timeout, or when the peer only enabled notifications, records are notified
+ *          back to back and the peer confirms them by writing {BLE_CUS_REC_ACK, seq} to the WRITE
+ *          characteristic, seq being the sequence number of the last record received in order.
+ *          Notified records that are not confirmed in time are sent again.
+ *
+ * @param[in]   p_cus          Custom Service structure.
+ * @param[in]   p_data         Record.
+ * @param[in]   length         Length of the record, at most BLE_CUS_REC_MAX_DATA_LEN.
+ *
+ * @retval NRF_SUCCESS             If the record was queued.
+ * @retval NRF_ERROR_INVALID_STATE If not connected, records are disabled or the peer enabled neither notifications nor indications.
+ * @retval NRF_ERROR_NO_MEM        If CUS_REC_QUEUE_SIZE records are waiting for confirmation.
+ */
+uint32_t ble_cus_record_send(ble_cus_t * p_cus, uint8_t const * p_data, uint16_t length);
+
+/**@brief Function for reading the reliable record counters of a Custom Service instance.
+ *
+ * @param[in]  p_cus    Custom Service structure.
+ * @param[out] p_stats  Counters.
+ *
+ * @return      NRF_SUCCESS on success, otherwise an error code.
+ */
+uint32_t ble_cus_rec_stats_get(ble_cus_t * p_cus, ble_cus_rec_stats_t * p_stats);
+
+/**@brief Function for reading the traffic counters of a Custom Service instance.
+ *
+ * @details The same counters are returned for all instances by the diagnostics characteristic
+ *          (see @ref ble_cus_init_t::char_diag_uuid). Any write to that characteristic clears
+ *          them, as does @ref ble_cus_counters_reset.
+ *
+ * @param[in]  p_cus        Custom Service structure.
+ * @param[out] p_counters   Counters.
+ *
+ * @return      NRF_SUCCESS on success, otherwise an error code.
+ */
+uint32_t ble_cus_counters_get(ble_cus_t * p_cus, ble_cus_counters_t * p_counters);
+
+/**@brief Function for clearing the traffic counters of all Custom Service instances, and with them
+ *        their TX scheduler counters.
+ */
+void ble_cus_counters_reset(void);
+
+/**@brief Function for reading the TX scheduler counters of a Custom Service instance.
+ *
+ * @param[in]  p_cus    Custom Service structure.
+ * @param[out] p_stats  Sent, queued, deferred and dropped packet counters.
+ *
+ * @return      NRF_SUCCESS on success, otherwise an error code.
+ */
+uint32_t ble_cus_tx_stats_get(ble_cus_t * p_cus, cus_tx_stats_t * p_stats);
+
+/**@brief Function for counting the attributes of the Custom Service instances.
+ *
+ * @details Handles are given in order, so this is the span from the service declaration of the
+ *          first instance initialized to the last attribute of the last one. Attributes that
+ *          other services added in between are counted too.
+ *
+ * @return Number of attributes, 0 if no instance is initialized.
+ */
+uint16_t ble_cus_attr_count(void);
+
 #ifdef __cplusplus
 }
 #endif
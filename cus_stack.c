@@ -0,0 +1,112 @@
+#include "sdk_common.h"
+#if CUS_STACK_ENABLED
+#include "cus_stack.h"
+
+#include "nrf.h"
+#include "app_util.h"
+
+
+#define STACK_PAINT                     0xDEADC0DEUL              /**< Not one byte repeated: the paint loop cannot become a memset call, which would run in the area being painted. */
+
+#if defined(__CC_ARM)
+extern uint32_t STACK$$Base[];                                    /**< STACK area of arm_startup_nrf51.s. */
+extern uint32_t STACK$$Limit[];
+#define STACK_BOTTOM                    (STACK$$Base)
+#define STACK_TOP                       (STACK$$Limit)
+#elif defined(__ICCARM__)
+#pragma section = "CSTACK"
+#define STACK_BOTTOM                    ((uint32_t *)__section_begin("CSTACK"))
+#define STACK_TOP                       ((uint32_t *)__section_end("CSTACK"))
+#else
+extern uint32_t __StackLimit[];                                   /**< From nrf5x_common.ld. */
+extern uint32_t __StackTop[];
+#define STACK_BOTTOM                    (__StackLimit)
+#define STACK_TOP                       (__StackTop)
+#endif
+
+static uint32_t const * m_peak;                                   /**< Deepest word found written. */
+static uint32_t         m_thread_low = UINT32_MAX;                /**< Lowest stack pointer sampled in thread mode. */
+static uint32_t         m_thread_high;                            /**< Highest one, 0 before the first sample. */
+
+
+static uint16_t depth_get(uint32_t address)
+{
+    return (uint16_t)((uint32_t)STACK_TOP - address);
+}
+
+
+void cus_stack_init(void)
+{
+    uint32_t * p_word = STACK_BOTTOM;
+    uint32_t * p_sp   = (uint32_t *)__get_MSP();
+
+    // Nothing below the stack pointer is in use yet.
+    while (p_word < p_sp)
+    {
+        *p_word++ = STACK_PAINT;
+    }
+    m_peak = p_sp;
+}
+
+
+void cus_stack_thread_sample(void)
+{
+    uint32_t sp = __get_MSP();
+
+    if (sp < m_thread_low)
+    {
+        m_thread_low = sp;
+    }
+    if (sp > m_thread_high)
+    {
+        m_thread_high = sp;
+    }
+}
+
+
+bool cus_stack_check(void)
+{
+    uint32_t const * p_word = STACK_BOTTOM;
+
+    // The used part only grows: words above the previous peak need not be looked at.
+    while ((p_word < m_peak) && (*p_word == STACK_PAINT))
+    {
+        p_word++;
+    }
+    if (p_word == m_peak)
+    {
+        return false;
+    }
+    m_peak = p_word;
+    return true;
+}
+
+
+void cus_stack_stats_get(cus_stack_stats_t * p_stats)
+{
+    uint16_t base;
+
+    p_stats->size   = depth_get((uint32_t)STACK_BOTTOM);
+    p_stats->thread = (m_thread_high != 0) ? depth_get(m_thread_low) : 0;
+    // A thread sample deeper than the paint shows until the next check.
+    p_stats->peak   = MAX(depth_get((uint32_t)m_peak), p_stats->thread);
+
+    base = (m_thread_high != 0) ? depth_get(m_thread_high) : 0;
+    p_stats->handler = p_stats->peak - base;
+}
+
+
+uint16_t cus_stack_encode(uint8_t * p_buf)
+{
+    cus_stack_stats_t stats;
+    uint16_t          len = 0;
+
+    cus_stack_stats_get(&stats);
+    len += uint16_encode(stats.size,    &p_buf[len]);
+    len += uint16_encode(stats.peak,    &p_buf[len]);
+    len += uint16_encode(stats.thread,  &p_buf[len]);
+    len += uint16_encode(stats.handler, &p_buf[len]);
+    return len;
+}
+
+#endif // CUS_STACK_ENABLED
@@ -0,0 +1,78 @@
+#ifndef __CUS_STACK_H_
+#define __CUS_STACK_H_
+
+#include "sdk_config.h"
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#ifdef __cplusplus
+	extern "C" {
+#endif
+
+/**@brief Stack use, in bytes from the top of the stack.
+ *
+ * @details On the nRF51 the main loop, the interrupt handlers and the SoftDevice all run on the
+ *          main stack, so the two modes cannot be measured apart. The peak comes from the paint
+ *          and covers everything. The thread figures come from the main loop, which samples the
+ *          stack pointer where it calls @ref cus_stack_thread_sample. Interrupts are almost
+ *          always taken while the main loop waits for events, at its shallowest, so handler is
+ *          what the handlers and the SoftDevice stacked on top of it at most.
+ */
+typedef struct
+{
+    uint16_t size;                                                /**< Stack reserved by the startup file. */
+    uint16_t peak;                                                /**< Deepest use since boot, size if the stack overflowed. */
+    uint16_t thread;                                              /**< Deepest use sampled in thread mode. */
+    uint16_t handler;                                             /**< peak minus the shallowest use sampled in thread mode. */
+} cus_stack_stats_t;
+
+#if CUS_STACK_ENABLED
+
+/**@brief Length of the report in @ref cus_stack_encode: size, peak, thread, handler (uint16). */
+#define CUS_STACK_ENCODED_LEN           (4 * 2)
+
+/**@brief Function for painting the unused part of the stack.
+ *
+ * @details To be called first in main, before any interrupt is enabled.
+ */
+void cus_stack_init(void);
+
+/**@brief Function for sampling the stack pointer in thread mode. Cheap, for the main loop. */
+void cus_stack_thread_sample(void);
+
+/**@brief Function for updating the peak from the paint.
+ *
+ * @details Scans the paint from the bottom of the stack up to the previous peak, so the time is
+ *          proportional to the stack never used. To be called periodically from the context of
+ *          the SoftDevice events, or at the same priority.
+ *
+ * @return true if the peak is deeper than at the previous call.
+ */
+bool cus_stack_check(void);
+
+/**@brief Function for reading the stack use found by the last @ref cus_stack_check.
+ *
+ * @param[out] p_stats  Stack use.
+ */
+void cus_stack_stats_get(cus_stack_stats_t * p_stats);
+
+/**@brief Function for encoding the stack use, little endian.
+ *
+ * @param[out] p_buf  Buffer of at least CUS_STACK_ENCODED_LEN bytes.
+ *
+ * @return Number of bytes written, CUS_STACK_ENCODED_LEN.
+ */
+uint16_t cus_stack_encode(uint8_t * p_buf);
+
+#else
+
+#define CUS_STACK_ENCODED_LEN           0
+
+#endif // CUS_STACK_ENABLED
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,173 @@
+#include "cus_tlm.h"
+
+#include "sdk_common.h"
+
+
+static uint8_t varint_put(uint8_t * p_buf, uint32_t value)
+{
+    uint8_t len = 0;
+
+    while (value >= 0x80)
+    {
+        p_buf[len++] = (uint8_t)(value | 0x80);
+        value      >>= 7;
+    }
+    p_buf[len++] = (uint8_t)value;
+
+    return len;
+}
+
+
+/**@brief Function for mapping small differences of either sign to small codes: 0, -1, 1, -2... */
+static uint32_t zigzag(uint32_t delta)
+{
+    return (delta << 1) ^ (uint32_t)((int32_t)delta >> 31);
+}
+
+
+/**@brief Function for coding a sample against the previous one, or against 0. */
+static uint8_t sample_encode(cus_tlm_t const * p_tlm, int32_t const * p_values, bool absolute, uint8_t * p_buf)
+{
+    uint8_t len = 0;
+
+    for (uint8_t i = 0; i < p_tlm->field_count; i++)
+    {
+        uint32_t base = absolute ? 0 : (uint32_t)p_tlm->prev[i];
+
+        len += varint_put(&p_buf[len], zigzag((uint32_t)p_values[i] - base));
+    }
+    return len;
+}
+
+
+static void frame_open(cus_tlm_t * p_tlm)
+{
+    p_tlm->key         = p_tlm->key_pending || (p_tlm->since_key >= p_tlm->key_interval);
+    p_tlm->key_pending = false;
+    p_tlm->frame[0]    = p_tlm->counter & CUS_TLM_HEADER_COUNTER_MASK;
+    p_tlm->len         = CUS_TLM_HEADER_LEN;
+    p_tlm->first       = p_tlm->index;
+
+    if (p_tlm->key)
+    {
+        p_tlm->frame[0] |= CUS_TLM_HEADER_KEY;
+        p_tlm->len      += varint_put(&p_tlm->frame[p_tlm->len], p_tlm->index);
+        p_tlm->since_key = 0;
+    }
+}
+
+
+static void frame_send(cus_tlm_t * p_tlm)
+{
+    if (cus_mux_send(p_tlm->p_mux, p_tlm->channel, p_tlm->frame, p_tlm->len) == NRF_SUCCESS)
+    {
+        p_tlm->stats.frames++;
+        if (p_tlm->key)
+        {
+            p_tlm->stats.key_frames++;
+        }
+    }
+    else
+    {
+        // The peer can only resume from absolute values.
+        p_tlm->stats.lost++;
+        p_tlm->key_pending = true;
+    }
+
+    // The counter moves on anyway, a lost frame shows as a gap.
+    p_tlm->counter++;
+    p_tlm->since_key++;
+    p_tlm->len = 0;
+}
+
+
+/**@brief Function for handling a write on the channel: the peer asks for a key frame. */
+static void tlm_channel_handler(cus_mux_t * p_mux, uint8_t channel, void * p_context, uint8_t * p_data, uint16_t length)
+{
+    cus_tlm_key_request((cus_tlm_t *)p_context);
+}
+
+
+uint32_t cus_tlm_init(cus_tlm_t * p_tlm, cus_tlm_init_t const * p_tlm_init)
+{
+    VERIFY_PARAM_NOT_NULL(p_tlm);
+    VERIFY_PARAM_NOT_NULL(p_tlm_init);
+    VERIFY_PARAM_NOT_NULL(p_tlm_init->p_mux);
+    VERIFY_TRUE((p_tlm_init->field_count >= 1) && (p_tlm_init->field_count <= CUS_TLM_MAX_FIELDS),
+                NRF_ERROR_INVALID_PARAM);
+    VERIFY_TRUE(p_tlm_init->key_interval >= 1, NRF_ERROR_INVALID_PARAM);
+
+    memset(p_tlm, 0, sizeof(cus_tlm_t));
+    p_tlm->p_mux        = p_tlm_init->p_mux;
+    p_tlm->channel      = p_tlm_init->channel;
+    p_tlm->field_count  = p_tlm_init->field_count;
+    p_tlm->key_interval = p_tlm_init->key_interval;
+    p_tlm->key_pending  = true;
+
+    return cus_mux_channel_register(p_tlm->p_mux, p_tlm->channel, tlm_channel_handler, p_tlm,
+                                    CUS_TX_PRIO_BULK, false);
+}
+
+
+void cus_tlm_put(cus_tlm_t * p_tlm, int32_t const * p_values)
+{
+    uint8_t sample[CUS_TLM_MAX_FIELDS * CUS_TLM_VARINT_MAX_LEN];
+    uint8_t len;
+
+    if (p_tlm->len == 0)
+    {
+        frame_open(p_tlm);
+    }
+
+    // Only the first sample of a key frame is absolute.
+    len = sample_encode(p_tlm, p_values, p_tlm->key && (p_tlm->index == p_tlm->first), sample);
+
+    if ((p_tlm->len + len) > sizeof(p_tlm->frame))
+    {
+        // A frame with no sample is not worth sending.
+        if (p_tlm->index != p_tlm->first)
+        {
+            frame_send(p_tlm);
+            frame_open(p_tlm);
+            len = sample_encode(p_tlm, p_values, p_tlm->key, sample);
+        }
+
+        if ((p_tlm->len + len) > sizeof(p_tlm->frame))
+        {
+            // Too long even alone in a frame. The empty frame is dropped with the sample and the
+            // peer resumes from the absolute values of the next key frame.
+            p_tlm->len         = 0;
+            p_tlm->key_pending = true;
+            p_tlm->index++;
+            p_tlm->stats.lost++;
+            return;
+        }
+    }
+
+    memcpy(&p_tlm->frame[p_tlm->len], sample, len);
+    p_tlm->len += len;
+    memcpy(p_tlm->prev, p_values, p_tlm->field_count * sizeof(int32_t));
+    p_tlm->index++;
+    p_tlm->stats.samples++;
+
+    // A sample takes at least one byte per field.
+    if ((sizeof(p_tlm->frame) - p_tlm->len) < p_tlm->field_count)
+    {
+        frame_send(p_tlm);
+    }
+}
+
+
+void cus_tlm_flush(cus_tlm_t * p_tlm)
+{
+    if (p_tlm->len != 0)
+    {
+        frame_send(p_tlm);
+    }
+}
+
+
+void cus_tlm_key_request(cus_tlm_t * p_tlm)
+{
+    p_tlm->key_pending = true;
+}
@@ -0,0 +1,111 @@
+#ifndef __CUS_TLM_H_
+#define __CUS_TLM_H_
+
+#include "sdk_config.h"
+#include "cus_mux.h"
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#ifdef __cplusplus
+	extern "C" {
+#endif
+
+/**@brief Frame format.
+ *
+ * @details A frame is a header byte followed by samples. A sample has one varint per field:
+ *          the zigzag encoding of the difference to the same field of the previous sample,
+ *          computed modulo 2^32. Varints hold 7 bits per byte, least significant group first,
+ *          with bit 7 set on every byte but the last. The number of samples follows from the
+ *          frame length.
+ *
+ *          The header holds a frame counter, modulo 128, and CUS_TLM_HEADER_KEY on a key frame.
+ *          A key frame has a varint with the index of its first sample after the header, and that
+ *          sample is coded against 0, so it gives the absolute values. A peer that joins the
+ *          stream, or sees a gap in the frame counter, skips frames until the next key frame.
+ *          A frame that could not be sent is always followed by a key frame, and the peer can
+ *          ask for one by writing anything to the channel.
+ */
+#define CUS_TLM_HEADER_LEN              1
+#define CUS_TLM_HEADER_KEY              0x80
+#define CUS_TLM_HEADER_COUNTER_MASK     0x7F
+#define CUS_TLM_VARINT_MAX_LEN          5                         /**< Longest varint of a 32-bit value. */
+
+/**@brief Telemetry counters. */
+typedef struct
+{
+    uint32_t samples;                                             /**< Samples added. */
+    uint32_t frames;                                              /**< Frames sent or queued. */
+    uint32_t key_frames;                                          /**< Key frames among them. */
+    uint32_t lost;                                                /**< Frames that could not be sent, with their samples, and samples too long for a frame. */
+} cus_tlm_stats_t;
+
+/**@brief Telemetry stream initialization structure. */
+typedef struct
+{
+    cus_mux_t              * p_mux;                               /**< Initialized multiplexer. */
+    uint8_t                  channel;                             /**< Channel carrying the stream. */
+    uint8_t                  field_count;                         /**< Fields of a sample, 1 to CUS_TLM_MAX_FIELDS. */
+    uint8_t                  key_interval;                        /**< A key frame every key_interval frames, at least 1. */
+} cus_tlm_init_t;
+
+/**@brief Telemetry stream of fixed-size integer samples, delta coded in notifications.
+ *
+ * @details Samples are collected until the next one does not fit in a frame; the frame is then
+ *          sent on the channel. With large differences on many fields, a sample can be longer
+ *          than a frame (CUS_TLM_VARINT_MAX_LEN bytes per field at worst): it is then dropped,
+ *          counted in lost, and the next frame is a key frame.
+ */
+typedef struct
+{
+    cus_mux_t              * p_mux;
+    uint8_t                  channel;
+    uint8_t                  field_count;
+    uint8_t                  key_interval;
+    uint8_t                  since_key;                           /**< Frames sent since the last key frame. */
+    uint8_t                  counter;                             /**< Counter of the frame being filled. */
+    volatile bool            key_pending;                         /**< The next frame is a key frame. */
+    uint8_t                  len;                                 /**< Bytes in the open frame, 0 if no frame is open. An open frame has at least one sample. */
+    bool                     key;                                 /**< The open frame is a key frame. */
+    uint8_t                  frame[CUS_MUX_MAX_DATA_LEN];
+    int32_t                  prev[CUS_TLM_MAX_FIELDS];            /**< Last sample added. */
+    uint32_t                 index;                               /**< Index of the next sample. */
+    uint32_t                 first;                               /**< Index of the first sample of the open frame. */
+    cus_tlm_stats_t          stats;
+} cus_tlm_t;
+
+/**@brief Function for initializing a telemetry stream and registering its channel.
+ *
+ * @param[out] p_tlm       Telemetry stream structure, supplied by the application.
+ * @param[in]  p_tlm_init  Initialization structure.
+ *
+ * @retval NRF_SUCCESS             If the channel was registered.
+ * @retval NRF_ERROR_INVALID_PARAM If a parameter is out of range.
+ * @return Otherwise the error code returned by @ref cus_mux_channel_register.
+ */
+uint32_t cus_tlm_init(cus_tlm_t * p_tlm, cus_tlm_init_t const * p_tlm_init);
+
+/**@brief Function for adding a sample.
+ *
+ * @details Sends the open frame first if the sample does not fit in it. This function and
+ *          @ref cus_tlm_flush must be called from the same interrupt priority.
+ *
+ * @param[in] p_tlm     Telemetry stream structure.
+ * @param[in] p_values  field_count values.
+ */
+void cus_tlm_put(cus_tlm_t * p_tlm, int32_t const * p_values);
+
+/**@brief Function for sending the open frame now, if it has samples. */
+void cus_tlm_flush(cus_tlm_t * p_tlm);
+
+/**@brief Function for making the next frame a key frame, for instance on a new connection.
+ *
+ * @details Can be called from any context.
+ */
+void cus_tlm_key_request(cus_tlm_t * p_tlm);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
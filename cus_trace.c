@@ -0,0 +1,130 @@
+#include "sdk_common.h"
+#if CUS_TRACE_ENABLED
+#include "cus_trace.h"
+
+#include "app_timer.h"
+#include "app_util_platform.h"
+
+
+#define TRACE_STAMP_MASK                0x00FFFFFF                /**< RTC1 is a 24-bit counter. */
+#define TRACE_ID_POS                    24
+
+STATIC_ASSERT((CUS_TRACE_SIZE & (CUS_TRACE_SIZE - 1)) == 0);
+STATIC_ASSERT(CUS_TRACE_ID_COUNT <= 256);
+
+
+/**@brief Trace entry, CUS_TRACE_ENTRY_LEN bytes. */
+typedef struct
+{
+    uint32_t stamp_id;                                            /**< RTC1 counter, id in the top byte. */
+    uint16_t arg0;
+    uint16_t arg1;
+} trace_entry_t;
+
+static trace_entry_t m_ring[CUS_TRACE_SIZE];
+static uint16_t      m_head;                                      /**< Oldest entry. */
+static uint16_t      m_count;
+static uint16_t      m_lost;                                      /**< Entries dropped since the last CUS_TRACE_LOST entry. */
+static uint8_t       m_record[CUS_TRACE_RECORD_LEN];              /**< Record being sent. */
+static uint8_t       m_record_pos = CUS_TRACE_RECORD_LEN;         /**< Next byte of m_record to send. */
+
+
+void cus_trace_add(cus_trace_id_t id, uint16_t arg0, uint16_t arg1)
+{
+    uint32_t stamp;
+
+    UNUSED_RETURN_VALUE(app_timer_cnt_get(&stamp));
+
+    CRITICAL_REGION_ENTER();
+    if (m_count < CUS_TRACE_SIZE)
+    {
+        trace_entry_t * p_entry = &m_ring[(m_head + m_count) & (CUS_TRACE_SIZE - 1)];
+
+        p_entry->stamp_id = (stamp & TRACE_STAMP_MASK) | ((uint32_t)id << TRACE_ID_POS);
+        p_entry->arg0     = arg0;
+        p_entry->arg1     = arg1;
+        m_count++;
+    }
+    else if (m_lost < UINT16_MAX)
+    {
+        m_lost++;
+    }
+    CRITICAL_REGION_EXIT();
+}
+
+
+/**@brief Function for taking the oldest entry into the record buffer.
+ *
+ * @return false if the ring is empty.
+ */
+static bool record_load(void)
+{
+    trace_entry_t entry;
+    uint8_t       check = 0;
+    bool          loaded = true;
+
+    CRITICAL_REGION_ENTER();
+    if (m_lost != 0)
+    {
+        // Reported in place of the oldest entry, which stays in the ring.
+        UNUSED_RETURN_VALUE(app_timer_cnt_get(&entry.stamp_id));
+        entry.stamp_id = (entry.stamp_id & TRACE_STAMP_MASK) | ((uint32_t)CUS_TRACE_LOST << TRACE_ID_POS);
+        entry.arg0     = m_lost;
+        entry.arg1     = 0;
+        m_lost         = 0;
+    }
+    else if (m_count > 0)
+    {
+        entry  = m_ring[m_head];
+        m_head = (m_head + 1) & (CUS_TRACE_SIZE - 1);
+        m_count--;
+    }
+    else
+    {
+        loaded = false;
+    }
+    CRITICAL_REGION_EXIT();
+
+    if (!loaded)
+    {
+        return false;
+    }
+
+    m_record[0] = CUS_TRACE_SYNC_0;
+    m_record[1] = CUS_TRACE_SYNC_1;
+    UNUSED_RETURN_VALUE(uint32_encode(entry.stamp_id, &m_record[2]));
+    UNUSED_RETURN_VALUE(uint16_encode(entry.arg0, &m_record[6]));
+    UNUSED_RETURN_VALUE(uint16_encode(entry.arg1, &m_record[8]));
+    for (uint8_t i = 2; i < 2 + CUS_TRACE_ENTRY_LEN; i++)
+    {
+        check ^= m_record[i];
+    }
+    m_record[2 + CUS_TRACE_ENTRY_LEN] = check;
+    m_record_pos = 0;
+
+    return true;
+}
+
+
+void cus_trace_flush(cus_trace_put_t put)
+{
+    for (;;)
+    {
+        if ((m_record_pos >= CUS_TRACE_RECORD_LEN) && !record_load())
+        {
+            return;
+        }
+
+        while (m_record_pos < CUS_TRACE_RECORD_LEN)
+        {
+            if (!put(m_record[m_record_pos]))
+            {
+                // Output full, the rest of the record goes at the next flush.
+                return;
+            }
+            m_record_pos++;
+        }
+    }
+}
+
+#endif // CUS_TRACE_ENABLED
@@ -0,0 +1,77 @@
+#ifndef __CUS_TRACE_H_
+#define __CUS_TRACE_H_
+
+#include "sdk_config.h"
+#include "cus_trace_ids.h"
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#ifdef __cplusplus
+	extern "C" {
+#endif
+
+#define CUS_TRACE_ID_ENUM(id, format)   id,
+
+/**@brief Trace event identifiers, see @ref CUS_TRACE_EVENTS. */
+typedef enum
+{
+    CUS_TRACE_EVENTS(CUS_TRACE_ID_ENUM)
+    CUS_TRACE_ID_COUNT
+} cus_trace_id_t;
+
+/**@brief Record format on the wire.
+ *
+ * @details CUS_TRACE_SYNC_0, CUS_TRACE_SYNC_1, then the entry: RTC1 counter (24 bits) and id
+ *          (8 bits) as a uint32, then the two arguments as uint16, all little endian, then the XOR
+ *          of the 8 entry bytes. Records are mixed with the other output of the UART; a decoder
+ *          looks for the sync bytes and drops records with a wrong check byte.
+ */
+#define CUS_TRACE_SYNC_0                0xA5
+#define CUS_TRACE_SYNC_1                0x5A
+#define CUS_TRACE_ENTRY_LEN             8
+#define CUS_TRACE_RECORD_LEN            (2 + CUS_TRACE_ENTRY_LEN + 1)
+
+/**@brief Function for writing a byte to the trace output.
+ *
+ * @return false if the output is full, the byte is then offered again at the next flush.
+ */
+typedef bool (*cus_trace_put_t)(uint8_t byte);
+
+#if CUS_TRACE_ENABLED
+
+/**@brief Macro for tracing an event. Compiles to nothing when CUS_TRACE_ENABLED is 0. */
+#define CUS_TRACE(id, arg0, arg1)       cus_trace_add((id), (uint16_t)(arg0), (uint16_t)(arg1))
+
+/**@brief Function for adding an entry to the trace ring.
+ *
+ * @details Constant time, safe from any interrupt priority. When the ring is full the entry is
+ *          dropped and counted; the flush then reports the loss with a @ref CUS_TRACE_LOST entry.
+ *
+ * @param[in] id    Event.
+ * @param[in] arg0  First argument.
+ * @param[in] arg1  Second argument.
+ */
+void cus_trace_add(cus_trace_id_t id, uint16_t arg0, uint16_t arg1);
+
+/**@brief Function for sending the pending entries, as long as the output accepts them.
+ *
+ * @details Meant for the main loop, before sleeping: the entries only cost their copy in the
+ *          handlers, and the output runs when nothing else does. The output can be the UART, or
+ *          any other byte sink such as RTT.
+ *
+ * @param[in] put  Output function.
+ */
+void cus_trace_flush(cus_trace_put_t put);
+
+#else
+
+#define CUS_TRACE(id, arg0, arg1)
+
+#endif // CUS_TRACE_ENABLED
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
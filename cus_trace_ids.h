@@ -0,0 +1,25 @@
+#ifndef __CUS_TRACE_IDS_H_
+#define __CUS_TRACE_IDS_H_
+
+/**@brief Trace events, as X(id, format).
+ *
+ * @details The id of an event is its position in the list, so new events go at the end. The
+ *          format is the text printed by the host decoder (tools/trace), with the two arguments
+ *          of the entry as unsigned integers; it may use fewer. This file is shared with the
+ *          decoder and must stay plain C.
+ */
+#define CUS_TRACE_EVENTS(X)                                                                     \
+    X(CUS_TRACE_LOST,               "trace: %u entries lost")                                   \
+    X(CUS_TRACE_NOTIF_ENABLED,      "service %u: notification enabled")                         \
+    X(CUS_TRACE_NOTIF_DISABLED,     "service %u: notification disabled")                        \
+    X(CUS_TRACE_CONNECTED,          "service %u: connected")                                    \
+    X(CUS_TRACE_DISCONNECTED,       "service %u: disconnected")                                 \
+    X(CUS_TRACE_READ,               "service %u: read")                                         \
+    X(CUS_TRACE_CONSOLE,            "service %u: %u bytes to the console")                      \
+    X(CUS_TRACE_LAT_PERCENTILES,    "UART latency: p50 %u ticks, p99 %u ticks")                 \
+    X(CUS_TRACE_LAT_MAX,            "UART latency: max %u ticks, %u frames (mod 65536)")        \
+    X(CUS_TRACE_LAT_BUCKET,         "UART latency: >= %u ticks: %u frames")                     \
+    X(CUS_TRACE_STACK_PEAK,         "stack: peak %u bytes, %u above the main loop")             \
+    X(CUS_TRACE_CONSOLE_LOST,       "service %u: %u bytes lost to a full console")
+
+#endif
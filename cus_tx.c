@@ -0,0 +1,715 @@
+#include "cus_tx.h"
+
+#include "sdk_common.h"
+#include "app_util_platform.h"
+#include "nrf_soc.h"
+
+
+/**@brief A notification waiting for a SoftDevice TX buffer. */
+typedef struct
+{
+    uint16_t  conn_handle;
+    uint16_t  handle;
+    uint16_t  len;
+    uint8_t   id;                                                 /**< Sender the packet is accounted to. */
+    uint8_t * p_buf;                                              /**< Pool buffer holding the payload, owned by the queue. */
+    uint32_t  stamp;                                              /**< See cus_tx_stamp_next. */
+} cus_tx_pkt_t;
+
+/**@brief FIFO of packets. */
+typedef struct
+{
+    cus_tx_pkt_t * p_pkts;
+    uint8_t        size;
+    uint8_t        limit;                                         /**< Packets accepted, up to size. */
+    uint8_t        head;
+    uint8_t        count;
+} cus_tx_queue_t;
+
+/**@brief State of one registered sender. */
+typedef struct
+{
+    cus_tx_queue_t queue;                                         /**< Bulk packets of this sender. */
+    cus_tx_stats_t stats;
+    uint8_t        weight;                                        /**< Bulk packets per round. */
+    uint8_t        credit;                                        /**< Bulk packets left in the current round. */
+    uint32_t       next_stamp;                                    /**< Stamp of the next packet submitted. */
+    uint32_t       left;                                          /**< Bulk packets that left the queue, sent or dropped, modulo 2^32. */
+} cus_tx_sender_t;
+
+/**@brief Senders and stamps of the packets held by the SoftDevice, in the order they were given to it.
+ *
+ * @details The SoftDevice has fewer TX buffers than this, so the FIFO cannot overflow.
+ */
+#define TX_INFLIGHT_SIZE                16
+
+typedef struct
+{
+    uint32_t stamps[TX_INFLIGHT_SIZE];
+    uint8_t  ids[TX_INFLIGHT_SIZE];
+    uint8_t  head;
+    uint8_t  count;
+} cus_tx_inflight_t;
+
+static uint8_t         m_pool[CUS_TX_POOL_SIZE][CUS_TX_MAX_PAYLOAD_LEN];
+static uint8_t         m_pool_free[CUS_TX_POOL_SIZE];            /**< Stack of free pool buffer indexes. */
+static uint8_t         m_pool_free_count;
+static cus_tx_pkt_t    m_ctrl_pkts[CUS_TX_CTRL_QUEUE_SIZE];
+static cus_tx_pkt_t    m_bulk_pkts[CUS_TX_MAX_INSTANCES][CUS_TX_QUEUE_SIZE];
+static cus_tx_queue_t  m_ctrl_queue = {m_ctrl_pkts, CUS_TX_CTRL_QUEUE_SIZE, CUS_TX_CTRL_QUEUE_SIZE, 0, 0};
+static cus_tx_sender_t m_senders[CUS_TX_MAX_INSTANCES];
+static uint8_t         m_sender_count;
+static uint8_t         m_rr_index;                                /**< Sender whose turn it is in the bulk round robin. */
+static uint16_t        m_bulk_pending;                            /**< Bulk packets queued over all senders. */
+static volatile bool   m_sync;                                    /**< Bulk packets are sent just before the radio events. */
+static cus_tx_sync_handler_t m_sync_handler;
+static cus_tx_inflight_t m_inflight;
+static cus_tx_complete_handler_t m_complete_handler;
+static volatile uint32_t m_radio_events;
+
+
+STATIC_ASSERT(CUS_TX_POOL_SIZE <= UINT8_MAX);
+
+
+static void pool_init(void)
+{
+    for (uint8_t i = 0; i < CUS_TX_POOL_SIZE; i++)
+    {
+        m_pool_free[i] = i;
+    }
+    m_pool_free_count = CUS_TX_POOL_SIZE;
+}
+
+
+static uint8_t * pool_alloc(void)
+{
+    if (m_pool_free_count == 0)
+    {
+        return NULL;
+    }
+
+    return m_pool[m_pool_free[--m_pool_free_count]];
+}
+
+
+static void pool_free(uint8_t * p_buf)
+{
+    m_pool_free[m_pool_free_count++] = (uint8_t)((p_buf - m_pool[0]) / CUS_TX_MAX_PAYLOAD_LEN);
+}
+
+
+static bool pool_owns(uint8_t const * p_buf)
+{
+    return (p_buf >= m_pool[0])
+        && (p_buf <  m_pool[0] + sizeof(m_pool))
+        && (((p_buf - m_pool[0]) % CUS_TX_MAX_PAYLOAD_LEN) == 0);
+}
+
+
+static uint32_t pkt_hvx(uint8_t         id,
+                        uint16_t        conn_handle,
+                        uint16_t        handle,
+                        uint8_t const * p_data,
+                        uint16_t        len,
+                        uint32_t        stamp)
+{
+    ble_gatts_hvx_params_t hvx_params;
+    uint32_t               err_code;
+
+    memset(&hvx_params, 0, sizeof(hvx_params));
+
+    hvx_params.handle = handle;
+    hvx_params.type   = BLE_GATT_HVX_NOTIFICATION;
+    hvx_params.offset = 0;
+    hvx_params.p_len  = &len;
+    hvx_params.p_data = (uint8_t *)p_data;
+
+    err_code = sd_ble_gatts_hvx(conn_handle, &hvx_params);
+
+    // Every packet taken by the SoftDevice is counted by a TX complete, stamped or not.
+    if ((err_code == NRF_SUCCESS) && (m_inflight.count < TX_INFLIGHT_SIZE))
+    {
+        uint8_t slot = (m_inflight.head + m_inflight.count) % TX_INFLIGHT_SIZE;
+
+        m_inflight.stamps[slot] = stamp;
+        m_inflight.ids[slot]    = id;
+        m_inflight.count++;
+    }
+
+    return err_code;
+}
+
+
+/**@brief Function for reporting the stamps of the packets the SoftDevice has sent.
+ *
+ * @details Runs outside of any critical region, the handler may send again.
+ */
+static void inflight_complete(uint8_t count)
+{
+    while (count-- > 0)
+    {
+        uint32_t stamp = CUS_TX_STAMP_NONE;
+        uint8_t  id    = 0;
+
+        CRITICAL_REGION_ENTER();
+        if (m_inflight.count > 0)
+        {
+            stamp           = m_inflight.stamps[m_inflight.head];
+            id              = m_inflight.ids[m_inflight.head];
+            m_inflight.head = (m_inflight.head + 1) % TX_INFLIGHT_SIZE;
+            m_inflight.count--;
+        }
+        CRITICAL_REGION_EXIT();
+
+        if ((stamp != CUS_TX_STAMP_NONE) && (m_complete_handler != NULL))
+        {
+            m_complete_handler(id, stamp);
+        }
+    }
+}
+
+
+/**@brief Function for appending a pool buffer to a queue. The queue takes ownership of the buffer. */
+static uint32_t queue_push(cus_tx_queue_t * p_queue,
+                           uint8_t          id,
+                           uint16_t         conn_handle,
+                           uint16_t         handle,
+                           uint8_t        * p_buf,
+                           uint16_t         length,
+                           uint32_t         stamp)
+{
+    if (p_queue->count >= p_queue->limit)
+    {
+        m_senders[id].stats.dropped++;
+        return NRF_ERROR_NO_MEM;
+    }
+
+    cus_tx_pkt_t * p_pkt = &p_queue->p_pkts[(p_queue->head + p_queue->count) % p_queue->size];
+
+    p_pkt->conn_handle = conn_handle;
+    p_pkt->handle      = handle;
+    p_pkt->len         = length;
+    p_pkt->id          = id;
+    p_pkt->p_buf       = p_buf;
+    p_pkt->stamp       = stamp;
+
+    p_queue->count++;
+    m_senders[id].stats.queued++;
+
+    return NRF_SUCCESS;
+}
+
+
+static void queue_pop(cus_tx_queue_t * p_queue)
+{
+    uint8_t id = p_queue->p_pkts[p_queue->head].id;
+
+    pool_free(p_queue->p_pkts[p_queue->head].p_buf);
+
+    p_queue->head = (p_queue->head + 1) % p_queue->size;
+    p_queue->count--;
+
+    if (p_queue != &m_ctrl_queue)
+    {
+        m_bulk_pending--;
+        m_senders[id].left++;
+    }
+}
+
+
+/**@brief Function for sending the packet at the head of a queue.
+ *
+ * @return false if the SoftDevice has no free TX buffer, in which case the packet stays queued.
+ */
+static bool queue_head_send(cus_tx_queue_t * p_queue)
+{
+    cus_tx_pkt_t    * p_pkt    = &p_queue->p_pkts[p_queue->head];
+    cus_tx_sender_t * p_sender = &m_senders[p_pkt->id];
+    uint32_t          err_code;
+
+    err_code = pkt_hvx(p_pkt->id, p_pkt->conn_handle, p_pkt->handle, p_pkt->p_buf, p_pkt->len, p_pkt->stamp);
+
+    if (err_code == BLE_ERROR_NO_TX_PACKETS)
+    {
+        p_sender->stats.deferred++;
+        return false;
+    }
+
+    if (err_code == NRF_SUCCESS)
+    {
+        p_sender->stats.sent++;
+        p_sender->stats.bytes += p_pkt->len;
+    }
+    else
+    {
+        // Notification disabled or link lost meanwhile, the packet can never be sent.
+        p_sender->stats.dropped++;
+    }
+
+    queue_pop(p_queue);
+    return true;
+}
+
+
+/**@brief Function for filling the free SoftDevice TX buffers from the queues.
+ *
+ * @details The control queue is drained first. Bulk queues are then served round robin, each
+ *          sender sending up to its weight before the turn passes on. The round robin position
+ *          and the remaining credit are kept when the buffers run out, so the next sender in
+ *          line is not skipped at the following connection event.
+ */
+static void tx_pump(void)
+{
+    uint8_t idle = 0;
+
+    while (m_ctrl_queue.count > 0)
+    {
+        if (!queue_head_send(&m_ctrl_queue))
+        {
+            return;
+        }
+    }
+
+    while (idle < m_sender_count)
+    {
+        cus_tx_sender_t * p_sender = &m_senders[m_rr_index];
+
+        if (p_sender->queue.count == 0)
+        {
+            p_sender->credit = 0;
+            m_rr_index       = (m_rr_index + 1) % m_sender_count;
+            idle++;
+            continue;
+        }
+
+        if (p_sender->credit == 0)
+        {
+            p_sender->credit = p_sender->weight;
+        }
+
+        if (!queue_head_send(&p_sender->queue))
+        {
+            return;
+        }
+
+        idle = 0;
+        if (--p_sender->credit == 0)
+        {
+            m_rr_index = (m_rr_index + 1) % m_sender_count;
+        }
+    }
+}
+
+
+static void queues_flush(void)
+{
+    while (m_ctrl_queue.count > 0)
+    {
+        m_senders[m_ctrl_queue.p_pkts[m_ctrl_queue.head].id].stats.dropped++;
+        queue_pop(&m_ctrl_queue);
+    }
+
+    for (uint8_t i = 0; i < m_sender_count; i++)
+    {
+        while (m_senders[i].queue.count > 0)
+        {
+            m_senders[i].stats.dropped++;
+            queue_pop(&m_senders[i].queue);
+        }
+        m_senders[i].queue.head = 0;
+        m_senders[i].credit     = 0;
+    }
+
+    m_rr_index = 0;
+
+    // Packets the SoftDevice held are lost with the link.
+    m_inflight.head  = 0;
+    m_inflight.count = 0;
+}
+
+
+uint32_t cus_tx_register(uint8_t weight, uint8_t * p_id)
+{
+    VERIFY_PARAM_NOT_NULL(p_id);
+
+    if (m_sender_count >= CUS_TX_MAX_INSTANCES)
+    {
+        return NRF_ERROR_NO_MEM;
+    }
+
+    if (m_sender_count == 0)
+    {
+        pool_init();
+    }
+
+    cus_tx_sender_t * p_sender = &m_senders[m_sender_count];
+
+    memset(p_sender, 0, sizeof(*p_sender));
+    p_sender->queue.p_pkts = m_bulk_pkts[m_sender_count];
+    p_sender->queue.size   = CUS_TX_QUEUE_SIZE;
+    p_sender->queue.limit  = CUS_TX_QUEUE_SIZE;
+    p_sender->weight       = (weight == 0) ? 1 : weight;
+    p_sender->next_stamp   = CUS_TX_STAMP_NONE;
+
+    *p_id = m_sender_count++;
+
+    return NRF_SUCCESS;
+}
+
+
+uint32_t cus_tx_queue_limit_set(uint8_t id, uint8_t limit)
+{
+    if ((id >= m_sender_count) || (limit == 0) || (limit > CUS_TX_QUEUE_SIZE))
+    {
+        return NRF_ERROR_INVALID_PARAM;
+    }
+
+    // Packets already queued beyond the new limit stay queued; only new ones are refused.
+    CRITICAL_REGION_ENTER();
+    m_senders[id].queue.limit = limit;
+    CRITICAL_REGION_EXIT();
+
+    return NRF_SUCCESS;
+}
+
+
+uint8_t * cus_tx_buf_alloc(void)
+{
+    uint8_t * p_buf;
+
+    CRITICAL_REGION_ENTER();
+    p_buf = pool_alloc();
+    CRITICAL_REGION_EXIT();
+
+    return p_buf;
+}
+
+
+void cus_tx_buf_free(uint8_t * p_buf)
+{
+    if (!pool_owns(p_buf))
+    {
+        return;
+    }
+
+    CRITICAL_REGION_ENTER();
+    pool_free(p_buf);
+    CRITICAL_REGION_EXIT();
+}
+
+
+/**@brief Function for sending a packet or queueing it if it cannot be sent at once.
+ *
+ * @details Must be called in a critical region. If the packet has to be queued and p_buf is NULL,
+ *          p_data is copied into a pool buffer; otherwise p_buf is queued as is. On return the
+ *          caller still owns p_buf only if it was not queued (*p_queued is false).
+ */
+static uint32_t tx_submit(uint8_t         id,
+                          uint16_t        conn_handle,
+                          uint16_t        handle,
+                          uint8_t const * p_data,
+                          uint8_t       * p_buf,
+                          uint16_t        length,
+                          cus_tx_prio_t   prio,
+                          bool          * p_queued)
+{
+    cus_tx_sender_t * p_sender = &m_senders[id];
+    cus_tx_queue_t  * p_queue  = (prio == CUS_TX_PRIO_CONTROL) ? &m_ctrl_queue : &p_sender->queue;
+    uint32_t          err_code = NRF_ERROR_NO_MEM;
+    uint32_t          stamp    = p_sender->next_stamp;
+
+    *p_queued = false;
+    p_sender->next_stamp = CUS_TX_STAMP_NONE;
+
+    // Only bypass the queues when nothing is waiting ahead of this packet, so that a sender
+    // calling often cannot overtake the backlog of the others.
+    // In sync mode bulk packets always wait for the next radio event.
+    bool bypass = (m_ctrl_queue.count == 0) &&
+                  ((prio == CUS_TX_PRIO_CONTROL) || ((m_bulk_pending == 0) && !m_sync));
+
+    if (bypass)
+    {
+        err_code = pkt_hvx(id, conn_handle, handle, p_data, length, stamp);
+
+        if (err_code == NRF_SUCCESS)
+        {
+            p_sender->stats.sent++;
+            p_sender->stats.bytes += length;
+            return NRF_SUCCESS;
+        }
+        else if (err_code == BLE_ERROR_NO_TX_PACKETS)
+        {
+            p_sender->stats.deferred++;
+        }
+        else
+        {
+            p_sender->stats.dropped++;
+            return err_code;
+        }
+    }
+
+    if (p_buf == NULL)
+    {
+        p_buf = pool_alloc();
+        if (p_buf == NULL)
+        {
+            p_sender->stats.dropped++;
+            return NRF_ERROR_NO_MEM;
+        }
+        memcpy(p_buf, p_data, length);
+    }
+
+    err_code = queue_push(p_queue, id, conn_handle, handle, p_buf, length, stamp);
+
+    if (err_code == NRF_SUCCESS)
+    {
+        *p_queued = true;
+        if (p_queue != &m_ctrl_queue)
+        {
+            m_bulk_pending++;
+        }
+    }
+    else if (p_buf != p_data)
+    {
+        // The buffer was taken from the pool for this call only.
+        pool_free(p_buf);
+    }
+
+    return err_code;
+}
+
+
+uint32_t cus_tx_send(uint8_t               id,
+                     uint16_t              conn_handle,
+                     uint16_t              handle,
+                     uint8_t const       * p_data,
+                     uint16_t              length,
+                     cus_tx_prio_t         prio)
+{
+    uint32_t err_code;
+    bool     queued;
+
+    VERIFY_PARAM_NOT_NULL(p_data);
+
+    if ((id >= m_sender_count) || (length > CUS_TX_MAX_PAYLOAD_LEN))
+    {
+        return NRF_ERROR_INVALID_PARAM;
+    }
+
+    CRITICAL_REGION_ENTER();
+    err_code = tx_submit(id, conn_handle, handle, p_data, NULL, length, prio, &queued);
+    CRITICAL_REGION_EXIT();
+
+    return err_code;
+}
+
+
+uint32_t cus_tx_buf_send(uint8_t               id,
+                         uint16_t              conn_handle,
+                         uint16_t              handle,
+                         uint8_t             * p_buf,
+                         uint16_t              length,
+                         cus_tx_prio_t         prio)
+{
+    uint32_t err_code;
+    bool     queued;
+
+    if (!pool_owns(p_buf))
+    {
+        return NRF_ERROR_INVALID_ADDR;
+    }
+
+    if ((id >= m_sender_count) || (length > CUS_TX_MAX_PAYLOAD_LEN))
+    {
+        cus_tx_buf_free(p_buf);
+        return NRF_ERROR_INVALID_PARAM;
+    }
+
+    CRITICAL_REGION_ENTER();
+    err_code = tx_submit(id, conn_handle, handle, p_buf, p_buf, length, prio, &queued);
+    if (!queued)
+    {
+        pool_free(p_buf);
+    }
+    CRITICAL_REGION_EXIT();
+
+    return err_code;
+}
+
+
+void cus_tx_on_ble_evt(ble_evt_t * p_ble_evt)
+{
+    if (p_ble_evt == NULL)
+    {
+        return;
+    }
+
+    switch (p_ble_evt->header.evt_id)
+    {
+        case BLE_EVT_TX_COMPLETE:
+        {
+            inflight_complete(p_ble_evt->evt.common_evt.params.tx_complete.count);
+
+            CRITICAL_REGION_ENTER();
+            tx_pump();
+            CRITICAL_REGION_EXIT();
+        } break;
+
+        case BLE_GAP_EVT_DISCONNECTED:
+        {
+            CRITICAL_REGION_ENTER();
+            queues_flush();
+            CRITICAL_REGION_EXIT();
+        } break;
+
+        default:
+            // No implementation needed.
+            break;
+    }
+}
+
+
+void cus_tx_stamp_next(uint8_t id, uint32_t stamp)
+{
+    if (id >= m_sender_count)
+    {
+        return;
+    }
+
+    CRITICAL_REGION_ENTER();
+    m_senders[id].next_stamp = stamp;
+    CRITICAL_REGION_EXIT();
+}
+
+
+void cus_tx_complete_handler_set(cus_tx_complete_handler_t handler)
+{
+    m_complete_handler = handler;
+}
+
+
+/**@brief Function for handling the radio notification, raised CUS_TX_SYNC_DISTANCE before each
+ *        radio event.
+ */
+void RADIO_NOTIFICATION_IRQHandler(void)
+{
+    m_radio_events++;
+
+    if (!m_sync)
+    {
+        return;
+    }
+
+    if (m_sync_handler != NULL)
+    {
+        m_sync_handler();
+    }
+
+    CRITICAL_REGION_ENTER();
+    tx_pump();
+    CRITICAL_REGION_EXIT();
+}
+
+
+uint32_t cus_tx_sync_init(cus_tx_sync_handler_t handler)
+{
+    uint32_t err_code;
+
+    m_sync_handler = handler;
+
+    err_code = sd_nvic_ClearPendingIRQ(RADIO_NOTIFICATION_IRQn);
+    VERIFY_SUCCESS(err_code);
+
+    err_code = sd_nvic_SetPriority(RADIO_NOTIFICATION_IRQn, APP_IRQ_PRIORITY_LOWEST);
+    VERIFY_SUCCESS(err_code);
+
+    err_code = sd_nvic_EnableIRQ(RADIO_NOTIFICATION_IRQn);
+    VERIFY_SUCCESS(err_code);
+
+    return sd_radio_notification_cfg_set(NRF_RADIO_NOTIFICATION_TYPE_INT_ON_ACTIVE,
+                                         CUS_TX_SYNC_DISTANCE);
+}
+
+
+void cus_tx_sync_set(bool enable)
+{
+    CRITICAL_REGION_ENTER();
+    m_sync = enable;
+    if (!enable)
+    {
+        // Packets held for the next radio event go now.
+        tx_pump();
+    }
+    CRITICAL_REGION_EXIT();
+}
+
+
+uint32_t cus_tx_radio_event_count(void)
+{
+    return m_radio_events;
+}
+
+
+uint32_t cus_tx_queue_mark(uint8_t id)
+{
+    uint32_t mark = 0;
+
+    if (id < m_sender_count)
+    {
+        CRITICAL_REGION_ENTER();
+        mark = m_senders[id].left + m_senders[id].queue.count;
+        CRITICAL_REGION_EXIT();
+    }
+
+    return mark;
+}
+
+
+bool cus_tx_queue_passed(uint8_t id, uint32_t mark)
+{
+    if (id >= m_sender_count)
+    {
+        return true;
+    }
+
+    // The counter wraps; marks are never more than a queue length ahead of it.
+    return (int32_t)(m_senders[id].left - mark) >= 0;
+}
+
+
+bool cus_tx_idle(void)
+{
+    return (m_ctrl_queue.count == 0) && (m_bulk_pending == 0) && (m_inflight.count == 0);
+}
+
+
+uint32_t cus_tx_stats_get(uint8_t id, cus_tx_stats_t * p_stats)
+{
+    VERIFY_PARAM_NOT_NULL(p_stats);
+
+    if (id >= m_sender_count)
+    {
+        return NRF_ERROR_INVALID_PARAM;
+    }
+
+    CRITICAL_REGION_ENTER();
+    *p_stats = m_senders[id].stats;
+    CRITICAL_REGION_EXIT();
+
+    return NRF_SUCCESS;
+}
+
+
+uint32_t cus_tx_stats_reset(uint8_t id)
+{
+    if (id >= m_sender_count)
+    {
+        return NRF_ERROR_INVALID_PARAM;
+    }
+
+    CRITICAL_REGION_ENTER();
+    memset(&m_senders[id].stats, 0, sizeof(m_senders[id].stats));
+    CRITICAL_REGION_EXIT();
+
+    return NRF_SUCCESS;
+}
@@ -0,0 +1,253 @@
+#ifndef __CUS_TX_H_
+#define __CUS_TX_H_
+
+#include "ble.h"
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#ifdef __cplusplus
+	extern "C" {
+#endif
+
+/**@brief Largest payload (in bytes) that can be queued in the TX scheduler. */
+#define CUS_TX_MAX_PAYLOAD_LEN          (GATT_MTU_SIZE_DEFAULT - 3)
+
+/**@brief Stamp of a packet that is not measured. app_timer ticks are 24-bit, no stamp has this value. */
+#define CUS_TX_STAMP_NONE               UINT32_MAX
+
+/**@brief TX priority class.
+ *
+ * @details Control packets are sent before any bulk packet of any instance, in FIFO order.
+ *          Bulk packets are shared between instances by weighted round robin.
+ */
+typedef enum
+{
+    CUS_TX_PRIO_CONTROL,                                          /**< Strict priority, for short latency-sensitive messages. */
+    CUS_TX_PRIO_BULK                                              /**< Weighted share of the TX buffers, for streams. */
+} cus_tx_prio_t;
+
+/**@brief Handler called just before each radio event in sync mode, to send the data collected so
+ *        far. Runs at APP_IRQ_PRIORITY_LOWEST.
+ */
+typedef void (*cus_tx_sync_handler_t)(void);
+
+/**@brief Handler called when the SoftDevice reports a stamped packet as sent, from
+ *        @ref cus_tx_on_ble_evt.
+ *
+ * @param[in] id     Sender of the packet.
+ * @param[in] stamp  Stamp given to @ref cus_tx_stamp_next for the packet.
+ */
+typedef void (*cus_tx_complete_handler_t)(uint8_t id, uint32_t stamp);
+
+/**@brief Per-instance TX counters, used to verify the fairness of the scheduler. */
+typedef struct
+{
+    uint32_t sent;                                                /**< Packets accepted by the SoftDevice. */
+    uint32_t bytes;                                               /**< Payload bytes of the packets sent. */
+    uint32_t queued;                                              /**< Packets that had to wait in the scheduler queue. */
+    uint32_t deferred;                                            /**< Times a packet was refused by the SoftDevice because all TX buffers were in use. */
+    uint32_t dropped;                                             /**< Packets discarded (queue full, link lost or notification disabled). */
+} cus_tx_stats_t;
+
+/**@brief Function for registering a sender with the TX scheduler.
+ *
+ * @param[in]  weight  Number of bulk packets the sender may send per round. 0 is treated as 1.
+ * @param[out] p_id    Identifier of the sender, to be passed to the other functions.
+ *
+ * @retval NRF_SUCCESS     If the sender was registered.
+ * @retval NRF_ERROR_NO_MEM If @ref CUS_TX_MAX_INSTANCES senders are already registered.
+ */
+uint32_t cus_tx_register(uint8_t weight, uint8_t * p_id);
+
+/**@brief Function for limiting the number of bulk packets a sender can have queued.
+ *
+ * @details The queue storage is sized by CUS_TX_QUEUE_SIZE at build time; the limit only lowers
+ *          the number of packets accepted, to trade buffering (and latency) against drops.
+ *
+ * @param[in] id     Sender identifier.
+ * @param[in] limit  Largest number of queued bulk packets, 1 to CUS_TX_QUEUE_SIZE.
+ *
+ * @retval NRF_SUCCESS             If the limit was set.
+ * @retval NRF_ERROR_INVALID_PARAM If the id or the limit is invalid.
+ */
+uint32_t cus_tx_queue_limit_set(uint8_t id, uint8_t limit);
+
+/**@brief Function for sending a notification through the TX scheduler.
+ *
+ * @details The packet is handed to the SoftDevice at once when it is the sender's turn and a TX
+ *          buffer is free. Otherwise it is copied into a pool buffer, queued in its priority class
+ *          and sent from @ref cus_tx_on_ble_evt when the SoftDevice reports free buffers.
+ *
+ * @param[in] id           Sender identifier returned by @ref cus_tx_register.
+ * @param[in] conn_handle  Connection handle.
+ * @param[in] handle       Attribute handle to notify.
+ * @param[in] p_data       Payload.
+ * @param[in] length       Payload length, at most @ref CUS_TX_MAX_PAYLOAD_LEN.
+ * @param[in] prio         Priority class of the packet.
+ *
+ * @retval NRF_SUCCESS             If the packet was sent or queued.
+ * @retval NRF_ERROR_INVALID_PARAM If the id or the length is invalid.
+ * @retval NRF_ERROR_NO_MEM        If the queue of the priority class or the pool is full.
+ * @return Otherwise the error code returned by @ref sd_ble_gatts_hvx.
+ */
+uint32_t cus_tx_send(uint8_t               id,
+                     uint16_t              conn_handle,
+                     uint16_t              handle,
+                     uint8_t const       * p_data,
+                     uint16_t              length,
+                     cus_tx_prio_t         prio);
+
+/**@brief Function for taking a payload buffer from the TX pool.
+ *
+ * @details The buffer is @ref CUS_TX_MAX_PAYLOAD_LEN bytes long. The caller fills it in place and
+ *          passes it to @ref cus_tx_buf_send, which hands it to the SoftDevice or queues it
+ *          without copying. A buffer that is not sent must be given back with @ref cus_tx_buf_free.
+ *
+ * @return Pointer to the buffer, or NULL if all buffers are in use.
+ */
+uint8_t * cus_tx_buf_alloc(void);
+
+/**@brief Function for giving a buffer back to the TX pool.
+ *
+ * @param[in] p_buf  Buffer obtained from @ref cus_tx_buf_alloc. Other pointers are ignored.
+ */
+void cus_tx_buf_free(uint8_t * p_buf);
+
+/**@brief Function for sending a notification from a pool buffer.
+ *
+ * @details Same as @ref cus_tx_send, except that the payload is never copied: if the packet has
+ *          to wait, the buffer itself is queued. The scheduler takes ownership of the buffer in
+ *          all cases, including on error.
+ *
+ * @param[in] id           Sender identifier returned by @ref cus_tx_register.
+ * @param[in] conn_handle  Connection handle.
+ * @param[in] handle       Attribute handle to notify.
+ * @param[in] p_buf        Buffer obtained from @ref cus_tx_buf_alloc.
+ * @param[in] length       Payload length, at most @ref CUS_TX_MAX_PAYLOAD_LEN.
+ * @param[in] prio         Priority class of the packet.
+ *
+ * @retval NRF_ERROR_INVALID_ADDR If p_buf does not come from the pool.
+ * @return Otherwise the same values as @ref cus_tx_send.
+ */
+uint32_t cus_tx_buf_send(uint8_t               id,
+                         uint16_t              conn_handle,
+                         uint16_t              handle,
+                         uint8_t             * p_buf,
+                         uint16_t              length,
+                         cus_tx_prio_t         prio);
+
+/**@brief Function for handling the BLE events relevant to the TX scheduler.
+ *
+ * @details Must be called once per event from the application's BLE event dispatcher.
+ *
+ * @param[in] p_ble_evt  Event received from the SoftDevice.
+ */
+void cus_tx_on_ble_evt(ble_evt_t * p_ble_evt);
+
+/**@brief Function for stamping the next packet of a sender, to measure when it is sent.
+ *
+ * @details The stamp applies to the next call to @ref cus_tx_send or @ref cus_tx_buf_send for the
+ *          sender, whatever its result, and follows the packet through the queue. Packets handed
+ *          to the SoftDevice are sent in order, so @ref BLE_EVT_TX_COMPLETE tells which stamped
+ *          packets left; each is reported to the handler set by @ref cus_tx_complete_handler_set.
+ *
+ * @param[in] id     Sender identifier.
+ * @param[in] stamp  Any value but CUS_TX_STAMP_NONE, typically the app_timer tick at which the
+ *                   data of the packet was produced.
+ */
+void cus_tx_stamp_next(uint8_t id, uint32_t stamp);
+
+/**@brief Function for setting the handler of stamped packets.
+ *
+ * @param[in] handler  Handler, or NULL.
+ */
+void cus_tx_complete_handler_set(cus_tx_complete_handler_t handler);
+
+/**@brief Function for subscribing to the radio notifications used by the sync mode.
+ *
+ * @details The SoftDevice signals CUS_TX_SYNC_DISTANCE before each radio event. When the sync mode
+ *          is enabled, the handler is then called and the TX buffers filled from the queues. The
+ *          notification can only be configured while the radio is idle, so this is done once
+ *          before advertising starts; the mode itself is switched with @ref cus_tx_sync_set.
+ *
+ * @param[in] handler  Handler called before each radio event, or NULL.
+ *
+ * @return NRF_SUCCESS on success, otherwise the error code returned by the SoftDevice.
+ */
+uint32_t cus_tx_sync_init(cus_tx_sync_handler_t handler);
+
+/**@brief Function for switching the sync mode.
+ *
+ * @details In sync mode bulk packets are always queued, and handed to the SoftDevice just before
+ *          the next radio event, or on @ref BLE_EVT_TX_COMPLETE. Producers batch their data until
+ *          the handler given to @ref cus_tx_sync_init asks for it, so the packets are full and the
+ *          data is as recent as possible when the connection event starts. Control packets are
+ *          not affected.
+ *
+ * @param[in] enable  true to enable the sync mode.
+ */
+void cus_tx_sync_set(bool enable);
+
+/**@brief Function for counting the radio events, from the notifications set up by
+ *        @ref cus_tx_sync_init, whether the sync mode is on or not.
+ *
+ * @details While connected, a radio event is a connection event.
+ *
+ * @return Radio events since @ref cus_tx_sync_init, modulo 2^32.
+ */
+uint32_t cus_tx_radio_event_count(void);
+
+/**@brief Function for marking the end of a sender's bulk queue.
+ *
+ * @details Bulk packets leave the queue of their sender in order, so once the packets queued now
+ *          have left it, sent or dropped, @ref cus_tx_queue_passed returns true for the mark. A
+ *          packet is thus known to be out of the scheduler without tracking it, before it is
+ *          sent again.
+ *
+ * @param[in] id  Sender identifier.
+ *
+ * @return Mark to pass to @ref cus_tx_queue_passed.
+ */
+uint32_t cus_tx_queue_mark(uint8_t id);
+
+/**@brief Function for checking whether the bulk packets queued before a mark have all left the
+ *        queue of their sender.
+ *
+ * @param[in] id    Sender identifier.
+ * @param[in] mark  Value returned by @ref cus_tx_queue_mark for the same sender.
+ *
+ * @return true if none of the packets is queued any more, or if the id is invalid.
+ */
+bool cus_tx_queue_passed(uint8_t id, uint32_t mark);
+
+/**@brief Function for checking that every packet was sent.
+ *
+ * @return true if no packet is queued and the SoftDevice reported all the packets it took as sent.
+ */
+bool cus_tx_idle(void);
+
+/**@brief Function for reading the TX counters of a sender.
+ *
+ * @param[in]  id       Sender identifier.
+ * @param[out] p_stats  Counters.
+ *
+ * @retval NRF_SUCCESS             If the counters were copied.
+ * @retval NRF_ERROR_INVALID_PARAM If the id is invalid.
+ */
+uint32_t cus_tx_stats_get(uint8_t id, cus_tx_stats_t * p_stats);
+
+/**@brief Function for clearing the TX counters of a sender.
+ *
+ * @param[in] id  Sender identifier.
+ *
+ * @retval NRF_SUCCESS             If the counters were cleared.
+ * @retval NRF_ERROR_INVALID_PARAM If the id is invalid.
+ */
+uint32_t cus_tx_stats_reset(uint8_t id);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -16,28 +16,43 @@
 #include "bsp_btn_ble.h"
 #include "nrf_delay.h"
 #include "cus_service.h"
+#include "cus_qwr.h"
+#include "cus_arq.h"
+#include "cus_mux.h"
+#include "cus_rpc.h"
+#include "cus_cfg.h"
+#include "cus_obj.h"
+#include "cus_tlm.h"
+#include "cus_bench.h"
+#include "cus_prof.h"
+#include "cus_lat.h"
+#include "cus_trace.h"
+#include "cus_evtcap.h"
+#include "cus_stack.h"
+#include "app_ram.h"
+#include "fstorage.h"
+#if CUS_LZ_ENABLED
+#include "cus_lz.h"
+#endif
 
 
 #define IS_SRVC_CHANGED_CHARACT_PRESENT 0                                           /**< Include the service_changed characteristic. If not enabled, the server's database cannot be changed for the lifetime of the device. */
 
 #define APP_FEATURE_NOT_SUPPORTED       BLE_GATT_STATUS_ATTERR_APP_BEGIN + 2        /**< Reply when unsupported features are requested. */
 
-#define CENTRAL_LINK_COUNT              0                                           /**< Number of central links used by the application. When changing this number remember to adjust the RAM settings*/
-#define PERIPHERAL_LINK_COUNT           1                                           /**< Number of peripheral links used by the application. When changing this number remember to adjust the RAM settings*/
-
 #define DEVICE_NAME                     "Khoa NRF"                               /**< Name of device. Will be included in the advertising data. */
 #define CUS_SERVICE_UUID_TYPE           BLE_UUID_TYPE_BLE                  /**< UUID type for the Nordic UART Service (vendor specific). */
 
-#define APP_ADV_INTERVAL                64                                          /**< The advertising interval (in units of 0.625 ms. This value corresponds to 40 ms). */
-#define APP_ADV_TIMEOUT_IN_SECONDS      180                                         /**< The advertising timeout (in units of seconds). */
+#define APP_ADV_INTERVAL                64                                          /**< Default advertising interval (in units of 0.625 ms. This value corresponds to 40 ms). */
+#define APP_ADV_TIMEOUT_IN_SECONDS      180                                         /**< Default advertising timeout (in units of seconds). */
 
 #define APP_TIMER_PRESCALER             0                                           /**< Value of the RTC1 PRESCALER register. */
-#define APP_TIMER_OP_QUEUE_SIZE         4                                           /**< Size of timer operation queues. */
+#define APP_TIMER_OP_QUEUE_SIZE         8                                           /**< Size of timer operation queues. */
 
-#define MIN_CONN_INTERVAL               MSEC_TO_UNITS(20, UNIT_1_25_MS)             /**< Minimum acceptable connection interval (20 ms), Connection interval uses 1.25 ms units. */
-#define MAX_CONN_INTERVAL               MSEC_TO_UNITS(75, UNIT_1_25_MS)             /**< Maximum acceptable connection interval (75 ms), Connection interval uses 1.25 ms units. */
-#define SLAVE_LATENCY                   0                                           /**< Slave latency. */
-#define CONN_SUP_TIMEOUT                MSEC_TO_UNITS(4000, UNIT_10_MS)             /**< Connection supervisory timeout (4 seconds), Supervision Timeout uses 10 ms units. */
+#define MIN_CONN_INTERVAL               MSEC_TO_UNITS(20, UNIT_1_25_MS)             /**< Default minimum acceptable connection interval (20 ms), Connection interval uses 1.25 ms units. */
+#define MAX_CONN_INTERVAL               MSEC_TO_UNITS(75, UNIT_1_25_MS)             /**< Default maximum acceptable connection interval (75 ms), Connection interval uses 1.25 ms units. */
+#define SLAVE_LATENCY                   0                                           /**< Default slave latency. */
+#define CONN_SUP_TIMEOUT                MSEC_TO_UNITS(4000, UNIT_10_MS)             /**< Default connection supervisory timeout (4 seconds), Supervision Timeout uses 10 ms units. */
 #define FIRST_CONN_PARAMS_UPDATE_DELAY  APP_TIMER_TICKS(5000, APP_TIMER_PRESCALER)  /**< Time from initiating event (connect or start of notification) to first time sd_ble_gap_conn_param_update is called (5 seconds). */
 #define NEXT_CONN_PARAMS_UPDATE_DELAY   APP_TIMER_TICKS(30000, APP_TIMER_PRESCALER) /**< Time between each call to sd_ble_gap_conn_param_update after the first call (30 seconds). */
 #define MAX_CONN_PARAMS_UPDATE_COUNT    3                                           /**< Number of attempts before giving up the connection parameter negotiation. */
@@ -46,10 +61,112 @@
 
 #define UART_TX_BUF_SIZE                256                                         /**< UART TX buffer size. */
 #define UART_RX_BUF_SIZE                256                                         /**< UART RX buffer size. */
+#define UART_TX_HEADROOM                (3 * (BLE_CUSTOM_MAX_DATA_LEN + 2))         /**< Room the trace leaves in the UART TX buffer for the console lines printed by the handlers. */
+#define UART_BAUDRATE                   115200                                      /**< Default UART baud rate. */
+#define TX_POWER                        0                                           /**< Default radio TX power (in dBm). */
+#define TX_SYNC                         1                                           /**< Default TX mode: bulk data sent just before each connection event. */
+
+#define CUS_READ_VALUE_MAX_LEN          BLE_CUSTOM_MAX_DATA_LEN                     /**< Size of the application buffers backing the READ characteristics. */
+#define CUS_READ_VALUE                  "Truong Bach Khoa"                          /**< Value returned by the READ characteristic of Service 1. */
+#define CUS_ARQ_WINDOW                  8                                           /**< Default window of the reliable UART stream of Service 1. */
+#define CUS_ARQ_TIMEOUT                 APP_TIMER_TICKS(300, APP_TIMER_PRESCALER)   /**< Time without any acknowledgement after which the UART stream sends its oldest frame again (300 ms). */
+#define CUS2_DIAG_LEN                   (sizeof(uint32_t) * (1 + 2 * 4 + 3) + CUS_STACK_ENCODED_LEN + CUS_PROF_ENCODED_LEN)  /**< Length of the diagnostics snapshot returned by the READ characteristic of Service 2 (longer than one packet, read with Read Blob). */
+#define CUS2_CH_CONSOLE                 0                                           /**< Service 2 channel printing what the peer writes to the UART. */
+#define CUS2_CH_RPC                     1                                           /**< Service 2 channel carrying the configuration and status calls. */
+#define CUS2_CH_OBJ                     2                                           /**< Service 2 channel carrying object transfers to flash. */
+#define CUS2_CH_TLM                     3                                           /**< Service 2 channel carrying the delta coded telemetry. */
+#define CUS2_CH_BENCH                   4                                           /**< Service 2 channel carrying the throughput benchmark. */
+#define CUS2_CH_ECHO                    5                                           /**< Service 2 channel returning each frame with the device timestamps. */
+
+#define ECHO_ANSWER                     0x00                                        /**< {ECHO_ANSWER, sequence, length written, receive ticks (uint32), payload}: the payload is cut to fit when shorter than the length written. */
+#define ECHO_SENT                       0x01                                        /**< {ECHO_SENT, sequence, send ticks (uint32)}: the answer with that sequence number was reported sent. */
+#define ECHO_HEADER_LEN                 (3 + sizeof(uint32_t))                      /**< Header of ECHO_ANSWER. */
+#define ECHO_SENT_LEN                   (2 + sizeof(uint32_t))                      /**< Length of ECHO_SENT. */
+#define TLM_INTERVAL                    APP_TIMER_TICKS(100, APP_TIMER_PRESCALER)   /**< Telemetry sampling interval while connected (100 ms). */
+#define TLM_KEY_INTERVAL                8                                           /**< A telemetry key frame every 8 frames. */
+#define STACK_CHECK_INTERVAL            APP_TIMER_TICKS(1000, APP_TIMER_PRESCALER)  /**< Interval of the stack high-water mark check (1 s). */
+
+#define RPC_PING                        0x00                                        /**< Returns its arguments. */
+#define RPC_UPTIME_GET                  0x01                                        /**< Returns the RTC1 counter (uint32). */
+#define RPC_TX_STATS_GET                0x02                                        /**< {service index} -> sent, queued, deferred, dropped (uint32). */
+#define RPC_ARQ_WINDOW_SET              0x03                                        /**< {window} sets the window of the reliable UART stream, as RPC_CFG_SET of CUS_CFG_ARQ_WINDOW. */
+#define RPC_ARQ_STATS_GET               0x04                                        /**< Returns sent, retransmitted, acked, timeouts of the UART stream (uint32). */
+#define RPC_CFG_GET                     0x05                                        /**< {parameter} -> value (int32). */
+#define RPC_CFG_SET                     0x06                                        /**< {parameter, value (int32)} repeated, checked and applied together. */
+#define RPC_CFG_SAVE                    0x07                                        /**< Saves the current configuration to flash, answers when written. */
+#define RPC_CFG_DEFAULTS                0x08                                        /**< Goes back to the default configuration (flash is not changed). */
+#define RPC_OBJ_STATS_GET               0x09                                        /**< Returns objects, failed, size and RTC1 ticks of the last object (uint32). */
+#define RPC_TLM_STATS_GET               0x0A                                        /**< Returns the telemetry samples, frames, key frames and lost frames (uint32). */
+#define RPC_LAT_GET                     0x0B                                        /**< {[reset]} -> count, p50, p99, max of the UART to TX complete latency (uint32, RTC1 ticks), then clears it if reset is 1. */
+#define RPC_EVTCAP_DUMP                 0x0C                                        /**< Returns records, bytes, overwritten, missed (uint32) of the event capture, then dumps it on the UART. */
+#define RPC_STACK_GET                   0x0D                                        /**< Returns size, peak, thread and handler use of the stack (uint32, bytes), see cus_stack_stats_t. */
+#define RPC_CFG_ENTRY_LEN               5                                           /**< Length of one {parameter, value} of RPC_CFG_SET. */
+#define CUS2_REC_TIMEOUT                APP_TIMER_TICKS(500, APP_TIMER_PRESCALER)   /**< Time without any confirmation after which the reliable records of Service 2 are sent again (500 ms). */
+#define CUS2_WRITE_VALUE_MAX_LEN        128                                         /**< Largest configuration blob the peer can write to Service 2 with a queued (long) write. */
+
+// app_ram.h is read by the linker too, so it restates these.
+STATIC_ASSERT(APP_ATTR_TAB_SIZE_SD_DEFAULT == BLE_GATTS_ATTR_TAB_SIZE_DEFAULT);
+STATIC_ASSERT(APP_ATTR_TAB_SIZE_SD_MIN == BLE_GATTS_ATTR_TAB_SIZE_MIN);
+STATIC_ASSERT(APP_CHAR_LEN == BLE_CUSTOM_MAX_DATA_LEN);
+STATIC_ASSERT((APP_ATTR_TAB_SIZE % 4) == 0);
+// Until checked, the RAM start of app_ram_base.h must hold what the SoftDevice is given.
+STATIC_ASSERT((APP_RAM_CHECK == 2) || ((APP_ATTR_TAB_SIZE_ENABLE <= APP_ATTR_TAB_SIZE_SD_DEFAULT) &&
+                                       (APP_VS_UUID_COUNT <= APP_VS_UUID_COUNT_SD_DEFAULT)));
 
 static ble_cus_t                        m_cus;                                      
 static ble_cus_t                        m_cus2; 
+static cus_arq_t                        m_arq;                                      /**< Reliable UART stream over Service 1. */
+#if CUS_LZ_ENABLED
+static cus_lz_t                         m_lz;                                       /**< Compressor of the UART stream. */
+static uint8_t                          m_uart_line[CUS_LZ_LINE_SIZE];              /**< UART bytes waiting to be compressed. */
+#endif
+static cus_mux_t                        m_mux;                                      /**< Logical channels over Service 2. */
+static cus_rpc_t                        m_rpc;                                      /**< Calls over channel CUS2_CH_RPC. */
+static uint8_t                          m_cus_read_value[CUS_READ_VALUE_MAX_LEN];   /**< Application-owned value of the READ characteristic of Service 1. */
+static uint8_t                          m_cus2_read_value[CUS2_DIAG_LEN];           /**< Application-owned value of the READ characteristic of Service 2. */
+static uint8_t                          m_cus2_write_value[CUS2_WRITE_VALUE_MAX_LEN]; /**< Application-owned value of the WRITE characteristic of Service 2, assembled by the SoftDevice on queued writes. */
 static uint16_t                         m_conn_handle = BLE_CONN_HANDLE_INVALID;    /**< Handle of the current connection. */
+static uint8_t                          m_cfg_save_id;                              /**< Id of the RPC_CFG_SAVE call waiting for the end of the flash write. */
+static cus_tlm_t                        m_tlm;                                      /**< Telemetry over channel CUS2_CH_TLM. */
+static uint32_t                         m_uart_rx_bytes;                            /**< Bytes received on the UART, sampled by the telemetry. */
+#if !CUS_LZ_ENABLED
+static uint8_t                        * m_uart_frame;                               /**< Frame of the reliable UART stream being filled, NULL if none. */
+#endif
+static uint8_t                          m_uart_len;                                 /**< UART bytes collected and not sent yet. */
+static volatile bool                    m_tx_sync;                                  /**< UART lines are batched until the next connection event. */
+static uint32_t                         m_uart_stamp;                               /**< RTC1 counter when the oldest UART byte not sent yet was received. */
+static uint32_t                         m_evt_ticks;                                /**< RTC1 counter when ble_evt_dispatch received the event being handled. */
+static uint8_t                          m_echo_seq;                                 /**< Sequence number of the next echo answer. */
+static volatile uint8_t                 m_uart_tx_empty_count;                      /**< Times the UART TX buffer was drained (APP_UART_TX_EMPTY). */
+static cus_lat_t                        m_lat;                                      /**< Time from UART reception to TX complete of the UART stream, in RTC1 ticks. */
+APP_TIMER_DEF(m_tlm_timer_id);                                                      /**< Telemetry sampling timer. */
+#if CUS_STACK_ENABLED
+APP_TIMER_DEF(m_stack_timer_id);                                                    /**< Stack high-water mark check timer. */
+#endif
+
+/**@brief Fields of a telemetry sample. */
+enum
+{
+    TLM_FIELD_TEMP,                                                                 /**< Die temperature, in 0.25 degree C. */
+    TLM_FIELD_RSSI,                                                                 /**< RSSI of the connection, in dBm. */
+    TLM_FIELD_UART_RX,                                                              /**< Bytes received on the UART since reset. */
+    TLM_FIELD_COUNT
+};
+
+static const int32_t                    m_cfg_defaults[CUS_CFG_PARAM_COUNT] =       /**< Configuration used until another one is saved. */
+{
+    [CUS_CFG_MIN_CONN_INTERVAL] = MIN_CONN_INTERVAL,
+    [CUS_CFG_MAX_CONN_INTERVAL] = MAX_CONN_INTERVAL,
+    [CUS_CFG_SLAVE_LATENCY]     = SLAVE_LATENCY,
+    [CUS_CFG_CONN_SUP_TIMEOUT]  = CONN_SUP_TIMEOUT,
+    [CUS_CFG_ADV_INTERVAL]      = APP_ADV_INTERVAL,
+    [CUS_CFG_ADV_TIMEOUT]       = APP_ADV_TIMEOUT_IN_SECONDS,
+    [CUS_CFG_UART_BAUDRATE]     = UART_BAUDRATE,
+    [CUS_CFG_TX_POWER]          = TX_POWER,
+    [CUS_CFG_ARQ_WINDOW]        = CUS_ARQ_WINDOW,
+    [CUS_CFG_TX_QUEUE_LIMIT]    = CUS_TX_QUEUE_SIZE,
+    [CUS_CFG_TX_SYNC]           = TX_SYNC,
+};
 
 static ble_uuid_t                       m_adv_uuids[] = {{BLE_UUID_CUSTOM_SERVICE, CUS_SERVICE_UUID_TYPE},
 																												 {BLE_UUID_CUSTOM_SERVICE_2, CUS_SERVICE_UUID_TYPE}
@@ -72,6 +189,18 @@ void assert_nrf_callback(uint16_t line_num, const uint8_t * p_file_name)
 }
 
 
+/**@brief Function for getting the preferred connection parameters from the configuration. */
+static void conn_params_get(ble_gap_conn_params_t * p_conn_params)
+{
+    memset(p_conn_params, 0, sizeof(*p_conn_params));
+
+    p_conn_params->min_conn_interval = (uint16_t)cus_cfg_get(CUS_CFG_MIN_CONN_INTERVAL);
+    p_conn_params->max_conn_interval = (uint16_t)cus_cfg_get(CUS_CFG_MAX_CONN_INTERVAL);
+    p_conn_params->slave_latency     = (uint16_t)cus_cfg_get(CUS_CFG_SLAVE_LATENCY);
+    p_conn_params->conn_sup_timeout  = (uint16_t)cus_cfg_get(CUS_CFG_CONN_SUP_TIMEOUT);
+}
+
+
 /**@brief Function for the GAP initialization.
  *
  * @details This function will set up all the necessary GAP (Generic Access Profile) parameters of
@@ -90,15 +219,45 @@ static void gap_params_init(void)
                                           strlen(DEVICE_NAME));
     APP_ERROR_CHECK(err_code);
 
-    memset(&gap_conn_params, 0, sizeof(gap_conn_params));
-
-    gap_conn_params.min_conn_interval = MIN_CONN_INTERVAL;
-    gap_conn_params.max_conn_interval = MAX_CONN_INTERVAL;
-    gap_conn_params.slave_latency     = SLAVE_LATENCY;
-    gap_conn_params.conn_sup_timeout  = CONN_SUP_TIMEOUT;
+    conn_params_get(&gap_conn_params);
 
     err_code = sd_ble_gap_ppcp_set(&gap_conn_params);
     APP_ERROR_CHECK(err_code);
+
+    err_code = sd_ble_gap_tx_power_set((int8_t)cus_cfg_get(CUS_CFG_TX_POWER));
+    APP_ERROR_CHECK(err_code);
+}
+
+
+/**@brief Function for printing a line written by the peer on the UART.
+ *
+ * @details Runs in the SoftDevice event handler, at the priority of the UART interrupt, so waiting
+ *          for room in the TX buffer would never end. What does not fit is dropped and traced.
+ *
+ * @param[in] service  Service of the line, for the trace.
+ * @param[in] p_data   Line, without CR LF.
+ * @param[in] length   Length of the line.
+ */
+static void console_put(uint8_t service, uint8_t const * p_data, uint16_t length)
+{
+		uint16_t sent = 0;
+		
+		while ((sent < length) && (app_uart_put(p_data[sent]) == NRF_SUCCESS))
+		{
+				sent++;
+		}
+		if ((sent == length) && (app_uart_put('\r') == NRF_SUCCESS))
+		{
+				sent++;
+				if (app_uart_put('\n') == NRF_SUCCESS)
+				{
+						sent++;
+				}
+		}
+		if (sent < length + 2)
+		{
+				CUS_TRACE(CUS_TRACE_CONSOLE_LOST, service, length + 2 - sent);
+		}
 }
 
 
@@ -114,24 +273,69 @@ static void gap_params_init(void)
 /**@snippet [Handling the data received over BLE] */
 static void cus_data_handler(ble_cus_t * p_cus, uint8_t * p_data, uint16_t length)
 {
-		printf("Service 1: \r\n");
-    for (uint32_t i = 0; i < length; i++)
-    {
-        while (app_uart_put(p_data[i]) != NRF_SUCCESS);
-    }
-    while (app_uart_put('\r') != NRF_SUCCESS);
-    while (app_uart_put('\n') != NRF_SUCCESS);
+		CUS_PROF_BEGIN(CUS_PROF_DATA);
+		
+		// Every write carries the acknowledgement of the UART stream, followed by the data.
+		if ((cus_arq_on_write(&m_arq, &p_data, &length) == NRF_SUCCESS) && (length > 0))
+		{
+				CUS_TRACE(CUS_TRACE_CONSOLE, 1, length);
+				console_put(1, p_data, length);
+		}
+		
+		CUS_PROF_END(CUS_PROF_DATA);
 }
 
 static void cus_data_handler2(ble_cus_t * p_cus, uint8_t * p_data, uint16_t length)
 {
-		printf("Service 2: \r\n");
-    for (uint32_t i = 0; i < length; i++)
-    {
-        while (app_uart_put(p_data[i]) != NRF_SUCCESS);
-    }
-    while (app_uart_put('\r') != NRF_SUCCESS);
-    while (app_uart_put('\n') != NRF_SUCCESS);
+		CUS_PROF_BEGIN(CUS_PROF_DATA2);
+		
+		// Every write to Service 2 is a frame for one of its channels.
+		cus_mux_on_write(&m_mux, p_data, length);
+		
+		CUS_PROF_END(CUS_PROF_DATA2);
+}
+
+static void console_channel_handler(cus_mux_t * p_mux, uint8_t channel, void * p_context, uint8_t * p_data, uint16_t length)
+{
+		CUS_TRACE(CUS_TRACE_CONSOLE, 2, length);
+		console_put(2, p_data, length);
+}
+
+/**@brief Function for returning a frame of the echo channel at once.
+ *
+ * @details The answer carries the RTC1 ticks at which the write entered ble_evt_dispatch. When it
+ *          was sent is only known at BLE_EVT_TX_COMPLETE: the packet is stamped with its sequence
+ *          number and @ref echo_sent reports it. The peer can then tell the time the frame spent
+ *          in the device from the air time of the round trip.
+ */
+static void echo_channel_handler(cus_mux_t * p_mux, uint8_t channel, void * p_context, uint8_t * p_data, uint16_t length)
+{
+		uint8_t frame[CUS_MUX_MAX_DATA_LEN];
+		uint8_t len = MIN(length, sizeof(frame) - ECHO_HEADER_LEN);
+		
+		frame[0] = ECHO_ANSWER;
+		frame[1] = m_echo_seq;
+		frame[2] = (uint8_t)MIN(length, UINT8_MAX);
+		UNUSED_RETURN_VALUE(uint32_encode(m_evt_ticks, &frame[3]));
+		memcpy(&frame[ECHO_HEADER_LEN], p_data, len);
+		
+		cus_tx_stamp_next(m_cus2.tx_id, m_echo_seq++);
+		UNUSED_RETURN_VALUE(cus_mux_send(p_mux, channel, frame, ECHO_HEADER_LEN + len));
+}
+
+/**@brief Function for reporting an echo answer sent by the SoftDevice.
+ *
+ * @param[in] seq  Sequence number of the answer.
+ */
+static void echo_sent(uint8_t seq)
+{
+		uint8_t frame[ECHO_SENT_LEN];
+		
+		frame[0] = ECHO_SENT;
+		frame[1] = seq;
+		UNUSED_RETURN_VALUE(uint32_encode(m_evt_ticks, &frame[2]));
+		
+		UNUSED_RETURN_VALUE(cus_mux_send(&m_mux, CUS2_CH_ECHO, frame, sizeof(frame)));
 }
 
 
@@ -140,9 +344,353 @@ static void cus_data_handler2(ble_cus_t * p_cus, uint8_t * p_data, uint16_t leng
 /**@snippet [Handling the data received over BLE] */
 
 uint8_t flag = 0;
-// Prepare the response.
-char data[21];
-ble_gatts_rw_authorize_reply_params_t auth_reply = {0};
+
+/**@brief Function for taking a telemetry sample, while connected.
+ */
+static void tlm_timeout_handler(void * p_context)
+{
+		int32_t values[TLM_FIELD_COUNT];
+		int32_t temp = 0;
+		int8_t  rssi = 0;
+		
+		UNUSED_RETURN_VALUE(sd_temp_get(&temp));
+		UNUSED_RETURN_VALUE(sd_ble_gap_rssi_get(m_conn_handle, &rssi));
+		
+		values[TLM_FIELD_TEMP]    = temp;
+		values[TLM_FIELD_RSSI]    = rssi;
+		values[TLM_FIELD_UART_RX] = (int32_t)m_uart_rx_bytes;
+		
+		cus_tlm_put(&m_tlm, values);
+}
+
+/**@brief Function for updating the diagnostics snapshot returned by the READ characteristic of Service 2.
+ *
+ * @details Little-endian fields: RTC1 counter (uint32), sent, queued, deferred and dropped
+ *          TX counters of Service 1 followed by those of Service 2 (uint32), then the queued write
+ *          pool counters: requests, rejected (uint32), bytes and blocks high-water marks (uint16).
+ *          With CUS_STACK_ENABLED, followed by the stack use (see cus_stack_encode), then with
+ *          CUS_PROF_ENABLED, by the execution time histograms (see cus_prof_encode).
+ */
+static void diag_snapshot_update(void)
+{
+		uint8_t        snapshot[CUS2_DIAG_LEN];
+		uint16_t       len = 0;
+		uint32_t       ticks;
+		cus_tx_stats_t stats;
+		cus_qwr_stats_t qwr_stats;
+		ble_cus_t    * p_services[] = {&m_cus, &m_cus2};
+
+		UNUSED_RETURN_VALUE(app_timer_cnt_get(&ticks));
+		len += uint32_encode(ticks, &snapshot[len]);
+	
+		for (uint32_t i = 0; i < sizeof(p_services) / sizeof(p_services[0]); i++)
+		{
+				memset(&stats, 0, sizeof(stats));
+				UNUSED_RETURN_VALUE(ble_cus_tx_stats_get(p_services[i], &stats));
+				len += uint32_encode(stats.sent,     &snapshot[len]);
+				len += uint32_encode(stats.queued,   &snapshot[len]);
+				len += uint32_encode(stats.deferred, &snapshot[len]);
+				len += uint32_encode(stats.dropped,  &snapshot[len]);
+		}
+		
+		cus_qwr_stats_get(&qwr_stats);
+		len += uint32_encode(qwr_stats.requests,   &snapshot[len]);
+		len += uint32_encode(qwr_stats.rejected,   &snapshot[len]);
+		len += uint16_encode(qwr_stats.bytes_hwm,  &snapshot[len]);
+		len += uint16_encode(qwr_stats.blocks_hwm, &snapshot[len]);
+#if CUS_STACK_ENABLED
+		UNUSED_RETURN_VALUE(cus_stack_check());
+		len += cus_stack_encode(&snapshot[len]);
+#endif
+#if CUS_PROF_ENABLED
+		len += cus_prof_encode(&snapshot[len]);
+#endif
+
+		// Same length as the buffer backing the characteristic: copied in place, no SoftDevice call.
+		UNUSED_RETURN_VALUE(ble_cus_read_value_set(&m_cus2, snapshot, len));
+}
+
+/**@brief Function for handling a stamped packet reported sent by the SoftDevice.
+ *
+ * @param[in] id     Sender of the packet.
+ * @param[in] stamp  On Service 1, RTC1 counter when the oldest byte of the UART frame was received.
+ *                   On Service 2, sequence number of the echo answer.
+ */
+static void tx_complete_handler(uint8_t id, uint32_t stamp)
+{
+		uint32_t now;
+		uint32_t ticks;
+		
+		if (id == m_cus2.tx_id)
+		{
+				echo_sent((uint8_t)stamp);
+				return;
+		}
+		
+		UNUSED_RETURN_VALUE(app_timer_cnt_get(&now));
+		UNUSED_RETURN_VALUE(app_timer_cnt_diff_compute(now, stamp, &ticks));
+		cus_lat_record(&m_lat, ticks);
+}
+
+#if CUS_TRACE_ENABLED
+// The dump goes into the trace ring at once, on top of the entries of the disconnection.
+STATIC_ASSERT(CUS_TRACE_SIZE >= 2 * (2 + CUS_LAT_BUCKETS));
+#endif
+
+/**@brief Function for dumping the UART latency histogram to the trace, in RTC1 ticks. */
+static void lat_dump(void)
+{
+		cus_lat_summary_t summary;
+		uint32_t          low;
+		uint32_t          high;
+		
+		cus_lat_summary_get(&m_lat, &summary);
+		CUS_TRACE(CUS_TRACE_LAT_PERCENTILES, MIN(summary.p50, UINT16_MAX), MIN(summary.p99, UINT16_MAX));
+		CUS_TRACE(CUS_TRACE_LAT_MAX, MIN(summary.max, UINT16_MAX), summary.count);
+		
+		for (uint8_t i = 0; i < CUS_LAT_BUCKETS; i++)
+		{
+				if (m_lat.buckets[i] != 0)
+				{
+						cus_lat_bucket_range(i, &low, &high);
+						CUS_TRACE(CUS_TRACE_LAT_BUCKET, MIN(low, UINT16_MAX), m_lat.buckets[i]);
+				}
+		}
+}
+
+/**@brief RPC methods. All of them answer at once, except RPC_CFG_SAVE, which answers once the
+ *        configuration is written to flash. */
+static uint8_t rpc_ping(cus_rpc_t * p_rpc, uint8_t id, uint8_t const * p_args, uint16_t args_len,
+                        uint8_t * p_result, uint16_t * p_result_len)
+{
+		*p_result_len = MIN(args_len, CUS_RPC_MAX_RESULT_LEN);
+		memcpy(p_result, p_args, *p_result_len);
+		return CUS_RPC_STATUS_OK;
+}
+
+static uint8_t rpc_uptime_get(cus_rpc_t * p_rpc, uint8_t id, uint8_t const * p_args, uint16_t args_len,
+                              uint8_t * p_result, uint16_t * p_result_len)
+{
+		uint32_t ticks;
+		
+		UNUSED_RETURN_VALUE(app_timer_cnt_get(&ticks));
+		*p_result_len = uint32_encode(ticks, p_result);
+		return CUS_RPC_STATUS_OK;
+}
+
+static uint8_t rpc_tx_stats_get(cus_rpc_t * p_rpc, uint8_t id, uint8_t const * p_args, uint16_t args_len,
+                                uint8_t * p_result, uint16_t * p_result_len)
+{
+		cus_tx_stats_t stats;
+		
+		if ((args_len != 1) || (p_args[0] > 1))
+		{
+				return CUS_RPC_STATUS_INVALID_ARGS;
+		}
+		if (ble_cus_tx_stats_get((p_args[0] == 0) ? &m_cus : &m_cus2, &stats) != NRF_SUCCESS)
+		{
+				return CUS_RPC_STATUS_FAILED;
+		}
+		*p_result_len  = uint32_encode(stats.sent,     &p_result[0]);
+		*p_result_len += uint32_encode(stats.queued,   &p_result[4]);
+		*p_result_len += uint32_encode(stats.deferred, &p_result[8]);
+		*p_result_len += uint32_encode(stats.dropped,  &p_result[12]);
+		return CUS_RPC_STATUS_OK;
+}
+
+static uint8_t rpc_arq_window_set(cus_rpc_t * p_rpc, uint8_t id, uint8_t const * p_args, uint16_t args_len,
+                                  uint8_t * p_result, uint16_t * p_result_len)
+{
+		cus_cfg_entry_t entry;
+		
+		if (args_len != 1)
+		{
+				return CUS_RPC_STATUS_INVALID_ARGS;
+		}
+		// Through the configuration, so that RPC_CFG_GET and RPC_CFG_SAVE see the new window. Applied
+		// from cfg_evt_handler.
+		entry.param = CUS_CFG_ARQ_WINDOW;
+		entry.value = p_args[0];
+		if (cus_cfg_set(&entry, 1) != NRF_SUCCESS)
+		{
+				return CUS_RPC_STATUS_INVALID_ARGS;
+		}
+		return CUS_RPC_STATUS_OK;
+}
+
+static uint8_t rpc_arq_stats_get(cus_rpc_t * p_rpc, uint8_t id, uint8_t const * p_args, uint16_t args_len,
+                                 uint8_t * p_result, uint16_t * p_result_len)
+{
+		cus_arq_stats_t stats;
+		
+		cus_arq_stats_get(&m_arq, &stats);
+		*p_result_len  = uint32_encode(stats.sent,          &p_result[0]);
+		*p_result_len += uint32_encode(stats.retransmitted, &p_result[4]);
+		*p_result_len += uint32_encode(stats.acked,         &p_result[8]);
+		*p_result_len += uint32_encode(stats.timeouts,      &p_result[12]);
+		return CUS_RPC_STATUS_OK;
+}
+
+static uint8_t rpc_cfg_get(cus_rpc_t * p_rpc, uint8_t id, uint8_t const * p_args, uint16_t args_len,
+                           uint8_t * p_result, uint16_t * p_result_len)
+{
+		if ((args_len != 1) || (p_args[0] >= CUS_CFG_PARAM_COUNT))
+		{
+				return CUS_RPC_STATUS_INVALID_ARGS;
+		}
+		*p_result_len = uint32_encode((uint32_t)cus_cfg_get((cus_cfg_param_t)p_args[0]), p_result);
+		return CUS_RPC_STATUS_OK;
+}
+
+static uint8_t rpc_cfg_set(cus_rpc_t * p_rpc, uint8_t id, uint8_t const * p_args, uint16_t args_len,
+                           uint8_t * p_result, uint16_t * p_result_len)
+{
+		cus_cfg_entry_t entries[CUS_CFG_PARAM_COUNT];
+		uint8_t         count = args_len / RPC_CFG_ENTRY_LEN;
+		
+		if ((args_len == 0) || ((args_len % RPC_CFG_ENTRY_LEN) != 0) || (count > CUS_CFG_PARAM_COUNT))
+		{
+				return CUS_RPC_STATUS_INVALID_ARGS;
+		}
+		for (uint8_t i = 0; i < count; i++)
+		{
+				entries[i].param = p_args[i * RPC_CFG_ENTRY_LEN];
+				entries[i].value = (int32_t)uint32_decode(&p_args[i * RPC_CFG_ENTRY_LEN + 1]);
+		}
+		// Applied from cfg_evt_handler before the answer is sent.
+		if (cus_cfg_set(entries, count) != NRF_SUCCESS)
+		{
+				return CUS_RPC_STATUS_INVALID_ARGS;
+		}
+		return CUS_RPC_STATUS_OK;
+}
+
+static uint8_t rpc_cfg_save(cus_rpc_t * p_rpc, uint8_t id, uint8_t const * p_args, uint16_t args_len,
+                            uint8_t * p_result, uint16_t * p_result_len)
+{
+		uint32_t err_code = cus_cfg_save();
+		
+		if (err_code == NRF_ERROR_BUSY)
+		{
+				return CUS_RPC_STATUS_BUSY;
+		}
+		if (err_code != NRF_SUCCESS)
+		{
+				return CUS_RPC_STATUS_FAILED;
+		}
+		// Answered from cfg_evt_handler once the page is written.
+		m_cfg_save_id = id;
+		return CUS_RPC_STATUS_PENDING;
+}
+
+static uint8_t rpc_cfg_defaults(cus_rpc_t * p_rpc, uint8_t id, uint8_t const * p_args, uint16_t args_len,
+                                uint8_t * p_result, uint16_t * p_result_len)
+{
+		cus_cfg_defaults_restore();
+		return CUS_RPC_STATUS_OK;
+}
+
+static uint8_t rpc_obj_stats_get(cus_rpc_t * p_rpc, uint8_t id, uint8_t const * p_args, uint16_t args_len,
+                                 uint8_t * p_result, uint16_t * p_result_len)
+{
+		cus_obj_stats_t stats;
+		
+		cus_obj_stats_get(&stats);
+		*p_result_len  = uint32_encode(stats.objects,    &p_result[0]);
+		*p_result_len += uint32_encode(stats.failed,     &p_result[4]);
+		*p_result_len += uint32_encode(stats.last_size,  &p_result[8]);
+		*p_result_len += uint32_encode(stats.last_ticks, &p_result[12]);
+		return CUS_RPC_STATUS_OK;
+}
+
+static uint8_t rpc_tlm_stats_get(cus_rpc_t * p_rpc, uint8_t id, uint8_t const * p_args, uint16_t args_len,
+                                 uint8_t * p_result, uint16_t * p_result_len)
+{
+		*p_result_len  = uint32_encode(m_tlm.stats.samples,    &p_result[0]);
+		*p_result_len += uint32_encode(m_tlm.stats.frames,     &p_result[4]);
+		*p_result_len += uint32_encode(m_tlm.stats.key_frames, &p_result[8]);
+		*p_result_len += uint32_encode(m_tlm.stats.lost,       &p_result[12]);
+		return CUS_RPC_STATUS_OK;
+}
+
+static uint8_t rpc_lat_get(cus_rpc_t * p_rpc, uint8_t id, uint8_t const * p_args, uint16_t args_len,
+                           uint8_t * p_result, uint16_t * p_result_len)
+{
+		cus_lat_summary_t summary;
+		
+		if ((args_len > 1) || ((args_len == 1) && (p_args[0] > 1)))
+		{
+				return CUS_RPC_STATUS_INVALID_ARGS;
+		}
+		
+		cus_lat_summary_get(&m_lat, &summary);
+		*p_result_len  = uint32_encode(summary.count, &p_result[0]);
+		*p_result_len += uint32_encode(summary.p50,   &p_result[4]);
+		*p_result_len += uint32_encode(summary.p99,   &p_result[8]);
+		*p_result_len += uint32_encode(summary.max,   &p_result[12]);
+		
+		if ((args_len == 1) && (p_args[0] == 1))
+		{
+				cus_lat_reset(&m_lat);
+		}
+		return CUS_RPC_STATUS_OK;
+}
+
+#if CUS_EVTCAP_ENABLED
+static uint8_t rpc_evtcap_dump(cus_rpc_t * p_rpc, uint8_t id, uint8_t const * p_args, uint16_t args_len,
+                               uint8_t * p_result, uint16_t * p_result_len)
+{
+		cus_evtcap_stats_t stats;
+		
+		if (cus_evtcap_dump_start(&stats) != NRF_SUCCESS)
+		{
+				return CUS_RPC_STATUS_BUSY;
+		}
+		*p_result_len  = uint32_encode(stats.records,     &p_result[0]);
+		*p_result_len += uint32_encode(stats.bytes,       &p_result[4]);
+		*p_result_len += uint32_encode(stats.overwritten, &p_result[8]);
+		*p_result_len += uint32_encode(stats.missed,      &p_result[12]);
+		return CUS_RPC_STATUS_OK;
+}
+#endif
+
+#if CUS_STACK_ENABLED
+static uint8_t rpc_stack_get(cus_rpc_t * p_rpc, uint8_t id, uint8_t const * p_args, uint16_t args_len,
+                             uint8_t * p_result, uint16_t * p_result_len)
+{
+		cus_stack_stats_t stats;
+		
+		UNUSED_RETURN_VALUE(cus_stack_check());
+		cus_stack_stats_get(&stats);
+		*p_result_len  = uint32_encode(stats.size,    &p_result[0]);
+		*p_result_len += uint32_encode(stats.peak,    &p_result[4]);
+		*p_result_len += uint32_encode(stats.thread,  &p_result[8]);
+		*p_result_len += uint32_encode(stats.handler, &p_result[12]);
+		return CUS_RPC_STATUS_OK;
+}
+#endif
+
+static const cus_rpc_method_t m_rpc_methods[] =
+{
+		{RPC_PING,           rpc_ping},
+		{RPC_UPTIME_GET,     rpc_uptime_get},
+		{RPC_TX_STATS_GET,   rpc_tx_stats_get},
+		{RPC_ARQ_WINDOW_SET, rpc_arq_window_set},
+		{RPC_ARQ_STATS_GET,  rpc_arq_stats_get},
+		{RPC_CFG_GET,        rpc_cfg_get},
+		{RPC_CFG_SET,        rpc_cfg_set},
+		{RPC_CFG_SAVE,       rpc_cfg_save},
+		{RPC_CFG_DEFAULTS,   rpc_cfg_defaults},
+		{RPC_OBJ_STATS_GET,  rpc_obj_stats_get},
+		{RPC_TLM_STATS_GET,  rpc_tlm_stats_get},
+		{RPC_LAT_GET,        rpc_lat_get},
+#if CUS_EVTCAP_ENABLED
+		{RPC_EVTCAP_DUMP,    rpc_evtcap_dump},
+#endif
+#if CUS_STACK_ENABLED
+		{RPC_STACK_GET,      rpc_stack_get},
+#endif
+};
 
 /**@brief Function for handling the Custom Service Service events.
  *
@@ -159,35 +707,27 @@ static void on_cus_evt_handler(ble_cus_t   *p_cus_service, ble_cus_evt_t   *p_ev
     switch(p_evt->evt_type)
     {
         case BLE_CUS_EVT_NOTIFICATION_ENABLED:
-						printf("BLE_CUS_EVT_NOTIFICATION_ENABLED\r\n");
+						CUS_TRACE(CUS_TRACE_NOTIF_ENABLED, 1, 0);
 						flag = 1;
             break;
 
         case BLE_CUS_EVT_NOTIFICATION_DISABLED:
-						printf("BLE_CUS_EVT_NOTIFICATION_DISABLED\r\n");
+						CUS_TRACE(CUS_TRACE_NOTIF_DISABLED, 1, 0);
 						flag = 0;
             break;
 
         case BLE_CUS_EVT_CONNECTED :
-						printf("BLE_CUS_EVT_CONNECTED\r\n");
+						CUS_TRACE(CUS_TRACE_CONNECTED, 1, 0);
             break;
 
         case BLE_CUS_EVT_DISCONNECTED:
-						printf("BLE_CUS_EVT_DISCONNECTED\r\n");
+						CUS_TRACE(CUS_TRACE_DISCONNECTED, 1, 0);
             break;
 
 				case BLE_CUS_EVT_READ:
-						printf("BLE_CUS_EVT_READ\r\n");
-						memset(data, 0, 21);
-
-						sprintf(data, "%s", "Truong Bach Khoa");
-				
-						auth_reply.type = BLE_GATTS_AUTHORIZE_TYPE_READ;
-						auth_reply.params.read.gatt_status = BLE_GATT_STATUS_SUCCESS;
-						auth_reply.params.read.update = 0x01;
-						auth_reply.params.read.len = strlen((char *)data);
-						auth_reply.params.read.p_data = (uint8_t*)data;
-						sd_ble_gatts_rw_authorize_reply(p_cus_service->conn_handle,&auth_reply);
+						CUS_TRACE(CUS_TRACE_READ, 1, 0);
+						// The value is kept up to date in the application buffer, return it without copy.
+						ble_cus_read_reply(p_cus_service, NULL, 0);
             break;
 				
         default:
@@ -202,35 +742,29 @@ static void on_cus_evt_handler2(ble_cus_t   *p_cus_service, ble_cus_evt_t   *p_e
     switch(p_evt->evt_type)
     {
         case BLE_CUS_EVT_NOTIFICATION_ENABLED:
-						printf("BLE_CUS_EVT_NOTIFICATION_ENABLED 2 \r\n");
+						CUS_TRACE(CUS_TRACE_NOTIF_ENABLED, 2, 0);
 						flag = 1;
             break;
 
         case BLE_CUS_EVT_NOTIFICATION_DISABLED:
-						printf("BLE_CUS_EVT_NOTIFICATION_DISABLED 2\r\n");
+						CUS_TRACE(CUS_TRACE_NOTIF_DISABLED, 2, 0);
 						flag = 0;
             break;
 
         case BLE_CUS_EVT_CONNECTED :
-						printf("BLE_CUS_EVT_CONNECTED 2\r\n");
+						CUS_TRACE(CUS_TRACE_CONNECTED, 2, 0);
             break;
 
         case BLE_CUS_EVT_DISCONNECTED:
-						printf("BLE_CUS_EVT_DISCONNECTED 2\r\n");
+						CUS_TRACE(CUS_TRACE_DISCONNECTED, 2, 0);
             break;
 
 				case BLE_CUS_EVT_READ:
-						printf("BLE_CUS_EVT_READ\r\n");
-						memset(data, 0, 21);
-
-						sprintf(data, "%s", "Dang Khoa");
-				
-						auth_reply.type = BLE_GATTS_AUTHORIZE_TYPE_READ;
-						auth_reply.params.read.gatt_status = BLE_GATT_STATUS_SUCCESS;
-						auth_reply.params.read.update = 0x01;
-						auth_reply.params.read.len = strlen((char *)data);
-						auth_reply.params.read.p_data = (uint8_t*)data;
-						sd_ble_gatts_rw_authorize_reply(p_cus_service->conn_handle,&auth_reply);
+						CUS_TRACE(CUS_TRACE_READ, 2, 0);
+						// Take a fresh snapshot for this read; the Read Blob requests that follow are
+						// answered by the service from the same snapshot.
+						diag_snapshot_update();
+						ble_cus_read_reply(p_cus_service, NULL, 0);
             break;
 				
         default:
@@ -241,39 +775,133 @@ static void on_cus_evt_handler2(ble_cus_t   *p_cus_service, ble_cus_evt_t   *p_e
 
 
 
+/**@brief Function for filling the settings of Service 1, the UART stream, that APP_CUS_SERVICES
+ *        does not give.
+ */
+static void service1_settings(ble_cus_init_t * p_init)
+{
+    BLE_GAP_CONN_SEC_MODE_SET_OPEN(&p_init->custom_value_char_attr_md.write_perm);
+    BLE_GAP_CONN_SEC_MODE_SET_OPEN(&p_init->custom_value_char_attr_md.read_perm); // When enabling READ properties, we must enable the READ permission, if not is error
+    p_init->data_handler     = cus_data_handler;
+    p_init->evt_handler      = on_cus_evt_handler;
+    p_init->service_uuid     = BLE_UUID_CUSTOM_SERVICE;
+    p_init->char_write_uuid  = BLE_UUID_CUSTOM_VAL_CHA_WRITE;
+    p_init->char_read_uuid   = BLE_UUID_CUSTOM_VAL_CHA_READ;
+    p_init->char_notify_uuid = BLE_UUID_CUSTOM_VAL_CHA_NOTIFY;
+    // The UART stream gets 3 packets for every packet of Service 2 when both are busy.
+    p_init->tx_weight        = 3;
+}
+
+
+/**@brief Function for filling the settings of Service 2, the channels, that APP_CUS_SERVICES
+ *        does not give.
+ */
+static void service2_settings(ble_cus_init_t * p_init)
+{
+    p_init->data_handler      = cus_data_handler2;
+    p_init->evt_handler       = on_cus_evt_handler2;
+    p_init->service_uuid      = BLE_UUID_CUSTOM_SERVICE_2;
+    p_init->char_write_uuid   = BLE_UUID_CUSTOM_VAL_CHA_WRITE_2;
+    p_init->char_read_uuid    = BLE_UUID_CUSTOM_VAL_CHA_READ_2;
+    p_init->char_notify_uuid  = BLE_UUID_CUSTOM_VAL_CHA_NOTIFY_2;
+    p_init->tx_weight         = 1;
+    p_init->rec_timeout_ticks = CUS2_REC_TIMEOUT;
+}
+
+
+/**@brief Value of a characteristic of an instance of APP_CUS_SERVICES: in the buffer of the
+ *        application, or kept by the SoftDevice if in_stack is 1. */
+#define SERVICE_VALUE_SET_0(p_value, max_len, buf)          (p_value) = (buf); (max_len) = sizeof(buf)
+#define SERVICE_VALUE_SET_1(p_value, max_len, buf)
+#define SERVICE_VALUE_SET(in_stack, p_value, max_len, buf)  SERVICE_VALUE_SET_##in_stack(p_value, max_len, buf)
+
+/**@brief Adds an instance of APP_CUS_SERVICES. The diagnostics characteristic holds the traffic
+ *        counters of all the instances, cleared by writing to it, so at most one adds it. */
+#define SERVICE_ADD(instance, settings, write_in_stack, read_in_stack, diag)                        \
+    memset(&cus_init, 0, sizeof(cus_init));                                                         \
+    settings(&cus_init);                                                                            \
+    SERVICE_VALUE_SET(write_in_stack, cus_init.p_write_value, cus_init.write_value_max_len,         \
+                      instance##_write_value);                                                      \
+    SERVICE_VALUE_SET(read_in_stack, cus_init.p_read_value, cus_init.read_value_max_len,            \
+                      instance##_read_value);                                                       \
+    cus_init.char_diag_uuid = (diag) ? BLE_UUID_CUSTOM_VAL_CHA_DIAG_2 : 0;                          \
+    err_code = ble_cus_init(&instance, &cus_init);                                                  \
+    APP_ERROR_CHECK(err_code);
+
+
 /**@brief Function for initializing services that will be used by the application.
  */
 static void services_init(void)
 {
     uint32_t       err_code;
     ble_cus_init_t cus_init;
-		ble_cus_init_t cus_init2;
-
-		// Initialize Service 1
-    memset(&cus_init, 0, sizeof(cus_init));
-
-		BLE_GAP_CONN_SEC_MODE_SET_OPEN(&cus_init.custom_value_char_attr_md.write_perm);
-		BLE_GAP_CONN_SEC_MODE_SET_OPEN(&cus_init.custom_value_char_attr_md.read_perm); // When enabling READ properties, we must enable the READ permission, if not is error
-    cus_init.data_handler = cus_data_handler;
-		// Set the cus event handler
-    cus_init.evt_handler                = on_cus_evt_handler;
-		cus_init.service_uuid 							= BLE_UUID_CUSTOM_SERVICE;
-		cus_init.char_write_uuid									= BLE_UUID_CUSTOM_VAL_CHA_WRITE;
-		cus_init.char_read_uuid									= BLE_UUID_CUSTOM_VAL_CHA_READ;
-		cus_init.char_notify_uuid									= BLE_UUID_CUSTOM_VAL_CHA_NOTIFY;
-    err_code = ble_cus_init(&m_cus, &cus_init);
+
+		// The instances are the ones app_ram.h sizes the attribute table for.
+		APP_CUS_SERVICES(SERVICE_ADD)
+
+		err_code = ble_cus_read_value_set(&m_cus, (uint8_t const *)CUS_READ_VALUE, strlen(CUS_READ_VALUE));
+		APP_ERROR_CHECK(err_code);
+		
+		// The UART stream of Service 1 is delivered reliably.
+		cus_arq_init_t arq_init;
+		
+		memset(&arq_init, 0, sizeof(arq_init));
+		arq_init.p_cus         = &m_cus;
+		arq_init.window        = (uint8_t)cus_cfg_get(CUS_CFG_ARQ_WINDOW);
+		arq_init.timeout_ticks = CUS_ARQ_TIMEOUT;
+		err_code = cus_arq_init(&m_arq, &arq_init);
+		APP_ERROR_CHECK(err_code);
+#if CUS_LZ_ENABLED
+		cus_lz_init(&m_lz);
+#endif
+		cus_lat_reset(&m_lat);
+		cus_tx_complete_handler_set(tx_complete_handler);
 	
-		// Initialize Service 2
-		memset(&cus_init2, 0, sizeof(cus_init));
-		cus_init2.data_handler = cus_data_handler2;
-		// Set the cus event handler
-    cus_init2.evt_handler               = on_cus_evt_handler2;
-		cus_init2.service_uuid							= BLE_UUID_CUSTOM_SERVICE_2;
-		cus_init2.char_write_uuid						= BLE_UUID_CUSTOM_VAL_CHA_WRITE_2;
-		cus_init2.char_read_uuid						= BLE_UUID_CUSTOM_VAL_CHA_READ_2;
-		cus_init2.char_notify_uuid					= BLE_UUID_CUSTOM_VAL_CHA_NOTIFY_2;
-		err_code = ble_cus_init(&m_cus2, &cus_init2);
-    APP_ERROR_CHECK(err_code);
+		err_code = cus_tx_queue_limit_set(m_cus.tx_id, (uint8_t)cus_cfg_get(CUS_CFG_TX_QUEUE_LIMIT));
+		APP_ERROR_CHECK(err_code);
+		err_code = cus_tx_queue_limit_set(m_cus2.tx_id, (uint8_t)cus_cfg_get(CUS_CFG_TX_QUEUE_LIMIT));
+		APP_ERROR_CHECK(err_code);
+		
+		diag_snapshot_update();
+		
+		// Further data streams are channels of Service 2, not new services.
+		err_code = cus_mux_init(&m_mux, &m_cus2);
+		APP_ERROR_CHECK(err_code);
+		
+		err_code = cus_mux_channel_register(&m_mux, CUS2_CH_CONSOLE, console_channel_handler, NULL, CUS_TX_PRIO_BULK, false);
+		APP_ERROR_CHECK(err_code);
+		
+		err_code = cus_rpc_init(&m_rpc, &m_mux, CUS2_CH_RPC, m_rpc_methods,
+		                        sizeof(m_rpc_methods) / sizeof(m_rpc_methods[0]));
+		APP_ERROR_CHECK(err_code);
+		
+		err_code = cus_obj_init(&m_mux, CUS2_CH_OBJ);
+		APP_ERROR_CHECK(err_code);
+		
+		cus_tlm_init_t tlm_init;
+		
+		memset(&tlm_init, 0, sizeof(tlm_init));
+		tlm_init.p_mux        = &m_mux;
+		tlm_init.channel      = CUS2_CH_TLM;
+		tlm_init.field_count  = TLM_FIELD_COUNT;
+		tlm_init.key_interval = TLM_KEY_INTERVAL;
+		err_code = cus_tlm_init(&m_tlm, &tlm_init);
+		APP_ERROR_CHECK(err_code);
+		
+		err_code = cus_bench_init(&m_mux, CUS2_CH_BENCH, APP_TIMER_PRESCALER);
+		APP_ERROR_CHECK(err_code);
+		
+		// Echoes skip the bulk queues, so the round trip only waits for the next connection event.
+		err_code = cus_mux_channel_register(&m_mux, CUS2_CH_ECHO, echo_channel_handler, NULL, CUS_TX_PRIO_CONTROL, false);
+		APP_ERROR_CHECK(err_code);
+		
+		err_code = app_timer_create(&m_tlm_timer_id, APP_TIMER_MODE_REPEATED, tlm_timeout_handler);
+		APP_ERROR_CHECK(err_code);
+		
+		// The attributes of each instance are counted by app_ram.h the way ble_cus_init adds them.
+		// Checked in release builds too: the services only fail to be added when the table is too
+		// small for them, not when they were counted wrong.
+		APP_ERROR_CHECK_BOOL(ble_cus_attr_count() == APP_ATTR_COUNT);
 }
 
 
@@ -391,12 +1019,27 @@ static void on_ble_evt(ble_evt_t * p_ble_evt)
             err_code = bsp_indication_set(BSP_INDICATE_CONNECTED);
             APP_ERROR_CHECK(err_code);
             m_conn_handle = p_ble_evt->evt.gap_evt.conn_handle;
+
+            // Telemetry starts over with absolute values for the new peer.
+            cus_tlm_key_request(&m_tlm);
+            err_code = sd_ble_gap_rssi_start(m_conn_handle, BLE_GAP_RSSI_THRESHOLD_INVALID, 0);
+            APP_ERROR_CHECK(err_code);
+            err_code = app_timer_start(m_tlm_timer_id, TLM_INTERVAL, NULL);
+            APP_ERROR_CHECK(err_code);
+#if CUS_LZ_ENABLED
+            // Frames still waiting from the last connection keep the old history; a peer that
+            // lost it gets back in sync at the next line.
+            cus_lz_reset(&m_lz);
+#endif
             break; // BLE_GAP_EVT_CONNECTED
 
         case BLE_GAP_EVT_DISCONNECTED:
             err_code = bsp_indication_set(BSP_INDICATE_IDLE);
             APP_ERROR_CHECK(err_code);
             m_conn_handle = BLE_CONN_HANDLE_INVALID;
+            err_code = app_timer_stop(m_tlm_timer_id);
+            APP_ERROR_CHECK(err_code);
+            lat_dump();
             break; // BLE_GAP_EVT_DISCONNECTED
 
         case BLE_GAP_EVT_SEC_PARAMS_REQUEST:
@@ -425,11 +1068,6 @@ static void on_ble_evt(ble_evt_t * p_ble_evt)
             APP_ERROR_CHECK(err_code);
             break; // BLE_GATTS_EVT_TIMEOUT
 
-        case BLE_EVT_USER_MEM_REQUEST:
-            err_code = sd_ble_user_mem_reply(p_ble_evt->evt.gattc_evt.conn_handle, NULL);
-            APP_ERROR_CHECK(err_code);
-            break; // BLE_EVT_USER_MEM_REQUEST
-
         case BLE_GATTS_EVT_RW_AUTHORIZE_REQUEST:
         {
             ble_gatts_evt_rw_authorize_request_t  req;
@@ -437,6 +1075,7 @@ static void on_ble_evt(ble_evt_t * p_ble_evt)
 
             req = p_ble_evt->evt.gatts_evt.params.authorize_request;
 
+            // Queued writes only come here when the cus_qwr pool had no block to lend.
             if (req.type != BLE_GATTS_AUTHORIZE_TYPE_INVALID)
             {
                 if ((req.request.write.op == BLE_GATTS_OP_PREP_WRITE_REQ)     ||
@@ -476,13 +1115,35 @@ static void on_ble_evt(ble_evt_t * p_ble_evt)
  */
 static void ble_evt_dispatch(ble_evt_t * p_ble_evt)
 {
+    CUS_PROF_BEGIN(CUS_PROF_BLE_EVT);
+
+    UNUSED_RETURN_VALUE(app_timer_cnt_get(&m_evt_ticks));
+#if CUS_EVTCAP_ENABLED
+    cus_evtcap_add(p_ble_evt);
+#endif
     ble_conn_params_on_ble_evt(p_ble_evt);
+    cus_tx_on_ble_evt(p_ble_evt);
+    cus_qwr_on_ble_evt(p_ble_evt);
     ble_cus_on_ble_evt(&m_cus, p_ble_evt);
 		ble_cus_on_ble_evt(&m_cus2, p_ble_evt);
+    cus_arq_on_ble_evt(&m_arq, p_ble_evt);
+    cus_obj_on_ble_evt(p_ble_evt);
+    cus_bench_on_ble_evt(p_ble_evt);
     on_ble_evt(p_ble_evt);
     ble_advertising_on_ble_evt(p_ble_evt);
     bsp_btn_ble_on_ble_evt(p_ble_evt);
 
+    CUS_PROF_END(CUS_PROF_BLE_EVT);
+}
+
+
+/**@brief Function for dispatching a system event to the modules with a system event handler.
+ *
+ * @param[in] sys_evt  System event, such as the end of a flash operation.
+ */
+static void sys_evt_dispatch(uint32_t sys_evt)
+{
+    fs_sys_event_handler(sys_evt);
 }
 
 
@@ -505,16 +1166,35 @@ static void ble_stack_init(void)
                                                     &ble_enable_params);
     APP_ERROR_CHECK(err_code);
 
-    //Check the ram settings against the used number of links
-    CHECK_RAM_START_ADDR(CENTRAL_LINK_COUNT,PERIPHERAL_LINK_COUNT);
+    // The attribute table is sized for the services, and the RAM of the application placed after
+    // it, by app_ram.h, once the estimate is checked on a board.
+    ble_enable_params.gatts_enable_params.attr_tab_size  = APP_ATTR_TAB_SIZE_ENABLE;
+    ble_enable_params.common_enable_params.vs_uuid_count = APP_VS_UUID_COUNT;
+
+    //Check the ram settings against the used number of links and the attribute table
+    err_code = sd_check_ram_start(APP_RAM_START);
+    APP_ERROR_CHECK(err_code);
+
+    // Enable BLE stack. Same as softdevice_enable, which does not give back the start of the
+    // application RAM the SoftDevice asks for.
+    uint32_t app_ram_base = APP_RAM_START;
 
-    // Enable BLE stack.
-    err_code = softdevice_enable(&ble_enable_params);
+    err_code = sd_ble_enable(&ble_enable_params, &app_ram_base);
     APP_ERROR_CHECK(err_code);
+#if APP_RAM_CHECK == 1
+    printf("\r\nRAM: sd_ble_enable asks for 0x%08lx, app_ram.h computes 0x%08lx\r\n",
+           (unsigned long)app_ram_base, (unsigned long)APP_RAM_BASE);
+#else
+    UNUSED_VARIABLE(app_ram_base);
+#endif
 
     // Subscribe for BLE events.
     err_code = softdevice_ble_evt_handler_set(ble_evt_dispatch);
     APP_ERROR_CHECK(err_code);
+
+    // Flash operations complete with a system event.
+    err_code = softdevice_sys_evt_handler_set(sys_evt_dispatch);
+    APP_ERROR_CHECK(err_code);
 }
 
 
@@ -556,6 +1236,83 @@ void bsp_event_handler(bsp_event_t event)
 }
 
 
+#if CUS_LZ_ENABLED
+/**@brief Function for compressing a UART line into frames of the reliable UART stream.
+ *
+ * @details What does not get a frame because the window is full is dropped. It never entered the
+ *          history of the compressor, so the frames that follow still decode.
+ */
+static void uart_line_send(uint8_t const * p_line, uint16_t length, uint32_t stamp)
+{
+		uint32_t err_code;
+		uint16_t offset = 0;
+
+		while (offset < length)
+		{
+				uint8_t * p_frame = cus_arq_buf_get(&m_arq);
+				uint16_t  frame_len;
+
+				if (p_frame == NULL)
+				{
+						break;
+				}
+
+				offset += cus_lz_frame_encode(&m_lz, &p_line[offset], length - offset,
+				                              p_frame, CUS_ARQ_MAX_DATA_LEN, &frame_len);
+
+				err_code = cus_arq_buf_commit(&m_arq, frame_len, stamp);
+				APP_ERROR_CHECK(err_code);
+		}
+}
+#endif
+
+
+/**@brief Function for sending the UART bytes collected so far.
+ */
+static void uart_pending_send(void)
+{
+#if CUS_LZ_ENABLED
+		uart_line_send(m_uart_line, m_uart_len, m_uart_stamp);
+#else
+		if (m_uart_frame != NULL)
+		{
+				uint32_t err_code = cus_arq_buf_commit(&m_arq, m_uart_len, m_uart_stamp);
+				APP_ERROR_CHECK(err_code);
+				m_uart_frame = NULL;
+		}
+#endif
+		m_uart_len = 0;
+}
+
+
+/**@brief Function for sending the batched UART data just before a radio event, in sync mode.
+ *
+ * @details Runs at the priority of uart_event_handle, which it cannot interrupt.
+ */
+static void tx_sync_handler(void)
+{
+		if (m_uart_len > 0)
+		{
+				uart_pending_send();
+		}
+}
+
+
+/**@brief Function for setting up the TX sync mode.
+ *
+ * @details Radio notifications can only be configured before advertising starts, so they are
+ *          always on; the mode itself is switched at runtime through the configuration.
+ */
+static void tx_sync_init(void)
+{
+		uint32_t err_code = cus_tx_sync_init(tx_sync_handler);
+		APP_ERROR_CHECK(err_code);
+
+		m_tx_sync = (cus_cfg_get(CUS_CFG_TX_SYNC) != 0);
+		cus_tx_sync_set(m_tx_sync);
+}
+
+
 /**@brief   Function for handling app_uart events.
  *
  * @details This function will receive a single character from the app_uart module and append it to
@@ -566,28 +1323,50 @@ void bsp_event_handler(bsp_event_t event)
 /**@snippet [Handling the data received over UART] */
 void uart_event_handle(app_uart_evt_t * p_event)
 {
-    static uint8_t data_array[BLE_CUSTOM_MAX_DATA_LEN];
-    static uint8_t index = 0;
-    uint32_t       err_code;
+    uint8_t byte;
+    bool    full;
+
+    CUS_PROF_BEGIN(CUS_PROF_UART_EVT);
 
     switch (p_event->evt_type)
     {
         case APP_UART_DATA_READY:
-            UNUSED_VARIABLE(app_uart_get(&data_array[index]));
-            index++;
+            UNUSED_VARIABLE(app_uart_get(&byte));
+            m_uart_rx_bytes++;
+            if (m_uart_len == 0)
+            {
+                UNUSED_RETURN_VALUE(app_timer_cnt_get(&m_uart_stamp));
+            }
 
-            if ((data_array[index - 1] == '\n') || (index >= (BLE_CUSTOM_MAX_DATA_LEN)))
+#if CUS_LZ_ENABLED
+            m_uart_line[m_uart_len++] = byte;
+            full = (m_uart_len >= CUS_LZ_LINE_SIZE);
+#else
+            // The line is collected directly in the retransmit buffer of the reliable stream.
+            if (m_uart_frame == NULL)
             {
-                err_code = ble_cus_string_send(&m_cus, data_array, index);
-                if (err_code != NRF_ERROR_INVALID_STATE)
+                m_uart_frame = cus_arq_buf_get(&m_arq);
+                if (m_uart_frame == NULL)
                 {
-                    APP_ERROR_CHECK(err_code);
+                    // The window is full of frames the peer has not acknowledged, the byte is dropped.
+                    break;
                 }
+            }
+            m_uart_frame[m_uart_len++] = byte;
+            full = (m_uart_len >= CUS_ARQ_MAX_DATA_LEN);
+#endif
 
-                index = 0;
+            // In sync mode lines are batched, tx_sync_handler sends them before the next event.
+            if (full || ((byte == '\n') && !m_tx_sync))
+            {
+                uart_pending_send();
             }
             break;
 
+        case APP_UART_TX_EMPTY:
+            m_uart_tx_empty_count++;
+            break;
+
         case APP_UART_COMMUNICATION_ERROR:
             APP_ERROR_HANDLER(p_event->data.error_communication);
             break;
@@ -599,10 +1378,43 @@ void uart_event_handle(app_uart_evt_t * p_event)
         default:
             break;
     }
+
+    CUS_PROF_END(CUS_PROF_UART_EVT);
 }
 /**@snippet [Handling the data received over UART] */
 
 
+#if CUS_TRACE_ENABLED || CUS_EVTCAP_ENABLED
+/**@brief Function for sending a trace or capture byte on the UART, without waiting for room in the FIFO.
+ *
+ * @details Fills the TX buffer up to UART_TX_HEADROOM bytes from the end, counting its own bytes
+ *          since the buffer was last drained. A drain between the check and the write makes the
+ *          count at most one byte short.
+ */
+static bool trace_put(uint8_t byte)
+{
+		static uint8_t  tx_empty_seen;
+		static uint16_t queued;
+		
+#if CUS_STACK_ENABLED
+		// Deepest call of the main loop.
+		cus_stack_thread_sample();
+#endif
+		if (tx_empty_seen != m_uart_tx_empty_count)
+		{
+				tx_empty_seen = m_uart_tx_empty_count;
+				queued        = 0;
+		}
+		if ((queued >= (UART_TX_BUF_SIZE - UART_TX_HEADROOM)) || (app_uart_put(byte) != NRF_SUCCESS))
+		{
+				return false;
+		}
+		queued++;
+		return true;
+}
+#endif
+
+
 /**@brief  Function for initializing the UART module.
  */
 /**@snippet [UART Initialization] */
@@ -617,7 +1429,7 @@ static void uart_init(void)
         CTS_PIN_NUMBER,
         APP_UART_FLOW_CONTROL_DISABLED,
         false,
-        UART_BAUDRATE_BAUDRATE_Baud115200
+        cus_cfg_uart_baudrate_reg_get()
     };
 
     APP_UART_FIFO_INIT( &comm_params,
@@ -652,14 +1464,125 @@ static void advertising_init(void)
 
     memset(&options, 0, sizeof(options));
     options.ble_adv_fast_enabled  = true;
-    options.ble_adv_fast_interval = APP_ADV_INTERVAL;
-		options.ble_adv_fast_timeout  = APP_ADV_TIMEOUT_IN_SECONDS;
+    options.ble_adv_fast_interval = (uint32_t)cus_cfg_get(CUS_CFG_ADV_INTERVAL);
+		options.ble_adv_fast_timeout  = (uint32_t)cus_cfg_get(CUS_CFG_ADV_TIMEOUT);
 		
     err_code = ble_advertising_init(&advdata, &scanrsp, &options, on_adv_evt, NULL);
     APP_ERROR_CHECK(err_code);
 }
 
 
+/**@brief Function for applying the parameters changed through the configuration.
+ *
+ * @param[in] changed  CUS_CFG_BIT of each changed parameter.
+ */
+static void cfg_apply(uint32_t changed)
+{
+    uint32_t err_code;
+
+    if (changed & (CUS_CFG_BIT(CUS_CFG_MIN_CONN_INTERVAL) | CUS_CFG_BIT(CUS_CFG_MAX_CONN_INTERVAL) |
+                   CUS_CFG_BIT(CUS_CFG_SLAVE_LATENCY)     | CUS_CFG_BIT(CUS_CFG_CONN_SUP_TIMEOUT)))
+    {
+        ble_gap_conn_params_t conn_params;
+
+        // Sets the PPCP and the parameters the Connection Parameters module negotiates, which
+        // requests an update at once if the current connection does not fit them. Without a
+        // connection the update request fails, the new parameters are used at the next one.
+        conn_params_get(&conn_params);
+        err_code = ble_conn_params_change_conn_params(&conn_params);
+        if ((m_conn_handle != BLE_CONN_HANDLE_INVALID) && (err_code != NRF_ERROR_BUSY))
+        {
+            APP_ERROR_CHECK(err_code);
+        }
+    }
+
+    if (changed & (CUS_CFG_BIT(CUS_CFG_ADV_INTERVAL) | CUS_CFG_BIT(CUS_CFG_ADV_TIMEOUT)))
+    {
+        // Used from the next time advertising starts.
+        advertising_init();
+    }
+
+    if (changed & CUS_CFG_BIT(CUS_CFG_UART_BAUDRATE))
+    {
+        // Bytes still in the UART FIFOs are lost.
+        UNUSED_RETURN_VALUE(app_uart_close());
+        uart_init();
+    }
+
+    if (changed & CUS_CFG_BIT(CUS_CFG_TX_POWER))
+    {
+        err_code = sd_ble_gap_tx_power_set((int8_t)cus_cfg_get(CUS_CFG_TX_POWER));
+        APP_ERROR_CHECK(err_code);
+    }
+
+    if (changed & CUS_CFG_BIT(CUS_CFG_ARQ_WINDOW))
+    {
+        err_code = cus_arq_window_set(&m_arq, (uint8_t)cus_cfg_get(CUS_CFG_ARQ_WINDOW));
+        APP_ERROR_CHECK(err_code);
+    }
+
+    if (changed & CUS_CFG_BIT(CUS_CFG_TX_QUEUE_LIMIT))
+    {
+        err_code = cus_tx_queue_limit_set(m_cus.tx_id, (uint8_t)cus_cfg_get(CUS_CFG_TX_QUEUE_LIMIT));
+        APP_ERROR_CHECK(err_code);
+        err_code = cus_tx_queue_limit_set(m_cus2.tx_id, (uint8_t)cus_cfg_get(CUS_CFG_TX_QUEUE_LIMIT));
+        APP_ERROR_CHECK(err_code);
+    }
+
+    if (changed & CUS_CFG_BIT(CUS_CFG_TX_SYNC))
+    {
+        // A line already batched goes at the next newline or radio event.
+        m_tx_sync = (cus_cfg_get(CUS_CFG_TX_SYNC) != 0);
+        cus_tx_sync_set(m_tx_sync);
+    }
+}
+
+
+/**@brief Function for handling the configuration events.
+ *
+ * @param[in] p_evt  Configuration event.
+ */
+static void cfg_evt_handler(cus_cfg_evt_t const * p_evt)
+{
+    switch (p_evt->evt_type)
+    {
+        case CUS_CFG_EVT_CHANGED:
+            cfg_apply(p_evt->params.changed);
+            break;
+
+        case CUS_CFG_EVT_SAVED:
+            UNUSED_RETURN_VALUE(cus_rpc_respond(&m_rpc,
+                                                m_cfg_save_id,
+                                                (p_evt->params.result == NRF_SUCCESS) ? CUS_RPC_STATUS_OK
+                                                                                      : CUS_RPC_STATUS_FAILED,
+                                                NULL,
+                                                0));
+            break;
+
+        default:
+            // No implementation needed.
+            break;
+    }
+}
+
+
+/**@brief Function for loading the configuration, before anything that depends on it is initialized.
+ */
+static void config_init(void)
+{
+    uint32_t       err_code;
+    cus_cfg_init_t cfg_init;
+
+    memset(&cfg_init, 0, sizeof(cfg_init));
+
+    cfg_init.p_defaults  = m_cfg_defaults;
+    cfg_init.evt_handler = cfg_evt_handler;
+
+    err_code = cus_cfg_init(&cfg_init);
+    APP_ERROR_CHECK(err_code);
+}
+
+
 /**@brief Function for initializing buttons and leds.
  *
  * @param[out] p_erase_bonds  Will be true if the clear bonding button was pressed to wake the application up.
@@ -680,6 +1603,38 @@ static void buttons_leds_init(bool * p_erase_bonds)
 }
 
 
+#if CUS_STACK_ENABLED
+/**@brief Function for handling the stack check timeout: traces every new peak.
+ *
+ * @param[in] p_context  Unused.
+ */
+static void stack_timeout_handler(void * p_context)
+{
+		cus_stack_stats_t stats;
+		
+		if (cus_stack_check())
+		{
+				cus_stack_stats_get(&stats);
+				CUS_TRACE(CUS_TRACE_STACK_PEAK, stats.peak, stats.handler);
+		}
+}
+
+
+/**@brief Function for starting the periodic check of the stack high-water mark.
+ */
+static void stack_check_init(void)
+{
+		uint32_t err_code;
+		
+		err_code = app_timer_create(&m_stack_timer_id, APP_TIMER_MODE_REPEATED, stack_timeout_handler);
+		APP_ERROR_CHECK(err_code);
+		
+		err_code = app_timer_start(m_stack_timer_id, STACK_CHECK_INTERVAL, NULL);
+		APP_ERROR_CHECK(err_code);
+}
+#endif
+
+
 /**@brief Function for placing the application in low power state while waiting for events.
  */
 static void power_manage(void)
@@ -696,16 +1651,28 @@ int main(void)
     uint32_t err_code;
     bool erase_bonds;
 
+#if CUS_STACK_ENABLED
+    cus_stack_init();
+#endif
+
     // Initialize.
     APP_TIMER_INIT(APP_TIMER_PRESCALER, APP_TIMER_OP_QUEUE_SIZE, false);
+#if CUS_PROF_ENABLED
+    cus_prof_init();
+#endif
+    config_init();
     uart_init();
 
     buttons_leds_init(&erase_bonds);
     ble_stack_init();
     gap_params_init();
     services_init();
+    tx_sync_init();
     advertising_init();
     conn_params_init();
+#if CUS_STACK_ENABLED
+    stack_check_init();
+#endif
 
     printf("\r\nUART Start!\r\n");
 		err_code = ble_advertising_start(BLE_ADV_MODE_FAST);
@@ -722,6 +1689,19 @@ int main(void)
 					nrf_delay_ms(1000);
 				}
 
+#if CUS_EVTCAP_ENABLED
+				// A dump of the captured events holds the trace back, which would cut its records.
+				if (!cus_evtcap_flush(trace_put))
+#endif
+				{
+#if CUS_TRACE_ENABLED
+						// Trace entries of the handlers go out when there is nothing else to do.
+						cus_trace_flush(trace_put);
+#endif
+				}
+#if CUS_STACK_ENABLED
+				cus_stack_thread_sample();
+#endif
         power_manage();
 				
     }
@@ -0,0 +1,7 @@
+# Stack peak of the application, in bytes, checked by the link against the stack reserved by the
+# startup file (see STACK_MARGIN in the Makefile). Rewritten from a log of a run by
+# make stack_peak LOG=<file>.
+#
+# Not measured yet: no run has been logged. Until then the application is held to a budget of
+# 1536 bytes, which with STACK_MARGIN leaves 256 of the 2048 bytes of gcc_startup_nrf51.S spare.
+STACK_PEAK := 1536
@@ -211,6 +211,244 @@
 #define BLE_TPS_ENABLED 0
 #endif
 
+// </h> 
+//==========================================================
+
+// <h> nRF_BLE_Custom_Service 
+
+//==========================================================
+// <h> cus_tx - TX scheduler shared by the Custom Service instances
+
+//==========================================================
+// <o> CUS_TX_MAX_INSTANCES - Number of Custom Service instances sharing the TX buffers 
+#ifndef CUS_TX_MAX_INSTANCES
+#define CUS_TX_MAX_INSTANCES 2
+#endif
+
+// <o> CUS_TX_QUEUE_SIZE - Bulk packets queued per instance 
+#ifndef CUS_TX_QUEUE_SIZE
+#define CUS_TX_QUEUE_SIZE 8
+#endif
+
+// <o> CUS_TX_CTRL_QUEUE_SIZE - Control packets queued for all instances 
+#ifndef CUS_TX_CTRL_QUEUE_SIZE
+#define CUS_TX_CTRL_QUEUE_SIZE 4
+#endif
+
+// <o> CUS_TX_POOL_SIZE - Number of payload buffers in the TX pool 
+// <i> Queued packets and buffers being filled by the application are taken from this pool.
+// <i> Should be at least CUS_TX_CTRL_QUEUE_SIZE + CUS_TX_MAX_INSTANCES * CUS_TX_QUEUE_SIZE.
+#ifndef CUS_TX_POOL_SIZE
+#define CUS_TX_POOL_SIZE 24
+#endif
+
+// <o> CUS_TX_SYNC_DISTANCE - Time between the radio notification and the radio event 
+// <i> A value of enum NRF_RADIO_NOTIFICATION_DISTANCES, 3 is 2680 us. Long enough for the
+// <i> handler to compress a UART line and fill the TX buffers.
+#ifndef CUS_TX_SYNC_DISTANCE
+#define CUS_TX_SYNC_DISTANCE 3
+#endif
+
+// </h> 
+//==========================================================
+
+// <h> cus_qwr - Queued (long) writes to the Custom Service characteristics
+
+//==========================================================
+// <o> CUS_QWR_BLOCK_COUNT - Number of user memory blocks in the pool 
+// <i> One block is lent to each link with queued writes in progress.
+#ifndef CUS_QWR_BLOCK_COUNT
+#define CUS_QWR_BLOCK_COUNT 1
+#endif
+
+// <o> CUS_QWR_BLOCK_SIZE - Size of a user memory block (in bytes) 
+// <i> Each Prepare Write takes 6 bytes of header plus its data (at most 18 bytes with the default MTU),
+// <i> and the block ends with a 2-byte terminator: a 128-byte value needs 8 * 6 + 128 + 2 = 178 bytes.
+#ifndef CUS_QWR_BLOCK_SIZE
+#define CUS_QWR_BLOCK_SIZE 256
+#endif
+
+// </h> 
+//==========================================================
+
+// <h> Reliable records - Indications and acknowledged notifications
+
+//==========================================================
+// <o> CUS_REC_QUEUE_SIZE - Records waiting for confirmation per instance 
+#ifndef CUS_REC_QUEUE_SIZE
+#define CUS_REC_QUEUE_SIZE 8
+#endif
+
+// <o> CUS_REC_BULK_THRESHOLD - Backlog from which records are notified instead of indicated 
+// <i> Indications allow one record per round trip (1 to 2 connection intervals). Above this
+// <i> many waiting records, the records are notified and acknowledged by the application instead.
+#ifndef CUS_REC_BULK_THRESHOLD
+#define CUS_REC_BULK_THRESHOLD 3
+#endif
+
+// </h> 
+//==========================================================
+
+// <h> cus_arq - Sliding-window reliable stream
+
+//==========================================================
+// <o> CUS_ARQ_WINDOW_MAX - Frames retained for retransmission per stream 
+// <i> Largest window that can be set at runtime. Power of two, at most 128.
+#ifndef CUS_ARQ_WINDOW_MAX
+#define CUS_ARQ_WINDOW_MAX 16
+#endif
+
+// </h> 
+//==========================================================
+
+// <h> cus_rpc - Request/response calls over a channel
+
+//==========================================================
+// <o> CUS_RPC_MAX_PENDING - Calls that can wait for an asynchronous answer 
+#ifndef CUS_RPC_MAX_PENDING
+#define CUS_RPC_MAX_PENDING 4
+#endif
+
+// </h> 
+//==========================================================
+
+// <h> cus_cfg - Runtime configuration
+
+//==========================================================
+// <o> CUS_CFG_FS_PRIORITY - fstorage priority of the saved configuration page 
+// <i> Must be unique among the fstorage users.
+#ifndef CUS_CFG_FS_PRIORITY
+#define CUS_CFG_FS_PRIORITY 0xFE
+#endif
+
+// </h> 
+//==========================================================
+
+// <h> cus_obj - Object transfer to flash
+
+//==========================================================
+// <o> CUS_OBJ_MAX_PAGES - Flash pages for the object data 
+// <i> One more page holds the header of the object. At most 64 (16-bit offsets).
+#ifndef CUS_OBJ_MAX_PAGES
+#define CUS_OBJ_MAX_PAGES 16
+#endif
+
+// <o> CUS_OBJ_BUF_SIZE - Size of each of the two staging buffers 
+// <i> Data is written to flash one staging buffer at a time. Multiple of 4, at most
+// <i> FS_MAX_WRITE_SIZE_WORDS * 4. The peer may have up to twice this amount not acknowledged.
+#ifndef CUS_OBJ_BUF_SIZE
+#define CUS_OBJ_BUF_SIZE 256
+#endif
+
+// <o> CUS_OBJ_FS_PRIORITY - fstorage priority of the object pages 
+// <i> Must be unique among the fstorage users.
+#ifndef CUS_OBJ_FS_PRIORITY
+#define CUS_OBJ_FS_PRIORITY 0xFD
+#endif
+
+// </h> 
+//==========================================================
+
+// <e> CUS_LZ_ENABLED - cus_lz - Compression of the UART stream
+// <i> The UART bridge sends LZ frames (see cus_lz.h) instead of raw bytes; the peer needs the
+// <i> decoder of tools/lz.
+//==========================================================
+#ifndef CUS_LZ_ENABLED
+#define CUS_LZ_ENABLED 1
+#endif
+#if  CUS_LZ_ENABLED
+// <o> CUS_LZ_WINDOW_BITS - History window, log2 of its size in bytes 
+// <i> The compressor keeps the window in RAM and searches all of it for each token.
+#ifndef CUS_LZ_WINDOW_BITS
+#define CUS_LZ_WINDOW_BITS 8
+#endif
+
+// <o> CUS_LZ_LOOKAHEAD_BITS - Bits of a copy length 
+#ifndef CUS_LZ_LOOKAHEAD_BITS
+#define CUS_LZ_LOOKAHEAD_BITS 4
+#endif
+
+// <o> CUS_LZ_LINE_SIZE - UART bytes compressed together 
+// <i> A line is compressed when a newline is received or when it is full.
+#ifndef CUS_LZ_LINE_SIZE
+#define CUS_LZ_LINE_SIZE 64
+#endif
+
+#endif //CUS_LZ_ENABLED
+// </e>
+
+// <e> CUS_PROF_ENABLED - cus_prof - Execution time histograms of the hot paths
+// <i> The histograms are appended to the diagnostics snapshot of Service 2.
+//==========================================================
+#ifndef CUS_PROF_ENABLED
+#define CUS_PROF_ENABLED 0
+#endif
+#if  CUS_PROF_ENABLED
+// <o> CUS_PROF_TIMER_INSTANCE - TIMER instance counting the time, 1 or 2 
+#ifndef CUS_PROF_TIMER_INSTANCE
+#define CUS_PROF_TIMER_INSTANCE 2
+#endif
+
+// <o> CUS_PROF_TIMER_PRESCALER - Timer prescaler 
+// <i> A tick is 2^prescaler / 16 us. 0 counts CPU cycles, up to 4.096 ms.
+#ifndef CUS_PROF_TIMER_PRESCALER
+#define CUS_PROF_TIMER_PRESCALER 0
+#endif
+
+#endif //CUS_PROF_ENABLED
+// </e>
+
+// <e> CUS_TRACE_ENABLED - cus_trace - Binary trace of the event handlers
+// <i> Entries are sent on the UART from the main loop and decoded on the host (tools/trace).
+//==========================================================
+#ifndef CUS_TRACE_ENABLED
+#define CUS_TRACE_ENABLED 1
+#endif
+#if  CUS_TRACE_ENABLED
+// <o> CUS_TRACE_SIZE - Entries in the trace ring, a power of 2 
+// <i> Each entry takes 8 bytes of RAM. The ring holds the UART latency histogram
+// <i> dumped at each disconnection (up to 63 entries) with room to spare.
+#ifndef CUS_TRACE_SIZE
+#define CUS_TRACE_SIZE 128
+#endif
+
+#endif //CUS_TRACE_ENABLED
+// </e>
+
+// <e> CUS_EVTCAP_ENABLED - cus_evtcap - Capture of the SoftDevice events
+// <i> Dumped on the UART on request and replayed on the host (tools/host).
+//==========================================================
+#ifndef CUS_EVTCAP_ENABLED
+#define CUS_EVTCAP_ENABLED 0
+#endif
+#if  CUS_EVTCAP_ENABLED
+// <o> CUS_EVTCAP_SIZE - Bytes of the capture ring, a power of 2 
+// <i> An event takes 5 bytes plus its parameters; the ring keeps the most recent ones.
+#ifndef CUS_EVTCAP_SIZE
+#define CUS_EVTCAP_SIZE 1024
+#endif
+
+#endif //CUS_EVTCAP_ENABLED
+// </e>
+
+// <q> CUS_STACK_ENABLED  - cus_stack - Stack high-water mark
+// <i> The stack is painted at boot and its peak use is added to the diagnostics snapshot of Service 2.
+#ifndef CUS_STACK_ENABLED
+#define CUS_STACK_ENABLED 1
+#endif
+
+// <h> cus_tlm - Delta coded telemetry
+
+//==========================================================
+// <o> CUS_TLM_MAX_FIELDS - Largest number of fields of a sample 
+#ifndef CUS_TLM_MAX_FIELDS
+#define CUS_TLM_MAX_FIELDS 8
+#endif
+
+// </h> 
+//==========================================================
+
+
 // </h> 
 //==========================================================
 
@@ -3072,7 +3310,7 @@
  
 
 #ifndef CRC32_ENABLED
-#define CRC32_ENABLED 0
+#define CRC32_ENABLED 1
 #endif
 
 // <q> ECC_ENABLED  - ecc - Elliptic Curve Cryptography Library
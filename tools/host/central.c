@@ -0,0 +1,801 @@
+/**@file
+ *
+ * @brief Emulated central driving the host build of the application.
+ *
+ * @details Connects as soon as the application advertises, enables every notification, then
+ *          acknowledges the UART stream of Service 1 in each connection event and checks what it
+ *          decodes against the lines fed to the UART. On request it also runs the benchmark, the
+ *          object transfer and the echo channels of Service 2. At the end of the run, or when the
+ *          application stops, it prints the link counters and the measurements.
+ *
+ *          Usage: sd_host [-i interval] [-n per_event] [-q tx_buffers] [-t duration_ms]
+ *                         [-u uart_bytes_per_s] [-b bench_tx_bytes] [-r bench_rx_bytes]
+ *                         [-R rec_depth] [-O object_bytes] [-e echo_period_ms] [-d dump_at_ms]
+ *                         [-o uart_out_file]
+ *
+ *          interval is in 1.25 ms units. -R makes the generator run of -b a record run with that
+ *          depth; the central then enables indications too, and acknowledges notified records. The UART lines have the format of the lz_bench sample.
+ *          -d asks for a dump of the captured SoftDevice events at that time; it goes to the UART
+ *          output, kept with -o, which evt_replay reads.
+ */
+#include "sd_emu.h"
+#include "hal_emu.h"
+#include "lz_dec.h"
+
+#include "sdk_config.h"
+#include "sdk_common.h"
+#include "app_timer.h"
+#include "cus_service.h"
+#include "cus_mux.h"
+#include "cus_bench.h"
+#include "cus_lat.h"
+#include "cus_rpc.h"
+#include "cus_obj.h"
+#include "crc32.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#define CH_RPC                          1                         /**< Channels of Service 2, as in main.c. */
+#define CH_OBJ                          2
+#define CH_BENCH                        4
+#define CH_ECHO                         5
+#define RPC_EVTCAP_DUMP                 0x0C                      /**< As in main.c. */
+#define ECHO_ANSWER                     0x00                      /**< Echo frames, as in main.c. */
+#define ECHO_SENT                       0x01
+#define ECHO_HEADER_LEN                 (3 + sizeof(uint32_t))
+#define ECHO_SENT_LEN                   (2 + sizeof(uint32_t))
+
+#define START_DELAY_US                  1000000                   /**< From the connection to the start of the benchmark and the echoes. */
+#define LINE_RING_SIZE                  1024                      /**< UART lines kept to check the decoded stream. */
+#define LINE_MAX                        96
+#define BENCH_CHUNK_LEN                 (CUS_MUX_MAX_DATA_LEN - 3)
+#define OBJ_CHUNK_LEN                   (CUS_MUX_MAX_DATA_LEN - 3)
+
+int app_main(void);
+
+typedef struct
+{
+    uint16_t    interval;
+    uint8_t     per_event;
+    uint8_t     tx_buffers;
+    uint32_t    duration_ms;
+    uint32_t    uart_rate;
+    uint32_t    bench_tx;
+    uint32_t    bench_rx;
+    uint8_t     rec_depth;
+    uint32_t    obj_size;
+    uint32_t    echo_ms;
+    uint32_t    dump_ms;
+    char const * p_out;
+} options_t;
+
+typedef struct
+{
+    char        text[LINE_MAX];
+    uint8_t     len;
+    uint32_t    index;
+    uint64_t    end_us;                                           /**< Time the last byte entered the UART. */
+} line_t;
+
+static options_t    m_opt = {24, 4, 7, 10000, 0, 0, 0, 0, 0, 0, 0, NULL};
+static FILE       * m_p_out;
+static uint64_t     m_connected_at;
+static uint32_t     m_connections;
+
+static uint16_t     m_s1_notify;
+static uint16_t     m_s1_write;
+static uint16_t     m_s2_notify;
+static uint16_t     m_s2_write;
+
+static uint8_t      m_arq_next;                                   /**< Next sequence number expected on Service 1. */
+static bool         m_arq_new;                                    /**< Frames received since the last acknowledgement. */
+static uint32_t     m_arq_frames;
+static uint32_t     m_arq_dups;
+static lz_dec_t     m_lz;
+static uint32_t     m_lz_errors;
+
+static line_t       m_lines[LINE_RING_SIZE];                      /**< Lines fed to the UART, by index. */
+static uint32_t     m_line_count;
+static uint8_t      m_line_pos;
+static char         m_rx_line[LINE_MAX];
+static uint8_t      m_rx_len;
+static uint64_t     m_rx_bytes;
+static uint32_t     m_lines_ok;
+static uint32_t     m_lines_bad;
+static cus_lat_t    m_uart_lat;
+
+static bool         m_bench_started;
+static uint32_t     m_bench_offset;                               /**< Stream bytes expected next, or written so far. */
+static uint32_t     m_bench_bytes;
+static uint32_t     m_bench_lost;
+static uint32_t     m_bench_bad;
+static uint64_t     m_bench_first_us;
+static uint64_t     m_bench_last_us;
+static bool         m_bench_reported;
+static cus_bench_report_t m_bench_report;
+
+static uint8_t      m_rec_next;                                   /**< Next record sequence number expected on Service 2. */
+static bool         m_rec_new;                                    /**< Notified records since the last acknowledgement. */
+static uint32_t     m_rec_indicated;
+static uint32_t     m_rec_notified;
+static uint32_t     m_rec_dups;
+
+static uint8_t      m_obj_data[CUS_OBJ_MAX_SIZE];
+static uint32_t     m_obj_crc;
+static bool         m_obj_create_sent;
+static bool         m_obj_created;                                /**< CREATED received, data may be sent. */
+static bool         m_obj_done;
+static uint8_t      m_obj_status;                                 /**< Of CREATED if it failed, else of DONE. */
+static uint32_t     m_obj_offset;                                 /**< Next byte to send. */
+static uint32_t     m_obj_acked;                                  /**< Bytes acknowledged in flash. */
+static uint16_t     m_obj_window;
+static uint32_t     m_obj_nacks;
+static uint32_t     m_obj_ticks;                                  /**< Device time from CREATED to the end, from DONE. */
+static uint64_t     m_obj_create_us;
+static uint64_t     m_obj_created_us;
+static uint64_t     m_obj_done_us;
+
+static uint64_t     m_echo_next_us;
+static uint32_t     m_echo_sent;
+static cus_lat_t    m_echo_rtt;
+static cus_lat_t    m_echo_device;                                /**< Time spent in the device, from its timestamps. */
+static uint32_t     m_echo_rx_ticks[256];                         /**< Receive ticks of the answers, by sequence number. */
+static uint32_t     m_echo_cut;                                   /**< Answers whose payload was cut. */
+
+static bool         m_dump_asked;
+
+
+/**@brief Function for making the next line of the UART input, as lz_bench does. */
+static void line_make(void)
+{
+    static char const * states[] = {"IDLE", "ADV", "CONNECTED", "BUSY"};
+    static uint32_t     seed     = 1;
+    line_t            * p_line   = &m_lines[m_line_count % LINE_RING_SIZE];
+
+    seed = seed * 1103515245 + 12345;
+    p_line->index = m_line_count;
+    p_line->len   = (uint8_t)snprintf(p_line->text, sizeof(p_line->text),
+                                      "t=%08u adc=0x%03x temp=%d.%uC state=%s\r\n",
+                                      m_line_count * 250, (seed >> 16) & 0x3FF, 20 + (int)((seed >> 8) % 8),
+                                      (seed >> 4) % 10, states[(seed >> 20) & 3]);
+    m_line_pos = 0;
+}
+
+
+static uint8_t uart_next_byte(void)
+{
+    line_t * p_line = &m_lines[m_line_count % LINE_RING_SIZE];
+    uint8_t  byte   = (uint8_t)p_line->text[m_line_pos++];
+
+    if (m_line_pos == p_line->len)
+    {
+        p_line->end_us = sd_emu_now();
+        m_line_count++;
+        line_make();
+    }
+    return byte;
+}
+
+
+static void uart_out(uint8_t byte)
+{
+    UNUSED_RETURN_VALUE(fputc(byte, m_p_out));
+}
+
+
+/**@brief Function for checking a line decoded from the UART stream against the line fed. */
+static void rx_line_check(void)
+{
+    unsigned t;
+    line_t * p_line;
+
+    if ((sscanf(m_rx_line, "t=%8u", &t) != 1) || ((t % 250) != 0))
+    {
+        m_lines_bad++;
+        return;
+    }
+
+    p_line = &m_lines[(t / 250) % LINE_RING_SIZE];
+    if ((p_line->index != t / 250) || (p_line->len != m_rx_len) || (memcmp(p_line->text, m_rx_line, m_rx_len) != 0))
+    {
+        // Out of the ring, or merged with the start of the next line after a drop.
+        m_lines_bad++;
+        return;
+    }
+
+    m_lines_ok++;
+    cus_lat_record(&m_uart_lat, hal_emu_ticks(sd_emu_now() - p_line->end_us));
+}
+
+
+static void rx_bytes(uint8_t const * p_data, int len)
+{
+    for (int i = 0; i < len; i++)
+    {
+        m_rx_bytes++;
+        if (m_rx_len < sizeof(m_rx_line) - 1)
+        {
+            m_rx_line[m_rx_len++] = (char)p_data[i];
+        }
+        if (p_data[i] == '\n')
+        {
+            m_rx_line[m_rx_len] = '\0';
+            rx_line_check();
+            m_rx_len = 0;
+        }
+    }
+}
+
+
+/**@brief Function for handling a frame of the UART stream, {seq, payload}. */
+static void on_arq_frame(uint8_t const * p_data, uint16_t len)
+{
+    if (len < 2)
+    {
+        // The 1-byte counter of ble_cus_custom_value_update shares the characteristic.
+        return;
+    }
+    if (p_data[0] != m_arq_next)
+    {
+        // Sent again after a timeout: only in-order frames are taken, acknowledged cumulatively.
+        m_arq_dups++;
+        m_arq_new = true;
+        return;
+    }
+
+    m_arq_next++;
+    m_arq_new = true;
+    m_arq_frames++;
+
+#if CUS_LZ_ENABLED
+    {
+        uint8_t out[LINE_MAX * 4];
+        int     n = lz_dec_frame(&m_lz, &p_data[1], len - 1, out, sizeof(out));
+
+        if (n < 0)
+        {
+            m_lz_errors++;
+            return;
+        }
+        rx_bytes(out, n);
+    }
+#else
+    rx_bytes(&p_data[1], len - 1);
+#endif
+}
+
+
+static void on_bench_frame(uint8_t const * p_data, uint16_t len)
+{
+    if ((len >= 3) && (p_data[0] == CUS_BENCH_OP_DATA))
+    {
+        uint16_t gap = uint16_decode(&p_data[1]) - (uint16_t)m_bench_offset;
+
+        if (m_bench_bytes == 0)
+        {
+            m_bench_first_us = sd_emu_now();
+        }
+        m_bench_last_us  = sd_emu_now();
+        m_bench_lost    += gap;
+        m_bench_offset  += gap;
+        for (uint16_t i = 3; i < len; i++)
+        {
+            m_bench_bad += (p_data[i] != (uint8_t)m_bench_offset++);
+            m_bench_bytes++;
+        }
+    }
+    else if ((len >= 1 + 1 + 3 * sizeof(uint32_t) + 2 * sizeof(uint16_t)) && (p_data[0] == CUS_BENCH_OP_REPORT))
+    {
+        m_bench_report.mode      = p_data[1];
+        m_bench_report.bytes     = uint32_decode(&p_data[2]);
+        m_bench_report.ticks     = uint32_decode(&p_data[6]);
+        m_bench_report.kbps      = uint16_decode(&p_data[10]);
+        m_bench_report.per_event = uint16_decode(&p_data[12]);
+        m_bench_report.lost      = uint32_decode(&p_data[14]);
+        m_bench_reported         = true;
+    }
+}
+
+
+static void on_obj_frame(uint8_t const * p_data, uint16_t len)
+{
+    switch (p_data[0])
+    {
+        case CUS_OBJ_OP_CREATED:
+            if (len < 1 + 1 + sizeof(uint32_t) + sizeof(uint16_t))
+            {
+                break;
+            }
+            if (p_data[1] != CUS_OBJ_STATUS_OK)
+            {
+                m_obj_status = p_data[1];
+                m_obj_done   = true;
+                break;
+            }
+            m_obj_offset     = uint32_decode(&p_data[2]);
+            m_obj_acked      = m_obj_offset;
+            m_obj_window     = uint16_decode(&p_data[6]);
+            m_obj_created    = true;
+            m_obj_created_us = sd_emu_now();
+            break;
+
+        case CUS_OBJ_OP_ACK:
+            if (len < 1 + 1 + sizeof(uint32_t))
+            {
+                break;
+            }
+            if (p_data[1] == CUS_OBJ_STATUS_OUT_OF_ORDER)
+            {
+                // Go back to what the device has.
+                m_obj_nacks++;
+                m_obj_offset = uint32_decode(&p_data[2]);
+            }
+            m_obj_acked = MAX(m_obj_acked, uint32_decode(&p_data[2]));
+            break;
+
+        case CUS_OBJ_OP_DONE:
+            if (len < 1 + 1 + 2 * sizeof(uint32_t))
+            {
+                break;
+            }
+            m_obj_status  = p_data[1];
+            m_obj_ticks   = uint32_decode(&p_data[6]);
+            m_obj_done_us = sd_emu_now();
+            m_obj_done    = true;
+            m_obj_created = false;
+            break;
+
+        default:
+            break;
+    }
+}
+
+
+/**@brief Function for handling a record of a record run, {DATA frame, seq}. */
+static void on_rec_frame(uint8_t type, uint8_t const * p_data, uint16_t len)
+{
+    if (type == BLE_GATT_HVX_NOTIFICATION)
+    {
+        m_rec_new = true;
+    }
+    if (p_data[len - 1] != m_rec_next)
+    {
+        m_rec_dups++;
+        return;
+    }
+
+    m_rec_next++;
+    if (type == BLE_GATT_HVX_NOTIFICATION)
+    {
+        m_rec_notified++;
+    }
+    else
+    {
+        m_rec_indicated++;
+    }
+    on_bench_frame(p_data, len - 1);
+}
+
+
+static void on_echo_frame(uint8_t const * p_data, uint16_t len)
+{
+    uint64_t sent_us;
+    uint32_t device_ticks;
+
+    if ((p_data[0] == ECHO_SENT) && (len >= ECHO_SENT_LEN))
+    {
+        // From the write reaching the device to the answer on air.
+        UNUSED_RETURN_VALUE(app_timer_cnt_diff_compute(uint32_decode(&p_data[2]),
+                                                       m_echo_rx_ticks[p_data[1]], &device_ticks));
+        cus_lat_record(&m_echo_device, device_ticks);
+        return;
+    }
+    if ((p_data[0] != ECHO_ANSWER) || (len < ECHO_HEADER_LEN + sizeof(sent_us)))
+    {
+        return;
+    }
+
+    m_echo_rx_ticks[p_data[1]] = uint32_decode(&p_data[3]);
+    if (p_data[2] > len - ECHO_HEADER_LEN)
+    {
+        m_echo_cut++;
+    }
+    memcpy(&sent_us, &p_data[ECHO_HEADER_LEN], sizeof(sent_us));
+    cus_lat_record(&m_echo_rtt, hal_emu_ticks(sd_emu_now() - sent_us));
+}
+
+
+static void on_hvx(uint16_t handle, uint8_t type, uint8_t const * p_data, uint16_t len)
+{
+    if (handle == m_s1_notify)
+    {
+        on_arq_frame(p_data, len);
+    }
+    else if ((handle == m_s2_notify) && (len >= CUS_MUX_HEADER_LEN))
+    {
+        switch (p_data[0] & 0x0F)
+        {
+            case CH_OBJ:
+                on_obj_frame(&p_data[1], len - 1);
+                break;
+
+            case CH_BENCH:
+                if ((m_opt.rec_depth > 0) && (len > 2) && (p_data[1] == CUS_BENCH_OP_DATA))
+                {
+                    on_rec_frame(type, &p_data[1], len - 1);
+                }
+                else
+                {
+                    on_bench_frame(&p_data[1], len - 1);
+                }
+                break;
+
+            case CH_ECHO:
+                on_echo_frame(&p_data[1], len - 1);
+                break;
+
+            default:
+                break;
+        }
+    }
+}
+
+
+static void mux_write(uint8_t channel, uint8_t const * p_data, uint16_t len)
+{
+    uint8_t frame[BLE_CUSTOM_MAX_DATA_LEN];
+
+    frame[0] = CUS_MUX_HEADER(channel);
+    memcpy(&frame[1], p_data, len);
+    UNUSED_RETURN_VALUE(sd_emu_peer_write(m_s2_write, frame, len + 1, false));
+}
+
+
+static void bench_step(void)
+{
+    if (!m_bench_started)
+    {
+        uint8_t start[1 + sizeof(uint32_t) + 1];
+        uint8_t len = 1 + sizeof(uint32_t);
+
+        start[0] = (m_opt.bench_tx > 0) ? CUS_BENCH_OP_START_TX : CUS_BENCH_OP_START_RX;
+        UNUSED_RETURN_VALUE(uint32_encode((m_opt.bench_tx > 0) ? m_opt.bench_tx : m_opt.bench_rx, &start[1]));
+        if (m_opt.rec_depth > 0)
+        {
+            start[0]     = CUS_BENCH_OP_START_REC;
+            start[len++] = m_opt.rec_depth;
+        }
+        mux_write(CH_BENCH, start, len);
+        m_bench_started  = true;
+        m_bench_first_us = sd_emu_now();
+        return;
+    }
+
+    // Sink run: as many DATA frames as the central sends in an event.
+    while ((m_opt.bench_rx > 0) && (m_bench_offset < m_opt.bench_rx) && (sd_emu_peer_pending() < m_opt.per_event))
+    {
+        uint8_t  data[3 + BENCH_CHUNK_LEN];
+        uint16_t len = (uint16_t)MIN(BENCH_CHUNK_LEN, m_opt.bench_rx - m_bench_offset);
+
+        data[0] = CUS_BENCH_OP_DATA;
+        UNUSED_RETURN_VALUE(uint16_encode((uint16_t)m_bench_offset, &data[1]));
+        for (uint16_t i = 0; i < len; i++)
+        {
+            data[3 + i] = (uint8_t)(m_bench_offset + i);
+        }
+        mux_write(CH_BENCH, data, 3 + len);
+        m_bench_offset  += len;
+        m_bench_bytes   += len;
+        m_bench_last_us  = sd_emu_now();
+    }
+}
+
+
+/**@brief Function for sending the object: CREATE, then DATA within the window the device gave. */
+static void obj_step(void)
+{
+    if (!m_obj_create_sent)
+    {
+        uint8_t create[1 + 2 * sizeof(uint32_t)];
+
+        create[0] = CUS_OBJ_OP_CREATE;
+        UNUSED_RETURN_VALUE(uint32_encode(m_opt.obj_size, &create[1]));
+        UNUSED_RETURN_VALUE(uint32_encode(m_obj_crc, &create[5]));
+        mux_write(CH_OBJ, create, sizeof(create));
+        m_obj_create_sent = true;
+        m_obj_create_us   = sd_emu_now();
+        return;
+    }
+
+    while (m_obj_created && (m_obj_offset < MIN(m_opt.obj_size, m_obj_acked + m_obj_window)) &&
+           (sd_emu_peer_pending() < m_opt.per_event))
+    {
+        uint8_t  data[3 + OBJ_CHUNK_LEN];
+        uint16_t len = (uint16_t)MIN(OBJ_CHUNK_LEN, MIN(m_opt.obj_size, m_obj_acked + m_obj_window) - m_obj_offset);
+
+        data[0] = CUS_OBJ_OP_DATA;
+        UNUSED_RETURN_VALUE(uint16_encode((uint16_t)m_obj_offset, &data[1]));
+        memcpy(&data[3], &m_obj_data[m_obj_offset], len);
+        mux_write(CH_OBJ, data, 3 + len);
+        m_obj_offset += len;
+    }
+}
+
+
+static void on_conn_event(void)
+{
+    uint64_t now = sd_emu_now();
+
+    if (m_arq_new)
+    {
+        uint8_t ack[2] = {m_arq_next, 0};
+
+        UNUSED_RETURN_VALUE(sd_emu_peer_write(m_s1_write, ack, sizeof(ack), false));
+        m_arq_new = false;
+    }
+
+    if (m_rec_new)
+    {
+        uint8_t ack[2] = {BLE_CUS_REC_ACK, (uint8_t)(m_rec_next - 1)};
+
+        UNUSED_RETURN_VALUE(sd_emu_peer_write(m_s2_write, ack, sizeof(ack), false));
+        m_rec_new = false;
+    }
+
+    if ((m_opt.dump_ms > 0) && !m_dump_asked && (now >= (uint64_t)m_opt.dump_ms * 1000))
+    {
+        uint8_t call[CUS_RPC_REQ_HEADER_LEN] = {0, RPC_EVTCAP_DUMP};
+
+        mux_write(CH_RPC, call, sizeof(call));
+        m_dump_asked = true;
+    }
+
+    if (now < m_connected_at + START_DELAY_US)
+    {
+        return;
+    }
+
+    if ((m_opt.bench_tx > 0) || (m_opt.bench_rx > 0))
+    {
+        bench_step();
+    }
+
+    if ((m_opt.obj_size > 0) && !m_obj_done)
+    {
+        obj_step();
+    }
+
+    if ((m_opt.echo_ms > 0) && (now >= m_echo_next_us))
+    {
+        mux_write(CH_ECHO, (uint8_t const *)&now, sizeof(now));
+        m_echo_sent++;
+        m_echo_next_us = now + (uint64_t)m_opt.echo_ms * 1000;
+    }
+}
+
+
+static void on_connected(uint16_t conn_interval)
+{
+    UNUSED_PARAMETER(conn_interval);
+
+    m_connections++;
+    m_connected_at = sd_emu_now();
+    m_s1_notify    = sd_emu_handle_find(BLE_UUID_CUSTOM_VAL_CHA_NOTIFY, false);
+    m_s1_write     = sd_emu_handle_find(BLE_UUID_CUSTOM_VAL_CHA_WRITE, false);
+    m_s2_notify    = sd_emu_handle_find(BLE_UUID_CUSTOM_VAL_CHA_NOTIFY_2, false);
+    m_s2_write     = sd_emu_handle_find(BLE_UUID_CUSTOM_VAL_CHA_WRITE_2, false);
+    sd_emu_peer_cccds_enable();
+    if (m_opt.rec_depth > 0)
+    {
+        uint8_t both[2] = {BLE_GATT_HVX_NOTIFICATION | BLE_GATT_HVX_INDICATION, 0};
+
+        UNUSED_RETURN_VALUE(sd_emu_peer_write(sd_emu_handle_find(BLE_UUID_CUSTOM_VAL_CHA_NOTIFY_2, true),
+                                              both, sizeof(both), true));
+    }
+}
+
+
+static double ticks_ms(uint32_t ticks)
+{
+    return ticks * 1000.0 / APP_TIMER_CLOCK_FREQ;
+}
+
+
+static void lat_print(char const * p_name, cus_lat_t const * p_lat)
+{
+    cus_lat_summary_t summary;
+
+    cus_lat_summary_get(p_lat, &summary);
+    printf("  %-22s p50 %7.2f  p99 %7.2f  max %7.2f ms  (%u)\n", p_name,
+           ticks_ms(summary.p50), ticks_ms(summary.p99), ticks_ms(summary.max), (unsigned)summary.count);
+}
+
+
+static void report(void)
+{
+    sd_emu_stats_t stats;
+    double         seconds = sd_emu_now() / 1e6;
+
+    sd_emu_stats_get(&stats);
+
+    printf("\n%.3f s emulated, %u connection(s)\n", seconds, (unsigned)m_connections);
+    printf("link: interval %.2f ms, %u exchanges per event, %u TX buffers\n",
+           m_opt.interval * 1.25, m_opt.per_event, m_opt.tx_buffers);
+    printf("  %u connection events, %u packets sent (at most %u per event), %u received, %u hvx refused\n",
+           (unsigned)stats.conn_events, (unsigned)stats.tx_packets, stats.max_tx_per_event,
+           (unsigned)stats.rx_packets, (unsigned)stats.no_tx_packets);
+    printf("  attribute table: %u of %u bytes (estimate)\n", stats.attr_tab_used, stats.attr_tab_size);
+
+    if (m_opt.uart_rate > 0)
+    {
+        printf("uart: %u bytes/s, %u lines fed, %u intact, %u damaged, %u not received\n",
+               (unsigned)m_opt.uart_rate, (unsigned)m_line_count, (unsigned)m_lines_ok, (unsigned)m_lines_bad,
+               (unsigned)(m_line_count - MIN(m_line_count, m_lines_ok + m_lines_bad)));
+        printf("  %u frames, %u sent again, %u decode errors, %.2f kbps decoded\n",
+               (unsigned)m_arq_frames, (unsigned)m_arq_dups, (unsigned)m_lz_errors,
+               (seconds > 0) ? m_rx_bytes * 8 / seconds / 1000 : 0.0);
+        lat_print("UART to central", &m_uart_lat);
+    }
+
+    if ((m_opt.bench_tx > 0) || (m_opt.bench_rx > 0))
+    {
+        double span = (m_bench_last_us - m_bench_first_us) / 1e6;
+
+        printf("bench %s: central %u bytes, %.2f kbps",
+               (m_opt.rec_depth > 0) ? "records" : (m_opt.bench_tx > 0) ? "generator" : "sink",
+               (unsigned)m_bench_bytes, (span > 0) ? m_bench_bytes * 8 / span / 1000 : 0.0);
+        if (m_opt.bench_tx > 0)
+        {
+            printf(", %u lost, %u wrong", (unsigned)m_bench_lost, (unsigned)m_bench_bad);
+        }
+        printf("\n");
+        if (m_opt.rec_depth > 0)
+        {
+            uint32_t records = m_rec_indicated + m_rec_notified;
+
+            printf("  depth %u: %u records, %u indicated, %u notified, %u duplicates, %.1f records/s\n",
+                   m_opt.rec_depth, (unsigned)records, (unsigned)m_rec_indicated, (unsigned)m_rec_notified,
+                   (unsigned)m_rec_dups, (span > 0) ? records / span : 0.0);
+        }
+        if (m_bench_reported)
+        {
+            printf("  device: %u bytes in %.2f ms, %u kbps, %.2f frames per event, lost %u\n",
+                   (unsigned)m_bench_report.bytes, ticks_ms(m_bench_report.ticks), m_bench_report.kbps,
+                   m_bench_report.per_event / 100.0, (unsigned)m_bench_report.lost);
+        }
+        else
+        {
+            printf("  device: no report\n");
+        }
+    }
+
+    if (m_opt.obj_size > 0)
+    {
+        double span = (m_obj_done_us - m_obj_created_us) / 1e6;
+
+        printf("object: %u bytes, ", (unsigned)m_opt.obj_size);
+        if (!m_obj_done)
+        {
+            printf("%u acknowledged, not done\n", (unsigned)m_obj_acked);
+        }
+        else if (m_obj_done_us == 0)
+        {
+            printf("CREATED status %u\n", m_obj_status);
+        }
+        else
+        {
+            printf("DONE status %u, %u sent again\n", m_obj_status, (unsigned)m_obj_nacks);
+            printf("  erase %.2f ms, CREATED to DONE %.2f ms (device %.2f ms), %.2f kB/s\n",
+                   (m_obj_created_us - m_obj_create_us) / 1e3, span * 1e3, ticks_ms(m_obj_ticks),
+                   (span > 0) ? m_opt.obj_size / span / 1000 : 0.0);
+            printf("  Write Commands alone: %.2f kB/s\n",
+                   m_opt.per_event * OBJ_CHUNK_LEN / (m_opt.interval * 1.25));
+        }
+    }
+
+    if (m_opt.echo_ms > 0)
+    {
+        printf("echo: %u sent, %u cut\n", (unsigned)m_echo_sent, (unsigned)m_echo_cut);
+        lat_print("round trip", &m_echo_rtt);
+        lat_print("in the device", &m_echo_device);
+    }
+
+    fflush(stdout);
+}
+
+
+static uint64_t end_due(void)
+{
+    return (uint64_t)m_opt.duration_ms * 1000;
+}
+
+
+static void end_run(void)
+{
+    exit(EXIT_SUCCESS);
+}
+
+
+static void usage(void)
+{
+    fprintf(stderr, "usage: sd_host [-i interval] [-n per_event] [-q tx_buffers] [-t duration_ms]\n"
+                    "               [-u uart_bytes_per_s] [-b bench_tx_bytes] [-r bench_rx_bytes]\n"
+                    "               [-R rec_depth] [-O object_bytes] [-e echo_period_ms] [-d dump_at_ms]\n"
+                    "               [-o uart_out_file]\n");
+    exit(EXIT_FAILURE);
+}
+
+
+int main(int argc, char ** argv)
+{
+    static sd_emu_source_t const end    = {end_due, end_run};
+    sd_emu_peer_t                peer   = {on_connected, NULL, on_conn_event, on_hvx, NULL};
+    sd_emu_cfg_t                 cfg;
+    int                          opt;
+
+    while ((opt = getopt(argc, argv, "i:n:q:t:u:b:r:R:O:e:d:o:")) != -1)
+    {
+        switch (opt)
+        {
+            case 'i': m_opt.interval    = (uint16_t)atoi(optarg); break;
+            case 'n': m_opt.per_event   = (uint8_t)atoi(optarg);  break;
+            case 'q': m_opt.tx_buffers  = (uint8_t)atoi(optarg);  break;
+            case 't': m_opt.duration_ms = (uint32_t)atol(optarg); break;
+            case 'u': m_opt.uart_rate   = (uint32_t)atol(optarg); break;
+            case 'b': m_opt.bench_tx    = (uint32_t)atol(optarg); break;
+            case 'r': m_opt.bench_rx    = (uint32_t)atol(optarg); break;
+            case 'R': m_opt.rec_depth   = (uint8_t)atoi(optarg);  break;
+            case 'O': m_opt.obj_size    = (uint32_t)atol(optarg); break;
+            case 'e': m_opt.echo_ms     = (uint32_t)atol(optarg); break;
+            case 'd': m_opt.dump_ms     = (uint32_t)atol(optarg); break;
+            case 'o': m_opt.p_out       = optarg;                 break;
+            default:  usage();
+        }
+    }
+    if ((m_opt.interval < BLE_GAP_CP_MIN_CONN_INTVL_MIN) || (m_opt.interval > BLE_GAP_CP_MAX_CONN_INTVL_MAX) ||
+        (m_opt.per_event == 0) || (m_opt.tx_buffers == 0) || ((m_opt.bench_tx > 0) && (m_opt.bench_rx > 0)) ||
+        (m_opt.obj_size > CUS_OBJ_MAX_SIZE) || ((m_opt.rec_depth > 0) && (m_opt.bench_tx == 0)))
+    {
+        usage();
+    }
+
+    cfg.conn_interval    = m_opt.interval;
+    cfg.tx_buffers       = m_opt.tx_buffers;
+    cfg.tx_per_event     = m_opt.per_event;
+    cfg.connect_delay_us = 50000;
+    cfg.replay           = false;
+
+    sd_emu_init(&cfg, &peer);
+    hal_emu_init();
+    sd_emu_source_add(&end);
+
+    if (m_opt.p_out != NULL)
+    {
+        m_p_out = fopen(m_opt.p_out, "wb");
+        if (m_p_out == NULL)
+        {
+            perror(m_opt.p_out);
+            return EXIT_FAILURE;
+        }
+        hal_emu_uart_tx_set(uart_out);
+    }
+    hal_emu_uart_rx_set(m_opt.uart_rate, uart_next_byte);
+
+    for (uint32_t i = 0; i < m_opt.obj_size; i++)
+    {
+        m_obj_data[i] = (uint8_t)(i * 31 + (i >> 8));
+    }
+    m_obj_crc = crc32_compute(m_obj_data, m_opt.obj_size, NULL);
+
+    line_make();
+    lz_dec_init(&m_lz);
+    cus_lat_reset(&m_uart_lat);
+    cus_lat_reset(&m_echo_rtt);
+    cus_lat_reset(&m_echo_device);
+    atexit(report);
+
+    return app_main();
+}
@@ -0,0 +1,500 @@
+/**@file
+ *
+ * @brief Replay of the SoftDevice events captured by cus_evtcap through the dispatch of the
+ *        host build of the application.
+ *
+ * @details Reads the UART output of the firmware, on stdin or from a file, and keeps the last
+ *          dump in it (see RPC_EVTCAP_DUMP of main.c). Its events are given to ble_evt_dispatch
+ *          at their recorded times, through the emulated stack, which follows them instead of
+ *          running its own link. A dump that does not start with the connection gets one first,
+ *          so that the handlers see a connected link.
+ *
+ *          Each handler called by ble_evt_dispatch is timed on the host clock: the calls are
+ *          wrapped at link time (see the Makefile). The times are for comparing two builds of
+ *          the handlers on the same trace, not cycles of the device.
+ *
+ *          Usage: evt_replay [-p app_timer_prescaler] [-v] [file]
+ *
+ *          -v prints each event with the time of its dispatch.
+ *
+ * @note The payload of queued writes is not replayed: the SoftDevice writes it straight into
+ *       the memory block of the application, not into the event.
+ */
+#include "sd_emu.h"
+#include "hal_emu.h"
+
+#include "sdk_config.h"
+#include "sdk_common.h"
+#include "softdevice_handler.h"
+#include "ble_advertising.h"
+#include "ble_conn_params.h"
+#include "bsp_btn_ble.h"
+#include "cus_service.h"
+#include "cus_tx.h"
+#include "cus_qwr.h"
+#include "cus_arq.h"
+#include "cus_obj.h"
+#include "cus_bench.h"
+#include "cus_evtcap.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#define RTC_FREQ                        32768
+#define STAMP_MASK                      0x00FFFFFFu
+#define REPLAY_START_US                 200000                    /**< Emulated time of the first event, after the start of the application. */
+#define RECORD_MAX_LEN                  (2 + CUS_EVTCAP_ENTRY_HEADER_LEN + CUS_EVTCAP_MAX_BODY_LEN + 1)
+#define EVT_MAX_LEN                     (sizeof(ble_evt_hdr_t) + CUS_EVTCAP_MAX_BODY_LEN)
+#define REPLAY_CONN_INTERVAL            24                        /**< Of a connection missing from the dump, in 1.25 ms units. */
+#define REPLAY_TX_BUFFERS               7                         /**< Freed by the TX_COMPLETE events of the dump. */
+#define MAX_HANDLERS                    16
+#define MAX_EVT_IDS                     256
+
+int app_main(void);
+
+typedef struct
+{
+    uint64_t    time_us;                                          /**< Emulated time of the dispatch. */
+    uint16_t    len;                                              /**< header.evt_len. */
+    union
+    {
+        ble_evt_t evt;
+        uint8_t   raw[EVT_MAX_LEN];                               /**< Room for the data of a write. */
+    } u;
+} replay_evt_t;
+
+typedef struct
+{
+    char const * p_name;
+    void const * p_instance;                                      /**< First parameter of the handlers of a module instance, else NULL. */
+    uint32_t     calls;
+    uint64_t     total_ns;
+    uint64_t     max_ns;
+} handler_stats_t;
+
+typedef struct
+{
+    uint32_t     count;
+    uint64_t     total_ns;
+    uint64_t     max_ns;
+} evt_stats_t;
+
+static unsigned          m_prescaler;
+static bool              m_verbose;
+static replay_evt_t    * m_evts;
+static uint32_t          m_evt_count;
+static uint32_t          m_evt_next;
+static uint32_t          m_dump_records;                          /**< Announced by the start entry of the dump. */
+static uint32_t          m_dump_overwritten;
+static uint32_t          m_dump_missed;
+static uint32_t          m_bad_records;
+static ble_evt_handler_t m_app_handler;
+static handler_stats_t   m_handlers[MAX_HANDLERS];
+static uint8_t           m_handler_count;
+static evt_stats_t       m_evt_stats[MAX_EVT_IDS];
+static evt_stats_t       m_dispatch;
+
+
+static uint64_t clock_ns(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000u + ts.tv_nsec;
+}
+
+
+static void handler_account(char const * p_name, void const * p_instance, uint64_t ns)
+{
+    handler_stats_t * p_stats = NULL;
+
+    for (uint8_t i = 0; i < m_handler_count; i++)
+    {
+        if ((m_handlers[i].p_name == p_name) && (m_handlers[i].p_instance == p_instance))
+        {
+            p_stats = &m_handlers[i];
+            break;
+        }
+    }
+    if (p_stats == NULL)
+    {
+        if (m_handler_count >= MAX_HANDLERS)
+        {
+            return;
+        }
+        p_stats             = &m_handlers[m_handler_count++];
+        p_stats->p_name     = p_name;
+        p_stats->p_instance = p_instance;
+    }
+
+    p_stats->calls++;
+    p_stats->total_ns += ns;
+    p_stats->max_ns    = MAX(p_stats->max_ns, ns);
+}
+
+
+static void evt_account(evt_stats_t * p_stats, uint64_t ns)
+{
+    p_stats->count++;
+    p_stats->total_ns += ns;
+    p_stats->max_ns    = MAX(p_stats->max_ns, ns);
+}
+
+
+/* Handlers of ble_evt_dispatch, wrapped with -Wl,--wrap=<name>. */
+
+#define HANDLER_WRAP(name, type)                                                \
+    void __real_##name(type p_ble_evt);                                         \
+    void __wrap_##name(type p_ble_evt)                                          \
+    {                                                                           \
+        uint64_t start = clock_ns();                                            \
+        __real_##name(p_ble_evt);                                               \
+        handler_account(#name, NULL, clock_ns() - start);                       \
+    }
+
+#define INSTANCE_HANDLER_WRAP(name, instance_type)                              \
+    void __real_##name(instance_type * p_instance, ble_evt_t * p_ble_evt);      \
+    void __wrap_##name(instance_type * p_instance, ble_evt_t * p_ble_evt)       \
+    {                                                                           \
+        uint64_t start = clock_ns();                                            \
+        __real_##name(p_instance, p_ble_evt);                                   \
+        handler_account(#name, p_instance, clock_ns() - start);                 \
+    }
+
+HANDLER_WRAP(ble_conn_params_on_ble_evt, ble_evt_t *)
+HANDLER_WRAP(cus_tx_on_ble_evt, ble_evt_t *)
+HANDLER_WRAP(cus_qwr_on_ble_evt, ble_evt_t *)
+INSTANCE_HANDLER_WRAP(ble_cus_on_ble_evt, ble_cus_t)
+INSTANCE_HANDLER_WRAP(cus_arq_on_ble_evt, cus_arq_t)
+HANDLER_WRAP(cus_obj_on_ble_evt, ble_evt_t *)
+HANDLER_WRAP(cus_bench_on_ble_evt, ble_evt_t *)
+HANDLER_WRAP(ble_advertising_on_ble_evt, ble_evt_t const * const)
+HANDLER_WRAP(bsp_btn_ble_on_ble_evt, ble_evt_t *)
+
+
+/**@brief Dispatch of the application, timed as a whole: on_ble_evt of main.c is the part not
+ *        covered by the handlers above.
+ */
+static void dispatch_timed(ble_evt_t * p_ble_evt)
+{
+    uint64_t start = clock_ns();
+    uint64_t ns;
+
+    m_app_handler(p_ble_evt);
+
+    ns = clock_ns() - start;
+    evt_account(&m_dispatch, ns);
+    evt_account(&m_evt_stats[p_ble_evt->header.evt_id % MAX_EVT_IDS], ns);
+    if (m_verbose)
+    {
+        printf("[%12.6f] evt 0x%02X, %u bytes: %llu ns\n", sd_emu_now() / 1e6, p_ble_evt->header.evt_id,
+               p_ble_evt->header.evt_len, (unsigned long long)ns);
+    }
+}
+
+
+uint32_t __real_softdevice_ble_evt_handler_set(ble_evt_handler_t ble_evt_handler);
+
+uint32_t __wrap_softdevice_ble_evt_handler_set(ble_evt_handler_t ble_evt_handler)
+{
+    m_app_handler = ble_evt_handler;
+    return __real_softdevice_ble_evt_handler_set(dispatch_timed);
+}
+
+
+static char const * evt_name(uint8_t evt_id)
+{
+    switch (evt_id)
+    {
+        case BLE_EVT_TX_COMPLETE:                   return "TX_COMPLETE";
+        case BLE_EVT_USER_MEM_REQUEST:              return "USER_MEM_REQUEST";
+        case BLE_EVT_USER_MEM_RELEASE:              return "USER_MEM_RELEASE";
+        case BLE_GAP_EVT_CONNECTED:                 return "GAP_CONNECTED";
+        case BLE_GAP_EVT_DISCONNECTED:              return "GAP_DISCONNECTED";
+        case BLE_GAP_EVT_CONN_PARAM_UPDATE:         return "GAP_CONN_PARAM_UPDATE";
+        case BLE_GAP_EVT_SEC_PARAMS_REQUEST:        return "GAP_SEC_PARAMS_REQUEST";
+        case BLE_GAP_EVT_SEC_INFO_REQUEST:          return "GAP_SEC_INFO_REQUEST";
+        case BLE_GAP_EVT_AUTH_STATUS:               return "GAP_AUTH_STATUS";
+        case BLE_GAP_EVT_CONN_SEC_UPDATE:           return "GAP_CONN_SEC_UPDATE";
+        case BLE_GAP_EVT_TIMEOUT:                   return "GAP_TIMEOUT";
+        case BLE_GAP_EVT_RSSI_CHANGED:              return "GAP_RSSI_CHANGED";
+        case BLE_GAP_EVT_SEC_REQUEST:               return "GAP_SEC_REQUEST";
+        case BLE_GAP_EVT_CONN_PARAM_UPDATE_REQUEST: return "GAP_CONN_PARAM_UPDATE_REQUEST";
+        case BLE_GATTS_EVT_WRITE:                   return "GATTS_WRITE";
+        case BLE_GATTS_EVT_RW_AUTHORIZE_REQUEST:    return "GATTS_RW_AUTHORIZE_REQUEST";
+        case BLE_GATTS_EVT_SYS_ATTR_MISSING:        return "GATTS_SYS_ATTR_MISSING";
+        case BLE_GATTS_EVT_HVC:                     return "GATTS_HVC";
+        case BLE_GATTS_EVT_SC_CONFIRM:              return "GATTS_SC_CONFIRM";
+        case BLE_GATTS_EVT_TIMEOUT:                 return "GATTS_TIMEOUT";
+        default:                                    return "?";
+    }
+}
+
+
+static void report(void)
+{
+    printf("\n%u events replayed over %.3f s", (unsigned)m_evt_next,
+           (m_evt_count > 0) ? (m_evts[m_evt_count - 1].time_us - m_evts[0].time_us) / 1e6 : 0.0);
+    if (m_dispatch.count > 0)
+    {
+        printf(", dispatch mean %llu ns, max %llu ns",
+               (unsigned long long)(m_dispatch.total_ns / m_dispatch.count), (unsigned long long)m_dispatch.max_ns);
+    }
+    printf("\n\n%-32s %8s %10s %10s\n", "event", "count", "mean ns", "max ns");
+    for (uint16_t i = 0; i < MAX_EVT_IDS; i++)
+    {
+        if (m_evt_stats[i].count > 0)
+        {
+            printf("0x%02X %-27s %8u %10llu %10llu\n", i, evt_name((uint8_t)i), (unsigned)m_evt_stats[i].count,
+                   (unsigned long long)(m_evt_stats[i].total_ns / m_evt_stats[i].count),
+                   (unsigned long long)m_evt_stats[i].max_ns);
+        }
+    }
+
+    printf("\n%-32s %8s %10s %10s %10s\n", "handler", "calls", "total us", "mean ns", "max ns");
+    for (uint8_t i = 0; i < m_handler_count; i++)
+    {
+        handler_stats_t const * p_stats = &m_handlers[i];
+        char                    name[48];
+        uint8_t                 instance = 0;
+
+        // Instances are numbered in the order of their first event, as they are dispatched.
+        for (uint8_t j = 0; j <= i; j++)
+        {
+            instance += (m_handlers[j].p_name == p_stats->p_name);
+        }
+        if (p_stats->p_instance != NULL)
+        {
+            snprintf(name, sizeof(name), "%s #%u", p_stats->p_name, instance);
+        }
+        else
+        {
+            snprintf(name, sizeof(name), "%s", p_stats->p_name);
+        }
+        printf("%-32s %8u %10.1f %10llu %10llu\n", name, (unsigned)p_stats->calls, p_stats->total_ns / 1e3,
+               (unsigned long long)(p_stats->total_ns / p_stats->calls), (unsigned long long)p_stats->max_ns);
+    }
+    fflush(stdout);
+}
+
+
+/* Reading of the dump. */
+
+static void evt_add(uint8_t evt_id, void const * p_body, uint8_t body_len, uint64_t time_us)
+{
+    static uint32_t size;
+    replay_evt_t  * p_evt;
+    ble_evt_t     * p_ble_evt;
+
+    if (m_evt_count >= size)
+    {
+        size   = MAX(2 * size, 256);
+        m_evts = realloc(m_evts, size * sizeof(replay_evt_t));
+        if (m_evts == NULL)
+        {
+            perror("evt_replay");
+            exit(EXIT_FAILURE);
+        }
+    }
+
+    p_evt     = &m_evts[m_evt_count++];
+    p_ble_evt = &p_evt->u.evt;
+    memset(p_evt, 0, sizeof(*p_evt));
+    p_evt->time_us            = time_us;
+    p_evt->len                = sizeof(ble_evt_hdr_t) + body_len;
+    p_ble_evt->header.evt_id  = evt_id;
+    p_ble_evt->header.evt_len = p_evt->len;
+    memcpy(&p_ble_evt->evt, p_body, body_len);
+}
+
+
+static bool record_valid(uint8_t const * p_record, size_t len)
+{
+    uint8_t check = 0;
+
+    for (size_t i = 2; i < len - 1; i++)
+    {
+        check ^= p_record[i];
+    }
+    return check == p_record[len - 1];
+}
+
+
+/**@brief Function for reading the last dump of the UART output. */
+static void dump_read(FILE * p_in)
+{
+    uint8_t  window[RECORD_MAX_LEN];
+    size_t   len = 0;
+    uint32_t last_stamp = 0;
+    uint64_t ticks = 0;
+    bool     started = false;
+    int      c;
+
+    while ((c = getc(p_in)) != EOF)
+    {
+        window[len++] = (uint8_t)c;
+
+        while (len > 0)
+        {
+            bool   is_record  = (window[0] == CUS_EVTCAP_SYNC_0) && ((len < 2) || (window[1] == CUS_EVTCAP_SYNC_1));
+            size_t record_len = (len > 2) ? (2 + CUS_EVTCAP_ENTRY_HEADER_LEN + window[2] + 1) : RECORD_MAX_LEN;
+
+            if (is_record && (len < record_len))
+            {
+                break;
+            }
+            if (is_record && record_valid(window, record_len))
+            {
+                uint8_t const * p_entry = &window[2];
+                uint32_t        stamp   = p_entry[2] | (p_entry[3] << 8) | ((uint32_t)p_entry[4] << 16);
+
+                if (p_entry[1] == CUS_EVTCAP_ID_START)
+                {
+                    // A new dump replaces the previous one.
+                    if ((p_entry[0] >= CUS_EVTCAP_START_BODY_LEN))
+                    {
+                        m_dump_records     = uint16_decode(&p_entry[CUS_EVTCAP_ENTRY_HEADER_LEN]);
+                        m_dump_overwritten = uint32_decode(&p_entry[CUS_EVTCAP_ENTRY_HEADER_LEN + 2]);
+                        m_dump_missed      = uint32_decode(&p_entry[CUS_EVTCAP_ENTRY_HEADER_LEN + 6]);
+                    }
+                    m_evt_count = 0;
+                    started     = false;
+                }
+                else
+                {
+                    if (started)
+                    {
+                        ticks += (stamp - last_stamp) & STAMP_MASK;
+                    }
+                    started    = true;
+                    last_stamp = stamp;
+                    evt_add(p_entry[1], &p_entry[CUS_EVTCAP_ENTRY_HEADER_LEN], p_entry[0],
+                            REPLAY_START_US + ticks * (m_prescaler + 1) * 1000000 / RTC_FREQ);
+                }
+
+                memmove(window, &window[record_len], len - record_len);
+                len -= record_len;
+                continue;
+            }
+            if (is_record)
+            {
+                m_bad_records++;
+            }
+
+            // Not a record, or one cut by other output.
+            memmove(window, &window[1], --len);
+        }
+    }
+}
+
+
+/**@brief Function for giving a connection to a dump that starts after it. */
+static void connection_add(void)
+{
+    ble_gap_evt_t gap_evt;
+    replay_evt_t  evt;
+
+    memset(&gap_evt, 0, sizeof(gap_evt));
+    gap_evt.params.connected.role                          = BLE_GAP_ROLE_PERIPH;
+    gap_evt.params.connected.conn_params.min_conn_interval = REPLAY_CONN_INTERVAL;
+    gap_evt.params.connected.conn_params.max_conn_interval = REPLAY_CONN_INTERVAL;
+    gap_evt.params.connected.conn_params.conn_sup_timeout  = 400;
+
+    evt_add(BLE_GAP_EVT_CONNECTED, &gap_evt, (uint8_t)MIN(sizeof(gap_evt), CUS_EVTCAP_MAX_BODY_LEN),
+            REPLAY_START_US / 2);
+
+    // Moved in front of the dump.
+    evt = m_evts[m_evt_count - 1];
+    memmove(&m_evts[1], &m_evts[0], (m_evt_count - 1) * sizeof(replay_evt_t));
+    m_evts[0] = evt;
+}
+
+
+/* Replay. */
+
+static uint64_t replay_due(void)
+{
+    if (m_evt_next < m_evt_count)
+    {
+        return m_evts[m_evt_next].time_us;
+    }
+    // The last event has been dispatched, events go before the sources.
+    return sd_emu_now();
+}
+
+
+static void replay_run(void)
+{
+    if (m_evt_next >= m_evt_count)
+    {
+        exit(EXIT_SUCCESS);
+    }
+    sd_emu_evt_inject(&m_evts[m_evt_next++].u.evt);
+}
+
+
+static void usage(void)
+{
+    fprintf(stderr, "usage: evt_replay [-p app_timer_prescaler] [-v] [file]\n");
+    exit(EXIT_FAILURE);
+}
+
+
+int main(int argc, char ** argv)
+{
+    static sd_emu_source_t const replay = {replay_due, replay_run};
+    sd_emu_peer_t                peer   = {NULL, NULL, NULL, NULL, NULL};
+    sd_emu_cfg_t                 cfg;
+    FILE                       * p_in = stdin;
+    int                          opt;
+
+    while ((opt = getopt(argc, argv, "p:v")) != -1)
+    {
+        switch (opt)
+        {
+            case 'p': m_prescaler = (unsigned)strtoul(optarg, NULL, 0); break;
+            case 'v': m_verbose   = true;                               break;
+            default:  usage();
+        }
+    }
+    if (optind < argc)
+    {
+        p_in = fopen(argv[optind], "rb");
+        if (p_in == NULL)
+        {
+            perror(argv[optind]);
+            return EXIT_FAILURE;
+        }
+    }
+
+    dump_read(p_in);
+    if (m_evt_count == 0)
+    {
+        fprintf(stderr, "evt_replay: no captured event in the input\n");
+        return EXIT_FAILURE;
+    }
+    printf("dump: %u events (%u announced), %u overwritten, %u missed, %u bad records\n",
+           (unsigned)m_evt_count, (unsigned)m_dump_records, (unsigned)m_dump_overwritten,
+           (unsigned)m_dump_missed, (unsigned)m_bad_records);
+
+    if (m_evts[0].u.evt.header.evt_id != BLE_GAP_EVT_CONNECTED)
+    {
+        connection_add();
+    }
+
+    memset(&cfg, 0, sizeof(cfg));
+    cfg.conn_interval = REPLAY_CONN_INTERVAL;
+    cfg.tx_buffers    = REPLAY_TX_BUFFERS;
+    cfg.tx_per_event  = 1;
+    cfg.replay        = true;
+
+    sd_emu_init(&cfg, &peer);
+    hal_emu_init();
+    sd_emu_source_add(&replay);
+    atexit(report);
+
+    return app_main();
+}
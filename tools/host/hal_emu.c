@@ -0,0 +1,687 @@
+/**@file
+ *
+ * @brief Stand-ins of the SDK libraries that drive peripherals: app_timer, app_uart, fstorage,
+ *        bsp, app_error and the critical regions of app_util_platform.
+ *
+ * @details Everything runs on the clock of the SoftDevice emulator. Timer, UART and flash
+ *          handlers run as emulated interrupt handlers, one at a time.
+ */
+#include "hal_emu.h"
+#include "sd_emu.h"
+
+#include "sdk_common.h"
+#include "app_timer.h"
+#include "app_uart.h"
+#include "app_util_platform.h"
+#include "bsp.h"
+#include "bsp_btn_ble.h"
+#include "fstorage.h"
+#include "nrf_soc.h"
+#include "nrf_nvic.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+
+#define EMU_RTC_FREQ                    32768
+#define EMU_RTC_MASK                    0x00FFFFFF                /**< The RTC counter has 24 bits. */
+#define EMU_TIMER_MAX                   16
+#define EMU_FLASH_PAGES                 32
+#define EMU_FS_QUEUE_SIZE               4
+#define EMU_FLASH_WORD_US               46                        /**< nRF51 word write time, maximum. */
+#define EMU_FLASH_PAGE_US               22300                     /**< nRF51 page erase time, maximum. */
+
+typedef struct
+{
+    app_timer_timeout_handler_t handler;
+    app_timer_mode_t            mode;
+    void                      * p_context;
+    bool                        active;
+    uint64_t                    expiry;                           /**< In RTC ticks at 32768 Hz since the start, not wrapped. */
+    uint32_t                    period;                           /**< In RTC ticks at 32768 Hz. */
+} emu_timer_t;
+
+typedef struct
+{
+    fs_config_t const * p_config;
+    fs_evt_id_t         id;
+    uint32_t          * p_dest;
+    uint32_t const    * p_src;
+    uint16_t            length;                                   /**< Words to store or pages to erase. */
+    void              * p_context;
+} emu_fs_op_t;
+
+
+static emu_timer_t              m_timers[EMU_TIMER_MAX];
+static uint8_t                  m_timer_count;
+static uint32_t                 m_prescaler;
+static bool                     m_timer_init;
+static uint8_t                  m_timer_fired;
+
+static app_uart_event_handler_t m_uart_handler;
+static bool                     m_uart_open;
+static uint8_t                * m_rx_buf;
+static uint32_t                 m_rx_size;
+static uint32_t                 m_rx_head;
+static uint32_t                 m_rx_count;
+static uint32_t                 m_uart_rate;
+static uint8_t               (* m_uart_next)(void);
+static void                  (* m_uart_tx)(uint8_t byte);
+static uint64_t                 m_uart_start;
+static uint64_t                 m_uart_bytes;                     /**< Bytes received since m_uart_start. */
+static bool                     m_uart_tx_put;                    /**< Bytes were written since the last APP_UART_TX_EMPTY. */
+
+static uint32_t                 m_flash[EMU_FLASH_PAGES * FS_PAGE_SIZE_WORDS];
+static bool                     m_fs_init;
+static emu_fs_op_t              m_fs_ops[EMU_FS_QUEUE_SIZE];
+static uint8_t                  m_fs_head;
+static uint8_t                  m_fs_count;
+static bool                     m_fs_started;                     /**< The operation at the head is under way. */
+static bool                     m_fs_raised;                      /**< Its SoC event is raised. */
+static uint64_t                 m_fs_done_at;
+
+extern fs_config_t __start_fs_data __attribute__((weak));
+extern fs_config_t __stop_fs_data __attribute__((weak));
+
+
+uint32_t hal_emu_ticks(uint64_t time_us)
+{
+    return (uint32_t)((time_us * EMU_RTC_FREQ / 1000000) & EMU_RTC_MASK);
+}
+
+
+static uint64_t rtc_now(void)
+{
+    return sd_emu_now() * EMU_RTC_FREQ / 1000000;
+}
+
+
+static uint64_t rtc_to_us(uint64_t ticks)
+{
+    return (ticks * 1000000 + EMU_RTC_FREQ - 1) / EMU_RTC_FREQ;
+}
+
+
+/* app_timer */
+
+static emu_timer_t * timer_get(app_timer_id_t timer_id)
+{
+    if ((timer_id == NULL) || (timer_id->data[0] == 0) || (timer_id->data[0] > m_timer_count))
+    {
+        return NULL;
+    }
+    return &m_timers[timer_id->data[0] - 1];
+}
+
+
+static uint64_t timer_due(void)
+{
+    uint64_t due = UINT64_MAX;
+
+    for (uint8_t i = 0; i < m_timer_count; i++)
+    {
+        if (m_timers[i].active)
+        {
+            due = MIN(due, rtc_to_us(m_timers[i].expiry));
+        }
+    }
+    return due;
+}
+
+
+static void timer_fire(void)
+{
+    emu_timer_t * p_timer = &m_timers[m_timer_fired];
+
+    p_timer->handler(p_timer->p_context);
+}
+
+
+static void timer_run(void)
+{
+    uint8_t next = 0;
+
+    for (uint8_t i = 1; i < m_timer_count; i++)
+    {
+        if (m_timers[i].active && (!m_timers[next].active || (m_timers[i].expiry < m_timers[next].expiry)))
+        {
+            next = i;
+        }
+    }
+
+    if (m_timers[next].mode == APP_TIMER_MODE_REPEATED)
+    {
+        m_timers[next].expiry += m_timers[next].period;
+    }
+    else
+    {
+        m_timers[next].active = false;
+    }
+
+    m_timer_fired = next;
+    sd_emu_irq_run(timer_fire);
+}
+
+
+uint32_t app_timer_init(uint32_t                      prescaler,
+                        uint8_t                       op_queue_size,
+                        void                        * p_buffer,
+                        app_timer_evt_schedule_func_t evt_schedule_func)
+{
+    UNUSED_PARAMETER(op_queue_size);
+    UNUSED_PARAMETER(p_buffer);
+    VERIFY_TRUE(evt_schedule_func == NULL, NRF_ERROR_NOT_SUPPORTED);
+    VERIFY_TRUE(prescaler <= 0xFFF, NRF_ERROR_INVALID_PARAM);
+
+    m_prescaler  = prescaler;
+    m_timer_init = true;
+    return NRF_SUCCESS;
+}
+
+
+uint32_t app_timer_create(app_timer_id_t const      * p_timer_id,
+                          app_timer_mode_t            mode,
+                          app_timer_timeout_handler_t timeout_handler)
+{
+    VERIFY_TRUE(m_timer_init, NRF_ERROR_INVALID_STATE);
+    VERIFY_PARAM_NOT_NULL(p_timer_id);
+    VERIFY_PARAM_NOT_NULL(*p_timer_id);
+    VERIFY_TRUE(timeout_handler != NULL, NRF_ERROR_INVALID_PARAM);
+    VERIFY_TRUE(m_timer_count < EMU_TIMER_MAX, NRF_ERROR_NO_MEM);
+
+    memset(&m_timers[m_timer_count], 0, sizeof(m_timers[0]));
+    m_timers[m_timer_count].handler = timeout_handler;
+    m_timers[m_timer_count].mode    = mode;
+    (*p_timer_id)->data[0]          = ++m_timer_count;
+
+    return NRF_SUCCESS;
+}
+
+
+uint32_t app_timer_start(app_timer_id_t timer_id, uint32_t timeout_ticks, void * p_context)
+{
+    emu_timer_t * p_timer = timer_get(timer_id);
+
+    VERIFY_TRUE(p_timer != NULL, NRF_ERROR_INVALID_STATE);
+    VERIFY_TRUE((timeout_ticks >= APP_TIMER_MIN_TIMEOUT_TICKS) && (timeout_ticks <= EMU_RTC_MASK),
+                NRF_ERROR_INVALID_PARAM);
+
+    // Starting a running timer is ignored, as app_timer does.
+    if (!p_timer->active)
+    {
+        p_timer->active    = true;
+        p_timer->p_context = p_context;
+        p_timer->period    = timeout_ticks * (m_prescaler + 1);
+        p_timer->expiry    = rtc_now() + p_timer->period;
+    }
+    return NRF_SUCCESS;
+}
+
+
+uint32_t app_timer_stop(app_timer_id_t timer_id)
+{
+    emu_timer_t * p_timer = timer_get(timer_id);
+
+    VERIFY_TRUE(p_timer != NULL, NRF_ERROR_INVALID_STATE);
+    p_timer->active = false;
+    return NRF_SUCCESS;
+}
+
+
+uint32_t app_timer_stop_all(void)
+{
+    for (uint8_t i = 0; i < m_timer_count; i++)
+    {
+        m_timers[i].active = false;
+    }
+    return NRF_SUCCESS;
+}
+
+
+uint32_t app_timer_cnt_get(uint32_t * p_ticks)
+{
+    *p_ticks = (uint32_t)((rtc_now() / (m_prescaler + 1)) & EMU_RTC_MASK);
+    return NRF_SUCCESS;
+}
+
+
+uint32_t app_timer_cnt_diff_compute(uint32_t ticks_to, uint32_t ticks_from, uint32_t * p_ticks_diff)
+{
+    *p_ticks_diff = (ticks_to - ticks_from) & EMU_RTC_MASK;
+    return NRF_SUCCESS;
+}
+
+
+/* app_uart */
+
+static uint64_t uart_due(void)
+{
+    if (!m_uart_open || (m_uart_rate == 0) || (m_uart_next == NULL))
+    {
+        return UINT64_MAX;
+    }
+    return m_uart_start + (m_uart_bytes + 1) * 1000000 / m_uart_rate;
+}
+
+
+static void uart_irq(void)
+{
+    app_uart_evt_t evt;
+
+    evt.evt_type = APP_UART_DATA_READY;
+    m_uart_handler(&evt);
+}
+
+
+static void uart_run(void)
+{
+    uint8_t byte = m_uart_next();
+
+    m_uart_bytes++;
+    if (m_rx_count >= m_rx_size)
+    {
+        app_uart_evt_t evt;
+
+        evt.evt_type        = APP_UART_FIFO_ERROR;
+        evt.data.error_code = NRF_ERROR_NO_MEM;
+        m_uart_handler(&evt);
+        return;
+    }
+
+    m_rx_buf[(m_rx_head + m_rx_count++) % m_rx_size] = byte;
+    sd_emu_irq_run(uart_irq);
+}
+
+
+static uint64_t uart_tx_due(void)
+{
+    return m_uart_tx_put ? sd_emu_now() : UINT64_MAX;
+}
+
+
+static void uart_tx_irq(void)
+{
+    app_uart_evt_t evt;
+
+    evt.evt_type = APP_UART_TX_EMPTY;
+    m_uart_handler(&evt);
+}
+
+
+static void uart_tx_run(void)
+{
+    m_uart_tx_put = false;
+    sd_emu_irq_run(uart_tx_irq);
+}
+
+
+void hal_emu_uart_rx_set(uint32_t bytes_per_s, uint8_t (*next_byte)(void))
+{
+    m_uart_rate  = bytes_per_s;
+    m_uart_next  = next_byte;
+    m_uart_start = sd_emu_now();
+    m_uart_bytes = 0;
+}
+
+
+void hal_emu_uart_tx_set(void (*tx_handler)(uint8_t byte))
+{
+    m_uart_tx = tx_handler;
+}
+
+
+uint32_t app_uart_init(const app_uart_comm_params_t * p_comm_params,
+                       app_uart_buffers_t *           p_buffers,
+                       app_uart_event_handler_t       error_handler,
+                       app_irq_priority_t             irq_priority)
+{
+    UNUSED_PARAMETER(p_comm_params);
+    UNUSED_PARAMETER(irq_priority);
+    VERIFY_PARAM_NOT_NULL(p_buffers);
+    VERIFY_PARAM_NOT_NULL(error_handler);
+
+    m_uart_handler = error_handler;
+    m_rx_buf       = p_buffers->rx_buf;
+    m_rx_size      = p_buffers->rx_buf_size;
+    m_rx_head      = 0;
+    m_rx_count     = 0;
+    m_uart_open    = true;
+    m_uart_start   = sd_emu_now();
+    m_uart_bytes   = 0;
+
+    return NRF_SUCCESS;
+}
+
+
+uint32_t app_uart_get(uint8_t * p_byte)
+{
+    VERIFY_TRUE(m_rx_count > 0, NRF_ERROR_NOT_FOUND);
+
+    *p_byte    = m_rx_buf[m_rx_head];
+    m_rx_head  = (m_rx_head + 1) % m_rx_size;
+    m_rx_count--;
+    return NRF_SUCCESS;
+}
+
+
+uint32_t app_uart_put(uint8_t byte)
+{
+    VERIFY_TRUE(m_uart_open, NRF_ERROR_INVALID_STATE);
+
+    // Sent at once: the TX FIFO is never full, and drained as soon as the application yields.
+    if (m_uart_tx != NULL)
+    {
+        m_uart_tx(byte);
+    }
+    m_uart_tx_put = true;
+    return NRF_SUCCESS;
+}
+
+
+uint32_t app_uart_flush(void)
+{
+    m_rx_count = 0;
+    return NRF_SUCCESS;
+}
+
+
+uint32_t app_uart_close(void)
+{
+    m_uart_open = false;
+    return NRF_SUCCESS;
+}
+
+
+/* fstorage */
+
+static bool fs_config_valid(fs_config_t const * p_config)
+{
+    return (p_config >= &__start_fs_data) && (p_config < &__stop_fs_data);
+}
+
+
+static void fs_op_start(void)
+{
+    emu_fs_op_t const * p_op = &m_fs_ops[m_fs_head];
+
+    if ((m_fs_count == 0) || m_fs_started)
+    {
+        return;
+    }
+
+    m_fs_started = true;
+    m_fs_raised  = false;
+    m_fs_done_at = sd_emu_now() + p_op->length * ((p_op->id == FS_EVT_STORE) ? EMU_FLASH_WORD_US : EMU_FLASH_PAGE_US);
+}
+
+
+static uint64_t fs_due(void)
+{
+    return (m_fs_started && !m_fs_raised) ? m_fs_done_at : UINT64_MAX;
+}
+
+
+static void fs_run(void)
+{
+    emu_fs_op_t const * p_op = &m_fs_ops[m_fs_head];
+
+    if (p_op->id == FS_EVT_STORE)
+    {
+        // Flash bits only go from 1 to 0.
+        for (uint16_t i = 0; i < p_op->length; i++)
+        {
+            p_op->p_dest[i] &= p_op->p_src[i];
+        }
+    }
+    else
+    {
+        memset(p_op->p_dest, 0xFF, p_op->length * FS_PAGE_SIZE_WORDS * sizeof(uint32_t));
+    }
+
+    m_fs_raised = true;
+    sd_emu_sys_evt_raise(NRF_EVT_FLASH_OPERATION_SUCCESS);
+}
+
+
+static fs_ret_t fs_op_queue(fs_config_t const * p_config, fs_evt_id_t id, uint32_t const * p_dest,
+                            uint32_t const * p_src, uint16_t length, void * p_context)
+{
+    uint32_t      words = (id == FS_EVT_STORE) ? length : length * FS_PAGE_SIZE_WORDS;
+    emu_fs_op_t * p_op;
+
+    if (!m_fs_init)
+    {
+        return FS_ERR_NOT_INITIALIZED;
+    }
+    if (!fs_config_valid(p_config))
+    {
+        return FS_ERR_INVALID_CFG;
+    }
+    if ((p_dest == NULL) || (p_src == NULL))
+    {
+        return FS_ERR_NULL_ARG;
+    }
+    if (length == 0)
+    {
+        return FS_ERR_INVALID_ARG;
+    }
+    if ((p_dest < p_config->p_start_addr) || (p_dest + words > p_config->p_end_addr))
+    {
+        return FS_ERR_INVALID_ADDR;
+    }
+    if (m_fs_count >= EMU_FS_QUEUE_SIZE)
+    {
+        return FS_ERR_QUEUE_FULL;
+    }
+
+    p_op = &m_fs_ops[(m_fs_head + m_fs_count++) % EMU_FS_QUEUE_SIZE];
+    p_op->p_config  = p_config;
+    p_op->id        = id;
+    p_op->p_dest    = (uint32_t *)p_dest;
+    p_op->p_src     = p_src;
+    p_op->length    = length;
+    p_op->p_context = p_context;
+
+    fs_op_start();
+    return FS_SUCCESS;
+}
+
+
+fs_ret_t fs_init(void)
+{
+    uint16_t page = 0;
+
+    if (m_fs_init)
+    {
+        return FS_SUCCESS;
+    }
+
+    memset(m_flash, 0xFF, sizeof(m_flash));
+
+    for (fs_config_t * p_config = &__start_fs_data; p_config < &__stop_fs_data; p_config++)
+    {
+        if (page + p_config->num_pages > EMU_FLASH_PAGES)
+        {
+            return FS_ERR_INVALID_CFG;
+        }
+        p_config->p_start_addr = &m_flash[page * FS_PAGE_SIZE_WORDS];
+        page                  += p_config->num_pages;
+        p_config->p_end_addr   = &m_flash[page * FS_PAGE_SIZE_WORDS];
+    }
+
+    m_fs_init = true;
+    return FS_SUCCESS;
+}
+
+
+fs_ret_t fs_store(fs_config_t const * const p_config,
+                  uint32_t    const * const p_dest,
+                  uint32_t    const * const p_src,
+                  uint16_t    const         length_words,
+                  void *                    p_context)
+{
+    return fs_op_queue(p_config, FS_EVT_STORE, p_dest, p_src, length_words, p_context);
+}
+
+
+fs_ret_t fs_erase(fs_config_t const * const p_config,
+                  uint32_t    const * const p_page_addr,
+                  uint16_t    const         num_pages,
+                  void *                    p_context)
+{
+    if (((p_page_addr - m_flash) % FS_PAGE_SIZE_WORDS) != 0)
+    {
+        return FS_ERR_UNALIGNED_ADDR;
+    }
+    return fs_op_queue(p_config, FS_EVT_ERASE, p_page_addr, p_page_addr, num_pages, p_context);
+}
+
+
+fs_ret_t fs_queued_op_count_get(uint32_t * const p_op_count)
+{
+    if (p_op_count == NULL)
+    {
+        return FS_ERR_NULL_ARG;
+    }
+    *p_op_count = m_fs_count;
+    return FS_SUCCESS;
+}
+
+
+void fs_sys_event_handler(uint32_t sys_evt)
+{
+    emu_fs_op_t op = m_fs_ops[m_fs_head];
+    fs_evt_t    evt;
+
+    if (((sys_evt != NRF_EVT_FLASH_OPERATION_SUCCESS) && (sys_evt != NRF_EVT_FLASH_OPERATION_ERROR)) ||
+        !m_fs_started || !m_fs_raised)
+    {
+        return;
+    }
+
+    m_fs_head    = (m_fs_head + 1) % EMU_FS_QUEUE_SIZE;
+    m_fs_count--;
+    m_fs_started = false;
+
+    memset(&evt, 0, sizeof(evt));
+    evt.id        = op.id;
+    evt.p_context = op.p_context;
+    if (op.id == FS_EVT_STORE)
+    {
+        evt.store.p_data       = op.p_dest;
+        evt.store.length_words = op.length;
+    }
+    else
+    {
+        evt.erase.first_page = (uint16_t)((op.p_dest - m_flash) / FS_PAGE_SIZE_WORDS);
+        evt.erase.last_page  = evt.erase.first_page + op.length - 1;
+    }
+
+    if (op.p_config->callback != NULL)
+    {
+        op.p_config->callback(&evt, FS_SUCCESS);
+    }
+    fs_op_start();
+}
+
+
+/* bsp: no LEDs, no buttons */
+
+uint32_t bsp_init(uint32_t type, uint32_t ticks_per_100ms, bsp_event_callback_t callback)
+{
+    UNUSED_PARAMETER(type);
+    UNUSED_PARAMETER(ticks_per_100ms);
+    UNUSED_PARAMETER(callback);
+    return NRF_SUCCESS;
+}
+
+
+uint32_t bsp_indication_set(bsp_indication_t indicate)
+{
+    UNUSED_PARAMETER(indicate);
+    return NRF_SUCCESS;
+}
+
+
+uint32_t bsp_btn_ble_init(bsp_btn_ble_error_handler_t error_handler, bsp_event_t * p_startup_bsp_evt)
+{
+    UNUSED_PARAMETER(error_handler);
+    if (p_startup_bsp_evt != NULL)
+    {
+        *p_startup_bsp_evt = BSP_EVENT_NOTHING;
+    }
+    return NRF_SUCCESS;
+}
+
+
+uint32_t bsp_btn_ble_sleep_mode_prepare(void)
+{
+    return NRF_SUCCESS;
+}
+
+
+void bsp_btn_ble_on_ble_evt(ble_evt_t * p_ble_evt)
+{
+    UNUSED_PARAMETER(p_ble_evt);
+}
+
+
+/* app_error, app_util_platform */
+
+void app_error_fault_handler(uint32_t id, uint32_t pc, uint32_t info)
+{
+    fprintf(stderr, "app_error: id 0x%08x pc 0x%08x info 0x%08x at %llu us\n",
+            (unsigned)id, (unsigned)pc, (unsigned)info, (unsigned long long)sd_emu_now());
+    exit(EXIT_FAILURE);
+}
+
+
+void app_error_handler(ret_code_t error_code, uint32_t line_num, const uint8_t * p_file_name)
+{
+    fprintf(stderr, "app_error: 0x%08x at %s:%u, %llu us\n",
+            (unsigned)error_code, (char const *)p_file_name, (unsigned)line_num, (unsigned long long)sd_emu_now());
+    exit(EXIT_FAILURE);
+}
+
+
+void app_error_handler_bare(ret_code_t error_code)
+{
+    fprintf(stderr, "app_error: 0x%08x at %llu us\n", (unsigned)error_code, (unsigned long long)sd_emu_now());
+    exit(EXIT_FAILURE);
+}
+
+
+void app_util_critical_region_enter(uint8_t * p_nested)
+{
+    UNUSED_RETURN_VALUE(sd_nvic_critical_region_enter(p_nested));
+}
+
+
+void app_util_critical_region_exit(uint8_t nested)
+{
+    UNUSED_RETURN_VALUE(sd_nvic_critical_region_exit(nested));
+}
+
+
+uint8_t current_int_priority_get(void)
+{
+    return sd_emu_in_irq() ? APP_IRQ_PRIORITY_LOW : APP_IRQ_PRIORITY_THREAD;
+}
+
+
+void hal_emu_init(void)
+{
+    static sd_emu_source_t const sources[] =
+    {
+        {timer_due,   timer_run},
+        {uart_due,    uart_run},
+        {uart_tx_due, uart_tx_run},
+        {fs_due,      fs_run}
+    };
+
+    for (uint8_t i = 0; i < sizeof(sources) / sizeof(sources[0]); i++)
+    {
+        sd_emu_source_add(&sources[i]);
+    }
+}
@@ -0,0 +1,34 @@
+#ifndef __HAL_EMU_H_
+#define __HAL_EMU_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#ifdef __cplusplus
+	extern "C" {
+#endif
+
+/**@brief Function for registering the timers, the UART and the flash of the emulator.
+ *
+ * @details To be called after @ref sd_emu_init and before the application starts.
+ */
+void hal_emu_init(void);
+
+/**@brief Function for feeding the UART of the application.
+ *
+ * @param[in] bytes_per_s  Rate of the bytes received, 0 for none.
+ * @param[in] next_byte    Source of the bytes, called when each one is received.
+ */
+void hal_emu_uart_rx_set(uint32_t bytes_per_s, uint8_t (*next_byte)(void));
+
+/**@brief Function for collecting what the application sends on the UART. Discarded by default. */
+void hal_emu_uart_tx_set(void (*tx_handler)(uint8_t byte));
+
+/**@brief Function for converting emulated time to app_timer ticks, with a prescaler of 0. */
+uint32_t hal_emu_ticks(uint64_t time_us);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,90 @@
+#ifndef FSTORAGE_H__
+#define FSTORAGE_H__
+
+/* Host stand-in of fstorage.h, same API. The configurations go to a section named without a
+ * leading dot, so that the linker provides __start_fs_data and __stop_fs_data.
+ */
+#include <stdint.h>
+
+#ifdef __cplusplus
+	extern "C" {
+#endif
+
+#define FS_PAGE_SIZE_WORDS              256
+#define FS_PAGE_SIZE                    (FS_PAGE_SIZE_WORDS * sizeof(uint32_t))
+#define FS_MAX_WRITE_SIZE_WORDS         256
+
+#define FS_REGISTER_CFG(cfg_var)        static cfg_var __attribute__((section("fs_data"), used))
+
+typedef enum
+{
+    FS_EVT_STORE,
+    FS_EVT_ERASE
+} fs_evt_id_t;
+
+typedef enum
+{
+    FS_SUCCESS,
+    FS_ERR_NOT_INITIALIZED,
+    FS_ERR_INVALID_CFG,
+    FS_ERR_NULL_ARG,
+    FS_ERR_INVALID_ARG,
+    FS_ERR_INVALID_ADDR,
+    FS_ERR_UNALIGNED_ADDR,
+    FS_ERR_QUEUE_FULL,
+    FS_ERR_OPERATION_TIMEOUT,
+    FS_ERR_INTERNAL
+} fs_ret_t;
+
+typedef struct
+{
+    fs_evt_id_t id;
+    void *      p_context;
+    union
+    {
+        struct
+        {
+            uint32_t const * p_data;
+            uint16_t         length_words;
+        } store;
+        struct
+        {
+            uint16_t first_page;
+            uint16_t last_page;
+        } erase;
+    };
+} fs_evt_t;
+
+typedef void (*fs_cb_t)(fs_evt_t const * const evt, fs_ret_t result);
+
+typedef struct
+{
+    fs_cb_t          callback;
+    uint32_t const * p_start_addr;
+    uint32_t const * p_end_addr;
+    uint8_t  const   num_pages;
+    uint8_t  const   priority;
+} fs_config_t;
+
+fs_ret_t fs_init(void);
+
+fs_ret_t fs_store(fs_config_t const * const p_config,
+                  uint32_t    const * const p_dest,
+                  uint32_t    const * const p_src,
+                  uint16_t    const         length_words,
+                  void *                    p_context);
+
+fs_ret_t fs_erase(fs_config_t const * const p_config,
+                  uint32_t    const * const p_page_addr,
+                  uint16_t    const         num_pages,
+                  void *                    p_context);
+
+fs_ret_t fs_queued_op_count_get(uint32_t * const p_op_count);
+
+void fs_sys_event_handler(uint32_t sys_evt);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,19 @@
+#ifndef _NRF_DELAY_H
+#define _NRF_DELAY_H
+
+/* Host stand-in of nrf_delay.h: a busy wait lets the emulated time run, interrupts included. */
+#include "sd_emu.h"
+
+#include <stdint.h>
+
+static inline void nrf_delay_us(uint32_t number_of_us)
+{
+    sd_emu_run_until(sd_emu_now() + number_of_us);
+}
+
+static inline void nrf_delay_ms(uint32_t number_of_ms)
+{
+    sd_emu_run_until(sd_emu_now() + (uint64_t)number_of_ms * 1000);
+}
+
+#endif
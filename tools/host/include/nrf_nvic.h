@@ -0,0 +1,30 @@
+#ifndef NRF_NVIC_H__
+#define NRF_NVIC_H__
+
+/* Host stand-in of the SoftDevice NVIC header, whose inline functions use the Cortex-M NVIC.
+ * The functions are implemented by the emulator.
+ */
+#include "nrf.h"
+#include "nrf_error_soc.h"
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+	extern "C" {
+#endif
+
+uint32_t sd_nvic_EnableIRQ(IRQn_Type IRQn);
+uint32_t sd_nvic_DisableIRQ(IRQn_Type IRQn);
+uint32_t sd_nvic_GetPendingIRQ(IRQn_Type IRQn, uint32_t * p_pending_irq);
+uint32_t sd_nvic_SetPendingIRQ(IRQn_Type IRQn);
+uint32_t sd_nvic_ClearPendingIRQ(IRQn_Type IRQn);
+uint32_t sd_nvic_SetPriority(IRQn_Type IRQn, uint32_t priority);
+uint32_t sd_nvic_SystemReset(void);
+uint32_t sd_nvic_critical_region_enter(uint8_t * p_is_nested_critical_region);
+uint32_t sd_nvic_critical_region_exit(uint8_t is_nested_critical_region);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
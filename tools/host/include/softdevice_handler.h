@@ -0,0 +1,64 @@
+#ifndef SOFTDEVICE_HANDLER_H__
+#define SOFTDEVICE_HANDLER_H__
+
+/* Host stand-in of softdevice_handler.h, same API. Events are given from the emulated SWI2
+ * interrupt, never through the scheduler, and there is no RAM start to check.
+ */
+#include "ble.h"
+#include "nrf_sdm.h"
+#include "nrf_soc.h"
+#include "app_error.h"
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#ifdef __cplusplus
+	extern "C" {
+#endif
+
+#ifndef BLE_STACK_EVT_MSG_BUF_SIZE
+#define BLE_STACK_EVT_MSG_BUF_SIZE      (sizeof(ble_evt_t) + (GATT_MTU_SIZE_DEFAULT))
+#endif
+
+typedef uint32_t (*softdevice_evt_schedule_func_t) (void);
+typedef void (*ble_evt_handler_t) (ble_evt_t * p_ble_evt);
+typedef void (*sys_evt_handler_t) (uint32_t evt_id);
+
+#define SOFTDEVICE_HANDLER_INIT(CLOCK_SOURCE, EVT_HANDLER)                                         \
+    do                                                                                             \
+    {                                                                                              \
+        uint32_t ERR_CODE = softdevice_handler_init((CLOCK_SOURCE), NULL, 0, (EVT_HANDLER));       \
+        APP_ERROR_CHECK(ERR_CODE);                                                                 \
+    } while (0)
+
+#define CHECK_RAM_START_ADDR(C_LINK_CNT, P_LINK_CNT)                                              \
+    do                                                                                             \
+    {                                                                                              \
+        err_code = sd_check_ram_start(0);                                                          \
+        APP_ERROR_CHECK(err_code);                                                                 \
+    } while (0)
+
+uint32_t softdevice_handler_init(nrf_clock_lf_cfg_t *           p_clock_lf_cfg,
+                                 void *                         p_ble_evt_buffer,
+                                 uint16_t                       ble_evt_buffer_size,
+                                 softdevice_evt_schedule_func_t evt_schedule_func);
+
+bool softdevice_handler_is_enabled(void);
+
+uint32_t softdevice_enable_get_default_config(uint8_t central_links_count,
+                                              uint8_t periph_links_count,
+                                              ble_enable_params_t * p_ble_enable_params);
+
+uint32_t sd_check_ram_start(uint32_t sd_req_ram_start);
+
+uint32_t softdevice_enable(ble_enable_params_t * p_ble_enable_params);
+
+uint32_t softdevice_ble_evt_handler_set(ble_evt_handler_t ble_evt_handler);
+
+uint32_t softdevice_sys_evt_handler_set(sys_evt_handler_t sys_evt_handler);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
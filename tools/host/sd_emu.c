@@ -0,0 +1,1558 @@
+/**@file
+ *
+ * @brief SoftDevice emulator: the sd_* calls of the application, the softdevice_handler module
+ *        and a deterministic connection-event model with one central.
+ *
+ * @details The headers of the SDK are used as they are, built with SVCALL_AS_NORMAL_FUNCTION
+ *          so that every sd_* call is a plain function defined here. Only what the application
+ *          and the SDK modules it links use is emulated; other calls do not link.
+ */
+#include "sd_emu.h"
+
+#include "sdk_common.h"
+#include "nrf_soc.h"
+#include "nrf_nvic.h"
+#include "ble_hci.h"
+#include "app_util_platform.h"
+#include "softdevice_handler.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+
+#define EMU_CONN_HANDLE                 0
+#define EMU_FIRST_HANDLE                0x000C                    /**< First application handle, after the GAP and GATT services of the SoftDevice. */
+#define EMU_MAX_ATTRS                   64
+#define EMU_ATTR_TAB_MAX                0x2000                    /**< Largest attribute table accepted. */
+#define EMU_MAX_VS_UUIDS                4
+#define EMU_MAX_SOURCES                 8
+#define EMU_EVT_QUEUE_SIZE              32
+#define EMU_EVT_WORDS                   ((sizeof(ble_evt_t) + GATT_MTU_SIZE_DEFAULT + 3) / 4)
+#define EMU_SYS_QUEUE_SIZE              8
+#define EMU_PEER_QUEUE_SIZE             32
+#define EMU_TX_QUEUE_MAX                16
+#define EMU_PAYLOAD_MAX                 (GATT_MTU_SIZE_DEFAULT - 3)
+#define EMU_READ_MAX                    (GATT_MTU_SIZE_DEFAULT - 1)
+
+/**@brief Cost of an attribute in the attribute table, an estimate: the layout of the
+ *        SoftDevice is not public. Values stored by the stack come on top, rounded to words.
+ */
+#define EMU_ATTR_COST                   12
+
+#define EMU_IFS_US                      150                       /**< Inter frame space. */
+#define EMU_PDU_OVERHEAD                17                        /**< Preamble, access address, header, CRC, L2CAP and ATT headers. */
+#define EMU_EMPTY_PDU_US                80
+
+/**@brief Kind of attribute. */
+typedef enum
+{
+    EMU_ATTR_SERVICE,
+    EMU_ATTR_CHAR,                                                /**< Characteristic declaration. */
+    EMU_ATTR_VALUE,
+    EMU_ATTR_CCCD,
+    EMU_ATTR_DESC
+} emu_attr_kind_t;
+
+typedef struct
+{
+    ble_uuid_t               uuid;
+    emu_attr_kind_t          kind;
+    ble_gatt_char_props_t    props;                               /**< Of the characteristic, for its value and CCCD. */
+    uint16_t                 char_uuid;                           /**< 16-bit UUID of the characteristic the attribute belongs to. */
+    uint16_t                 value_handle;                        /**< Of the characteristic, for a CCCD. */
+    bool                     rd_auth;
+    bool                     wr_auth;
+    bool                     vlen;
+    uint16_t                 max_len;
+    uint16_t                 len;
+    uint8_t                * p_value;
+} emu_attr_t;
+
+/**@brief Packet of the central or of the device. */
+typedef struct
+{
+    uint16_t                 handle;
+    uint8_t                  type;                                /**< For the device: BLE_GATT_HVX_*. */
+    bool                     with_response;                       /**< For the central: write request. */
+    bool                     read;                                /**< For the central: read request. */
+    uint16_t                 offset;
+    uint16_t                 len;
+    uint8_t                  data[EMU_PAYLOAD_MAX];
+} emu_pkt_t;
+
+/**@brief FIFO of packets. */
+typedef struct
+{
+    emu_pkt_t              * p_pkts;
+    uint8_t                  size;
+    uint8_t                  head;
+    uint8_t                  count;
+} emu_fifo_t;
+
+
+static sd_emu_cfg_t         m_cfg;
+static sd_emu_peer_t        m_peer;
+static sd_emu_stats_t       m_stats;
+static uint64_t             m_now;
+static sd_emu_source_t      m_sources[EMU_MAX_SOURCES];
+static uint8_t              m_source_count;
+static bool                 m_woken;
+static bool                 m_in_irq;
+static uint8_t              m_in_critical;
+
+static bool                 m_enabled;
+static ble_evt_handler_t    m_ble_evt_handler;
+static sys_evt_handler_t    m_sys_evt_handler;
+static uint32_t             m_evts[EMU_EVT_QUEUE_SIZE][EMU_EVT_WORDS];
+static uint8_t              m_evt_head;
+static uint8_t              m_evt_count;
+static uint32_t             m_sys_evts[EMU_SYS_QUEUE_SIZE];
+static uint8_t              m_sys_head;
+static uint8_t              m_sys_count;
+
+static emu_attr_t           m_attrs[EMU_MAX_ATTRS];
+static uint16_t             m_attr_count;
+static uint8_t              m_attr_mem[EMU_ATTR_TAB_MAX];
+static uint16_t             m_attr_tab_size = BLE_GATTS_ATTR_TAB_SIZE_DEFAULT;
+static uint16_t             m_attr_tab_used;
+static uint16_t             m_attr_mem_used;
+static ble_uuid128_t        m_vs_uuids[EMU_MAX_VS_UUIDS];
+static uint8_t              m_vs_uuid_count;
+static uint8_t              m_vs_uuid_max = 1;
+
+static uint8_t              m_dev_name[BLE_GAP_DEVNAME_MAX_LEN];
+static uint16_t             m_dev_name_len;
+static ble_gap_conn_params_t m_ppcp;
+static bool                 m_advertising;
+static uint64_t             m_connect_at;
+static bool                 m_connected;
+static uint16_t             m_interval;
+static uint64_t             m_next_event;
+static bool                 m_disconnect_pending;
+static uint8_t              m_disconnect_reason;
+static bool                 m_update_pending;
+static ble_gap_conn_params_t m_update_params;
+
+static uint8_t              m_notif_type;
+static uint32_t             m_notif_distance_us;
+static bool                 m_notif_active_done;              /**< The ACTIVE notification of the next event was given. */
+static uint64_t             m_notif_inactive_at;              /**< UINT64_MAX if no INACTIVE notification is due. */
+static uint32_t             m_irq_enabled;
+static uint32_t             m_irq_pending;
+
+static emu_pkt_t            m_tx_pkts[EMU_TX_QUEUE_MAX];
+static emu_fifo_t           m_tx_fifo = {m_tx_pkts, EMU_TX_QUEUE_MAX, 0, 0};
+static emu_pkt_t            m_ind;
+static bool                 m_ind_queued;
+static bool                 m_ind_sent;                       /**< Sent in the last event, confirmed in the next. */
+static emu_pkt_t            m_peer_pkts[EMU_PEER_QUEUE_SIZE];
+static emu_fifo_t           m_peer_fifo = {m_peer_pkts, EMU_PEER_QUEUE_SIZE, 0, 0};
+static emu_pkt_t            m_auth_pkt;                       /**< Central request waiting for an authorize reply. */
+static uint8_t              m_auth_type;
+
+void SWI1_IRQHandler(void) __attribute__((weak));
+
+
+static emu_pkt_t * fifo_tail(emu_fifo_t * p_fifo)
+{
+    return (p_fifo->count < p_fifo->size) ? &p_fifo->p_pkts[(p_fifo->head + p_fifo->count) % p_fifo->size] : NULL;
+}
+
+
+static emu_pkt_t * fifo_head(emu_fifo_t * p_fifo)
+{
+    return (p_fifo->count > 0) ? &p_fifo->p_pkts[p_fifo->head] : NULL;
+}
+
+
+static void fifo_pop(emu_fifo_t * p_fifo)
+{
+    p_fifo->head = (p_fifo->head + 1) % p_fifo->size;
+    p_fifo->count--;
+}
+
+
+static emu_attr_t * attr_get(uint16_t handle)
+{
+    if ((handle < EMU_FIRST_HANDLE) || (handle >= EMU_FIRST_HANDLE + m_attr_count))
+    {
+        return NULL;
+    }
+    return &m_attrs[handle - EMU_FIRST_HANDLE];
+}
+
+
+static emu_attr_t * cccd_get(uint16_t value_handle)
+{
+    for (uint16_t i = 0; i < m_attr_count; i++)
+    {
+        if ((m_attrs[i].kind == EMU_ATTR_CCCD) && (m_attrs[i].value_handle == value_handle))
+        {
+            return &m_attrs[i];
+        }
+    }
+    return NULL;
+}
+
+
+/**@brief Function for adding an attribute, its value in the stack if p_value is NULL. */
+static uint32_t attr_add(emu_attr_kind_t kind, ble_uuid_t const * p_uuid, uint16_t max_len, uint8_t * p_value,
+                         uint16_t * p_handle)
+{
+    uint16_t     mem  = (p_value == NULL) ? (uint16_t)((max_len + 3) & ~3) : 0;
+    emu_attr_t * p_attr;
+
+    if ((m_attr_count >= EMU_MAX_ATTRS) || (m_attr_tab_used + EMU_ATTR_COST + mem > m_attr_tab_size))
+    {
+        return NRF_ERROR_NO_MEM;
+    }
+
+    p_attr = &m_attrs[m_attr_count];
+    memset(p_attr, 0, sizeof(*p_attr));
+    p_attr->uuid    = *p_uuid;
+    p_attr->kind    = kind;
+    p_attr->max_len = max_len;
+    p_attr->p_value = p_value;
+    if (p_value == NULL)
+    {
+        p_attr->p_value  = &m_attr_mem[m_attr_mem_used];
+        m_attr_mem_used += mem;
+    }
+
+    m_attr_tab_used += EMU_ATTR_COST + mem;
+    *p_handle        = EMU_FIRST_HANDLE + m_attr_count++;
+
+    return NRF_SUCCESS;
+}
+
+
+static uint32_t attr_value_add(emu_attr_kind_t kind, ble_gatts_attr_t const * p_attr, uint16_t * p_handle)
+{
+    ble_gatts_attr_md_t const * p_md = p_attr->p_attr_md;
+    uint8_t                   * p_value = (p_md->vloc == BLE_GATTS_VLOC_USER) ? p_attr->p_value : NULL;
+    emu_attr_t                * p_emu;
+    uint32_t                    err_code;
+
+    if ((p_md->vloc == BLE_GATTS_VLOC_USER) && (p_value == NULL))
+    {
+        return NRF_ERROR_INVALID_PARAM;
+    }
+    if ((p_attr->init_offs + p_attr->init_len > p_attr->max_len) || (p_attr->max_len > BLE_GATTS_VAR_ATTR_LEN_MAX))
+    {
+        return NRF_ERROR_INVALID_PARAM;
+    }
+
+    err_code = attr_add(kind, p_attr->p_uuid, p_attr->max_len, p_value, p_handle);
+    VERIFY_SUCCESS(err_code);
+
+    p_emu          = attr_get(*p_handle);
+    p_emu->rd_auth = p_md->rd_auth;
+    p_emu->wr_auth = p_md->wr_auth;
+    p_emu->vlen    = p_md->vlen;
+    p_emu->len     = p_md->vlen ? p_attr->init_len : p_attr->max_len;
+    if ((p_md->vloc != BLE_GATTS_VLOC_USER) && (p_attr->p_value != NULL))
+    {
+        memcpy(&p_emu->p_value[p_attr->init_offs], p_attr->p_value, p_attr->init_len);
+    }
+
+    return NRF_SUCCESS;
+}
+
+
+static ble_evt_t * evt_push(uint16_t evt_id, uint16_t extra_len)
+{
+    ble_evt_t * p_evt;
+
+    if (m_evt_count >= EMU_EVT_QUEUE_SIZE)
+    {
+        fprintf(stderr, "sd_emu: event queue full, the application does not take its events\n");
+        exit(EXIT_FAILURE);
+    }
+
+    p_evt = (ble_evt_t *)m_evts[(m_evt_head + m_evt_count++) % EMU_EVT_QUEUE_SIZE];
+    memset(p_evt, 0, sizeof(m_evts[0]));
+    p_evt->header.evt_id  = evt_id;
+    p_evt->header.evt_len = (uint16_t)(sizeof(ble_evt_t) + extra_len);
+
+    return p_evt;
+}
+
+
+/**@brief SWI2: gives the pending events to the application, as softdevice_handler does. */
+static void evt_dispatch(void)
+{
+    static uint32_t evt[EMU_EVT_WORDS];
+
+    while (m_sys_count > 0)
+    {
+        uint32_t evt_id = m_sys_evts[m_sys_head];
+
+        m_sys_head = (m_sys_head + 1) % EMU_SYS_QUEUE_SIZE;
+        m_sys_count--;
+        if (m_sys_evt_handler != NULL)
+        {
+            m_sys_evt_handler(evt_id);
+        }
+    }
+
+    while (m_evt_count > 0)
+    {
+        // Copied out, the handler can cause new events.
+        memcpy(evt, m_evts[m_evt_head], sizeof(evt));
+        m_evt_head = (m_evt_head + 1) % EMU_EVT_QUEUE_SIZE;
+        m_evt_count--;
+        if (m_ble_evt_handler != NULL)
+        {
+            m_ble_evt_handler((ble_evt_t *)evt);
+        }
+    }
+}
+
+
+static uint32_t pdu_us(uint16_t len)
+{
+    return (len == 0) ? EMU_EMPTY_PDU_US : (EMU_PDU_OVERHEAD + len) * 8;
+}
+
+
+static uint64_t interval_us(void)
+{
+    return (uint64_t)m_interval * 1250;
+}
+
+
+static void radio_notification(void)
+{
+    if ((m_irq_enabled & (1UL << SWI1_IRQn)) && (SWI1_IRQHandler != NULL))
+    {
+        sd_emu_irq_run(SWI1_IRQHandler);
+    }
+}
+
+
+/**@brief Function for handling a write or read of the central, in a connection event. */
+static void peer_pkt_deliver(emu_pkt_t const * p_pkt)
+{
+    emu_attr_t * p_attr = attr_get(p_pkt->handle);
+    ble_evt_t  * p_evt;
+
+    m_stats.rx_packets++;
+
+    if (p_attr == NULL)
+    {
+        return;
+    }
+
+    if (p_pkt->read)
+    {
+        if (p_attr->rd_auth)
+        {
+            m_auth_pkt  = *p_pkt;
+            m_auth_type = BLE_GATTS_AUTHORIZE_TYPE_READ;
+            p_evt = evt_push(BLE_GATTS_EVT_RW_AUTHORIZE_REQUEST, 0);
+            p_evt->evt.gatts_evt.conn_handle                                      = EMU_CONN_HANDLE;
+            p_evt->evt.gatts_evt.params.authorize_request.type                    = BLE_GATTS_AUTHORIZE_TYPE_READ;
+            p_evt->evt.gatts_evt.params.authorize_request.request.read.handle    = p_pkt->handle;
+            p_evt->evt.gatts_evt.params.authorize_request.request.read.uuid      = p_attr->uuid;
+            p_evt->evt.gatts_evt.params.authorize_request.request.read.offset    = p_pkt->offset;
+        }
+        else if (m_peer.on_read != NULL)
+        {
+            uint16_t offset = MIN(p_pkt->offset, p_attr->len);
+
+            m_peer.on_read(p_pkt->handle, &p_attr->p_value[offset], MIN(p_attr->len - offset, EMU_READ_MAX));
+        }
+        return;
+    }
+
+    if (p_pkt->offset + p_pkt->len > p_attr->max_len)
+    {
+        return;
+    }
+
+    if (p_attr->wr_auth)
+    {
+        ble_gatts_evt_write_t * p_write;
+
+        m_auth_pkt  = *p_pkt;
+        m_auth_type = BLE_GATTS_AUTHORIZE_TYPE_WRITE;
+        p_evt   = evt_push(BLE_GATTS_EVT_RW_AUTHORIZE_REQUEST, p_pkt->len);
+        p_write = &p_evt->evt.gatts_evt.params.authorize_request.request.write;
+        p_evt->evt.gatts_evt.conn_handle                   = EMU_CONN_HANDLE;
+        p_evt->evt.gatts_evt.params.authorize_request.type = BLE_GATTS_AUTHORIZE_TYPE_WRITE;
+        p_write->handle = p_pkt->handle;
+        p_write->uuid   = p_attr->uuid;
+        p_write->op     = p_pkt->with_response ? BLE_GATTS_OP_WRITE_REQ : BLE_GATTS_OP_WRITE_CMD;
+        p_write->offset = p_pkt->offset;
+        p_write->len    = p_pkt->len;
+        memcpy(p_write->data, p_pkt->data, p_pkt->len);
+        return;
+    }
+
+    memcpy(&p_attr->p_value[p_pkt->offset], p_pkt->data, p_pkt->len);
+    if (p_attr->vlen)
+    {
+        p_attr->len = p_pkt->offset + p_pkt->len;
+    }
+
+    p_evt = evt_push(BLE_GATTS_EVT_WRITE, p_pkt->len);
+    p_evt->evt.gatts_evt.conn_handle              = EMU_CONN_HANDLE;
+    p_evt->evt.gatts_evt.params.write.handle      = p_pkt->handle;
+    p_evt->evt.gatts_evt.params.write.uuid        = p_attr->uuid;
+    p_evt->evt.gatts_evt.params.write.op          = p_pkt->with_response ? BLE_GATTS_OP_WRITE_REQ : BLE_GATTS_OP_WRITE_CMD;
+    p_evt->evt.gatts_evt.params.write.offset      = p_pkt->offset;
+    p_evt->evt.gatts_evt.params.write.len         = p_pkt->len;
+    memcpy(p_evt->evt.gatts_evt.params.write.data, p_pkt->data, p_pkt->len);
+}
+
+
+/**@brief Function for clearing the state of the link, at its end. */
+static void link_reset(void)
+{
+    m_connected          = false;
+    m_disconnect_pending = false;
+    m_update_pending     = false;
+    m_ind_queued         = false;
+    m_ind_sent           = false;
+    m_tx_fifo.count      = 0;
+    m_peer_fifo.count    = 0;
+    m_notif_inactive_at  = UINT64_MAX;
+
+    // The CCCDs of a peer without bond are back to 0.
+    for (uint16_t i = 0; i < m_attr_count; i++)
+    {
+        if (m_attrs[i].kind == EMU_ATTR_CCCD)
+        {
+            memset(m_attrs[i].p_value, 0, m_attrs[i].max_len);
+        }
+    }
+}
+
+
+static void link_lost(void)
+{
+    ble_evt_t * p_evt = evt_push(BLE_GAP_EVT_DISCONNECTED, 0);
+
+    p_evt->evt.gap_evt.conn_handle                    = EMU_CONN_HANDLE;
+    p_evt->evt.gap_evt.params.disconnected.reason     = m_disconnect_reason;
+
+    link_reset();
+
+    if (m_peer.on_disconnected != NULL)
+    {
+        m_peer.on_disconnected(m_disconnect_reason);
+    }
+}
+
+
+static void conn_event(void)
+{
+    uint32_t airtime  = 0;
+    uint8_t  sent     = 0;
+    bool     request  = false;
+    uint8_t  i;
+
+    m_stats.conn_events++;
+
+    if (m_peer.on_conn_event != NULL)
+    {
+        m_peer.on_conn_event();
+    }
+
+    if (m_disconnect_pending)
+    {
+        link_lost();
+        return;
+    }
+
+    if (m_update_pending)
+    {
+        // The central keeps its interval if it is acceptable, else takes the nearest bound.
+        ble_evt_t * p_evt = evt_push(BLE_GAP_EVT_CONN_PARAM_UPDATE, 0);
+
+        m_interval       = MAX(m_interval, m_update_params.min_conn_interval);
+        m_interval       = MIN(m_interval, m_update_params.max_conn_interval);
+        m_update_pending = false;
+
+        p_evt->evt.gap_evt.conn_handle                                       = EMU_CONN_HANDLE;
+        p_evt->evt.gap_evt.params.conn_param_update.conn_params                  = m_update_params;
+        p_evt->evt.gap_evt.params.conn_param_update.conn_params.min_conn_interval = m_interval;
+        p_evt->evt.gap_evt.params.conn_param_update.conn_params.max_conn_interval = m_interval;
+    }
+
+    if (m_ind_sent)
+    {
+        ble_evt_t * p_evt = evt_push(BLE_GATTS_EVT_HVC, 0);
+
+        p_evt->evt.gatts_evt.conn_handle       = EMU_CONN_HANDLE;
+        p_evt->evt.gatts_evt.params.hvc.handle = m_ind.handle;
+        m_ind_sent = false;
+    }
+
+    for (i = 0; i < m_cfg.tx_per_event; i++)
+    {
+        emu_pkt_t * p_rx = fifo_head(&m_peer_fifo);
+        emu_pkt_t * p_tx = fifo_head(&m_tx_fifo);
+        uint16_t    rx_len = 0;
+        uint16_t    tx_len = 0;
+
+        // One request per event: ATT waits for the response before the next one.
+        if ((p_rx != NULL) && (p_rx->with_response || p_rx->read))
+        {
+            if (request)
+            {
+                p_rx = NULL;
+            }
+            request = true;
+        }
+        if (m_ind_queued && !m_ind_sent)
+        {
+            p_tx = &m_ind;
+        }
+
+        if ((p_rx == NULL) && (p_tx == NULL))
+        {
+            break;
+        }
+
+        rx_len = (p_rx != NULL) ? p_rx->len : 0;
+        tx_len = (p_tx != NULL) ? p_tx->len : 0;
+        if (airtime + pdu_us(rx_len) + pdu_us(tx_len) + 2 * EMU_IFS_US > interval_us() - EMU_IFS_US)
+        {
+            break;
+        }
+        airtime += pdu_us(rx_len) + pdu_us(tx_len) + 2 * EMU_IFS_US;
+
+        if (p_rx != NULL)
+        {
+            emu_pkt_t pkt = *p_rx;
+
+            fifo_pop(&m_peer_fifo);
+            peer_pkt_deliver(&pkt);
+        }
+
+        if (p_tx != NULL)
+        {
+            if (m_peer.on_hvx != NULL)
+            {
+                m_peer.on_hvx(p_tx->handle, p_tx->type, p_tx->data, p_tx->len);
+            }
+            m_stats.tx_packets++;
+            if (p_tx == &m_ind)
+            {
+                m_ind_queued = false;
+                m_ind_sent   = true;
+            }
+            else
+            {
+                fifo_pop(&m_tx_fifo);
+                sent++;
+            }
+        }
+    }
+
+    if (sent > 0)
+    {
+        ble_evt_t * p_evt = evt_push(BLE_EVT_TX_COMPLETE, 0);
+
+        p_evt->evt.common_evt.conn_handle              = EMU_CONN_HANDLE;
+        p_evt->evt.common_evt.params.tx_complete.count = sent;
+        m_stats.max_tx_per_event = MAX(m_stats.max_tx_per_event, sent);
+    }
+
+    m_next_event        += interval_us();
+    m_notif_active_done  = false;
+    if (m_notif_type & NRF_RADIO_NOTIFICATION_TYPE_INT_ON_INACTIVE)
+    {
+        m_notif_inactive_at = m_now + MAX(airtime, EMU_EMPTY_PDU_US * 2 + EMU_IFS_US);
+    }
+}
+
+
+/**@brief Function for getting the time of the next ACTIVE radio notification, UINT64_MAX if none. */
+static uint64_t notif_active_due(void)
+{
+    if (!m_connected || m_notif_active_done || !(m_notif_type & NRF_RADIO_NOTIFICATION_TYPE_INT_ON_ACTIVE))
+    {
+        return UINT64_MAX;
+    }
+    return (m_next_event > m_notif_distance_us) ? (m_next_event - m_notif_distance_us) : 0;
+}
+
+
+static uint64_t link_due(void)
+{
+    uint64_t due = UINT64_MAX;
+
+    if (m_cfg.replay)
+    {
+        return due;
+    }
+    if (m_advertising)
+    {
+        due = m_connect_at;
+    }
+    if (m_connected)
+    {
+        due = MIN(m_next_event, MIN(notif_active_due(), m_notif_inactive_at));
+    }
+    return due;
+}
+
+
+static void link_run(void)
+{
+    if (m_advertising && (m_connect_at <= m_now))
+    {
+        ble_evt_t * p_evt = evt_push(BLE_GAP_EVT_CONNECTED, 0);
+
+        m_advertising       = false;
+        m_connected         = true;
+        m_interval          = m_cfg.conn_interval;
+        m_next_event        = m_now + interval_us();
+        m_notif_active_done = false;
+        m_notif_inactive_at = UINT64_MAX;
+
+        p_evt->evt.gap_evt.conn_handle                                  = EMU_CONN_HANDLE;
+        p_evt->evt.gap_evt.params.connected.role                        = BLE_GAP_ROLE_PERIPH;
+        p_evt->evt.gap_evt.params.connected.peer_addr.addr_type         = BLE_GAP_ADDR_TYPE_RANDOM_STATIC;
+        p_evt->evt.gap_evt.params.connected.conn_params.min_conn_interval = m_interval;
+        p_evt->evt.gap_evt.params.connected.conn_params.max_conn_interval = m_interval;
+        p_evt->evt.gap_evt.params.connected.conn_params.slave_latency     = 0;
+        p_evt->evt.gap_evt.params.connected.conn_params.conn_sup_timeout  = 400;
+
+        if (m_peer.on_connected != NULL)
+        {
+            m_peer.on_connected(m_interval);
+        }
+        return;
+    }
+
+    if (!m_connected)
+    {
+        return;
+    }
+
+    if (notif_active_due() <= m_now)
+    {
+        m_notif_active_done = true;
+        radio_notification();
+    }
+    else if (m_notif_inactive_at <= m_now)
+    {
+        m_notif_inactive_at = UINT64_MAX;
+        radio_notification();
+    }
+    else if (m_next_event <= m_now)
+    {
+        conn_event();
+    }
+}
+
+
+/**@brief Function for running the next piece of work, delivering pending events first. */
+static void step(void)
+{
+    uint64_t due  = link_due();
+    int      next = -1;
+
+    if ((m_evt_count > 0) || (m_sys_count > 0))
+    {
+        sd_emu_irq_run(evt_dispatch);
+        return;
+    }
+    if (m_irq_pending & (1UL << SWI1_IRQn))
+    {
+        m_irq_pending &= ~(1UL << SWI1_IRQn);
+        radio_notification();
+        return;
+    }
+
+    for (uint8_t i = 0; i < m_source_count; i++)
+    {
+        uint64_t source_due = m_sources[i].due();
+
+        if (source_due < due)
+        {
+            due  = source_due;
+            next = i;
+        }
+    }
+
+    if (due == UINT64_MAX)
+    {
+        fprintf(stderr, "sd_emu: nothing left to run\n");
+        exit(EXIT_FAILURE);
+    }
+
+    m_now = MAX(m_now, due);
+    if (next < 0)
+    {
+        link_run();
+    }
+    else
+    {
+        m_sources[next].run();
+    }
+}
+
+
+void sd_emu_init(sd_emu_cfg_t const * p_cfg, sd_emu_peer_t const * p_peer)
+{
+    m_cfg               = *p_cfg;
+    m_cfg.tx_buffers    = MIN(MAX(m_cfg.tx_buffers, 1), EMU_TX_QUEUE_MAX);
+    m_cfg.tx_per_event  = MAX(m_cfg.tx_per_event, 1);
+    m_peer              = *p_peer;
+    m_tx_fifo.size      = m_cfg.tx_buffers;
+    m_notif_inactive_at = UINT64_MAX;
+}
+
+
+void sd_emu_source_add(sd_emu_source_t const * p_source)
+{
+    if (m_source_count >= EMU_MAX_SOURCES)
+    {
+        fprintf(stderr, "sd_emu: too many sources\n");
+        exit(EXIT_FAILURE);
+    }
+    m_sources[m_source_count++] = *p_source;
+}
+
+
+uint64_t sd_emu_now(void)
+{
+    return m_now;
+}
+
+
+void sd_emu_run_until(uint64_t time_us)
+{
+    // Same priority handlers would not run before the current one returns.
+    while (!m_in_irq)
+    {
+        uint64_t due = link_due();
+
+        for (uint8_t i = 0; i < m_source_count; i++)
+        {
+            due = MIN(due, m_sources[i].due());
+        }
+        if ((m_evt_count == 0) && (m_sys_count == 0) && (m_irq_pending == 0) && (due > time_us))
+        {
+            break;
+        }
+        step();
+    }
+    m_now = MAX(m_now, time_us);
+}
+
+
+void sd_emu_irq_run(void (*handler)(void))
+{
+    bool in_irq = m_in_irq;
+
+    m_in_irq = true;
+    handler();
+    m_in_irq = in_irq;
+    m_woken  = true;
+}
+
+
+bool sd_emu_in_irq(void)
+{
+    return m_in_irq;
+}
+
+
+void sd_emu_sys_evt_raise(uint32_t evt_id)
+{
+    if (m_sys_count >= EMU_SYS_QUEUE_SIZE)
+    {
+        fprintf(stderr, "sd_emu: SoC event queue full\n");
+        exit(EXIT_FAILURE);
+    }
+    m_sys_evts[(m_sys_head + m_sys_count++) % EMU_SYS_QUEUE_SIZE] = evt_id;
+}
+
+
+static uint32_t peer_pkt_queue(uint16_t handle, uint8_t const * p_data, uint16_t len, uint16_t offset,
+                               bool with_response, bool read)
+{
+    emu_pkt_t * p_pkt = fifo_tail(&m_peer_fifo);
+
+    VERIFY_TRUE(m_connected, NRF_ERROR_INVALID_STATE);
+    VERIFY_TRUE(len <= EMU_PAYLOAD_MAX, NRF_ERROR_INVALID_LENGTH);
+    VERIFY_TRUE(p_pkt != NULL, NRF_ERROR_NO_MEM);
+
+    memset(p_pkt, 0, sizeof(*p_pkt));
+    p_pkt->handle        = handle;
+    p_pkt->with_response = with_response;
+    p_pkt->read          = read;
+    p_pkt->offset        = offset;
+    p_pkt->len           = len;
+    if (len > 0)
+    {
+        memcpy(p_pkt->data, p_data, len);
+    }
+    m_peer_fifo.count++;
+
+    return NRF_SUCCESS;
+}
+
+
+uint32_t sd_emu_peer_write(uint16_t handle, uint8_t const * p_data, uint16_t len, bool with_response)
+{
+    return peer_pkt_queue(handle, p_data, len, 0, with_response, false);
+}
+
+
+uint32_t sd_emu_peer_read(uint16_t handle, uint16_t offset)
+{
+    return peer_pkt_queue(handle, NULL, 0, offset, false, true);
+}
+
+
+uint16_t sd_emu_peer_pending(void)
+{
+    return m_peer_fifo.count;
+}
+
+
+uint16_t sd_emu_handle_find(uint16_t uuid, bool cccd)
+{
+    for (uint16_t i = 0; i < m_attr_count; i++)
+    {
+        if ((m_attrs[i].char_uuid == uuid) && (m_attrs[i].kind == (cccd ? EMU_ATTR_CCCD : EMU_ATTR_VALUE)))
+        {
+            return EMU_FIRST_HANDLE + i;
+        }
+    }
+    return BLE_GATT_HANDLE_INVALID;
+}
+
+
+void sd_emu_peer_cccds_enable(void)
+{
+    for (uint16_t i = 0; i < m_attr_count; i++)
+    {
+        if (m_attrs[i].kind == EMU_ATTR_CCCD)
+        {
+            uint8_t value[2] = {m_attrs[i].props.notify ? BLE_GATT_HVX_NOTIFICATION : BLE_GATT_HVX_INDICATION, 0};
+
+            UNUSED_RETURN_VALUE(sd_emu_peer_write(EMU_FIRST_HANDLE + i, value, sizeof(value), true));
+        }
+    }
+}
+
+
+void sd_emu_stats_get(sd_emu_stats_t * p_stats)
+{
+    *p_stats               = m_stats;
+    p_stats->attr_tab_used = m_attr_tab_used;
+    p_stats->attr_tab_size = m_attr_tab_size;
+}
+
+
+void sd_emu_evt_inject(ble_evt_t const * p_evt)
+{
+    ble_evt_t  * p_copy = evt_push(p_evt->header.evt_id, 0);
+    emu_attr_t * p_attr;
+
+    memcpy(p_copy, p_evt, MIN(p_evt->header.evt_len, sizeof(m_evts[0])));
+    p_copy->header.evt_len = MIN(p_evt->header.evt_len, sizeof(m_evts[0]));
+
+    // What the SoftDevice did before giving the event.
+    switch (p_evt->header.evt_id)
+    {
+        case BLE_GAP_EVT_CONNECTED:
+            m_advertising = false;
+            m_connected   = true;
+            m_interval    = p_evt->evt.gap_evt.params.connected.conn_params.max_conn_interval;
+            break;
+
+        case BLE_GAP_EVT_DISCONNECTED:
+            link_reset();
+            break;
+
+        case BLE_GAP_EVT_CONN_PARAM_UPDATE:
+            m_interval = p_evt->evt.gap_evt.params.conn_param_update.conn_params.max_conn_interval;
+            break;
+
+        case BLE_GATTS_EVT_WRITE:
+        {
+            ble_gatts_evt_write_t const * p_write = &p_evt->evt.gatts_evt.params.write;
+
+            p_attr = attr_get(p_write->handle);
+            if ((p_attr != NULL) &&
+                ((p_write->op == BLE_GATTS_OP_WRITE_REQ) || (p_write->op == BLE_GATTS_OP_WRITE_CMD)) &&
+                (p_write->offset + p_write->len <= p_attr->max_len))
+            {
+                memcpy(&p_attr->p_value[p_write->offset], p_write->data, p_write->len);
+                if (p_attr->vlen)
+                {
+                    p_attr->len = p_write->offset + p_write->len;
+                }
+            }
+        } break;
+
+        case BLE_GATTS_EVT_HVC:
+            m_ind_queued = false;
+            m_ind_sent   = false;
+            break;
+
+        case BLE_EVT_TX_COMPLETE:
+            for (uint8_t i = 0; (i < p_evt->evt.common_evt.params.tx_complete.count) && (m_tx_fifo.count > 0); i++)
+            {
+                fifo_pop(&m_tx_fifo);
+                m_stats.tx_packets++;
+            }
+            break;
+
+        default:
+            break;
+    }
+}
+
+
+/* softdevice_handler */
+
+uint32_t softdevice_handler_init(nrf_clock_lf_cfg_t *           p_clock_lf_cfg,
+                                 void *                         p_ble_evt_buffer,
+                                 uint16_t                       ble_evt_buffer_size,
+                                 softdevice_evt_schedule_func_t evt_schedule_func)
+{
+    UNUSED_PARAMETER(p_clock_lf_cfg);
+    UNUSED_PARAMETER(p_ble_evt_buffer);
+    UNUSED_PARAMETER(ble_evt_buffer_size);
+
+    // Events are always given from the emulated SWI2 interrupt.
+    VERIFY_TRUE(evt_schedule_func == NULL, NRF_ERROR_NOT_SUPPORTED);
+
+    m_enabled = true;
+    return NRF_SUCCESS;
+}
+
+
+bool softdevice_handler_is_enabled(void)
+{
+    return m_enabled;
+}
+
+
+uint32_t softdevice_enable_get_default_config(uint8_t central_links_count,
+                                              uint8_t periph_links_count,
+                                              ble_enable_params_t * p_ble_enable_params)
+{
+    memset(p_ble_enable_params, 0, sizeof(ble_enable_params_t));
+    p_ble_enable_params->common_enable_params.vs_uuid_count   = 1;
+    p_ble_enable_params->gap_enable_params.central_conn_count = central_links_count;
+    p_ble_enable_params->gap_enable_params.periph_conn_count  = periph_links_count;
+    p_ble_enable_params->gatts_enable_params.attr_tab_size    = BLE_GATTS_ATTR_TAB_SIZE_DEFAULT;
+
+    return NRF_SUCCESS;
+}
+
+
+uint32_t sd_check_ram_start(uint32_t sd_req_ram_start)
+{
+    UNUSED_PARAMETER(sd_req_ram_start);
+    return NRF_SUCCESS;
+}
+
+
+uint32_t softdevice_enable(ble_enable_params_t * p_ble_enable_params)
+{
+    uint32_t app_ram_base = 0;
+
+    return sd_ble_enable(p_ble_enable_params, &app_ram_base);
+}
+
+
+uint32_t softdevice_ble_evt_handler_set(ble_evt_handler_t ble_evt_handler)
+{
+    VERIFY_PARAM_NOT_NULL(ble_evt_handler);
+    m_ble_evt_handler = ble_evt_handler;
+    return NRF_SUCCESS;
+}
+
+
+uint32_t softdevice_sys_evt_handler_set(sys_evt_handler_t sys_evt_handler)
+{
+    VERIFY_PARAM_NOT_NULL(sys_evt_handler);
+    m_sys_evt_handler = sys_evt_handler;
+    return NRF_SUCCESS;
+}
+
+
+/* SoC */
+
+uint32_t sd_app_evt_wait(void)
+{
+    // Like WFE, returns at once if an interrupt ran since the last call.
+    while (!m_woken)
+    {
+        step();
+    }
+    m_woken = false;
+    return NRF_SUCCESS;
+}
+
+
+uint32_t sd_temp_get(int32_t * p_temp)
+{
+    *p_temp = 25 * 4;
+    return NRF_SUCCESS;
+}
+
+
+uint32_t sd_power_system_off(void)
+{
+    printf("sd_emu: system off\n");
+    exit(EXIT_SUCCESS);
+}
+
+
+uint32_t sd_radio_notification_cfg_set(uint8_t type, uint8_t distance)
+{
+    static uint16_t const distances_us[] = {0, 800, 1740, 2680, 3620, 4560, 5500};
+
+    VERIFY_TRUE(!m_connected && !m_advertising, NRF_ERROR_INVALID_STATE);
+    VERIFY_TRUE((type <= NRF_RADIO_NOTIFICATION_TYPE_INT_ON_BOTH) && (distance < sizeof(distances_us) / sizeof(distances_us[0])),
+                NRF_ERROR_INVALID_PARAM);
+
+    m_notif_type        = type;
+    m_notif_distance_us = distances_us[distance];
+    return NRF_SUCCESS;
+}
+
+
+uint32_t sd_nvic_EnableIRQ(IRQn_Type IRQn)
+{
+    m_irq_enabled |= 1UL << IRQn;
+    return NRF_SUCCESS;
+}
+
+
+uint32_t sd_nvic_DisableIRQ(IRQn_Type IRQn)
+{
+    m_irq_enabled &= ~(1UL << IRQn);
+    return NRF_SUCCESS;
+}
+
+
+uint32_t sd_nvic_GetPendingIRQ(IRQn_Type IRQn, uint32_t * p_pending_irq)
+{
+    *p_pending_irq = (m_irq_pending >> IRQn) & 1;
+    return NRF_SUCCESS;
+}
+
+
+uint32_t sd_nvic_SetPendingIRQ(IRQn_Type IRQn)
+{
+    // Only the radio notification interrupt has a handler here.
+    if (IRQn == SWI1_IRQn)
+    {
+        m_irq_pending |= 1UL << IRQn;
+    }
+    return NRF_SUCCESS;
+}
+
+
+uint32_t sd_nvic_ClearPendingIRQ(IRQn_Type IRQn)
+{
+    m_irq_pending &= ~(1UL << IRQn);
+    return NRF_SUCCESS;
+}
+
+
+uint32_t sd_nvic_SetPriority(IRQn_Type IRQn, uint32_t priority)
+{
+    UNUSED_PARAMETER(IRQn);
+    VERIFY_TRUE((priority == APP_IRQ_PRIORITY_HIGH) || (priority == APP_IRQ_PRIORITY_LOW),
+                NRF_ERROR_SOC_NVIC_INTERRUPT_PRIORITY_NOT_ALLOWED);
+    return NRF_SUCCESS;
+}
+
+
+uint32_t sd_nvic_SystemReset(void)
+{
+    printf("sd_emu: system reset\n");
+    exit(EXIT_SUCCESS);
+}
+
+
+uint32_t sd_nvic_critical_region_enter(uint8_t * p_is_nested_critical_region)
+{
+    *p_is_nested_critical_region = m_in_critical;
+    m_in_critical = 1;
+    return NRF_SUCCESS;
+}
+
+
+uint32_t sd_nvic_critical_region_exit(uint8_t is_nested_critical_region)
+{
+    if (!is_nested_critical_region)
+    {
+        m_in_critical = 0;
+    }
+    return NRF_SUCCESS;
+}
+
+
+/* BLE common */
+
+uint32_t sd_ble_enable(ble_enable_params_t * p_ble_enable_params, uint32_t * p_app_ram_base)
+{
+    uint32_t attr_tab_size = p_ble_enable_params->gatts_enable_params.attr_tab_size;
+
+    // The emulator has no RAM layout: any start of the application RAM is enough, and is the one
+    // it asks for.
+    VERIFY_PARAM_NOT_NULL(p_app_ram_base);
+    VERIFY_TRUE(m_enabled, NRF_ERROR_INVALID_STATE);
+    VERIFY_TRUE(p_ble_enable_params->gap_enable_params.periph_conn_count == 1, NRF_ERROR_NOT_SUPPORTED);
+
+    m_attr_tab_size = (attr_tab_size == 0) ? BLE_GATTS_ATTR_TAB_SIZE_DEFAULT : (uint16_t)attr_tab_size;
+    VERIFY_TRUE(m_attr_tab_size <= sizeof(m_attr_mem), NRF_ERROR_NO_MEM);
+    m_vs_uuid_max = MIN(p_ble_enable_params->common_enable_params.vs_uuid_count, EMU_MAX_VS_UUIDS);
+
+    return NRF_SUCCESS;
+}
+
+
+uint32_t sd_ble_uuid_vs_add(ble_uuid128_t const * p_vs_uuid, uint8_t * p_uuid_type)
+{
+    for (uint8_t i = 0; i < m_vs_uuid_count; i++)
+    {
+        // The same base added again gets the same type.
+        if (memcmp(&m_vs_uuids[i], p_vs_uuid, sizeof(*p_vs_uuid)) == 0)
+        {
+            *p_uuid_type = BLE_UUID_TYPE_VENDOR_BEGIN + i;
+            return NRF_SUCCESS;
+        }
+    }
+
+    VERIFY_TRUE(m_vs_uuid_count < m_vs_uuid_max, NRF_ERROR_NO_MEM);
+
+    m_vs_uuids[m_vs_uuid_count] = *p_vs_uuid;
+    *p_uuid_type = BLE_UUID_TYPE_VENDOR_BEGIN + m_vs_uuid_count++;
+    return NRF_SUCCESS;
+}
+
+
+uint32_t sd_ble_uuid_encode(ble_uuid_t const * p_uuid, uint8_t * p_uuid_le_len, uint8_t * p_uuid_le)
+{
+    if (p_uuid->type == BLE_UUID_TYPE_BLE)
+    {
+        *p_uuid_le_len = 2;
+        if (p_uuid_le != NULL)
+        {
+            UNUSED_RETURN_VALUE(uint16_encode(p_uuid->uuid, p_uuid_le));
+        }
+        return NRF_SUCCESS;
+    }
+
+    VERIFY_TRUE((p_uuid->type >= BLE_UUID_TYPE_VENDOR_BEGIN) &&
+                (p_uuid->type < BLE_UUID_TYPE_VENDOR_BEGIN + m_vs_uuid_count), NRF_ERROR_INVALID_PARAM);
+
+    *p_uuid_le_len = 16;
+    if (p_uuid_le != NULL)
+    {
+        memcpy(p_uuid_le, &m_vs_uuids[p_uuid->type - BLE_UUID_TYPE_VENDOR_BEGIN], 16);
+        UNUSED_RETURN_VALUE(uint16_encode(p_uuid->uuid, &p_uuid_le[12]));
+    }
+    return NRF_SUCCESS;
+}
+
+
+uint32_t sd_ble_tx_packet_count_get(uint16_t conn_handle, uint8_t * p_count)
+{
+    UNUSED_PARAMETER(conn_handle);
+    *p_count = m_cfg.tx_buffers;
+    return NRF_SUCCESS;
+}
+
+
+uint32_t sd_ble_user_mem_reply(uint16_t conn_handle, ble_user_mem_block_t const * p_block)
+{
+    UNUSED_PARAMETER(p_block);
+    VERIFY_TRUE(m_connected && (conn_handle == EMU_CONN_HANDLE), BLE_ERROR_INVALID_CONN_HANDLE);
+    return NRF_SUCCESS;
+}
+
+
+/* GAP */
+
+uint32_t sd_ble_gap_address_get(ble_gap_addr_t * p_addr)
+{
+    static uint8_t const addr[BLE_GAP_ADDR_LEN] = {0x01, 0x02, 0x03, 0x04, 0x05, 0xC6};
+
+    p_addr->addr_type = BLE_GAP_ADDR_TYPE_RANDOM_STATIC;
+    memcpy(p_addr->addr, addr, sizeof(addr));
+    return NRF_SUCCESS;
+}
+
+
+uint32_t sd_ble_gap_device_name_set(ble_gap_conn_sec_mode_t const * p_write_perm, uint8_t const * p_dev_name, uint16_t len)
+{
+    UNUSED_PARAMETER(p_write_perm);
+    VERIFY_TRUE(len <= sizeof(m_dev_name), NRF_ERROR_DATA_SIZE);
+
+    memcpy(m_dev_name, p_dev_name, len);
+    m_dev_name_len = len;
+    return NRF_SUCCESS;
+}
+
+
+uint32_t sd_ble_gap_device_name_get(uint8_t * p_dev_name, uint16_t * p_len)
+{
+    if (p_dev_name != NULL)
+    {
+        VERIFY_TRUE(*p_len >= m_dev_name_len, NRF_ERROR_DATA_SIZE);
+        memcpy(p_dev_name, m_dev_name, m_dev_name_len);
+    }
+    *p_len = m_dev_name_len;
+    return NRF_SUCCESS;
+}
+
+
+uint32_t sd_ble_gap_appearance_set(uint16_t appearance)
+{
+    UNUSED_PARAMETER(appearance);
+    return NRF_SUCCESS;
+}
+
+
+uint32_t sd_ble_gap_ppcp_set(ble_gap_conn_params_t const * p_conn_params)
+{
+    m_ppcp = *p_conn_params;
+    return NRF_SUCCESS;
+}
+
+
+uint32_t sd_ble_gap_ppcp_get(ble_gap_conn_params_t * p_conn_params)
+{
+    *p_conn_params = m_ppcp;
+    return NRF_SUCCESS;
+}
+
+
+uint32_t sd_ble_gap_adv_data_set(uint8_t const * p_data, uint8_t dlen, uint8_t const * p_sr_data, uint8_t srdlen)
+{
+    UNUSED_PARAMETER(p_data);
+    UNUSED_PARAMETER(p_sr_data);
+    VERIFY_TRUE((dlen <= BLE_GAP_ADV_MAX_SIZE) && (srdlen <= BLE_GAP_ADV_MAX_SIZE), NRF_ERROR_INVALID_LENGTH);
+    return NRF_SUCCESS;
+}
+
+
+uint32_t sd_ble_gap_adv_start(ble_gap_adv_params_t const * p_adv_params)
+{
+    UNUSED_PARAMETER(p_adv_params);
+    VERIFY_TRUE(!m_connected && !m_advertising, NRF_ERROR_INVALID_STATE);
+
+    // The central connects at once; advertising timeouts never happen.
+    m_advertising = true;
+    m_connect_at  = m_now + m_cfg.connect_delay_us;
+    return NRF_SUCCESS;
+}
+
+
+uint32_t sd_ble_gap_adv_stop(void)
+{
+    VERIFY_TRUE(m_advertising, NRF_ERROR_INVALID_STATE);
+    m_advertising = false;
+    return NRF_SUCCESS;
+}
+
+
+uint32_t sd_ble_gap_conn_param_update(uint16_t conn_handle, ble_gap_conn_params_t const * p_conn_params)
+{
+    VERIFY_TRUE(m_connected && (conn_handle == EMU_CONN_HANDLE), BLE_ERROR_INVALID_CONN_HANDLE);
+    VERIFY_TRUE(!m_update_pending, NRF_ERROR_BUSY);
+
+    m_update_params  = (p_conn_params != NULL) ? *p_conn_params : m_ppcp;
+    m_update_pending = true;
+    return NRF_SUCCESS;
+}
+
+
+uint32_t sd_ble_gap_disconnect(uint16_t conn_handle, uint8_t hci_status_code)
+{
+    UNUSED_PARAMETER(hci_status_code);
+    VERIFY_TRUE(m_connected && (conn_handle == EMU_CONN_HANDLE), BLE_ERROR_INVALID_CONN_HANDLE);
+    VERIFY_TRUE(!m_disconnect_pending, NRF_ERROR_INVALID_STATE);
+
+    m_disconnect_pending = true;
+    m_disconnect_reason  = BLE_HCI_LOCAL_HOST_TERMINATED_CONNECTION;
+    return NRF_SUCCESS;
+}
+
+
+uint32_t sd_ble_gap_tx_power_set(int8_t tx_power)
+{
+    UNUSED_PARAMETER(tx_power);
+    return NRF_SUCCESS;
+}
+
+
+uint32_t sd_ble_gap_rssi_start(uint16_t conn_handle, uint8_t threshold_dbm, uint8_t skip_count)
+{
+    UNUSED_PARAMETER(threshold_dbm);
+    UNUSED_PARAMETER(skip_count);
+    VERIFY_TRUE(m_connected && (conn_handle == EMU_CONN_HANDLE), BLE_ERROR_INVALID_CONN_HANDLE);
+    return NRF_SUCCESS;
+}
+
+
+uint32_t sd_ble_gap_rssi_get(uint16_t conn_handle, int8_t * p_rssi)
+{
+    VERIFY_TRUE(m_connected && (conn_handle == EMU_CONN_HANDLE), BLE_ERROR_INVALID_CONN_HANDLE);
+    *p_rssi = -55;
+    return NRF_SUCCESS;
+}
+
+
+uint32_t sd_ble_gap_sec_params_reply(uint16_t                     conn_handle,
+                                     uint8_t                      sec_status,
+                                     ble_gap_sec_params_t const * p_sec_params,
+                                     ble_gap_sec_keyset_t const * p_sec_keyset)
+{
+    UNUSED_PARAMETER(sec_status);
+    UNUSED_PARAMETER(p_sec_params);
+    UNUSED_PARAMETER(p_sec_keyset);
+    VERIFY_TRUE(m_connected && (conn_handle == EMU_CONN_HANDLE), BLE_ERROR_INVALID_CONN_HANDLE);
+    return NRF_SUCCESS;
+}
+
+
+/* GATTS */
+
+uint32_t sd_ble_gatts_service_add(uint8_t type, ble_uuid_t const * p_uuid, uint16_t * p_handle)
+{
+    VERIFY_TRUE(type == BLE_GATTS_SRVC_TYPE_PRIMARY, NRF_ERROR_INVALID_PARAM);
+    return attr_add(EMU_ATTR_SERVICE, p_uuid, 0, NULL, p_handle);
+}
+
+
+uint32_t sd_ble_gatts_characteristic_add(uint16_t                   service_handle,
+                                         ble_gatts_char_md_t const * p_char_md,
+                                         ble_gatts_attr_t const *    p_attr_char_value,
+                                         ble_gatts_char_handles_t *  p_handles)
+{
+    static ble_uuid_t const char_uuid = {BLE_UUID_CHARACTERISTIC, BLE_UUID_TYPE_BLE};
+    static ble_uuid_t const cccd_uuid = {BLE_UUID_DESCRIPTOR_CLIENT_CHAR_CONFIG, BLE_UUID_TYPE_BLE};
+    static ble_uuid_t const desc_uuid = {BLE_UUID_DESCRIPTOR_CHAR_USER_DESC, BLE_UUID_TYPE_BLE};
+    uint16_t                decl_handle;
+    uint16_t                first = m_attr_count;
+    uint32_t                err_code;
+
+    UNUSED_PARAMETER(service_handle);
+    memset(p_handles, 0, sizeof(*p_handles));
+
+    err_code = attr_add(EMU_ATTR_CHAR, &char_uuid, 0, NULL, &decl_handle);
+    VERIFY_SUCCESS(err_code);
+    err_code = attr_value_add(EMU_ATTR_VALUE, p_attr_char_value, &p_handles->value_handle);
+    VERIFY_SUCCESS(err_code);
+
+    if (p_char_md->p_char_user_desc != NULL)
+    {
+        err_code = attr_add(EMU_ATTR_DESC, &desc_uuid, p_char_md->char_user_desc_max_size, NULL,
+                            &p_handles->user_desc_handle);
+        VERIFY_SUCCESS(err_code);
+        attr_get(p_handles->user_desc_handle)->len = p_char_md->char_user_desc_size;
+    }
+    if (p_char_md->char_props.notify || p_char_md->char_props.indicate)
+    {
+        err_code = attr_add(EMU_ATTR_CCCD, &cccd_uuid, sizeof(uint16_t), NULL, &p_handles->cccd_handle);
+        VERIFY_SUCCESS(err_code);
+        attr_get(p_handles->cccd_handle)->len          = sizeof(uint16_t);
+        attr_get(p_handles->cccd_handle)->value_handle = p_handles->value_handle;
+    }
+
+    for (uint16_t i = first; i < m_attr_count; i++)
+    {
+        m_attrs[i].props     = p_char_md->char_props;
+        m_attrs[i].char_uuid = p_attr_char_value->p_uuid->uuid;
+    }
+
+    return NRF_SUCCESS;
+}
+
+
+uint32_t sd_ble_gatts_descriptor_add(uint16_t char_handle, ble_gatts_attr_t const * p_attr, uint16_t * p_handle)
+{
+    emu_attr_t * p_char = attr_get(char_handle);
+    uint32_t     err_code;
+
+    VERIFY_TRUE(p_char != NULL, BLE_ERROR_INVALID_ATTR_HANDLE);
+
+    err_code = attr_value_add(EMU_ATTR_DESC, p_attr, p_handle);
+    VERIFY_SUCCESS(err_code);
+    attr_get(*p_handle)->char_uuid = p_char->char_uuid;
+
+    return NRF_SUCCESS;
+}
+
+
+uint32_t sd_ble_gatts_value_set(uint16_t conn_handle, uint16_t handle, ble_gatts_value_t * p_value)
+{
+    emu_attr_t * p_attr = attr_get(handle);
+
+    UNUSED_PARAMETER(conn_handle);
+    VERIFY_TRUE(p_attr != NULL, BLE_ERROR_INVALID_ATTR_HANDLE);
+    VERIFY_TRUE(p_value->offset <= p_attr->len, NRF_ERROR_INVALID_PARAM);
+
+    p_value->len = MIN(p_value->len, p_attr->max_len - p_value->offset);
+    if (p_value->p_value != NULL)
+    {
+        memcpy(&p_attr->p_value[p_value->offset], p_value->p_value, p_value->len);
+    }
+    if (p_attr->vlen)
+    {
+        p_attr->len = p_value->offset + p_value->len;
+    }
+    return NRF_SUCCESS;
+}
+
+
+uint32_t sd_ble_gatts_value_get(uint16_t conn_handle, uint16_t handle, ble_gatts_value_t * p_value)
+{
+    emu_attr_t * p_attr = attr_get(handle);
+
+    UNUSED_PARAMETER(conn_handle);
+    VERIFY_TRUE(p_attr != NULL, BLE_ERROR_INVALID_ATTR_HANDLE);
+    VERIFY_TRUE(p_value->offset <= p_attr->len, NRF_ERROR_INVALID_PARAM);
+
+    if (p_value->p_value != NULL)
+    {
+        p_value->len = MIN(p_value->len, p_attr->len - p_value->offset);
+        memcpy(p_value->p_value, &p_attr->p_value[p_value->offset], p_value->len);
+    }
+    else
+    {
+        p_value->len = p_attr->len - p_value->offset;
+    }
+    return NRF_SUCCESS;
+}
+
+
+uint32_t sd_ble_gatts_hvx(uint16_t conn_handle, ble_gatts_hvx_params_t const * p_hvx_params)
+{
+    emu_attr_t * p_attr = attr_get(p_hvx_params->handle);
+    emu_attr_t * p_cccd;
+    emu_pkt_t  * p_pkt;
+    uint16_t     len;
+
+    VERIFY_TRUE(m_connected && (conn_handle == EMU_CONN_HANDLE), BLE_ERROR_INVALID_CONN_HANDLE);
+    VERIFY_TRUE((p_attr != NULL) && (p_attr->kind == EMU_ATTR_VALUE), BLE_ERROR_INVALID_ATTR_HANDLE);
+
+    p_cccd = cccd_get(p_hvx_params->handle);
+    VERIFY_TRUE(p_cccd != NULL, NRF_ERROR_INVALID_PARAM);
+    VERIFY_TRUE(uint16_decode(p_cccd->p_value) & p_hvx_params->type, NRF_ERROR_INVALID_STATE);
+
+    len = (p_hvx_params->p_len != NULL) ? *p_hvx_params->p_len : p_attr->len;
+    len = MIN(len, EMU_PAYLOAD_MAX);
+    if (p_hvx_params->p_data != NULL)
+    {
+        // The value of the attribute is updated with the data sent.
+        len = MIN(len, p_attr->max_len - MIN(p_hvx_params->offset, p_attr->max_len));
+        memcpy(&p_attr->p_value[p_hvx_params->offset], p_hvx_params->p_data, len);
+        if (p_attr->vlen)
+        {
+            p_attr->len = p_hvx_params->offset + len;
+        }
+    }
+
+    if (p_hvx_params->type == BLE_GATT_HVX_INDICATION)
+    {
+        VERIFY_TRUE(!m_ind_queued && !m_ind_sent, NRF_ERROR_BUSY);
+        p_pkt        = &m_ind;
+        m_ind_queued = true;
+    }
+    else
+    {
+        p_pkt = fifo_tail(&m_tx_fifo);
+        if (p_pkt == NULL)
+        {
+            m_stats.no_tx_packets++;
+            return BLE_ERROR_NO_TX_PACKETS;
+        }
+        m_tx_fifo.count++;
+    }
+
+    p_pkt->handle = p_hvx_params->handle;
+    p_pkt->type   = p_hvx_params->type;
+    p_pkt->len    = len;
+    memcpy(p_pkt->data, &p_attr->p_value[p_hvx_params->offset], len);
+
+    if (p_hvx_params->p_len != NULL)
+    {
+        *p_hvx_params->p_len = len;
+    }
+    return NRF_SUCCESS;
+}
+
+
+uint32_t sd_ble_gatts_rw_authorize_reply(uint16_t conn_handle,
+                                         ble_gatts_rw_authorize_reply_params_t const * p_rw_authorize_reply_params)
+{
+    ble_gatts_authorize_params_t const * p_params;
+    emu_attr_t                         * p_attr = attr_get(m_auth_pkt.handle);
+
+    VERIFY_TRUE(m_connected && (conn_handle == EMU_CONN_HANDLE), BLE_ERROR_INVALID_CONN_HANDLE);
+    VERIFY_TRUE((m_auth_type != BLE_GATTS_AUTHORIZE_TYPE_INVALID) &&
+                (p_rw_authorize_reply_params->type == m_auth_type), NRF_ERROR_INVALID_STATE);
+
+    m_auth_type = BLE_GATTS_AUTHORIZE_TYPE_INVALID;
+
+    if (p_rw_authorize_reply_params->type == BLE_GATTS_AUTHORIZE_TYPE_READ)
+    {
+        uint16_t offset = m_auth_pkt.offset;
+
+        p_params = &p_rw_authorize_reply_params->params.read;
+        if (p_params->gatt_status != BLE_GATT_STATUS_SUCCESS)
+        {
+            return NRF_SUCCESS;
+        }
+        if (p_params->update && (p_params->p_data != NULL))
+        {
+            VERIFY_TRUE(p_params->offset + p_params->len <= p_attr->max_len, NRF_ERROR_INVALID_PARAM);
+            memcpy(&p_attr->p_value[p_params->offset], p_params->p_data, p_params->len);
+            if (p_attr->vlen)
+            {
+                p_attr->len = p_params->offset + p_params->len;
+            }
+        }
+        if (m_peer.on_read != NULL)
+        {
+            offset = MIN(offset, p_attr->len);
+            m_peer.on_read(m_auth_pkt.handle, &p_attr->p_value[offset], MIN(p_attr->len - offset, EMU_READ_MAX));
+        }
+        return NRF_SUCCESS;
+    }
+
+    p_params = &p_rw_authorize_reply_params->params.write;
+    if ((p_params->gatt_status == BLE_GATT_STATUS_SUCCESS) && p_params->update)
+    {
+        uint8_t const * p_data = (p_params->p_data != NULL) ? p_params->p_data : m_auth_pkt.data;
+        uint16_t        len    = (p_params->p_data != NULL) ? p_params->len : m_auth_pkt.len;
+
+        VERIFY_TRUE(m_auth_pkt.offset + len <= p_attr->max_len, NRF_ERROR_INVALID_PARAM);
+        memcpy(&p_attr->p_value[m_auth_pkt.offset], p_data, len);
+        if (p_attr->vlen)
+        {
+            p_attr->len = m_auth_pkt.offset + len;
+        }
+    }
+    return NRF_SUCCESS;
+}
+
+
+uint32_t sd_ble_gatts_sys_attr_set(uint16_t conn_handle, uint8_t const * p_sys_attr_data, uint16_t len, uint32_t flags)
+{
+    UNUSED_PARAMETER(p_sys_attr_data);
+    UNUSED_PARAMETER(len);
+    UNUSED_PARAMETER(flags);
+    VERIFY_TRUE(m_connected && (conn_handle == EMU_CONN_HANDLE), BLE_ERROR_INVALID_CONN_HANDLE);
+    return NRF_SUCCESS;
+}
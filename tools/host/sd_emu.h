@@ -0,0 +1,133 @@
+#ifndef __SD_EMU_H_
+#define __SD_EMU_H_
+
+#include "ble.h"
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#ifdef __cplusplus
+	extern "C" {
+#endif
+
+/**@brief Model of the link, fixed for a run so that runs are repeatable.
+ *
+ * @details Connection events are exactly conn_interval apart. In each event up to tx_per_event
+ *          exchanges take place, each carrying at most one packet from the central and one from
+ *          the device. Only the packets queued when the event starts are sent in it: whatever the
+ *          application sends from the events of a connection event goes in the next one.
+ */
+typedef struct
+{
+    uint16_t conn_interval;                                       /**< Interval in 1.25 ms units. */
+    uint8_t  tx_buffers;                                          /**< Application TX buffers of the SoftDevice. */
+    uint8_t  tx_per_event;                                        /**< Exchanges per connection event. */
+    uint32_t connect_delay_us;                                    /**< Time from the start of advertising to the connection. */
+    bool     replay;                                              /**< The link only follows the events given to @ref sd_emu_evt_inject. */
+} sd_emu_cfg_t;
+
+/**@brief Link counters. */
+typedef struct
+{
+    uint32_t conn_events;
+    uint32_t tx_packets;                                          /**< Notifications and indications sent. */
+    uint32_t rx_packets;                                          /**< Writes and reads received. */
+    uint32_t no_tx_packets;                                       /**< hvx calls refused for lack of TX buffers. */
+    uint8_t  max_tx_per_event;
+    uint16_t attr_tab_used;                                       /**< Bytes of the attribute table used by the services. */
+    uint16_t attr_tab_size;
+} sd_emu_stats_t;
+
+/**@brief Handlers of the emulated central. All are optional. */
+typedef struct
+{
+    void (*on_connected)(uint16_t conn_interval);
+    void (*on_disconnected)(uint8_t reason);
+    void (*on_conn_event)(void);                                  /**< Start of a connection event, before the packets. */
+    void (*on_hvx)(uint16_t handle, uint8_t type, uint8_t const * p_data, uint16_t len);
+    void (*on_read)(uint16_t handle, uint8_t const * p_data, uint16_t len);
+} sd_emu_peer_t;
+
+/**@brief Work scheduled on the emulated clock, by the other stand-ins and the central.
+ *
+ * @details due returns the time the work is next due, UINT64_MAX if none; run is called when
+ *          the clock reaches it.
+ */
+typedef struct
+{
+    uint64_t (*due)(void);
+    void     (*run)(void);
+} sd_emu_source_t;
+
+/**@brief Function for setting up the emulator. To be called before the application starts. */
+void sd_emu_init(sd_emu_cfg_t const * p_cfg, sd_emu_peer_t const * p_peer);
+
+/**@brief Function for adding work on the emulated clock. Sources are never removed. */
+void sd_emu_source_add(sd_emu_source_t const * p_source);
+
+/**@brief Function for getting the emulated time, in microseconds since the start. */
+uint64_t sd_emu_now(void);
+
+/**@brief Function for running the emulator until a given time. Used by busy waits. */
+void sd_emu_run_until(uint64_t time_us);
+
+/**@brief Function for running an application interrupt handler.
+ *
+ * @details Handlers run one at a time to completion: the emulator does not model preemption.
+ *          Running one wakes the application from @ref sd_app_evt_wait.
+ */
+void sd_emu_irq_run(void (*handler)(void));
+
+/**@brief Function for checking whether an application interrupt handler is running. */
+bool sd_emu_in_irq(void);
+
+/**@brief Function for raising a SoC event, given to the handler set with softdevice_sys_evt_handler_set. */
+void sd_emu_sys_evt_raise(uint32_t evt_id);
+
+/**@brief Function for queuing a write of the central. Writes with response go one per event.
+ *
+ * @retval NRF_SUCCESS             If the write was queued.
+ * @retval NRF_ERROR_INVALID_STATE If not connected.
+ * @retval NRF_ERROR_NO_MEM        If the central queue is full.
+ */
+uint32_t sd_emu_peer_write(uint16_t handle, uint8_t const * p_data, uint16_t len, bool with_response);
+
+/**@brief Function for queuing a read of the central, answered through sd_emu_peer_t::on_read.
+ *
+ * @details A non zero offset makes it a Read Blob. Reads are requests, one per event too.
+ */
+uint32_t sd_emu_peer_read(uint16_t handle, uint16_t offset);
+
+/**@brief Function for counting the writes and reads the central has not sent yet. */
+uint16_t sd_emu_peer_pending(void);
+
+/**@brief Function for finding an attribute of a characteristic by the 16-bit UUID of the characteristic.
+ *
+ * @param[in] uuid  UUID of the characteristic, of any UUID type.
+ * @param[in] cccd  true for the CCCD of the characteristic, false for its value.
+ *
+ * @return Handle, or BLE_GATT_HANDLE_INVALID.
+ */
+uint16_t sd_emu_handle_find(uint16_t uuid, bool cccd);
+
+/**@brief Function for enabling every notification and indication, as a central does after discovery. */
+void sd_emu_peer_cccds_enable(void);
+
+/**@brief Function for reading the link counters. */
+void sd_emu_stats_get(sd_emu_stats_t * p_stats);
+
+/**@brief Function for giving the application a recorded SoftDevice event.
+ *
+ * @details The emulated stack is brought to the state the event reports: connected or not, the
+ *          value written by the central, the TX buffers freed. Meant for a replay, where the link
+ *          makes no events of its own (sd_emu_cfg_t::replay).
+ *
+ * @param[in] p_evt  Event, header.evt_len bytes.
+ */
+void sd_emu_evt_inject(ble_evt_t const * p_evt);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
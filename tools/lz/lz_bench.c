@@ -0,0 +1,245 @@
+/**@file
+ *
+ * @brief Host benchmark of the UART stream compression.
+ *
+ * @details Cuts the input into lines and frames the way the firmware does, decodes the frames and
+ *          checks the result, then reports the size of the stream against uncompressed frames and
+ *          the time spent per KB. Usage: lz_bench [-f frame_size] [-n rounds] [file], the default
+ *          input being synthetic console lines.
+ */
+#include "cus_lz.h"
+#include "lz_dec.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#define FRAME_SIZE_DEFAULT              19                        /**< CUS_ARQ_MAX_DATA_LEN with the default ATT MTU. */
+#define FRAME_SIZE_MAX                  244
+#define SAMPLE_LINES                    2000
+
+
+static double now_ns(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+
+/**@brief Function for making console output like the firmware prints. */
+static size_t sample_make(uint8_t ** pp_data)
+{
+    static char const * states[] = {"IDLE", "ADV", "CONNECTED", "BUSY"};
+    size_t              size     = SAMPLE_LINES * 80;
+    char              * p_data   = malloc(size);
+    size_t              len      = 0;
+    uint32_t            seed     = 1;
+
+    for (int i = 0; i < SAMPLE_LINES; i++)
+    {
+        seed = seed * 1103515245 + 12345;
+        len += snprintf(&p_data[len], size - len,
+                        "t=%08u adc=0x%03x temp=%d.%uC state=%s\r\n",
+                        i * 250, (seed >> 16) & 0x3FF, 20 + (int)((seed >> 8) % 8),
+                        (seed >> 4) % 10, states[(seed >> 20) & 3]);
+    }
+
+    *pp_data = (uint8_t *)p_data;
+    return len;
+}
+
+
+static size_t file_read(char const * p_name, uint8_t ** pp_data)
+{
+    FILE   * p_file = fopen(p_name, "rb");
+    size_t   size   = 0;
+    size_t   len;
+
+    if (p_file == NULL)
+    {
+        perror(p_name);
+        exit(1);
+    }
+
+    *pp_data = NULL;
+    do
+    {
+        *pp_data = realloc(*pp_data, size + 65536);
+        len      = fread(&(*pp_data)[size], 1, 65536, p_file);
+        size    += len;
+    } while (len > 0);
+
+    fclose(p_file);
+    return size;
+}
+
+
+/**@brief Function for counting the frames the firmware sends without compression. */
+static size_t raw_frames_count(uint8_t const * p_data, size_t size, size_t frame_size)
+{
+    size_t frames = 0;
+    size_t index  = 0;
+
+    for (size_t i = 0; i < size; i++)
+    {
+        index++;
+        if ((p_data[i] == '\n') || (index >= frame_size))
+        {
+            frames++;
+            index = 0;
+        }
+    }
+    return frames + ((index != 0) ? 1 : 0);
+}
+
+
+/**@brief Function for compressing the input line by line, as uart_line_send does.
+ *
+ * @return Number of frames, whose lengths and contents are stored one after the other.
+ */
+static size_t encode_all(uint8_t const * p_data, size_t size, size_t frame_size,
+                         uint8_t * p_frames, uint16_t * p_lengths, size_t * p_bytes)
+{
+    cus_lz_t lz;
+    size_t   frames = 0;
+    size_t   start  = 0;
+
+    cus_lz_init(&lz);
+    *p_bytes = 0;
+
+    while (start < size)
+    {
+        size_t end = start;
+
+        while ((end < size) && ((end - start) < CUS_LZ_LINE_SIZE))
+        {
+            if (p_data[end++] == '\n')
+            {
+                break;
+            }
+        }
+
+        for (size_t offset = start; offset < end; )
+        {
+            offset += cus_lz_frame_encode(&lz, &p_data[offset], (uint16_t)(end - offset),
+                                          &p_frames[frames * frame_size], (uint16_t)frame_size,
+                                          &p_lengths[frames]);
+            *p_bytes += p_lengths[frames++];
+        }
+        start = end;
+    }
+    return frames;
+}
+
+
+static size_t decode_all(uint8_t const * p_frames, uint16_t const * p_lengths, size_t frames,
+                         size_t frame_size, uint8_t * p_out, size_t out_max)
+{
+    lz_dec_t dec;
+    size_t   out = 0;
+
+    lz_dec_init(&dec);
+
+    for (size_t i = 0; i < frames; i++)
+    {
+        int len = lz_dec_frame(&dec, &p_frames[i * frame_size], p_lengths[i],
+                               &p_out[out], out_max - out);
+        if (len < 0)
+        {
+            fprintf(stderr, "frame %zu does not decode\n", i);
+            exit(1);
+        }
+        out += (size_t)len;
+    }
+    return out;
+}
+
+
+int main(int argc, char ** argv)
+{
+    size_t     frame_size = FRAME_SIZE_DEFAULT;
+    int        rounds     = 20;
+    uint8_t  * p_data;
+    size_t     size;
+    int        opt;
+
+    while ((opt = getopt(argc, argv, "f:n:")) != -1)
+    {
+        switch (opt)
+        {
+            case 'f':
+                frame_size = (size_t)atoi(optarg);
+                break;
+
+            case 'n':
+                rounds = atoi(optarg);
+                break;
+
+            default:
+                fprintf(stderr, "usage: %s [-f frame_size] [-n rounds] [file]\n", argv[0]);
+                return 1;
+        }
+    }
+
+    if ((frame_size < (CUS_LZ_HEADER_LEN + 2)) || (frame_size > FRAME_SIZE_MAX) || (rounds < 1))
+    {
+        fprintf(stderr, "frame size %u..%u, rounds at least 1\n",
+                CUS_LZ_HEADER_LEN + 2, FRAME_SIZE_MAX);
+        return 1;
+    }
+
+    size = (optind < argc) ? file_read(argv[optind], &p_data) : sample_make(&p_data);
+
+    // A frame carries at least one byte of data.
+    uint8_t  * p_frames  = malloc(size * frame_size + 1);
+    uint16_t * p_lengths = malloc((size + 1) * sizeof(uint16_t));
+    uint8_t  * p_out     = malloc(size + 1);
+    size_t     bytes     = 0;
+    size_t     frames    = 0;
+    size_t     out       = 0;
+    double     t_enc;
+    double     t_dec;
+
+    t_enc = now_ns();
+    for (int i = 0; i < rounds; i++)
+    {
+        frames = encode_all(p_data, size, frame_size, p_frames, p_lengths, &bytes);
+    }
+    t_enc = (now_ns() - t_enc) / rounds;
+
+    t_dec = now_ns();
+    for (int i = 0; i < rounds; i++)
+    {
+        out = decode_all(p_frames, p_lengths, frames, frame_size, p_out, size + 1);
+    }
+    t_dec = (now_ns() - t_dec) / rounds;
+
+    if ((out != size) || (memcmp(p_out, p_data, size) != 0))
+    {
+        fprintf(stderr, "decoded data differs from the input\n");
+        return 1;
+    }
+
+    size_t raw_frames = raw_frames_count(p_data, size, frame_size);
+
+    printf("window %u B, copies %u..%u B, line %u B, frame %zu B\n",
+           CUS_LZ_WINDOW_SIZE, CUS_LZ_MIN_MATCH, CUS_LZ_MAX_MATCH, CUS_LZ_LINE_SIZE, frame_size);
+    printf("input          %zu B\n", size);
+    printf("compressed     %zu B in %zu frames (%.1f B per frame)\n",
+           bytes, frames, (double)bytes / frames);
+    printf("uncompressed   %zu frames\n", raw_frames);
+    printf("ratio          %.2f (bytes), %.2f (notifications)\n",
+           (double)size / bytes, (double)raw_frames / frames);
+    printf("encode         %.1f us/KB\n", t_enc / (size / 1024.0) / 1000.0);
+    printf("decode         %.1f us/KB\n", t_dec / (size / 1024.0) / 1000.0);
+
+    free(p_out);
+    free(p_lengths);
+    free(p_frames);
+    free(p_data);
+    return 0;
+}
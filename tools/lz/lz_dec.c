@@ -0,0 +1,113 @@
+#include "lz_dec.h"
+
+
+/**@brief Bit reader over a frame. */
+typedef struct
+{
+    uint8_t const * p_buf;
+    size_t          bits;                                         /**< Bits read. */
+    size_t          max_bits;
+} bit_reader_t;
+
+
+static uint16_t bits_get(bit_reader_t * p_reader, uint8_t count)
+{
+    uint16_t value = 0;
+
+    while (count-- > 0)
+    {
+        value = (value << 1) | ((p_reader->p_buf[p_reader->bits >> 3] >> (7 - (p_reader->bits & 7))) & 1);
+        p_reader->bits++;
+    }
+    return value;
+}
+
+
+static void window_put(lz_dec_t * p_dec, uint8_t byte)
+{
+    p_dec->window[p_dec->head] = byte;
+    p_dec->head                = (p_dec->head + 1) & (CUS_LZ_WINDOW_SIZE - 1);
+    if (p_dec->len < CUS_LZ_WINDOW_SIZE)
+    {
+        p_dec->len++;
+    }
+}
+
+
+void lz_dec_init(lz_dec_t * p_dec)
+{
+    p_dec->head   = 0;
+    p_dec->len    = 0;
+    p_dec->synced = false;
+}
+
+
+int lz_dec_frame(lz_dec_t * p_dec, uint8_t const * p_frame, size_t frame_len,
+                 uint8_t * p_out, size_t out_max)
+{
+    bit_reader_t reader;
+    size_t       out = 0;
+
+    if (frame_len < CUS_LZ_HEADER_LEN)
+    {
+        p_dec->synced = false;
+        return -1;
+    }
+
+    if (p_frame[0] & CUS_LZ_HEADER_RESET)
+    {
+        p_dec->head   = 0;
+        p_dec->len    = 0;
+        p_dec->synced = true;
+    }
+
+    if (!p_dec->synced)
+    {
+        return 0;
+    }
+
+    reader.p_buf    = &p_frame[CUS_LZ_HEADER_LEN];
+    reader.bits     = 0;
+    reader.max_bits = (frame_len - CUS_LZ_HEADER_LEN) * 8;
+
+    // What is left after the last token is padding, shorter than any token.
+    while ((reader.max_bits - reader.bits) >= CUS_LZ_LITERAL_BITS)
+    {
+        if (bits_get(&reader, 1))
+        {
+            if (out >= out_max)
+            {
+                p_dec->synced = false;
+                return -1;
+            }
+            p_out[out] = (uint8_t)bits_get(&reader, 8);
+            window_put(p_dec, p_out[out++]);
+        }
+        else
+        {
+            if ((reader.max_bits - reader.bits) < (CUS_LZ_MATCH_BITS - 1))
+            {
+                p_dec->synced = false;
+                return -1;
+            }
+
+            uint16_t dist = bits_get(&reader, CUS_LZ_WINDOW_BITS) + 1;
+            uint16_t len  = bits_get(&reader, CUS_LZ_LOOKAHEAD_BITS) + CUS_LZ_MIN_MATCH;
+
+            if ((dist > p_dec->len) || ((out + len) > out_max))
+            {
+                p_dec->synced = false;
+                return -1;
+            }
+
+            // Byte by byte: the copy may overlap the bytes it produces.
+            while (len-- > 0)
+            {
+                p_out[out] = p_dec->window[(p_dec->head - dist) & (CUS_LZ_WINDOW_SIZE - 1)];
+                window_put(p_dec, p_out[out++]);
+            }
+        }
+    }
+
+    return (int)out;
+}
@@ -0,0 +1,49 @@
+#ifndef __LZ_DEC_H_
+#define __LZ_DEC_H_
+
+#include "cus_lz.h"
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+#ifdef __cplusplus
+	extern "C" {
+#endif
+
+/**@brief Decoder of the UART stream frames, the peer side of cus_lz. */
+typedef struct
+{
+    uint8_t           window[CUS_LZ_WINDOW_SIZE];                 /**< Last bytes decoded, circular. */
+    uint16_t          head;                                       /**< Where the next byte is stored in the window. */
+    uint16_t          len;                                        /**< Bytes in the window. */
+    bool              synced;                                     /**< A frame with CUS_LZ_HEADER_RESET was seen. */
+} lz_dec_t;
+
+/**@brief Function for initializing a decoder. Frames are skipped until one starts a new history.
+ *
+ * @param[out] p_dec  Decoder.
+ */
+void lz_dec_init(lz_dec_t * p_dec);
+
+/**@brief Function for decoding one frame, frames in the order of the stream.
+ *
+ * @param[in]  p_dec      Decoder.
+ * @param[in]  p_frame    Frame.
+ * @param[in]  frame_len  Length of the frame.
+ * @param[out] p_out      Decoded bytes.
+ * @param[in]  out_max    Size of p_out. A frame of n bytes decodes to at most
+ *                        (n - CUS_LZ_HEADER_LEN) * 8 / CUS_LZ_MATCH_BITS * CUS_LZ_MAX_MATCH bytes.
+ *
+ * @return Number of bytes decoded, 0 for a frame skipped before the stream is in sync, -1 if the
+ *         frame is not valid (copy from outside the history, or p_out too small). The decoder is
+ *         out of sync after an error.
+ */
+int lz_dec_frame(lz_dec_t * p_dec, uint8_t const * p_frame, size_t frame_len,
+                 uint8_t * p_out, size_t out_max);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
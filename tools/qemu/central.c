@@ -0,0 +1,231 @@
+/**@file
+ *
+ * @brief Central of the QEMU microbit build, and the report of the run.
+ *
+ * @details Connects when the application advertises, enables every notification, then
+ *          acknowledges the UART stream of Service 1 in each connection event and sends an echo
+ *          frame on Service 2 every CENTRAL_ECHO_MS. After CENTRAL_RUN_MS it prints the link
+ *          counters, the stack use and the cus_prof histograms of the hot paths through
+ *          semihosting, and stops the emulator. The stack use leaves out the SoftDevice, which the
+ *          stub does not model.
+ *
+ *          qemu-system-arm runs with -icount shift=QEMU_ICOUNT_SHIFT: every instruction takes
+ *          2^QEMU_ICOUNT_SHIFT ns of virtual time, which the TIMER of cus_prof counts, so the
+ *          ticks of a section convert back to the instructions it executed. These are M0
+ *          instructions, not cycles: loads, stores and taken branches take 2 or 3 cycles on the
+ *          device, and flash wait states are not modelled.
+ */
+#include "sd_stub.h"
+#include "semihost.h"
+
+#include "sdk_config.h"
+#include "sdk_common.h"
+#include "app_error.h"
+#include "cus_service.h"
+#include "cus_mux.h"
+#include "cus_prof.h"
+#include "cus_stack.h"
+
+#include <string.h>
+
+#if !CUS_PROF_ENABLED
+#error "The QEMU build reports the cus_prof histograms: build with CUS_PROF_ENABLED=1."
+#endif
+
+#ifndef CENTRAL_RUN_MS
+#define CENTRAL_RUN_MS                  10000
+#endif
+#ifndef QEMU_ICOUNT_SHIFT
+#define QEMU_ICOUNT_SHIFT               6
+#endif
+
+#define CENTRAL_CONN_INTERVAL           24                        /**< 30 ms, in 1.25 ms units. */
+#define CENTRAL_TX_BUFFERS              7
+#define CENTRAL_TX_PER_EVENT            4
+#define CENTRAL_CONNECT_DELAY_US        100000
+#define CENTRAL_ECHO_MS                 200
+#define CH_ECHO                         5                         /**< Channel of Service 2, as in main.c. */
+#define ECHO_ANSWER                     0x00                      /**< Echo answer, as in main.c. */
+#define ECHO_HEADER_LEN                 (3 + sizeof(uint32_t))
+
+static char const * const m_probe_names[] = {"BLE_EVT", "UART_EVT", "DATA", "DATA2", "READ_AUTH"};
+
+STATIC_ASSERT(ARRAY_SIZE(m_probe_names) == CUS_PROF_PROBE_COUNT);
+
+static uint16_t     m_s1_notify;
+static uint16_t     m_s1_write;
+static uint16_t     m_s2_notify;
+static uint16_t     m_s2_write;
+
+static uint8_t      m_arq_next;                                   /**< Next sequence number expected on Service 1. */
+static bool         m_arq_new;                                    /**< Frames received since the last acknowledgement. */
+static uint32_t     m_arq_frames;
+static uint32_t     m_arq_dups;
+
+static uint32_t     m_echo_next_us;
+static uint32_t     m_echo_sent;
+static uint32_t     m_echo_received;
+static uint32_t     m_echo_rtt_total_us;
+
+
+/**@brief Function for converting timer ticks of cus_prof to instructions. */
+static uint32_t ticks_to_insns(uint32_t ticks)
+{
+    return (uint32_t)(((uint64_t)ticks * (1000UL << CUS_PROF_TIMER_PRESCALER)) / (16UL << QEMU_ICOUNT_SHIFT));
+}
+
+
+static void report(void)
+{
+    sd_stub_stats_t stats;
+
+    sd_stub_stats_get(&stats);
+    semihost_printf("central: %u ms, %lu connection events, %lu packets sent, %lu received, %lu hvx refused, %lu SVC calls\n",
+                    CENTRAL_RUN_MS, (unsigned long)stats.conn_events, (unsigned long)stats.tx_packets,
+                    (unsigned long)stats.rx_packets, (unsigned long)stats.no_tx_packets, (unsigned long)stats.svc_calls);
+    semihost_printf("central: UART stream %lu frames, %lu sent again; echo %lu of %lu, mean round trip %lu us\n",
+                    (unsigned long)m_arq_frames, (unsigned long)m_arq_dups, (unsigned long)m_echo_received,
+                    (unsigned long)m_echo_sent,
+                    (unsigned long)((m_echo_received > 0) ? m_echo_rtt_total_us / m_echo_received : 0));
+#if CUS_STACK_ENABLED
+    cus_stack_stats_t stack;
+
+    UNUSED_RETURN_VALUE(cus_stack_check());
+    cus_stack_stats_get(&stack);
+    semihost_printf("central: stack %u of %u bytes, thread %u, handler %u\n",
+                    stack.peak, stack.size, stack.thread, stack.handler);
+#endif
+
+    semihost_printf("%-10s %8s %10s %8s %10s %8s\n", "probe", "count", "mean tick", "max tick", "mean insn", "max insn");
+    for (uint8_t i = 0; i < CUS_PROF_PROBE_COUNT; i++)
+    {
+        cus_prof_hist_t hist;
+        uint32_t        mean;
+
+        cus_prof_hist_get((cus_prof_probe_t)i, &hist);
+        mean = (hist.count > 0) ? hist.total / hist.count : 0;
+        semihost_printf("%-10s %8lu %10lu %8u %10lu %8lu\n", m_probe_names[i], (unsigned long)hist.count,
+                        (unsigned long)mean, hist.max, (unsigned long)ticks_to_insns(mean),
+                        (unsigned long)ticks_to_insns(hist.max));
+    }
+}
+
+
+/**@brief Function for handling a frame of the UART stream, {seq, payload}. */
+static void on_arq_frame(uint8_t const * p_data, uint16_t len)
+{
+    if (len < 2)
+    {
+        // The 1-byte counter of ble_cus_custom_value_update shares the characteristic.
+        return;
+    }
+    if (p_data[0] != m_arq_next)
+    {
+        m_arq_dups++;
+    }
+    else
+    {
+        m_arq_next++;
+        m_arq_frames++;
+    }
+    m_arq_new = true;
+}
+
+
+static void on_echo_frame(uint8_t const * p_data, uint16_t len)
+{
+    // The ECHO_SENT reports are not used here.
+    if ((p_data[0] == ECHO_ANSWER) && (len >= ECHO_HEADER_LEN + sizeof(uint32_t)))
+    {
+        m_echo_received++;
+        m_echo_rtt_total_us += sd_stub_now() - uint32_decode(&p_data[ECHO_HEADER_LEN]);
+    }
+}
+
+
+static void on_hvx(uint16_t handle, uint8_t const * p_data, uint16_t len)
+{
+    if (handle == m_s1_notify)
+    {
+        on_arq_frame(p_data, len);
+    }
+    else if ((handle == m_s2_notify) && (len >= CUS_MUX_HEADER_LEN) && ((p_data[0] & 0x0F) == CH_ECHO))
+    {
+        on_echo_frame(&p_data[1], len - 1);
+    }
+}
+
+
+static void on_conn_event(void)
+{
+    uint32_t now = sd_stub_now();
+
+    if (now >= (uint32_t)CENTRAL_RUN_MS * 1000)
+    {
+        report();
+        semihost_exit(true);
+    }
+
+    if (m_arq_new)
+    {
+        uint8_t ack[2] = {m_arq_next, 0};
+
+        UNUSED_RETURN_VALUE(sd_stub_peer_write(m_s1_write, ack, sizeof(ack), false));
+        m_arq_new = false;
+    }
+
+    if ((int32_t)(now - m_echo_next_us) >= 0)
+    {
+        uint8_t frame[CUS_MUX_HEADER_LEN + sizeof(uint32_t)];
+
+        frame[0] = CUS_MUX_HEADER(CH_ECHO);
+        UNUSED_RETURN_VALUE(uint32_encode(now, &frame[CUS_MUX_HEADER_LEN]));
+        if (sd_stub_peer_write(m_s2_write, frame, sizeof(frame), false) == NRF_SUCCESS)
+        {
+            m_echo_sent++;
+        }
+        m_echo_next_us = now + CENTRAL_ECHO_MS * 1000;
+    }
+}
+
+
+static void on_connected(void)
+{
+    m_s1_notify    = sd_stub_handle_find(BLE_UUID_CUSTOM_VAL_CHA_NOTIFY, false);
+    m_s1_write     = sd_stub_handle_find(BLE_UUID_CUSTOM_VAL_CHA_WRITE, false);
+    m_s2_notify    = sd_stub_handle_find(BLE_UUID_CUSTOM_VAL_CHA_NOTIFY_2, false);
+    m_s2_write     = sd_stub_handle_find(BLE_UUID_CUSTOM_VAL_CHA_WRITE_2, false);
+    m_arq_next     = 0;
+    m_echo_next_us = sd_stub_now();
+    sd_stub_peer_cccds_enable();
+}
+
+
+void sd_stub_central_init(void)
+{
+    static sd_stub_cfg_t const  cfg  = {CENTRAL_CONN_INTERVAL, CENTRAL_TX_BUFFERS, CENTRAL_TX_PER_EVENT,
+                                        CENTRAL_CONNECT_DELAY_US};
+    static sd_stub_peer_t const peer = {on_connected, on_conn_event, on_hvx};
+
+    sd_stub_init(&cfg, &peer);
+}
+
+
+/**@brief Function for stopping the run on an application error: on the device it would reset. */
+void app_error_fault_handler(uint32_t id, uint32_t pc, uint32_t info)
+{
+    if (id == NRF_FAULT_ID_SDK_ERROR)
+    {
+        error_info_t const * p_info = (error_info_t const *)info;
+
+        semihost_printf("app_error: 0x%08lX at %s:%u\n", (unsigned long)p_info->err_code,
+                        (p_info->p_file_name != NULL) ? (char const *)p_info->p_file_name : "?",
+                        (unsigned)p_info->line_num);
+    }
+    else
+    {
+        semihost_printf("app_error: id 0x%08lX pc 0x%08lX info 0x%08lX\n",
+                        (unsigned long)id, (unsigned long)pc, (unsigned long)info);
+    }
+    semihost_exit(false);
+}
@@ -0,0 +1,1170 @@
+/**@file
+ *
+ * @brief SoftDevice stub for the QEMU microbit build: the SVC calls of the application, served
+ *        from SVC_Handler, and a connection-event model with one central driven by TIMER0.
+ *
+ * @details The application and the SDK modules are built as for the device: every sd_* call is
+ *          an SVC instruction whose number is the enum value from the S130 headers. SVC_Handler
+ *          finds the number and the arguments in the stacked frame and writes the result back to
+ *          the stacked r0. Events are queued here and given to the real softdevice_handler
+ *          through SWI2, as the SoftDevice does. Only the calls the application makes are served;
+ *          any other one is reported on the console and fails with NRF_ERROR_NOT_SUPPORTED.
+ *
+ *          The SVC handler and TIMER0 run at priority 0 and cannot interrupt each other, so the
+ *          state below needs no critical region. The instructions spent here are counted in the
+ *          sections the application times: they stand for the SoftDevice, which costs more.
+ */
+#include "sd_stub.h"
+#include "semihost.h"
+
+#include "sdk_common.h"
+#include "nrf.h"
+#include "nrf_sdm.h"
+#include "nrf_soc.h"
+#include "ble_hci.h"
+#include "app_util_platform.h"
+
+#include <string.h>
+
+
+#define STUB_CONN_HANDLE                0
+#define STUB_FIRST_HANDLE               0x000C                    /**< First application handle, after the GAP and GATT services of the SoftDevice. */
+#define STUB_MAX_ATTRS                  32
+#define STUB_ATTR_MEM_SIZE              768                       /**< Values stored by the stack. Less than the real table: RAM is 16 KB. */
+#define STUB_MAX_VS_UUIDS               2
+#define STUB_EVT_QUEUE_SIZE             8
+#define STUB_EVT_WORDS                  ((sizeof(ble_evt_t) + GATT_MTU_SIZE_DEFAULT + 3) / 4)
+#define STUB_SYS_QUEUE_SIZE             4
+#define STUB_PEER_QUEUE_SIZE            8
+#define STUB_TX_QUEUE_MAX               8
+#define STUB_PAYLOAD_MAX                (GATT_MTU_SIZE_DEFAULT - 3)
+
+#define STUB_TIMER                      NRF_TIMER0
+#define STUB_TIMER_PRESCALER            4                         /**< 1 MHz. */
+#define STUB_CC_LINK                    0                         /**< Next connection, or next connection event. */
+#define STUB_CC_NOTIF                   1                         /**< Next ACTIVE radio notification. */
+#define STUB_CC_NOW                     3                         /**< Capture register used to read the time. */
+
+typedef enum
+{
+    STUB_ATTR_SERVICE,
+    STUB_ATTR_CHAR,                                               /**< Characteristic declaration. */
+    STUB_ATTR_VALUE,
+    STUB_ATTR_CCCD,
+    STUB_ATTR_DESC
+} stub_attr_kind_t;
+
+typedef struct
+{
+    ble_uuid_t               uuid;
+    stub_attr_kind_t         kind;
+    ble_gatt_char_props_t    props;                               /**< Of the characteristic, for its value and CCCD. */
+    uint16_t                 char_uuid;                           /**< 16-bit UUID of the characteristic the attribute belongs to. */
+    uint16_t                 value_handle;                        /**< Of the characteristic, for a CCCD. */
+    bool                     wr_auth;
+    bool                     vlen;
+    uint16_t                 max_len;
+    uint16_t                 len;
+    uint8_t                * p_value;
+} stub_attr_t;
+
+/**@brief Packet of the central or of the device. */
+typedef struct
+{
+    uint16_t                 handle;
+    uint8_t                  type;                                /**< For the device: BLE_GATT_HVX_*. */
+    bool                     with_response;                       /**< For the central: write request. */
+    uint16_t                 len;
+    uint8_t                  data[STUB_PAYLOAD_MAX];
+} stub_pkt_t;
+
+typedef struct
+{
+    stub_pkt_t             * p_pkts;
+    uint8_t                  size;
+    uint8_t                  head;
+    uint8_t                  count;
+} stub_fifo_t;
+
+
+static sd_stub_cfg_t        m_cfg;
+static sd_stub_peer_t       m_peer;
+static sd_stub_stats_t      m_stats;
+
+static uint32_t             m_evts[STUB_EVT_QUEUE_SIZE][STUB_EVT_WORDS];
+static uint8_t              m_evt_head;
+static uint8_t              m_evt_count;
+static uint32_t             m_sys_evts[STUB_SYS_QUEUE_SIZE];
+static uint8_t              m_sys_head;
+static uint8_t              m_sys_count;
+
+static stub_attr_t          m_attrs[STUB_MAX_ATTRS];
+static uint16_t             m_attr_count;
+static uint32_t             m_attr_mem[STUB_ATTR_MEM_SIZE / 4];
+static uint16_t             m_attr_mem_used;
+static ble_uuid128_t        m_vs_uuids[STUB_MAX_VS_UUIDS];
+static uint8_t              m_vs_uuid_count;
+
+static uint8_t              m_dev_name[BLE_GAP_DEVNAME_MAX_LEN];
+static uint16_t             m_dev_name_len;
+static ble_gap_conn_params_t m_ppcp;
+static bool                 m_enabled;
+static bool                 m_advertising;
+static bool                 m_connected;
+static uint16_t             m_interval;
+static uint32_t             m_next_event;
+static bool                 m_disconnect_pending;
+static bool                 m_update_pending;
+static ble_gap_conn_params_t m_update_params;
+
+static uint8_t              m_notif_type;
+static uint32_t             m_notif_distance_us;
+
+static stub_pkt_t           m_tx_pkts[STUB_TX_QUEUE_MAX];
+static stub_fifo_t          m_tx_fifo = {m_tx_pkts, STUB_TX_QUEUE_MAX, 0, 0};
+static stub_pkt_t           m_ind;
+static bool                 m_ind_queued;
+static bool                 m_ind_sent;                           /**< Sent in the last event, confirmed in the next. */
+static stub_pkt_t           m_peer_pkts[STUB_PEER_QUEUE_SIZE];
+static stub_fifo_t          m_peer_fifo = {m_peer_pkts, STUB_PEER_QUEUE_SIZE, 0, 0};
+static stub_pkt_t           m_auth_pkt;                           /**< Central write waiting for an authorize reply. */
+static bool                 m_auth_pending;
+
+
+static stub_pkt_t * fifo_tail(stub_fifo_t * p_fifo)
+{
+    return (p_fifo->count < p_fifo->size) ? &p_fifo->p_pkts[(p_fifo->head + p_fifo->count) % p_fifo->size] : NULL;
+}
+
+
+static stub_pkt_t * fifo_head(stub_fifo_t * p_fifo)
+{
+    return (p_fifo->count > 0) ? &p_fifo->p_pkts[p_fifo->head] : NULL;
+}
+
+
+static void fifo_pop(stub_fifo_t * p_fifo)
+{
+    p_fifo->head = (p_fifo->head + 1) % p_fifo->size;
+    p_fifo->count--;
+}
+
+
+static stub_attr_t * attr_get(uint16_t handle)
+{
+    if ((handle < STUB_FIRST_HANDLE) || (handle >= STUB_FIRST_HANDLE + m_attr_count))
+    {
+        return NULL;
+    }
+    return &m_attrs[handle - STUB_FIRST_HANDLE];
+}
+
+
+static stub_attr_t * cccd_get(uint16_t value_handle)
+{
+    for (uint16_t i = 0; i < m_attr_count; i++)
+    {
+        if ((m_attrs[i].kind == STUB_ATTR_CCCD) && (m_attrs[i].value_handle == value_handle))
+        {
+            return &m_attrs[i];
+        }
+    }
+    return NULL;
+}
+
+
+/**@brief Function for adding an attribute, its value in the stack if p_value is NULL. */
+static uint32_t attr_add(stub_attr_kind_t kind, ble_uuid_t const * p_uuid, uint16_t max_len, uint8_t * p_value,
+                         uint16_t * p_handle)
+{
+    uint16_t      mem = (p_value == NULL) ? (uint16_t)((max_len + 3) & ~3) : 0;
+    stub_attr_t * p_attr;
+
+    if ((m_attr_count >= STUB_MAX_ATTRS) || (m_attr_mem_used + mem > sizeof(m_attr_mem)))
+    {
+        return NRF_ERROR_NO_MEM;
+    }
+
+    p_attr = &m_attrs[m_attr_count];
+    memset(p_attr, 0, sizeof(*p_attr));
+    p_attr->uuid    = *p_uuid;
+    p_attr->kind    = kind;
+    p_attr->max_len = max_len;
+    p_attr->p_value = p_value;
+    if (p_value == NULL)
+    {
+        p_attr->p_value  = &((uint8_t *)m_attr_mem)[m_attr_mem_used];
+        m_attr_mem_used += mem;
+    }
+
+    *p_handle = STUB_FIRST_HANDLE + m_attr_count++;
+
+    return NRF_SUCCESS;
+}
+
+
+static uint32_t attr_value_add(stub_attr_kind_t kind, ble_gatts_attr_t const * p_attr, uint16_t * p_handle)
+{
+    ble_gatts_attr_md_t const * p_md    = p_attr->p_attr_md;
+    uint8_t                   * p_value = (p_md->vloc == BLE_GATTS_VLOC_USER) ? p_attr->p_value : NULL;
+    stub_attr_t               * p_stub;
+    uint32_t                    err_code;
+
+    if ((p_md->vloc == BLE_GATTS_VLOC_USER) && (p_value == NULL))
+    {
+        return NRF_ERROR_INVALID_PARAM;
+    }
+    if ((p_attr->init_offs + p_attr->init_len > p_attr->max_len) || (p_attr->max_len > BLE_GATTS_VAR_ATTR_LEN_MAX))
+    {
+        return NRF_ERROR_INVALID_PARAM;
+    }
+
+    err_code = attr_add(kind, p_attr->p_uuid, p_attr->max_len, p_value, p_handle);
+    VERIFY_SUCCESS(err_code);
+
+    p_stub          = attr_get(*p_handle);
+    p_stub->wr_auth = p_md->wr_auth;
+    p_stub->vlen    = p_md->vlen;
+    p_stub->len     = p_md->vlen ? p_attr->init_len : p_attr->max_len;
+    if ((p_md->vloc != BLE_GATTS_VLOC_USER) && (p_attr->p_value != NULL))
+    {
+        memcpy(&p_stub->p_value[p_attr->init_offs], p_attr->p_value, p_attr->init_len);
+    }
+
+    return NRF_SUCCESS;
+}
+
+
+static uint32_t timer_now(void)
+{
+    STUB_TIMER->TASKS_CAPTURE[STUB_CC_NOW] = 1;
+    return STUB_TIMER->CC[STUB_CC_NOW];
+}
+
+
+static ble_evt_t * evt_push(uint16_t evt_id, uint16_t extra_len)
+{
+    ble_evt_t * p_evt;
+
+    if (m_evt_count >= STUB_EVT_QUEUE_SIZE)
+    {
+        semihost_printf("sd_stub: event queue full, the application does not take its events\n");
+        semihost_exit(false);
+    }
+
+    p_evt = (ble_evt_t *)m_evts[(m_evt_head + m_evt_count++) % STUB_EVT_QUEUE_SIZE];
+    memset(p_evt, 0, sizeof(m_evts[0]));
+    p_evt->header.evt_id  = evt_id;
+    p_evt->header.evt_len = (uint16_t)(sizeof(ble_evt_t) + extra_len);
+
+    NVIC_SetPendingIRQ(SWI2_IRQn);
+    return p_evt;
+}
+
+
+static void sys_evt_push(uint32_t evt_id)
+{
+    if (m_sys_count >= STUB_SYS_QUEUE_SIZE)
+    {
+        semihost_printf("sd_stub: SoC event queue full\n");
+        semihost_exit(false);
+    }
+    m_sys_evts[(m_sys_head + m_sys_count++) % STUB_SYS_QUEUE_SIZE] = evt_id;
+    NVIC_SetPendingIRQ(SWI2_IRQn);
+}
+
+
+static uint32_t interval_us(void)
+{
+    return (uint32_t)m_interval * 1250;
+}
+
+
+/**@brief Function for setting the compare registers for the next connection event. */
+static void next_event_set(void)
+{
+    STUB_TIMER->CC[STUB_CC_LINK] = m_next_event;
+    if (m_notif_type & NRF_RADIO_NOTIFICATION_TYPE_INT_ON_ACTIVE)
+    {
+        STUB_TIMER->CC[STUB_CC_NOTIF] = m_next_event - m_notif_distance_us;
+    }
+}
+
+
+/**@brief Function for handling a write of the central, in a connection event. */
+static void peer_pkt_deliver(stub_pkt_t const * p_pkt)
+{
+    stub_attr_t * p_attr = attr_get(p_pkt->handle);
+    ble_evt_t   * p_evt;
+    uint8_t       op     = p_pkt->with_response ? BLE_GATTS_OP_WRITE_REQ : BLE_GATTS_OP_WRITE_CMD;
+
+    m_stats.rx_packets++;
+
+    if ((p_attr == NULL) || (p_pkt->len > p_attr->max_len))
+    {
+        return;
+    }
+
+    if (p_attr->wr_auth)
+    {
+        ble_gatts_evt_write_t * p_write;
+
+        m_auth_pkt     = *p_pkt;
+        m_auth_pending = true;
+        p_evt   = evt_push(BLE_GATTS_EVT_RW_AUTHORIZE_REQUEST, p_pkt->len);
+        p_write = &p_evt->evt.gatts_evt.params.authorize_request.request.write;
+        p_evt->evt.gatts_evt.conn_handle                   = STUB_CONN_HANDLE;
+        p_evt->evt.gatts_evt.params.authorize_request.type = BLE_GATTS_AUTHORIZE_TYPE_WRITE;
+        p_write->handle = p_pkt->handle;
+        p_write->uuid   = p_attr->uuid;
+        p_write->op     = op;
+        p_write->len    = p_pkt->len;
+        memcpy(p_write->data, p_pkt->data, p_pkt->len);
+        return;
+    }
+
+    memcpy(p_attr->p_value, p_pkt->data, p_pkt->len);
+    if (p_attr->vlen)
+    {
+        p_attr->len = p_pkt->len;
+    }
+
+    p_evt = evt_push(BLE_GATTS_EVT_WRITE, p_pkt->len);
+    p_evt->evt.gatts_evt.conn_handle         = STUB_CONN_HANDLE;
+    p_evt->evt.gatts_evt.params.write.handle = p_pkt->handle;
+    p_evt->evt.gatts_evt.params.write.uuid   = p_attr->uuid;
+    p_evt->evt.gatts_evt.params.write.op     = op;
+    p_evt->evt.gatts_evt.params.write.len    = p_pkt->len;
+    memcpy(p_evt->evt.gatts_evt.params.write.data, p_pkt->data, p_pkt->len);
+}
+
+
+/**@brief Function for ending the link, the CCCDs of a peer without bond back to 0. */
+static void link_lost(void)
+{
+    ble_evt_t * p_evt = evt_push(BLE_GAP_EVT_DISCONNECTED, 0);
+
+    p_evt->evt.gap_evt.conn_handle                = STUB_CONN_HANDLE;
+    p_evt->evt.gap_evt.params.disconnected.reason = BLE_HCI_LOCAL_HOST_TERMINATED_CONNECTION;
+
+    m_connected          = false;
+    m_disconnect_pending = false;
+    m_update_pending     = false;
+    m_auth_pending       = false;
+    m_ind_queued         = false;
+    m_ind_sent           = false;
+    m_tx_fifo.count      = 0;
+    m_peer_fifo.count    = 0;
+
+    for (uint16_t i = 0; i < m_attr_count; i++)
+    {
+        if (m_attrs[i].kind == STUB_ATTR_CCCD)
+        {
+            memset(m_attrs[i].p_value, 0, m_attrs[i].max_len);
+        }
+    }
+}
+
+
+static void conn_event(void)
+{
+    uint8_t sent = 0;
+
+    m_stats.conn_events++;
+
+    if (m_peer.on_conn_event != NULL)
+    {
+        m_peer.on_conn_event();
+    }
+
+    if (m_disconnect_pending)
+    {
+        link_lost();
+        return;
+    }
+
+    if (m_update_pending)
+    {
+        // The central keeps its interval if it is acceptable, else takes the nearest bound.
+        ble_evt_t * p_evt = evt_push(BLE_GAP_EVT_CONN_PARAM_UPDATE, 0);
+
+        m_interval       = MAX(m_interval, m_update_params.min_conn_interval);
+        m_interval       = MIN(m_interval, m_update_params.max_conn_interval);
+        m_update_pending = false;
+
+        p_evt->evt.gap_evt.conn_handle                                            = STUB_CONN_HANDLE;
+        p_evt->evt.gap_evt.params.conn_param_update.conn_params                   = m_update_params;
+        p_evt->evt.gap_evt.params.conn_param_update.conn_params.min_conn_interval = m_interval;
+        p_evt->evt.gap_evt.params.conn_param_update.conn_params.max_conn_interval = m_interval;
+    }
+
+    if (m_ind_sent)
+    {
+        ble_evt_t * p_evt = evt_push(BLE_GATTS_EVT_HVC, 0);
+
+        p_evt->evt.gatts_evt.conn_handle       = STUB_CONN_HANDLE;
+        p_evt->evt.gatts_evt.params.hvc.handle = m_ind.handle;
+        m_ind_sent = false;
+    }
+
+    for (uint8_t i = 0; i < m_cfg.tx_per_event; i++)
+    {
+        stub_pkt_t * p_rx = fifo_head(&m_peer_fifo);
+        stub_pkt_t * p_tx = (m_ind_queued && !m_ind_sent) ? &m_ind : fifo_head(&m_tx_fifo);
+
+        if ((p_rx == NULL) && (p_tx == NULL))
+        {
+            break;
+        }
+
+        if (p_rx != NULL)
+        {
+            stub_pkt_t pkt = *p_rx;
+
+            fifo_pop(&m_peer_fifo);
+            peer_pkt_deliver(&pkt);
+        }
+
+        if (p_tx != NULL)
+        {
+            if (m_peer.on_hvx != NULL)
+            {
+                m_peer.on_hvx(p_tx->handle, p_tx->data, p_tx->len);
+            }
+            m_stats.tx_packets++;
+            if (p_tx == &m_ind)
+            {
+                m_ind_queued = false;
+                m_ind_sent   = true;
+            }
+            else
+            {
+                fifo_pop(&m_tx_fifo);
+                sent++;
+            }
+        }
+    }
+
+    if (sent > 0)
+    {
+        ble_evt_t * p_evt = evt_push(BLE_EVT_TX_COMPLETE, 0);
+
+        p_evt->evt.common_evt.conn_handle              = STUB_CONN_HANDLE;
+        p_evt->evt.common_evt.params.tx_complete.count = sent;
+    }
+
+    if (m_notif_type & NRF_RADIO_NOTIFICATION_TYPE_INT_ON_INACTIVE)
+    {
+        NVIC_SetPendingIRQ(SWI1_IRQn);
+    }
+}
+
+
+static void link_run(void)
+{
+    if (m_advertising)
+    {
+        ble_evt_t * p_evt = evt_push(BLE_GAP_EVT_CONNECTED, 0);
+
+        m_advertising = false;
+        m_connected   = true;
+        m_interval    = m_cfg.conn_interval;
+
+        p_evt->evt.gap_evt.conn_handle                                    = STUB_CONN_HANDLE;
+        p_evt->evt.gap_evt.params.connected.role                          = BLE_GAP_ROLE_PERIPH;
+        p_evt->evt.gap_evt.params.connected.peer_addr.addr_type           = BLE_GAP_ADDR_TYPE_RANDOM_STATIC;
+        p_evt->evt.gap_evt.params.connected.conn_params.min_conn_interval = m_interval;
+        p_evt->evt.gap_evt.params.connected.conn_params.max_conn_interval = m_interval;
+        p_evt->evt.gap_evt.params.connected.conn_params.slave_latency     = 0;
+        p_evt->evt.gap_evt.params.connected.conn_params.conn_sup_timeout  = 400;
+
+        if (m_peer.on_connected != NULL)
+        {
+            m_peer.on_connected();
+        }
+    }
+    else if (m_connected)
+    {
+        conn_event();
+    }
+
+    if (m_connected)
+    {
+        m_next_event += interval_us();
+        next_event_set();
+    }
+}
+
+
+void TIMER0_IRQHandler(void)
+{
+    if (STUB_TIMER->EVENTS_COMPARE[STUB_CC_NOTIF])
+    {
+        STUB_TIMER->EVENTS_COMPARE[STUB_CC_NOTIF] = 0;
+        if (m_connected && (m_notif_type & NRF_RADIO_NOTIFICATION_TYPE_INT_ON_ACTIVE))
+        {
+            NVIC_SetPendingIRQ(SWI1_IRQn);
+        }
+    }
+    if (STUB_TIMER->EVENTS_COMPARE[STUB_CC_LINK])
+    {
+        STUB_TIMER->EVENTS_COMPARE[STUB_CC_LINK] = 0;
+        link_run();
+    }
+}
+
+
+/* SDM and SoC */
+
+static uint32_t softdevice_enable(nrf_clock_lf_cfg_t const * p_clock_lf_cfg, nrf_fault_handler_t fault_handler)
+{
+    UNUSED_PARAMETER(p_clock_lf_cfg);
+    UNUSED_PARAMETER(fault_handler);
+    VERIFY_FALSE(m_enabled, NRF_ERROR_INVALID_STATE);
+
+    // What the SoftDevice sets up for the application and for itself.
+    NVIC_SetPriority(SWI2_IRQn, APP_IRQ_PRIORITY_LOW);
+    NVIC_SetPriority(TIMER0_IRQn, 0);
+
+    STUB_TIMER->TASKS_STOP  = 1;
+    STUB_TIMER->MODE        = TIMER_MODE_MODE_Timer;
+    STUB_TIMER->BITMODE     = TIMER_BITMODE_BITMODE_32Bit;
+    STUB_TIMER->PRESCALER   = STUB_TIMER_PRESCALER;
+    STUB_TIMER->TASKS_CLEAR = 1;
+    STUB_TIMER->INTENSET    = TIMER_INTENSET_COMPARE0_Msk | TIMER_INTENSET_COMPARE1_Msk;
+    STUB_TIMER->TASKS_START = 1;
+    NVIC_ClearPendingIRQ(TIMER0_IRQn);
+    NVIC_EnableIRQ(TIMER0_IRQn);
+
+    m_enabled = true;
+    sd_stub_central_init();
+    return NRF_SUCCESS;
+}
+
+
+static uint32_t flash_page_erase(uint32_t page_number)
+{
+    NRF_NVMC->CONFIG = NVMC_CONFIG_WEN_Een << NVMC_CONFIG_WEN_Pos;
+    NRF_NVMC->ERASEPAGE = page_number * NRF_FICR->CODEPAGESIZE;
+    while (NRF_NVMC->READY == NVMC_READY_READY_Busy)
+    {
+    }
+    NRF_NVMC->CONFIG = NVMC_CONFIG_WEN_Ren << NVMC_CONFIG_WEN_Pos;
+
+    sys_evt_push(NRF_EVT_FLASH_OPERATION_SUCCESS);
+    return NRF_SUCCESS;
+}
+
+
+static uint32_t flash_write(uint32_t * p_dst, uint32_t const * p_src, uint32_t size)
+{
+    NRF_NVMC->CONFIG = NVMC_CONFIG_WEN_Wen << NVMC_CONFIG_WEN_Pos;
+    for (uint32_t i = 0; i < size; i++)
+    {
+        p_dst[i] = p_src[i];
+        while (NRF_NVMC->READY == NVMC_READY_READY_Busy)
+        {
+        }
+    }
+    NRF_NVMC->CONFIG = NVMC_CONFIG_WEN_Ren << NVMC_CONFIG_WEN_Pos;
+
+    sys_evt_push(NRF_EVT_FLASH_OPERATION_SUCCESS);
+    return NRF_SUCCESS;
+}
+
+
+static uint32_t evt_get(uint32_t * p_evt_id)
+{
+    VERIFY_TRUE(m_sys_count > 0, NRF_ERROR_NOT_FOUND);
+
+    *p_evt_id  = m_sys_evts[m_sys_head];
+    m_sys_head = (m_sys_head + 1) % STUB_SYS_QUEUE_SIZE;
+    m_sys_count--;
+    return NRF_SUCCESS;
+}
+
+
+static uint32_t radio_notification_cfg_set(uint8_t type, uint8_t distance)
+{
+    static uint16_t const distances_us[] = {0, 800, 1740, 2680, 3620, 4560, 5500};
+
+    VERIFY_TRUE(!m_connected && !m_advertising, NRF_ERROR_INVALID_STATE);
+    VERIFY_TRUE((type <= NRF_RADIO_NOTIFICATION_TYPE_INT_ON_BOTH) && (distance < ARRAY_SIZE(distances_us)),
+                NRF_ERROR_INVALID_PARAM);
+
+    m_notif_type        = type;
+    m_notif_distance_us = distances_us[distance];
+    return NRF_SUCCESS;
+}
+
+
+/* BLE common */
+
+static uint32_t ble_evt_get(uint8_t * p_dest, uint16_t * p_len)
+{
+    ble_evt_t const * p_evt;
+
+    VERIFY_TRUE(m_evt_count > 0, NRF_ERROR_NOT_FOUND);
+
+    p_evt = (ble_evt_t const *)m_evts[m_evt_head];
+    if (p_dest == NULL)
+    {
+        *p_len = p_evt->header.evt_len;
+        return NRF_SUCCESS;
+    }
+    VERIFY_TRUE(*p_len >= p_evt->header.evt_len, NRF_ERROR_DATA_SIZE);
+
+    *p_len = p_evt->header.evt_len;
+    memcpy(p_dest, p_evt, p_evt->header.evt_len);
+    m_evt_head = (m_evt_head + 1) % STUB_EVT_QUEUE_SIZE;
+    m_evt_count--;
+    return NRF_SUCCESS;
+}
+
+
+static uint32_t uuid_vs_add(ble_uuid128_t const * p_vs_uuid, uint8_t * p_uuid_type)
+{
+    for (uint8_t i = 0; i < m_vs_uuid_count; i++)
+    {
+        // The same base added again gets the same type.
+        if (memcmp(&m_vs_uuids[i], p_vs_uuid, sizeof(*p_vs_uuid)) == 0)
+        {
+            *p_uuid_type = BLE_UUID_TYPE_VENDOR_BEGIN + i;
+            return NRF_SUCCESS;
+        }
+    }
+
+    VERIFY_TRUE(m_vs_uuid_count < STUB_MAX_VS_UUIDS, NRF_ERROR_NO_MEM);
+
+    m_vs_uuids[m_vs_uuid_count] = *p_vs_uuid;
+    *p_uuid_type = BLE_UUID_TYPE_VENDOR_BEGIN + m_vs_uuid_count++;
+    return NRF_SUCCESS;
+}
+
+
+static uint32_t uuid_encode(ble_uuid_t const * p_uuid, uint8_t * p_uuid_le_len, uint8_t * p_uuid_le)
+{
+    if (p_uuid->type == BLE_UUID_TYPE_BLE)
+    {
+        *p_uuid_le_len = 2;
+        if (p_uuid_le != NULL)
+        {
+            UNUSED_RETURN_VALUE(uint16_encode(p_uuid->uuid, p_uuid_le));
+        }
+        return NRF_SUCCESS;
+    }
+
+    VERIFY_TRUE((p_uuid->type >= BLE_UUID_TYPE_VENDOR_BEGIN) &&
+                (p_uuid->type < BLE_UUID_TYPE_VENDOR_BEGIN + m_vs_uuid_count), NRF_ERROR_INVALID_PARAM);
+
+    *p_uuid_le_len = 16;
+    if (p_uuid_le != NULL)
+    {
+        memcpy(p_uuid_le, &m_vs_uuids[p_uuid->type - BLE_UUID_TYPE_VENDOR_BEGIN], 16);
+        UNUSED_RETURN_VALUE(uint16_encode(p_uuid->uuid, &p_uuid_le[12]));
+    }
+    return NRF_SUCCESS;
+}
+
+
+static uint32_t conn_check(uint16_t conn_handle)
+{
+    return (m_connected && (conn_handle == STUB_CONN_HANDLE)) ? NRF_SUCCESS : BLE_ERROR_INVALID_CONN_HANDLE;
+}
+
+
+/* GAP */
+
+static uint32_t gap_address_get(ble_gap_addr_t * p_addr)
+{
+    static uint8_t const addr[BLE_GAP_ADDR_LEN] = {0x01, 0x02, 0x03, 0x04, 0x05, 0xC6};
+
+    p_addr->addr_type = BLE_GAP_ADDR_TYPE_RANDOM_STATIC;
+    memcpy(p_addr->addr, addr, sizeof(addr));
+    return NRF_SUCCESS;
+}
+
+
+static uint32_t gap_device_name_set(uint8_t const * p_dev_name, uint16_t len)
+{
+    VERIFY_TRUE(len <= sizeof(m_dev_name), NRF_ERROR_DATA_SIZE);
+
+    memcpy(m_dev_name, p_dev_name, len);
+    m_dev_name_len = len;
+    return NRF_SUCCESS;
+}
+
+
+static uint32_t gap_device_name_get(uint8_t * p_dev_name, uint16_t * p_len)
+{
+    if (p_dev_name != NULL)
+    {
+        VERIFY_TRUE(*p_len >= m_dev_name_len, NRF_ERROR_DATA_SIZE);
+        memcpy(p_dev_name, m_dev_name, m_dev_name_len);
+    }
+    *p_len = m_dev_name_len;
+    return NRF_SUCCESS;
+}
+
+
+static uint32_t gap_adv_start(void)
+{
+    VERIFY_TRUE(!m_connected && !m_advertising, NRF_ERROR_INVALID_STATE);
+
+    // The central connects after connect_delay_us; advertising timeouts never happen.
+    m_advertising = true;
+    m_next_event  = timer_now() + m_cfg.connect_delay_us;
+    STUB_TIMER->CC[STUB_CC_LINK] = m_next_event;
+    return NRF_SUCCESS;
+}
+
+
+static uint32_t gap_conn_param_update(uint16_t conn_handle, ble_gap_conn_params_t const * p_conn_params)
+{
+    VERIFY_SUCCESS(conn_check(conn_handle));
+    VERIFY_FALSE(m_update_pending, NRF_ERROR_BUSY);
+
+    m_update_params  = (p_conn_params != NULL) ? *p_conn_params : m_ppcp;
+    m_update_pending = true;
+    return NRF_SUCCESS;
+}
+
+
+static uint32_t gap_disconnect(uint16_t conn_handle)
+{
+    VERIFY_SUCCESS(conn_check(conn_handle));
+    VERIFY_FALSE(m_disconnect_pending, NRF_ERROR_INVALID_STATE);
+
+    m_disconnect_pending = true;
+    return NRF_SUCCESS;
+}
+
+
+/* GATTS */
+
+static uint32_t gatts_characteristic_add(ble_gatts_char_md_t const * p_char_md,
+                                         ble_gatts_attr_t const *    p_attr_char_value,
+                                         ble_gatts_char_handles_t *  p_handles)
+{
+    static ble_uuid_t const char_uuid = {BLE_UUID_CHARACTERISTIC, BLE_UUID_TYPE_BLE};
+    static ble_uuid_t const cccd_uuid = {BLE_UUID_DESCRIPTOR_CLIENT_CHAR_CONFIG, BLE_UUID_TYPE_BLE};
+    static ble_uuid_t const desc_uuid = {BLE_UUID_DESCRIPTOR_CHAR_USER_DESC, BLE_UUID_TYPE_BLE};
+    uint16_t                decl_handle;
+    uint16_t                first = m_attr_count;
+    uint32_t                err_code;
+
+    memset(p_handles, 0, sizeof(*p_handles));
+
+    err_code = attr_add(STUB_ATTR_CHAR, &char_uuid, 0, NULL, &decl_handle);
+    VERIFY_SUCCESS(err_code);
+    err_code = attr_value_add(STUB_ATTR_VALUE, p_attr_char_value, &p_handles->value_handle);
+    VERIFY_SUCCESS(err_code);
+
+    if (p_char_md->p_char_user_desc != NULL)
+    {
+        err_code = attr_add(STUB_ATTR_DESC, &desc_uuid, p_char_md->char_user_desc_max_size, NULL,
+                            &p_handles->user_desc_handle);
+        VERIFY_SUCCESS(err_code);
+        attr_get(p_handles->user_desc_handle)->len = p_char_md->char_user_desc_size;
+    }
+    if (p_char_md->char_props.notify || p_char_md->char_props.indicate)
+    {
+        err_code = attr_add(STUB_ATTR_CCCD, &cccd_uuid, sizeof(uint16_t), NULL, &p_handles->cccd_handle);
+        VERIFY_SUCCESS(err_code);
+        attr_get(p_handles->cccd_handle)->len          = sizeof(uint16_t);
+        attr_get(p_handles->cccd_handle)->value_handle = p_handles->value_handle;
+    }
+
+    for (uint16_t i = first; i < m_attr_count; i++)
+    {
+        m_attrs[i].props     = p_char_md->char_props;
+        m_attrs[i].char_uuid = p_attr_char_value->p_uuid->uuid;
+    }
+
+    return NRF_SUCCESS;
+}
+
+
+static uint32_t gatts_descriptor_add(uint16_t char_handle, ble_gatts_attr_t const * p_attr, uint16_t * p_handle)
+{
+    stub_attr_t * p_char = attr_get(char_handle);
+    uint32_t      err_code;
+
+    VERIFY_TRUE(p_char != NULL, BLE_ERROR_INVALID_ATTR_HANDLE);
+
+    err_code = attr_value_add(STUB_ATTR_DESC, p_attr, p_handle);
+    VERIFY_SUCCESS(err_code);
+    attr_get(*p_handle)->char_uuid = p_char->char_uuid;
+
+    return NRF_SUCCESS;
+}
+
+
+static uint32_t gatts_value_set(uint16_t handle, ble_gatts_value_t * p_value)
+{
+    stub_attr_t * p_attr = attr_get(handle);
+
+    VERIFY_TRUE(p_attr != NULL, BLE_ERROR_INVALID_ATTR_HANDLE);
+    VERIFY_TRUE(p_value->offset <= p_attr->len, NRF_ERROR_INVALID_PARAM);
+
+    p_value->len = MIN(p_value->len, p_attr->max_len - p_value->offset);
+    if (p_value->p_value != NULL)
+    {
+        memcpy(&p_attr->p_value[p_value->offset], p_value->p_value, p_value->len);
+    }
+    if (p_attr->vlen)
+    {
+        p_attr->len = p_value->offset + p_value->len;
+    }
+    return NRF_SUCCESS;
+}
+
+
+static uint32_t gatts_value_get(uint16_t handle, ble_gatts_value_t * p_value)
+{
+    stub_attr_t * p_attr = attr_get(handle);
+
+    VERIFY_TRUE(p_attr != NULL, BLE_ERROR_INVALID_ATTR_HANDLE);
+    VERIFY_TRUE(p_value->offset <= p_attr->len, NRF_ERROR_INVALID_PARAM);
+
+    if (p_value->p_value != NULL)
+    {
+        p_value->len = MIN(p_value->len, p_attr->len - p_value->offset);
+        memcpy(p_value->p_value, &p_attr->p_value[p_value->offset], p_value->len);
+    }
+    else
+    {
+        p_value->len = p_attr->len - p_value->offset;
+    }
+    return NRF_SUCCESS;
+}
+
+
+static uint32_t gatts_hvx(uint16_t conn_handle, ble_gatts_hvx_params_t const * p_hvx_params)
+{
+    stub_attr_t * p_attr = attr_get(p_hvx_params->handle);
+    stub_attr_t * p_cccd;
+    stub_pkt_t  * p_pkt;
+    uint16_t      len;
+
+    VERIFY_SUCCESS(conn_check(conn_handle));
+    VERIFY_TRUE((p_attr != NULL) && (p_attr->kind == STUB_ATTR_VALUE), BLE_ERROR_INVALID_ATTR_HANDLE);
+
+    p_cccd = cccd_get(p_hvx_params->handle);
+    VERIFY_TRUE(p_cccd != NULL, NRF_ERROR_INVALID_PARAM);
+    VERIFY_TRUE(uint16_decode(p_cccd->p_value) & p_hvx_params->type, NRF_ERROR_INVALID_STATE);
+
+    len = (p_hvx_params->p_len != NULL) ? *p_hvx_params->p_len : p_attr->len;
+    len = MIN(len, STUB_PAYLOAD_MAX);
+    if (p_hvx_params->p_data != NULL)
+    {
+        // The value of the attribute is updated with the data sent.
+        len = MIN(len, p_attr->max_len - MIN(p_hvx_params->offset, p_attr->max_len));
+        memcpy(&p_attr->p_value[p_hvx_params->offset], p_hvx_params->p_data, len);
+        if (p_attr->vlen)
+        {
+            p_attr->len = p_hvx_params->offset + len;
+        }
+    }
+
+    if (p_hvx_params->type == BLE_GATT_HVX_INDICATION)
+    {
+        VERIFY_TRUE(!m_ind_queued && !m_ind_sent, NRF_ERROR_BUSY);
+        p_pkt        = &m_ind;
+        m_ind_queued = true;
+    }
+    else
+    {
+        p_pkt = (m_tx_fifo.count < m_cfg.tx_buffers) ? fifo_tail(&m_tx_fifo) : NULL;
+        if (p_pkt == NULL)
+        {
+            m_stats.no_tx_packets++;
+            return BLE_ERROR_NO_TX_PACKETS;
+        }
+        m_tx_fifo.count++;
+    }
+
+    p_pkt->handle = p_hvx_params->handle;
+    p_pkt->type   = p_hvx_params->type;
+    p_pkt->len    = len;
+    memcpy(p_pkt->data, &p_attr->p_value[p_hvx_params->offset], len);
+
+    if (p_hvx_params->p_len != NULL)
+    {
+        *p_hvx_params->p_len = len;
+    }
+    return NRF_SUCCESS;
+}
+
+
+static uint32_t gatts_rw_authorize_reply(uint16_t conn_handle, ble_gatts_rw_authorize_reply_params_t const * p_reply)
+{
+    ble_gatts_authorize_params_t const * p_params = &p_reply->params.write;
+    stub_attr_t                        * p_attr   = attr_get(m_auth_pkt.handle);
+
+    VERIFY_SUCCESS(conn_check(conn_handle));
+    VERIFY_TRUE(m_auth_pending && (p_reply->type == BLE_GATTS_AUTHORIZE_TYPE_WRITE), NRF_ERROR_INVALID_STATE);
+
+    // The central only writes: read authorizations never come from it.
+    m_auth_pending = false;
+    if ((p_params->gatt_status == BLE_GATT_STATUS_SUCCESS) && p_params->update)
+    {
+        uint8_t const * p_data = (p_params->p_data != NULL) ? p_params->p_data : m_auth_pkt.data;
+        uint16_t        len    = (p_params->p_data != NULL) ? p_params->len : m_auth_pkt.len;
+
+        VERIFY_TRUE(len <= p_attr->max_len, NRF_ERROR_INVALID_PARAM);
+        memcpy(p_attr->p_value, p_data, len);
+        if (p_attr->vlen)
+        {
+            p_attr->len = len;
+        }
+    }
+    return NRF_SUCCESS;
+}
+
+
+/**@brief Function for serving an SVC call.
+ *
+ * @param[in] svc     Number of the call.
+ * @param[in] p_args  r0 to r3 of the caller. No call of the S130 API has more arguments.
+ *
+ * @return Result of the call.
+ */
+static uint32_t svc_call(uint8_t svc, uint32_t const * p_args)
+{
+    switch (svc)
+    {
+        case SD_SOFTDEVICE_ENABLE:
+            return softdevice_enable((nrf_clock_lf_cfg_t const *)p_args[0], (nrf_fault_handler_t)p_args[1]);
+
+        case SD_SOFTDEVICE_IS_ENABLED:
+            *(uint8_t *)p_args[0] = m_enabled;
+            return NRF_SUCCESS;
+
+        case SD_FLASH_PAGE_ERASE:
+            return flash_page_erase(p_args[0]);
+
+        case SD_FLASH_WRITE:
+            return flash_write((uint32_t *)p_args[0], (uint32_t const *)p_args[1], p_args[2]);
+
+        case SD_APP_EVT_WAIT:
+            // A WFI at priority 0 would never wake up for the application interrupts: the main
+            // loop spins instead, which only costs host time.
+            return NRF_SUCCESS;
+
+        case SD_CLOCK_HFCLK_REQUEST:
+        case SD_CLOCK_HFCLK_RELEASE:
+            return NRF_SUCCESS;
+
+        case SD_CLOCK_HFCLK_IS_RUNNING:
+            *(uint32_t *)p_args[0] = 1;
+            return NRF_SUCCESS;
+
+        case SD_RADIO_NOTIFICATION_CFG_SET:
+            return radio_notification_cfg_set((uint8_t)p_args[0], (uint8_t)p_args[1]);
+
+        case SD_EVT_GET:
+            return evt_get((uint32_t *)p_args[0]);
+
+        case SD_TEMP_GET:
+            *(int32_t *)p_args[0] = 25 * 4;
+            return NRF_SUCCESS;
+
+        case SD_POWER_SYSTEM_OFF:
+            semihost_printf("sd_stub: system off\n");
+            semihost_exit(true);
+
+        case SD_BLE_ENABLE:
+        case SD_BLE_OPT_SET:
+            return NRF_SUCCESS;
+
+        case SD_BLE_EVT_GET:
+            return ble_evt_get((uint8_t *)p_args[0], (uint16_t *)p_args[1]);
+
+        case SD_BLE_TX_PACKET_COUNT_GET:
+            *(uint8_t *)p_args[1] = m_cfg.tx_buffers;
+            return NRF_SUCCESS;
+
+        case SD_BLE_UUID_VS_ADD:
+            return uuid_vs_add((ble_uuid128_t const *)p_args[0], (uint8_t *)p_args[1]);
+
+        case SD_BLE_UUID_ENCODE:
+            return uuid_encode((ble_uuid_t const *)p_args[0], (uint8_t *)p_args[1], (uint8_t *)p_args[2]);
+
+        case SD_BLE_USER_MEM_REPLY:
+            return conn_check((uint16_t)p_args[0]);
+
+        case SD_BLE_GAP_ADDRESS_GET:
+            return gap_address_get((ble_gap_addr_t *)p_args[0]);
+
+        case SD_BLE_GAP_DEVICE_NAME_SET:
+            return gap_device_name_set((uint8_t const *)p_args[1], (uint16_t)p_args[2]);
+
+        case SD_BLE_GAP_DEVICE_NAME_GET:
+            return gap_device_name_get((uint8_t *)p_args[0], (uint16_t *)p_args[1]);
+
+        case SD_BLE_GAP_APPEARANCE_SET:
+        case SD_BLE_GAP_TX_POWER_SET:
+        case SD_BLE_GAP_ADV_DATA_SET:
+            return NRF_SUCCESS;
+
+        case SD_BLE_GAP_PPCP_SET:
+            m_ppcp = *(ble_gap_conn_params_t const *)p_args[0];
+            return NRF_SUCCESS;
+
+        case SD_BLE_GAP_PPCP_GET:
+            *(ble_gap_conn_params_t *)p_args[0] = m_ppcp;
+            return NRF_SUCCESS;
+
+        case SD_BLE_GAP_ADV_START:
+            return gap_adv_start();
+
+        case SD_BLE_GAP_ADV_STOP:
+            VERIFY_TRUE(m_advertising, NRF_ERROR_INVALID_STATE);
+            m_advertising = false;
+            return NRF_SUCCESS;
+
+        case SD_BLE_GAP_CONN_PARAM_UPDATE:
+            return gap_conn_param_update((uint16_t)p_args[0], (ble_gap_conn_params_t const *)p_args[1]);
+
+        case SD_BLE_GAP_DISCONNECT:
+            return gap_disconnect((uint16_t)p_args[0]);
+
+        case SD_BLE_GAP_RSSI_START:
+        case SD_BLE_GAP_SEC_PARAMS_REPLY:
+            return conn_check((uint16_t)p_args[0]);
+
+        case SD_BLE_GAP_RSSI_GET:
+            VERIFY_SUCCESS(conn_check((uint16_t)p_args[0]));
+            *(int8_t *)p_args[1] = -55;
+            return NRF_SUCCESS;
+
+        case SD_BLE_GATTS_SERVICE_ADD:
+            VERIFY_TRUE(p_args[0] == BLE_GATTS_SRVC_TYPE_PRIMARY, NRF_ERROR_INVALID_PARAM);
+            return attr_add(STUB_ATTR_SERVICE, (ble_uuid_t const *)p_args[1], 0, NULL, (uint16_t *)p_args[2]);
+
+        case SD_BLE_GATTS_CHARACTERISTIC_ADD:
+            return gatts_characteristic_add((ble_gatts_char_md_t const *)p_args[1],
+                                            (ble_gatts_attr_t const *)p_args[2],
+                                            (ble_gatts_char_handles_t *)p_args[3]);
+
+        case SD_BLE_GATTS_DESCRIPTOR_ADD:
+            return gatts_descriptor_add((uint16_t)p_args[0], (ble_gatts_attr_t const *)p_args[1],
+                                        (uint16_t *)p_args[2]);
+
+        case SD_BLE_GATTS_VALUE_SET:
+            return gatts_value_set((uint16_t)p_args[1], (ble_gatts_value_t *)p_args[2]);
+
+        case SD_BLE_GATTS_VALUE_GET:
+            return gatts_value_get((uint16_t)p_args[1], (ble_gatts_value_t *)p_args[2]);
+
+        case SD_BLE_GATTS_HVX:
+            return gatts_hvx((uint16_t)p_args[0], (ble_gatts_hvx_params_t const *)p_args[1]);
+
+        case SD_BLE_GATTS_RW_AUTHORIZE_REPLY:
+            return gatts_rw_authorize_reply((uint16_t)p_args[0],
+                                            (ble_gatts_rw_authorize_reply_params_t const *)p_args[1]);
+
+        case SD_BLE_GATTS_SYS_ATTR_SET:
+            return conn_check((uint16_t)p_args[0]);
+
+        default:
+            semihost_printf("sd_stub: SVC 0x%02X not emulated\n", svc);
+            return NRF_ERROR_NOT_SUPPORTED;
+    }
+}
+
+
+/**@brief Function for serving the SVC of the stacked frame {r0, r1, r2, r3, r12, lr, pc, xpsr}. */
+static __attribute__((used)) void svc_handle(uint32_t * p_frame)
+{
+    // The number is the immediate of the SVC instruction, just before the return address.
+    uint8_t svc = ((uint8_t const *)p_frame[6])[-2];
+
+    m_stats.svc_calls++;
+    p_frame[0] = svc_call(svc, p_frame);
+}
+
+
+void SVC_Handler(void) __attribute__((naked));
+void SVC_Handler(void)
+{
+    // Bit 2 of EXC_RETURN tells the stack the frame was pushed on.
+    __asm volatile(
+        "    movs r0, #4          \n"
+        "    mov  r1, lr          \n"
+        "    tst  r0, r1          \n"
+        "    beq  1f              \n"
+        "    mrs  r0, psp         \n"
+        "    b    2f              \n"
+        "1:  mrs  r0, msp         \n"
+        "2:  ldr  r1, =svc_handle \n"
+        "    bx   r1              \n"
+        "    .ltorg               \n"
+    );
+}
+
+
+void sd_stub_init(sd_stub_cfg_t const * p_cfg, sd_stub_peer_t const * p_peer)
+{
+    m_cfg  = *p_cfg;
+    m_peer = *p_peer;
+    m_cfg.tx_buffers = MIN(m_cfg.tx_buffers, STUB_TX_QUEUE_MAX);
+}
+
+
+uint32_t sd_stub_now(void)
+{
+    return timer_now();
+}
+
+
+uint32_t sd_stub_peer_write(uint16_t handle, uint8_t const * p_data, uint16_t len, bool with_response)
+{
+    stub_pkt_t * p_pkt = fifo_tail(&m_peer_fifo);
+
+    VERIFY_TRUE(m_connected, NRF_ERROR_INVALID_STATE);
+    VERIFY_TRUE(len <= STUB_PAYLOAD_MAX, NRF_ERROR_INVALID_LENGTH);
+    VERIFY_TRUE(p_pkt != NULL, NRF_ERROR_NO_MEM);
+
+    p_pkt->handle        = handle;
+    p_pkt->with_response = with_response;
+    p_pkt->len           = len;
+    memcpy(p_pkt->data, p_data, len);
+    m_peer_fifo.count++;
+
+    return NRF_SUCCESS;
+}
+
+
+uint16_t sd_stub_handle_find(uint16_t uuid, bool cccd)
+{
+    for (uint16_t i = 0; i < m_attr_count; i++)
+    {
+        if ((m_attrs[i].char_uuid == uuid) && (m_attrs[i].kind == (cccd ? STUB_ATTR_CCCD : STUB_ATTR_VALUE)))
+        {
+            return STUB_FIRST_HANDLE + i;
+        }
+    }
+    return BLE_GATT_HANDLE_INVALID;
+}
+
+
+void sd_stub_peer_cccds_enable(void)
+{
+    for (uint16_t i = 0; i < m_attr_count; i++)
+    {
+        if (m_attrs[i].kind == STUB_ATTR_CCCD)
+        {
+            uint8_t value[2] = {m_attrs[i].props.notify ? BLE_GATT_HVX_NOTIFICATION : BLE_GATT_HVX_INDICATION, 0};
+
+            UNUSED_RETURN_VALUE(sd_stub_peer_write(STUB_FIRST_HANDLE + i, value, sizeof(value), true));
+        }
+    }
+}
+
+
+void sd_stub_stats_get(sd_stub_stats_t * p_stats)
+{
+    *p_stats = m_stats;
+}
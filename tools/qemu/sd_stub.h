@@ -0,0 +1,86 @@
+#ifndef __SD_STUB_H_
+#define __SD_STUB_H_
+
+#include "ble.h"
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#ifdef __cplusplus
+	extern "C" {
+#endif
+
+/**@brief Model of the link.
+ *
+ * @details Connection events are driven by TIMER0, which belongs to the SoftDevice on a real
+ *          device, and are exactly conn_interval apart. In each event up to tx_per_event
+ *          exchanges take place, each carrying at most one packet from the central and one from
+ *          the device.
+ */
+typedef struct
+{
+    uint16_t conn_interval;                                       /**< Interval in 1.25 ms units. */
+    uint8_t  tx_buffers;                                          /**< Application TX buffers of the SoftDevice. */
+    uint8_t  tx_per_event;                                        /**< Exchanges per connection event. */
+    uint32_t connect_delay_us;                                    /**< Time from the start of advertising to the connection. */
+} sd_stub_cfg_t;
+
+/**@brief Link counters. */
+typedef struct
+{
+    uint32_t conn_events;
+    uint32_t tx_packets;                                          /**< Notifications and indications sent. */
+    uint32_t rx_packets;                                          /**< Writes received. */
+    uint32_t no_tx_packets;                                       /**< hvx calls refused for lack of TX buffers. */
+    uint32_t svc_calls;
+} sd_stub_stats_t;
+
+/**@brief Handlers of the central, called from the TIMER0 interrupt. All are optional. */
+typedef struct
+{
+    void (*on_connected)(void);
+    void (*on_conn_event)(void);                                  /**< Start of a connection event, before the packets. */
+    void (*on_hvx)(uint16_t handle, uint8_t const * p_data, uint16_t len);
+} sd_stub_peer_t;
+
+/**@brief Function for setting up the central, defined with it.
+ *
+ * @details Called when the application enables the SoftDevice, before any other SoftDevice call.
+ *          It is expected to call @ref sd_stub_init.
+ */
+void sd_stub_central_init(void);
+
+/**@brief Function for setting up the stub. */
+void sd_stub_init(sd_stub_cfg_t const * p_cfg, sd_stub_peer_t const * p_peer);
+
+/**@brief Function for getting the time of the stub, in microseconds since the SoftDevice was enabled. */
+uint32_t sd_stub_now(void);
+
+/**@brief Function for queuing a write of the central, sent in the next connection event.
+ *
+ * @retval NRF_SUCCESS             If the write was queued.
+ * @retval NRF_ERROR_INVALID_STATE If not connected.
+ * @retval NRF_ERROR_NO_MEM        If the central queue is full.
+ */
+uint32_t sd_stub_peer_write(uint16_t handle, uint8_t const * p_data, uint16_t len, bool with_response);
+
+/**@brief Function for finding an attribute of a characteristic by the 16-bit UUID of the characteristic.
+ *
+ * @param[in] uuid  UUID of the characteristic, of any UUID type.
+ * @param[in] cccd  true for the CCCD of the characteristic, false for its value.
+ *
+ * @return Handle, or BLE_GATT_HANDLE_INVALID.
+ */
+uint16_t sd_stub_handle_find(uint16_t uuid, bool cccd);
+
+/**@brief Function for enabling every notification and indication, as a central does after discovery. */
+void sd_stub_peer_cccds_enable(void);
+
+/**@brief Function for reading the link counters. */
+void sd_stub_stats_get(sd_stub_stats_t * p_stats);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,52 @@
+/**@file
+ *
+ * @brief Console and exit of the emulator through ARM semihosting (BKPT 0xAB on ARMv6-M), as
+ *        qemu-system-arm implements it with -semihosting-config enable=on.
+ */
+#include "semihost.h"
+
+#include "nordic_common.h"
+
+#include <stdarg.h>
+#include <stdio.h>
+
+
+#define SYS_WRITE0                      0x04
+#define SYS_EXIT                        0x18
+#define ADP_STOPPED_APPLICATION_EXIT    0x20026
+#define ADP_STOPPED_RUN_TIME_ERROR      0x20023
+#define SEMIHOST_LINE_MAX               128
+
+
+static uint32_t semihost_call(uint32_t op, void const * p_arg)
+{
+    register uint32_t     r0 __asm("r0") = op;
+    register void const * r1 __asm("r1") = p_arg;
+
+    __asm volatile("bkpt 0xAB" : "+r"(r0) : "r"(r1) : "memory");
+    return r0;
+}
+
+
+void semihost_printf(char const * p_format, ...)
+{
+    char    line[SEMIHOST_LINE_MAX];
+    va_list args;
+
+    va_start(args, p_format);
+    UNUSED_RETURN_VALUE(vsnprintf(line, sizeof(line), p_format, args));
+    va_end(args);
+
+    UNUSED_RETURN_VALUE(semihost_call(SYS_WRITE0, line));
+}
+
+
+void semihost_exit(bool success)
+{
+    // On 32-bit targets the argument of SYS_EXIT is the reason itself.
+    UNUSED_RETURN_VALUE(semihost_call(SYS_EXIT,
+                        (void const *)(uintptr_t)(success ? ADP_STOPPED_APPLICATION_EXIT : ADP_STOPPED_RUN_TIME_ERROR)));
+    for (;;)
+    {
+    }
+}
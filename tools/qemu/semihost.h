@@ -0,0 +1,28 @@
+#ifndef __SEMIHOST_H_
+#define __SEMIHOST_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#ifdef __cplusplus
+	extern "C" {
+#endif
+
+/**@brief Function for printing on the console of the emulator, formatted as printf.
+ *
+ * @details Goes through ARM semihosting, out of band from the UART of the application. Lines
+ *          longer than 127 characters are cut. Usable at any priority.
+ */
+void semihost_printf(char const * p_format, ...) __attribute__((format(printf, 1, 2)));
+
+/**@brief Function for stopping the emulator.
+ *
+ * @param[in] success  false makes qemu-system-arm exit with status 1.
+ */
+void semihost_exit(bool success) __attribute__((noreturn));
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
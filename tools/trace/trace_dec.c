@@ -0,0 +1,153 @@
+/* Host decoder of the firmware trace (cus_trace).
+ *
+ * Reads the UART output on stdin, or from a file, and writes it to stdout with the trace records
+ * replaced by text lines: the time since reset in seconds, then the event formatted with
+ * cus_trace_ids.h. The other bytes are passed through unchanged.
+ *
+ *     stty -F /dev/ttyACM0 115200 raw && ./trace_dec < /dev/ttyACM0
+ */
+#include "cus_trace.h"
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#define RTC_FREQ                        32768
+#define STAMP_MASK                      0x00FFFFFFu
+
+#define TRACE_FORMAT(id, format)        format,
+
+static const char * const m_formats[] =
+{
+    CUS_TRACE_EVENTS(TRACE_FORMAT)
+};
+
+static unsigned  m_prescaler;                                      /* APP_TIMER_PRESCALER of the firmware. */
+static uint32_t  m_last_stamp;
+static uint64_t  m_wraps;
+static int       m_at_line_start = 1;
+
+
+static void text_put(uint8_t byte)
+{
+    putchar(byte);
+    m_at_line_start = (byte == '\n');
+}
+
+
+static void record_print(uint8_t const * p_entry)
+{
+    uint32_t stamp_id = (uint32_t)p_entry[0] | ((uint32_t)p_entry[1] << 8) |
+                        ((uint32_t)p_entry[2] << 16) | ((uint32_t)p_entry[3] << 24);
+    unsigned arg0     = p_entry[4] | (p_entry[5] << 8);
+    unsigned arg1     = p_entry[6] | (p_entry[7] << 8);
+    unsigned id       = stamp_id >> 24;
+    uint32_t stamp    = stamp_id & STAMP_MASK;
+
+    /* Loss reports are stamped when sent, not in order with the entries around them. */
+    if (id != CUS_TRACE_LOST)
+    {
+        if (stamp < m_last_stamp)
+        {
+            m_wraps++;
+        }
+        m_last_stamp = stamp;
+    }
+
+    if (!m_at_line_start)
+    {
+        putchar('\n');
+    }
+
+    printf("[%12.6f] ", (double)((m_wraps << 24) | stamp) * (m_prescaler + 1) / RTC_FREQ);
+    if (id < CUS_TRACE_ID_COUNT)
+    {
+        printf(m_formats[id], arg0, arg1);
+    }
+    else
+    {
+        printf("unknown event %u (%u, %u)", id, arg0, arg1);
+    }
+    putchar('\n');
+    m_at_line_start = 1;
+}
+
+
+static int record_valid(uint8_t const * p_record)
+{
+    uint8_t check = 0;
+
+    for (int i = 2; i < 2 + CUS_TRACE_ENTRY_LEN; i++)
+    {
+        check ^= p_record[i];
+    }
+    return check == p_record[2 + CUS_TRACE_ENTRY_LEN];
+}
+
+
+int main(int argc, char ** argv)
+{
+    uint8_t window[CUS_TRACE_RECORD_LEN];
+    size_t  len = 0;
+    FILE  * p_in = stdin;
+    int     c;
+    int     opt;
+
+    while ((opt = getopt(argc, argv, "p:")) != -1)
+    {
+        if (opt == 'p')
+        {
+            m_prescaler = (unsigned)strtoul(optarg, NULL, 0);
+        }
+        else
+        {
+            fprintf(stderr, "usage: %s [-p app_timer_prescaler] [file]\n", argv[0]);
+            return 2;
+        }
+    }
+    if (optind < argc)
+    {
+        p_in = fopen(argv[optind], "rb");
+        if (p_in == NULL)
+        {
+            perror(argv[optind]);
+            return 1;
+        }
+    }
+
+    while ((c = getc(p_in)) != EOF)
+    {
+        window[len++] = (uint8_t)c;
+
+        while (len > 0)
+        {
+            int is_record = (window[0] == CUS_TRACE_SYNC_0) &&
+                            ((len < 2) || (window[1] == CUS_TRACE_SYNC_1));
+
+            if (is_record && (len < CUS_TRACE_RECORD_LEN))
+            {
+                break;
+            }
+            if (is_record && record_valid(window))
+            {
+                record_print(&window[2]);
+                len = 0;
+                break;
+            }
+
+            /* Not a record, or one cut by other output: the first byte is text. */
+            text_put(window[0]);
+            memmove(window, &window[1], --len);
+        }
+        fflush(stdout);
+    }
+
+    for (size_t i = 0; i < len; i++)
+    {
+        text_put(window[i]);
+    }
+
+    return 0;
+}